@@ -2,13 +2,17 @@
 #include <ggl/buffer.h>
 #include <ggl/bump_alloc.h>
 #include <ggl/core_bus/client.h>
+#include <ggl/core_bus/constants.h>
 #include <ggl/error.h>
 #include <ggl/json_decode.h>
 #include <ggl/log.h>
 #include <ggl/object.h>
+#include <ggl/utils.h>
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 static char *print_key_path(GglList *key_path) {
     static char path_string[64] = { 0 };
@@ -93,6 +97,9 @@ static void test_insert(
 
 static void compare_objects(GglObject expected, GglObject result);
 
+// Number of mismatches found by compare_objects
+static int compare_failures = 0;
+
 // NOLINTNEXTLINE(misc-no-recursion)
 static void compare_lists(GglList expected, GglList result) {
     if (result.len != expected.len) {
@@ -101,6 +108,7 @@ static void compare_lists(GglList expected, GglList result) {
             (int) expected.len,
             (int) result.len
         );
+        compare_failures++;
         return;
     }
     for (size_t i = 0; i < expected.len; i++) {
@@ -118,6 +126,7 @@ static void compare_maps(GglMap expected, GglMap result) {
             (int) expected.len,
             (int) result.len
         );
+        compare_failures++;
         return;
     }
     for (size_t i = 0; i < expected.len; i++) {
@@ -143,6 +152,7 @@ static void compare_maps(GglMap expected, GglMap result) {
                 (int) expected_key.len,
                 (char *) expected_key.data
             );
+            compare_failures++;
         }
     }
 }
@@ -153,43 +163,45 @@ static void compare_objects(GglObject expected, GglObject result) {
     case GGL_TYPE_BOOLEAN:
         if (result.type != GGL_TYPE_BOOLEAN) {
             GGL_LOGE("expected boolean, got %d", result.type);
+            compare_failures++;
             return;
         }
         if (result.boolean != expected.boolean) {
             GGL_LOGE("expected %d got %d", expected.boolean, result.boolean);
+            compare_failures++;
         }
         break;
     case GGL_TYPE_I64:
         if (result.type != GGL_TYPE_I64) {
             GGL_LOGE("expected i64, got %d", result.type);
+            compare_failures++;
             return;
         }
         if (result.i64 != expected.i64) {
             GGL_LOGE(
                 "expected %" PRId64 " got %" PRId64, expected.i64, result.i64
             );
+            compare_failures++;
         }
         break;
     case GGL_TYPE_F64:
         if (result.type != GGL_TYPE_F64) {
             GGL_LOGE("expected f64, got %d", result.type);
+            compare_failures++;
             return;
         }
         if (result.f64 != expected.f64) {
             GGL_LOGE("expected %f got %f", expected.f64, result.f64);
+            compare_failures++;
         }
         break;
     case GGL_TYPE_BUF:
         if (result.type != GGL_TYPE_BUF) {
             GGL_LOGE("expected buffer, got %d", result.type);
+            compare_failures++;
             return;
         }
-        if (strncmp(
-                (const char *) result.buf.data,
-                (const char *) expected.buf.data,
-                result.buf.len
-            )
-            != 0) {
+        if (!ggl_buffer_eq(result.buf, expected.buf)) {
             GGL_LOGE(
                 "expected %.*s got %.*s",
                 (int) expected.buf.len,
@@ -197,12 +209,14 @@ static void compare_objects(GglObject expected, GglObject result) {
                 (int) result.buf.len,
                 (char *) result.buf.data
             );
+            compare_failures++;
             return;
         }
         break;
     case GGL_TYPE_LIST:
         if (result.type != GGL_TYPE_LIST) {
             GGL_LOGE("expected list, got %d", result.type);
+            compare_failures++;
             return;
         }
         compare_lists(expected.list, result.list);
@@ -210,6 +224,7 @@ static void compare_objects(GglObject expected, GglObject result) {
     case GGL_TYPE_MAP:
         if (result.type != GGL_TYPE_MAP) {
             GGL_LOGE("expected map, got %d", result.type);
+            compare_failures++;
             return;
         }
         compare_maps(expected.map, result.map);
@@ -217,11 +232,13 @@ static void compare_objects(GglObject expected, GglObject result) {
     case GGL_TYPE_NULL:
         if (result.type != GGL_TYPE_NULL) {
             GGL_LOGE("expected null, got %d", result.type);
+            compare_failures++;
             return;
         }
         break;
     default:
         GGL_LOGE("unexpected type %d", expected.type);
+        compare_failures++;
         break;
     }
 }
@@ -350,6 +367,96 @@ static void test_subscribe(GglList key, GglError expected_response) {
     }
 }
 
+typedef struct {
+    atomic_int count;
+    atomic_size_t path_len;
+} UpdateCount;
+
+static GglError count_updates_callback(
+    void *ctx, unsigned int handle, GglObject data
+) {
+    (void) handle;
+    UpdateCount *updates = ctx;
+    if (data.type != GGL_TYPE_LIST) {
+        GGL_LOGE("expected a list ");
+        return GGL_ERR_OK;
+    }
+    GGL_LOGI("read %s", print_key_path(&data.list));
+    atomic_store(&updates->path_len, data.list.len);
+    atomic_fetch_add(&updates->count, 1);
+    return GGL_ERR_OK;
+}
+
+// A write of several keys under a component's configuration root must notify
+// a subscriber of the root once, with the root's own three element path. IPC
+// reports this as an update with an empty keyPath.
+static void test_multi_key_write_notification(void) {
+    GglList config_root = GGL_LIST(
+        GGL_OBJ_BUF(GGL_STR("services")),
+        GGL_OBJ_BUF(GGL_STR("component5")),
+        GGL_OBJ_BUF(GGL_STR("configuration"))
+    );
+    test_insert(
+        config_root,
+        GGL_OBJ_MAP(GGL_MAP({ GGL_STR("alpha"), GGL_OBJ_BUF(GGL_STR("a")) })),
+        -1,
+        GGL_ERR_OK
+    );
+
+    static UpdateCount updates = { 0 };
+    uint32_t handle = 0;
+    GglError error = ggl_subscribe(
+        GGL_STR("gg_config"),
+        GGL_STR("subscribe"),
+        GGL_MAP({ GGL_STR("key_path"), GGL_OBJ_LIST(config_root) }),
+        count_updates_callback,
+        subscription_close,
+        &updates,
+        NULL,
+        &handle
+    );
+    if (error != GGL_ERR_OK) {
+        GGL_LOGE(
+            "subscribe key %s failed with %s",
+            print_key_path(&config_root),
+            ggl_strerror(error)
+        );
+        assert(0);
+        return;
+    }
+
+    test_insert(
+        config_root,
+        GGL_OBJ_MAP(GGL_MAP(
+            { GGL_STR("alpha"), GGL_OBJ_BUF(GGL_STR("data")) },
+            { GGL_STR("bravo"), GGL_OBJ_BUF(GGL_STR("data")) },
+            { GGL_STR("charlie"), GGL_OBJ_BUF(GGL_STR("data")) }
+        )),
+        -1,
+        GGL_ERR_OK
+    );
+    (void) ggl_sleep_ms(500);
+
+    if (atomic_load(&updates.count) != 1) {
+        GGL_LOGE(
+            "expected one notification for %s but got %d",
+            print_key_path(&config_root),
+            atomic_load(&updates.count)
+        );
+        assert(0);
+    }
+    if (atomic_load(&updates.path_len) != config_root.len) {
+        GGL_LOGE(
+            "expected notification of %s but got a path of length %zu",
+            print_key_path(&config_root),
+            atomic_load(&updates.path_len)
+        );
+        assert(0);
+    }
+
+    ggl_client_sub_close(handle);
+}
+
 /*
 test case for test_write_object
 component = "component"
@@ -409,9 +516,144 @@ static void test_write_object(void) {
     GGL_LOGI("test complete %d", error);
 }
 
+// Reads of a database created from fixtures/config-0.1.sql, which must be the
+// same as those of database version 0.1 once ggconfigd has migrated it
+static void test_migrated_values(void) {
+    GglObject nested = GGL_OBJ_MAP(GGL_MAP(
+        { GGL_STR("key"), GGL_OBJ_BUF(GGL_STR("nested value")) }
+    ));
+    GglMap expected = GGL_MAP(
+        { GGL_STR("string"), GGL_OBJ_BUF(GGL_STR("value")) },
+        { GGL_STR("integer"), GGL_OBJ_I64(-42) },
+        { GGL_STR("float"), GGL_OBJ_F64(1.5) },
+        { GGL_STR("true"), GGL_OBJ_BOOL(true) },
+        { GGL_STR("false"), GGL_OBJ_BOOL(false) },
+        { GGL_STR("null"), GGL_OBJ_NULL() },
+        { GGL_STR("list"),
+          GGL_OBJ_LIST(GGL_LIST(
+              GGL_OBJ_BUF(GGL_STR("a")),
+              GGL_OBJ_I64(1),
+              GGL_OBJ_BOOL(true),
+              GGL_OBJ_NULL(),
+              GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_F64(2.5)))
+          )) },
+        { GGL_STR("nested"), nested },
+    );
+
+    compare_failures = 0;
+    for (size_t i = 0; i < expected.len; i++) {
+        test_get(
+            GGL_LIST(
+                GGL_OBJ_BUF(GGL_STR("migrated")),
+                GGL_OBJ_BUF(expected.pairs[i].key)
+            ),
+            expected.pairs[i].val,
+            GGL_ERR_OK
+        );
+    }
+    test_get(
+        GGL_LIST(GGL_OBJ_BUF(GGL_STR("migrated"))),
+        GGL_OBJ_MAP(expected),
+        GGL_ERR_OK
+    );
+    if (compare_failures != 0) {
+        GGL_LOGE(
+            "%d migrated values differ from version 0.1.", compare_failures
+        );
+        assert(0);
+    }
+}
+
+// Matches GGCONFIGD_CHECKPOINT_IDLE_MS
+#define CHECKPOINT_IDLE_MS 2000
+
+// Write key until count writes are done, returning how many failed
+static int write_repeatedly(GglBuffer key, int64_t count) {
+    int failures = 0;
+    for (int64_t i = 0; i < count; i++) {
+        static uint8_t result_mem[256];
+        GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(result_mem));
+        GglObject result;
+        GglError remote_error = GGL_ERR_OK;
+        GglError error = ggl_call(
+            GGL_STR("gg_config"),
+            GGL_STR("write"),
+            GGL_MAP(
+                { GGL_STR("key_path"),
+                  GGL_OBJ_LIST(GGL_LIST(
+                      GGL_OBJ_BUF(GGL_STR("checkpoint")), GGL_OBJ_BUF(key)
+                  )) },
+                { GGL_STR("value"), GGL_OBJ_I64(i) }
+            ),
+            &remote_error,
+            &balloc.alloc,
+            &result
+        );
+        if (error != GGL_ERR_OK) {
+            failures += 1;
+        }
+    }
+    return failures;
+}
+
+// Writes must succeed while the write-ahead log is being checkpointed, which
+// happens once writes have been idle for CHECKPOINT_IDLE_MS. Each round grows
+// the log, so the checkpoint that follows the idle period takes a while, and
+// writes right as it starts.
+static void test_writes_during_checkpoint(void) {
+    int failures = 0;
+    for (int round = 0; round < 5; round++) {
+        failures += write_repeatedly(GGL_STR("fill"), 2000);
+        (void) ggl_sleep_ms(CHECKPOINT_IDLE_MS + (round * 5));
+        failures += write_repeatedly(GGL_STR("during"), 200);
+    }
+    if (failures != 0) {
+        GGL_LOGE("%d writes failed while checkpointing.", failures);
+        assert(0);
+    }
+}
+
+// Calls must keep working after their cached connections have been idle long
+// enough for ggconfigd to close them. By default this waits past when both
+// sides close them; a shorter wait can be given to test a ggconfigd built with
+// a lower GGL_COREBUS_IDLE_CLOSE_MS, which closes connections configtest would
+// still reuse.
+static void test_reconnect(int64_t idle_ms) {
+    int failures = 0;
+    for (int round = 0; round < 3; round++) {
+        failures += write_repeatedly(GGL_STR("reconnect"), 10);
+        (void) ggl_sleep_ms(idle_ms);
+    }
+    failures += write_repeatedly(GGL_STR("reconnect"), 10);
+    if (failures != 0) {
+        GGL_LOGE("%d writes failed after connections went idle.", failures);
+        assert(0);
+    }
+}
+
 int main(int argc, char **argv) {
-    (void) argc;
-    (void) argv;
+    // Run against a database created from fixtures/config-0.1.sql
+    if ((argc > 1) && (strcmp(argv[1], "migrated") == 0)) {
+        test_migrated_values();
+        return compare_failures == 0 ? 0 : 1;
+    }
+    // Run against ggconfigd started with `--db-profile wal`
+    if ((argc > 1) && (strcmp(argv[1], "checkpoint") == 0)) {
+        test_writes_during_checkpoint();
+        return 0;
+    }
+    if ((argc > 1) && (strcmp(argv[1], "reconnect") == 0)) {
+        // Idle connections are closed within a quarter of the limit past it
+        int64_t idle_ms = (GGL_COREBUS_IDLE_CLOSE_MS * 5 / 4) + 1000;
+        if ((argc > 2)
+            && (ggl_str_to_int64(ggl_buffer_from_null_term(argv[2]), &idle_ms)
+                != GGL_ERR_OK)) {
+            GGL_LOGE("Invalid idle time %s.", argv[2]);
+            return 1;
+        }
+        test_reconnect(idle_ms);
+        return 0;
+    }
 
     // Test to ensure getting a key which doesn't exist works
     test_get(
@@ -901,10 +1143,8 @@ int main(int argc, char **argv) {
     //     possible?
     // );
 
-    // TODO: verify If you have a subscriber on /foo and write
-    // /foo/bar/baz = {"alpha":"data","bravo":"data","charlie":"data"}
-    // , it should only signal the notification once.
-    // This behavior needs to be implemented first.
+    // Test to ensure a write of several keys signals a subscriber once
+    test_multi_key_write_notification();
 
     return 0;
 }
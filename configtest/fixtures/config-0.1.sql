@@ -0,0 +1,70 @@
+-- Configuration database written by ggconfigd with database version 0.1,
+-- which stored values as json text. ggconfigd migrates it when opened; reads
+-- must match those of version 0.1. Verified by `configtest migrated`.
+CREATE TABLE keyTable (
+  'keyid' INTEGER PRIMARY KEY AUTOINCREMENT UNIQUE NOT NULL,
+  'keyvalue' TEXT NOT NULL COLLATE BINARY
+);
+
+CREATE TABLE relationTable (
+  'keyid' INT UNIQUE NOT NULL,
+  'parentid' INT NOT NULL,
+  PRIMARY KEY (keyid),
+  FOREIGN KEY (keyid) REFERENCES keyTable (keyid),
+  FOREIGN KEY (parentid) REFERENCES keyTable (keyid)
+);
+
+CREATE TABLE valueTable (
+  'keyid' INT UNIQUE NOT NULL,
+  'value' TEXT NOT NULL,
+  'timeStamp' INTEGER NOT NULL,
+  FOREIGN KEY (keyid) REFERENCES keyTable (keyid)
+);
+
+CREATE TABLE version ('version' TEXT DEFAULT '0.1');
+
+CREATE INDEX idx_parentid ON relationTable (parentid);
+
+INSERT INTO
+  version (version)
+VALUES
+  ('0.1');
+
+INSERT INTO
+  keyTable (keyid, keyvalue)
+VALUES
+  (1, 'migrated'),
+  (2, 'string'),
+  (3, 'integer'),
+  (4, 'float'),
+  (5, 'true'),
+  (6, 'false'),
+  (7, 'null'),
+  (8, 'list'),
+  (9, 'nested'),
+  (10, 'key');
+
+INSERT INTO
+  relationTable (keyid, parentid)
+VALUES
+  (2, 1),
+  (3, 1),
+  (4, 1),
+  (5, 1),
+  (6, 1),
+  (7, 1),
+  (8, 1),
+  (9, 1),
+  (10, 9);
+
+INSERT INTO
+  valueTable (keyid, value, timeStamp)
+VALUES
+  (2, '"value"', 1723142212),
+  (3, '-42', 1723142212),
+  (4, '1.5', 1723142212),
+  (5, 'true', 1723142212),
+  (6, 'false', 1723142212),
+  (7, 'null', 1723142212),
+  (8, '["a",1,true,null,[2.5]]', 1723142212),
+  (10, '"nested value"', 1723142212);
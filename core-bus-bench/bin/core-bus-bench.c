@@ -0,0 +1,80 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "core-bus-bench.h"
+#include <argp.h>
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <ggl/version.h>
+#include <stdint.h>
+
+__attribute__((visibility("default"))) const char *argp_program_version
+    = GGL_VERSION;
+
+static char doc[] = "core-bus-bench -- Core bus latency and throughput "
+                    "benchmark";
+
+static struct argp_option opts[] = {
+    { "interface_name", 'n', "name", 0, "Core bus interface to serve on", 0 },
+    { "mode", 'm', "call|notify|subscribe|all", 0, "Operations to run", 0 },
+    { "threads", 't', "count", 0, "Concurrent clients or subscribers", 0 },
+    { "count", 'c', "count", 0, "Messages per client or subscriber", 0 },
+    { "payload", 'p', "bytes", 0, "Payload size in bytes", 0 },
+    { "workers", 'w', "count", 0, "Server worker threads", 0 },
+    { 0 }
+};
+
+static uint32_t parse_u32(char *arg, struct argp_state *state) {
+    int64_t val = 0;
+    GglError ret = ggl_str_to_int64(ggl_buffer_from_null_term(arg), &val);
+    if ((ret != GGL_ERR_OK) || (val < 0) || (val > UINT32_MAX)) {
+        // NOLINTNEXTLINE(concurrency-mt-unsafe)
+        argp_error(state, "Invalid number: %s", arg);
+    }
+    return (uint32_t) val;
+}
+
+static error_t arg_parser(int key, char *arg, struct argp_state *state) {
+    CoreBusBenchArgs *args = state->input;
+    switch (key) {
+    case 'n':
+        args->interface_name = arg;
+        break;
+    case 'm':
+        args->mode = arg;
+        break;
+    case 't':
+        args->threads = parse_u32(arg, state);
+        break;
+    case 'c':
+        args->count = parse_u32(arg, state);
+        break;
+    case 'p':
+        args->payload_len = parse_u32(arg, state);
+        break;
+    case 'w':
+        args->workers = parse_u32(arg, state);
+        break;
+    case ARGP_KEY_END:
+        // All options have defaults in run_core_bus_bench.
+        break;
+    default:
+        return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = { opts, arg_parser, 0, doc, 0, 0, 0 };
+
+int main(int argc, char **argv) {
+    static CoreBusBenchArgs args = { 0 };
+
+    // NOLINTNEXTLINE(concurrency-mt-unsafe)
+    argp_parse(&argp, argc, argv, 0, 0, &args);
+
+    GglError ret = run_core_bus_bench(&args);
+    if (ret != GGL_ERR_OK) {
+        return 1;
+    }
+}
@@ -0,0 +1,22 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CORE_BUS_BENCH_H
+#define CORE_BUS_BENCH_H
+
+#include <ggl/error.h>
+#include <stdint.h>
+
+typedef struct {
+    char *interface_name;
+    char *mode;
+    uint32_t threads;
+    uint32_t count;
+    uint32_t payload_len;
+    uint32_t workers;
+} CoreBusBenchArgs;
+
+GglError run_core_bus_bench(CoreBusBenchArgs *args);
+
+#endif
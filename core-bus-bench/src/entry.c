@@ -0,0 +1,503 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "core-bus-bench.h"
+#include <ggl/buffer.h>
+#include <ggl/core_bus/client.h>
+#include <ggl/core_bus/constants.h>
+#include <ggl/core_bus/server.h>
+#include <ggl/error.h>
+#include <ggl/log.h>
+#include <ggl/map.h>
+#include <ggl/object.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Serves an echo interface and drives it from client threads in the same
+// process, measuring per-message latency and overall message rate. Both client
+// and server run here, so results include both sides' CPU time.
+
+#define BENCH_MAX_THREADS 64
+#define BENCH_MAX_SAMPLES (1024 * 1024)
+#define BENCH_MAX_PAYLOAD (1024 * 1024)
+
+/// Max subscription responses in flight per subscriber.
+/// Keeps the publisher from overrunning the server's subscriber queue.
+#define BENCH_SUB_WINDOW 16
+
+/// Time to wait for the server or for messages before giving up.
+#define BENCH_TIMEOUT_NS (60ULL * 1000000000ULL)
+
+static_assert(
+    BENCH_MAX_PAYLOAD <= GGL_COREBUS_SHM_MAX_LEN,
+    "Benchmark payloads must fit in shared memory."
+);
+
+static uint8_t payload_mem[BENCH_MAX_PAYLOAD];
+static uint64_t samples[BENCH_MAX_SAMPLES];
+
+static atomic_size_t notify_received;
+static _Atomic(uint32_t) sub_handles[BENCH_MAX_THREADS];
+static atomic_size_t sub_received[BENCH_MAX_THREADS];
+static atomic_bool sub_closing;
+static atomic_bool sub_failed;
+
+typedef struct {
+    CoreBusBenchArgs *args;
+    uint32_t id;
+    GglError ret;
+} BenchThread;
+
+typedef void *(*BenchThreadFn)(void *ctx);
+
+static BenchThread bench_threads[BENCH_MAX_THREADS];
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000U) + (uint64_t) ts.tv_nsec;
+}
+
+static void sleep_briefly(void) {
+    struct timespec ts = { .tv_nsec = 10000 };
+    nanosleep(&ts, NULL);
+}
+
+static GglBuffer interface(CoreBusBenchArgs *args) {
+    return ggl_buffer_from_null_term(args->interface_name);
+}
+
+static GglBuffer payload(CoreBusBenchArgs *args) {
+    return (GglBuffer) { .data = payload_mem, .len = args->payload_len };
+}
+
+static GglError handle_echo(void *ctx, GglMap params, uint32_t handle) {
+    (void) ctx;
+    ggl_respond(handle, GGL_OBJ_MAP(params));
+    return GGL_ERR_OK;
+}
+
+static GglError handle_sink(void *ctx, GglMap params, uint32_t handle) {
+    (void) ctx;
+    (void) params;
+    atomic_fetch_add(&notify_received, 1);
+    ggl_respond(handle, GGL_OBJ_NULL());
+    return GGL_ERR_OK;
+}
+
+static GglError handle_stream(void *ctx, GglMap params, uint32_t handle) {
+    (void) ctx;
+    GglObject *id_obj = NULL;
+    if (!ggl_map_get(params, GGL_STR("id"), &id_obj)
+        || (id_obj->type != GGL_TYPE_I64) || (id_obj->i64 < 0)
+        || (id_obj->i64 >= BENCH_MAX_THREADS)) {
+        return GGL_ERR_INVALID;
+    }
+    ggl_sub_accept(handle, NULL, NULL);
+    atomic_store(&sub_handles[id_obj->i64], handle);
+    return GGL_ERR_OK;
+}
+
+static void *server_thread(void *ctx) {
+    CoreBusBenchArgs *args = ctx;
+
+    static GglRpcMethodDesc handlers[] = {
+        { GGL_STR("echo"), false, handle_echo, NULL, true },
+        { GGL_STR("sink"), false, handle_sink, NULL, true },
+        { GGL_STR("stream"), true, handle_stream, NULL, true },
+    };
+    size_t handlers_len = sizeof(handlers) / sizeof(handlers[0]);
+
+    ggl_listen_threaded(interface(args), handlers, handlers_len, args->workers);
+
+    GGL_LOGE("Benchmark server exited.");
+    return NULL;
+}
+
+static GglError wait_for_server(CoreBusBenchArgs *args) {
+    uint64_t deadline = now_ns() + BENCH_TIMEOUT_NS;
+    while (true) {
+        GglError ret = ggl_call(
+            interface(args), GGL_STR("echo"), GGL_MAP(), NULL, NULL, NULL
+        );
+        if (ret == GGL_ERR_OK) {
+            return GGL_ERR_OK;
+        }
+        if (now_ns() > deadline) {
+            GGL_LOGE("Benchmark server did not start.");
+            return ret;
+        }
+        sleep_briefly();
+    }
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(size_t total, size_t per_mille) {
+    size_t index = (total * per_mille) / 1000;
+    if (index >= total) {
+        index = total - 1;
+    }
+    return (double) samples[index] / 1000.0;
+}
+
+static void report(CoreBusBenchArgs *args, const char *mode, uint64_t elapsed) {
+    size_t total = (size_t) args->threads * args->count;
+    qsort(samples, total, sizeof(samples[0]), compare_u64);
+
+    GGL_LOGI(
+        "%s: %u threads, %u byte payload, %zu messages in %.3f s "
+        "(%.0f msgs/s); latency p50 %.1f us, p99 %.1f us, p999 %.1f us.",
+        mode,
+        args->threads,
+        args->payload_len,
+        total,
+        (double) elapsed / 1e9,
+        (double) total * 1e9 / (double) elapsed,
+        percentile_us(total, 500),
+        percentile_us(total, 990),
+        percentile_us(total, 999)
+    );
+}
+
+static void init_threads(CoreBusBenchArgs *args) {
+    for (uint32_t i = 0; i < args->threads; i++) {
+        bench_threads[i]
+            = (BenchThread) { .args = args, .id = i, .ret = GGL_ERR_OK };
+    }
+}
+
+/// Run `fn` on `args->threads` threads and wait for them to finish.
+static GglError run_threads(CoreBusBenchArgs *args, BenchThreadFn fn) {
+    static pthread_t thread_ids[BENCH_MAX_THREADS];
+
+    uint32_t started = 0;
+    for (; started < args->threads; started++) {
+        int sys_ret = pthread_create(
+            &thread_ids[started], NULL, fn, &bench_threads[started]
+        );
+        if (sys_ret != 0) {
+            GGL_LOGE("Failed to create benchmark thread.");
+            break;
+        }
+    }
+
+    GglError ret = (started == args->threads) ? GGL_ERR_OK : GGL_ERR_FATAL;
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(thread_ids[i], NULL);
+        if (bench_threads[i].ret != GGL_ERR_OK) {
+            ret = bench_threads[i].ret;
+        }
+    }
+    return ret;
+}
+
+static void *call_thread(void *ctx) {
+    BenchThread *thread = ctx;
+    CoreBusBenchArgs *args = thread->args;
+    uint64_t *out = &samples[(size_t) thread->id * args->count];
+
+    GglMap params = GGL_MAP({ GGL_STR("data"), GGL_OBJ_BUF(payload(args)) });
+
+    for (uint32_t i = 0; i < args->count; i++) {
+        uint64_t start = now_ns();
+        GglError ret = ggl_call(
+            interface(args), GGL_STR("echo"), params, NULL, NULL, NULL
+        );
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGE("Benchmark call failed.");
+            thread->ret = ret;
+            return NULL;
+        }
+        out[i] = now_ns() - start;
+    }
+    return NULL;
+}
+
+static GglError bench_call(CoreBusBenchArgs *args) {
+    init_threads(args);
+    uint64_t start = now_ns();
+    GglError ret = run_threads(args, call_thread);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    report(args, "call", now_ns() - start);
+    return GGL_ERR_OK;
+}
+
+static void *notify_thread(void *ctx) {
+    BenchThread *thread = ctx;
+    CoreBusBenchArgs *args = thread->args;
+    uint64_t *out = &samples[(size_t) thread->id * args->count];
+
+    GglMap params = GGL_MAP({ GGL_STR("data"), GGL_OBJ_BUF(payload(args)) });
+
+    for (uint32_t i = 0; i < args->count; i++) {
+        uint64_t start = now_ns();
+        GglError ret = ggl_notify(interface(args), GGL_STR("sink"), params);
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGE("Benchmark notify failed.");
+            thread->ret = ret;
+            return NULL;
+        }
+        out[i] = now_ns() - start;
+    }
+    return NULL;
+}
+
+static GglError bench_notify(CoreBusBenchArgs *args) {
+    size_t total = (size_t) args->threads * args->count;
+    atomic_store(&notify_received, 0);
+    init_threads(args);
+
+    uint64_t start = now_ns();
+    GglError ret = run_threads(args, notify_thread);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    // Latency is time to send; rate counts until the server has handled all
+    while (atomic_load(&notify_received) < total) {
+        if (now_ns() - start > BENCH_TIMEOUT_NS) {
+            GGL_LOGE(
+                "Server handled %zu of %zu notifications.",
+                atomic_load(&notify_received),
+                total
+            );
+            return GGL_ERR_FAILURE;
+        }
+        sleep_briefly();
+    }
+    report(args, "notify", now_ns() - start);
+    return GGL_ERR_OK;
+}
+
+/// Number of subscription responses a publisher may have in flight.
+static size_t sub_window(CoreBusBenchArgs *args) {
+    // Allow for the message headers and the rest of the response map
+    size_t message_len = (size_t) args->payload_len + 128;
+    if (message_len > GGL_COREBUS_MAX_MSG_LEN) {
+        // Sent through shared memory, which is only done with an empty queue
+        return 1;
+    }
+    size_t window = GGL_COREBUS_SUB_QUEUE_LEN / message_len;
+    if (window > BENCH_SUB_WINDOW) {
+        return BENCH_SUB_WINDOW;
+    }
+    return (window == 0) ? 1 : window;
+}
+
+static GglError on_sub_response(void *ctx, uint32_t handle, GglObject data) {
+    (void) handle;
+    BenchThread *thread = ctx;
+    uint64_t received = now_ns();
+
+    GglObject *sent = NULL;
+    if ((data.type != GGL_TYPE_MAP)
+        || !ggl_map_get(data.map, GGL_STR("sent"), &sent)
+        || (sent->type != GGL_TYPE_I64)) {
+        GGL_LOGE("Malformed benchmark subscription response.");
+        return GGL_ERR_INVALID;
+    }
+
+    // Responses for a subscription are handled by a single thread
+    size_t index = atomic_load(&sub_received[thread->id]);
+    if (index < thread->args->count) {
+        samples[((size_t) thread->id * thread->args->count) + index]
+            = received - (uint64_t) sent->i64;
+    }
+    atomic_store(&sub_received[thread->id], index + 1);
+    return GGL_ERR_OK;
+}
+
+static void on_sub_close(void *ctx, uint32_t handle) {
+    (void) ctx;
+    (void) handle;
+    if (!atomic_load(&sub_closing)) {
+        GGL_LOGE("Benchmark subscription closed early.");
+        atomic_store(&sub_failed, true);
+    }
+}
+
+static void *publish_thread(void *ctx) {
+    BenchThread *thread = ctx;
+    CoreBusBenchArgs *args = thread->args;
+    uint32_t handle = atomic_load(&sub_handles[thread->id]);
+    size_t window = sub_window(args);
+
+    for (uint32_t i = 0; i < args->count; i++) {
+        while (i - atomic_load(&sub_received[thread->id]) >= window) {
+            if (atomic_load(&sub_failed)) {
+                thread->ret = GGL_ERR_FAILURE;
+                return NULL;
+            }
+            sleep_briefly();
+        }
+
+        ggl_sub_respond(
+            handle,
+            GGL_OBJ_MAP(GGL_MAP(
+                { GGL_STR("sent"), GGL_OBJ_I64((int64_t) now_ns()) },
+                { GGL_STR("data"), GGL_OBJ_BUF(payload(args)) }
+            ))
+        );
+    }
+
+    while (atomic_load(&sub_received[thread->id]) < args->count) {
+        if (atomic_load(&sub_failed)) {
+            thread->ret = GGL_ERR_FAILURE;
+            return NULL;
+        }
+        sleep_briefly();
+    }
+    return NULL;
+}
+
+static GglError bench_subscribe(CoreBusBenchArgs *args) {
+    static uint32_t client_handles[BENCH_MAX_THREADS];
+
+    atomic_store(&sub_closing, false);
+    atomic_store(&sub_failed, false);
+    init_threads(args);
+
+    GglError ret = GGL_ERR_OK;
+    uint32_t subscribed = 0;
+    for (; subscribed < args->threads; subscribed++) {
+        atomic_store(&sub_handles[subscribed], 0);
+        atomic_store(&sub_received[subscribed], 0);
+        ret = ggl_subscribe(
+            interface(args),
+            GGL_STR("stream"),
+            GGL_MAP({ GGL_STR("id"), GGL_OBJ_I64(subscribed) }),
+            on_sub_response,
+            on_sub_close,
+            &bench_threads[subscribed],
+            NULL,
+            &client_handles[subscribed]
+        );
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGE("Failed to subscribe to benchmark server.");
+            break;
+        }
+    }
+
+    if (ret == GGL_ERR_OK) {
+        // Server handles are stored by the handler after accepting
+        for (uint32_t i = 0; i < args->threads; i++) {
+            while (atomic_load(&sub_handles[i]) == 0) {
+                sleep_briefly();
+            }
+        }
+
+        uint64_t start = now_ns();
+        ret = run_threads(args, publish_thread);
+        if (ret == GGL_ERR_OK) {
+            report(args, "subscribe", now_ns() - start);
+        }
+    }
+
+    atomic_store(&sub_closing, true);
+    for (uint32_t i = 0; i < subscribed; i++) {
+        ggl_client_sub_close(client_handles[i]);
+    }
+    return ret;
+}
+
+static bool mode_enabled(CoreBusBenchArgs *args, const char *mode) {
+    return (strcmp(args->mode, "all") == 0) || (strcmp(args->mode, mode) == 0);
+}
+
+GglError run_core_bus_bench(CoreBusBenchArgs *args) {
+    if (args->interface_name == NULL) {
+        args->interface_name = "core_bus_bench";
+    }
+    if (args->mode == NULL) {
+        args->mode = "all";
+    }
+    if (args->threads == 0) {
+        args->threads = 4;
+    }
+    if (args->count == 0) {
+        args->count = 10000;
+    }
+    if (args->workers == 0) {
+        args->workers = GGL_COREBUS_MAX_WORKERS;
+    }
+
+    if (!mode_enabled(args, "call") && !mode_enabled(args, "notify")
+        && !mode_enabled(args, "subscribe")) {
+        GGL_LOGE("Unknown benchmark mode %s.", args->mode);
+        return GGL_ERR_INVALID;
+    }
+    if (args->threads > BENCH_MAX_THREADS) {
+        GGL_LOGE("At most %d threads are supported.", BENCH_MAX_THREADS);
+        return GGL_ERR_RANGE;
+    }
+    if ((size_t) args->threads * args->count > BENCH_MAX_SAMPLES) {
+        GGL_LOGE(
+            "At most %d messages (threads * count) are supported.",
+            BENCH_MAX_SAMPLES
+        );
+        return GGL_ERR_RANGE;
+    }
+    if (args->payload_len > BENCH_MAX_PAYLOAD) {
+        GGL_LOGE("Payload may be at most %d bytes.", BENCH_MAX_PAYLOAD);
+        return GGL_ERR_RANGE;
+    }
+    if (args->workers > GGL_COREBUS_MAX_WORKERS) {
+        GGL_LOGE("At most %d workers are supported.", GGL_COREBUS_MAX_WORKERS);
+        return GGL_ERR_RANGE;
+    }
+
+    memset(payload_mem, 'x', args->payload_len);
+
+    pthread_t server;
+    if (pthread_create(&server, NULL, server_thread, args) != 0) {
+        GGL_LOGE("Failed to create benchmark server thread.");
+        return GGL_ERR_FATAL;
+    }
+    pthread_detach(server);
+
+    GglError ret = wait_for_server(args);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    GGL_LOGI(
+        "Benchmarking %s with %u server workers.",
+        args->interface_name,
+        args->workers
+    );
+
+    if (mode_enabled(args, "call")) {
+        ret = bench_call(args);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+    if (mode_enabled(args, "notify")) {
+        ret = bench_notify(args);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+    if (mode_enabled(args, "subscribe")) {
+        ret = bench_subscribe(args);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+    return GGL_ERR_OK;
+}
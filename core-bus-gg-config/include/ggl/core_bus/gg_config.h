@@ -37,4 +37,26 @@ GglError ggl_gg_config_subscribe(
     uint32_t *handle
 );
 
+/// Wrapper for core-bus `gg_config` `subscribe` with a debounce window
+/// Changes within `debounce_ms` of a notification are collapsed into one
+/// notification, sent when the window ends.
+GglError ggl_gg_config_subscribe_debounced(
+    GglBufList key_path,
+    uint32_t debounce_ms,
+    GglSubscribeCallback on_response,
+    GglSubscribeCloseCallback on_close,
+    void *ctx,
+    uint32_t *handle
+);
+
+/// Wrapper for core-bus `gg_config` `export`
+/// Writes a snapshot of the whole configuration to the regular file open for
+/// writing as `fd`. `fd` is not closed.
+GglError ggl_gg_config_export(int fd);
+
+/// Wrapper for core-bus `gg_config` `import`
+/// Replaces the whole configuration with the snapshot in the regular file open
+/// for reading as `fd`. Existing subscriptions are closed. `fd` is not closed.
+GglError ggl_gg_config_import(int fd);
+
 #endif
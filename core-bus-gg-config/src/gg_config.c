@@ -109,6 +109,19 @@ GglError ggl_gg_config_subscribe(
     GglSubscribeCloseCallback on_close,
     void *ctx,
     uint32_t *handle
+) {
+    return ggl_gg_config_subscribe_debounced(
+        key_path, 0, on_response, on_close, ctx, handle
+    );
+}
+
+GglError ggl_gg_config_subscribe_debounced(
+    GglBufList key_path,
+    uint32_t debounce_ms,
+    GglSubscribeCallback on_response,
+    GglSubscribeCloseCallback on_close,
+    void *ctx,
+    uint32_t *handle
 ) {
     if (key_path.len > GGL_MAX_OBJECT_DEPTH) {
         GGL_LOGE("Key path depth exceeds maximum handled.");
@@ -120,10 +133,13 @@ GglError ggl_gg_config_subscribe(
         path_obj[i] = GGL_OBJ_BUF(key_path.bufs[i]);
     }
 
-    GglMap args = GGL_MAP(
+    GglKV args_pairs[] = {
         { GGL_STR("key_path"),
           GGL_OBJ_LIST((GglList) { .items = path_obj, .len = key_path.len }) },
-    );
+        { GGL_STR("debounce_ms"), GGL_OBJ_I64(debounce_ms) },
+    };
+    // debounce_ms is omitted when not set
+    GglMap args = { .pairs = args_pairs, .len = (debounce_ms > 0) ? 2 : 1 };
 
     GglError remote_err = GGL_ERR_OK;
     GglError err = ggl_subscribe(
@@ -143,3 +159,24 @@ GglError ggl_gg_config_subscribe(
 
     return err;
 }
+
+static GglError snapshot_call(GglBuffer method, int fd) {
+    GglError remote_err = GGL_ERR_OK;
+    GglError err = ggl_call_with_fd(
+        GGL_STR("gg_config"), method, GGL_MAP(), fd, &remote_err, NULL, NULL
+    );
+
+    if ((err == GGL_ERR_REMOTE) && (remote_err != GGL_ERR_OK)) {
+        err = remote_err;
+    }
+
+    return err;
+}
+
+GglError ggl_gg_config_export(int fd) {
+    return snapshot_call(GGL_STR("export"), fd);
+}
+
+GglError ggl_gg_config_import(int fd) {
+    return snapshot_call(GGL_STR("import"), fd);
+}
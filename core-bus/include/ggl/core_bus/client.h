@@ -19,6 +19,22 @@
 #define GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS 100
 #endif
 
+/// Maximum number of cached core-bus connections for calls/notifications.
+/// Idle connections are closed when more are needed, or once idle for half of
+/// `GGL_COREBUS_IDLE_CLOSE_MS`.
+/// Can be configured with `-DGGL_COREBUS_CLIENT_MAX_CONNECTIONS=<N>`.
+#ifndef GGL_COREBUS_CLIENT_MAX_CONNECTIONS
+#define GGL_COREBUS_CLIENT_MAX_CONNECTIONS 16
+#endif
+
+/// Maximum number of cached connections to one interface. Calls use an idle
+/// connection if there is one, else open another up to this limit, else are
+/// pipelined on the least busy connection.
+/// Can be configured with `-DGGL_COREBUS_CLIENT_MAX_INTERFACE_CONNECTIONS=<N>`.
+#ifndef GGL_COREBUS_CLIENT_MAX_INTERFACE_CONNECTIONS
+#define GGL_COREBUS_CLIENT_MAX_INTERFACE_CONNECTIONS 4
+#endif
+
 /// Send a Core Bus notification (call, but don't wait for response).
 GglError ggl_notify(GglBuffer interface, GglBuffer method, GglMap params);
 
@@ -33,6 +49,19 @@ GglError ggl_call(
     GglObject *result
 ) __attribute__((warn_unused_result));
 
+/// Make a Core Bus call, passing `send_fd` to the handler with the request.
+/// The handler takes it with `ggl_take_request_fd`. `send_fd` is not closed.
+/// If `send_fd` is -1, this is the same as `ggl_call`.
+GglError ggl_call_with_fd(
+    GglBuffer interface,
+    GglBuffer method,
+    GglMap params,
+    int send_fd,
+    GglError *error,
+    GglAlloc *alloc,
+    GglObject *result
+) __attribute__((warn_unused_result));
+
 /// Callback for new data on a subscription.
 typedef GglError (*GglSubscribeCallback)(
     void *ctx, uint32_t handle, GglObject data
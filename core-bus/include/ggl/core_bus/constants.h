@@ -13,4 +13,20 @@
 #define GGL_COREBUS_MAX_MSG_LEN 10000
 #endif
 
+/// Maximum size of a payload passed through shared memory.
+/// Payloads too large for a core-bus packet are sent in a sealed memfd passed
+/// over the socket, up to this size. Set to 0 to disable.
+/// Can be configured with `-DGGL_COREBUS_SHM_MAX_LEN=<N>`.
+#ifndef GGL_COREBUS_SHM_MAX_LEN
+#define GGL_COREBUS_SHM_MAX_LEN (16 * 1024 * 1024)
+#endif
+
+/// Time a connection may go without requests before the server closes it.
+/// Subscriptions are not closed. Clients stop reusing cached connections after
+/// half this time, so requests are not sent on a connection being closed.
+/// Can be configured with `-DGGL_COREBUS_IDLE_CLOSE_MS=<N>`.
+#ifndef GGL_COREBUS_IDLE_CLOSE_MS
+#define GGL_COREBUS_IDLE_CLOSE_MS 60000
+#endif
+
 #endif
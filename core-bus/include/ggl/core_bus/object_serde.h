@@ -0,0 +1,78 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef GGL_COREBUS_OBJECT_SERDE_H
+#define GGL_COREBUS_OBJECT_SERDE_H
+
+//! Serialization/Deserialization for GGL objects.
+
+#include <ggl/alloc.h>
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <ggl/io.h>
+#include <ggl/object.h>
+#include <ggl/vector.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Max map keys remembered by a key dictionary.
+#define GGL_KEY_DICT_MAX_KEYS 16
+
+/// Max length of a key added to a key dictionary.
+#define GGL_KEY_DICT_MAX_KEY_LEN 32
+
+/// Map keys sent so far in a compact encoding stream.
+/// Encoder and decoder each add keys sent in full, in order, while there is
+/// room; repeated keys are then sent as an index into the dictionary.
+/// A zero-initialized dictionary is empty.
+typedef struct {
+    GglBuffer keys[GGL_KEY_DICT_MAX_KEYS];
+    /// Storage for keys that must outlive the message they were sent in, or
+    /// NULL to reference keys in place.
+    uint8_t (*mem)[GGL_KEY_DICT_MAX_KEY_LEN];
+    size_t len;
+} GglKeyDict;
+
+// Functions below use the compact encoding when given a key dictionary, which
+// is updated with the keys encoded or decoded. The compact encoding uses
+// varints and holds small values and lengths in type tags.
+
+/// Serialize an object into a buffer.
+GglError ggl_serialize(GglObject obj, GglKeyDict *dict, GglBuffer *buf);
+
+/// Minimum length of buffers `ggl_serialize_segments` references in place.
+#define GGL_SERIALIZE_REF_MIN_LEN 256
+
+/// Serialize an object without copying its large buffers.
+/// Object structure and small values are written into `buf`, which is set to
+/// the used portion. `segments` is appended with the serialized data in order,
+/// as slices of `buf` interleaved with buffers of at least
+/// `GGL_SERIALIZE_REF_MIN_LEN` bytes referenced from `obj`. Buffers are copied
+/// into `buf` once `segments` is too full to split further.
+GglError ggl_serialize_segments(
+    GglObject obj, GglKeyDict *dict, GglBuffer *buf, GglBufVec *segments
+);
+
+/// Get the length `ggl_serialize` would produce for an object.
+/// `dict` is left unchanged.
+GglError ggl_serialized_len(GglObject obj, GglKeyDict *dict, size_t *len);
+
+/// Deserialize an object from a buffer.
+/// The resultant object holds references into the buffer (and into `dict` for
+/// keys it stores), unless `copy_bufs` is true, in which case all data will
+/// live in `alloc`.
+GglError ggl_deserialize(
+    GglAlloc *alloc,
+    bool copy_bufs,
+    GglKeyDict *dict,
+    GglBuffer buf,
+    GglObject *obj
+);
+
+/// Reader from which a serialized object can be read.
+/// Errors if buffer is not large enough for entire object.
+GglReader ggl_serialize_reader(GglObject *obj);
+
+#endif
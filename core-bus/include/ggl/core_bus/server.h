@@ -5,6 +5,7 @@
 #ifndef GGL_COREBUS_SERVER_H
 #define GGL_COREBUS_SERVER_H
 
+#include "constants.h"
 #include <ggl/buffer.h>
 #include <ggl/error.h>
 #include <ggl/object.h>
@@ -20,6 +21,27 @@
 #define GGL_COREBUS_MAX_CLIENTS 100
 #endif
 
+/// Maximum number of threads handling requests for a core-bus server.
+/// Can be configured with `-DGGL_COREBUS_MAX_WORKERS=<N>`.
+#ifndef GGL_COREBUS_MAX_WORKERS
+#define GGL_COREBUS_MAX_WORKERS 4
+#endif
+
+/// Size in bytes of the outbound queue for each subscription.
+/// Messages are queued when a subscriber is not reading fast enough.
+/// Can be configured with `-DGGL_COREBUS_SUB_QUEUE_LEN=<N>`.
+#ifndef GGL_COREBUS_SUB_QUEUE_LEN
+#define GGL_COREBUS_SUB_QUEUE_LEN (2 * GGL_COREBUS_MAX_MSG_LEN)
+#endif
+
+/// Number of subscription queue buffers. Buffers are shared by subscriptions
+/// and held only while responses are queued; when none is free, a response
+/// that can't be sent is handled as if its queue were full.
+/// Can be configured with `-DGGL_COREBUS_SUB_QUEUES=<N>`.
+#ifndef GGL_COREBUS_SUB_QUEUES
+#define GGL_COREBUS_SUB_QUEUES 16
+#endif
+
 /// Function that receives client invocations of a method.
 /// For call/notify, the handler must either use the handle to respond and
 /// return GGL_ERR_OK, or return an error without responding. For
@@ -34,6 +56,9 @@ typedef struct {
     bool is_subscription;
     GglBusHandler handler;
     void *ctx;
+    /// Handler may run concurrently with other handlers.
+    /// Only has an effect when using `ggl_listen_threaded`.
+    bool thread_safe;
 } GglRpcMethodDesc;
 
 /// Listen on `interface` and receive incoming Core Bus method invocations.
@@ -42,11 +67,29 @@ GglError ggl_listen(
     GglBuffer interface, GglRpcMethodDesc *handlers, size_t handlers_len
 );
 
+/// Like `ggl_listen`, but handles requests using `worker_count` threads.
+/// Requests on a connection are handled in order. Handlers not marked
+/// `thread_safe` are run one at a time, but request reading and decoding is
+/// still done in parallel.
+GglError ggl_listen_threaded(
+    GglBuffer interface,
+    GglRpcMethodDesc *handlers,
+    size_t handlers_len,
+    size_t worker_count
+);
+
 /// Send a response to the client for a call/notify request.
-/// Closes the connection.
+/// Closes the connection, unless the client keeps it open for further
+/// requests.
 /// Must be called from within a core bus handler.
 void ggl_respond(uint32_t handle, GglObject value);
 
+/// Take the fd passed with a request by `ggl_call_with_fd`.
+/// Must be called by the request's handler before it responds. The caller
+/// owns the fd and must close it. Returns GGL_ERR_NOENTRY if the request was
+/// sent without an fd.
+GglError ggl_take_request_fd(uint32_t handle, int *fd);
+
 /// Server callback for whenever a subscription is closed.
 typedef void (*GglServerSubCloseCallback)(void *ctx, uint32_t handle);
 
@@ -57,8 +100,24 @@ void ggl_sub_accept(
     uint32_t handle, GglServerSubCloseCallback on_close, void *ctx
 );
 
+/// Action taken when a subscription's outbound queue is full.
+typedef enum {
+    /// Close the subscription (default).
+    GGL_SUB_QUEUE_DISCONNECT,
+    /// Discard the oldest queued response to make room.
+    GGL_SUB_QUEUE_DROP_OLDEST,
+    /// Discard the response being sent.
+    GGL_SUB_QUEUE_DROP_NEWEST,
+} GglSubQueuePolicy;
+
+/// Set the policy for when a subscription's outbound queue is full.
+/// Should be set before the first response is sent.
+void ggl_sub_set_queue_policy(uint32_t handle, GglSubQueuePolicy policy);
+
 /// Send a response to the client on a subscription.
 /// Subscriptions must be accepted before responding.
+/// Does not block on the subscriber; if it is not reading, the response is
+/// queued and sent when the socket is writable.
 void ggl_sub_respond(uint32_t handle, GglObject value);
 
 /// Close a server subscription handle.
@@ -4,69 +4,657 @@
 
 #include "ggl/core_bus/client.h"
 #include "client_common.h"
-#include "object_serde.h"
+#include "ggl/core_bus/constants.h"
+#include "ggl/core_bus/object_serde.h"
+#include "message_encode.h"
+#include "payload_codec.h"
+#include "shm.h"
 #include "types.h"
+#include <assert.h>
+#include <errno.h>
 #include <ggl/alloc.h>
+#include <ggl/buffer.h>
 #include <ggl/cleanup.h>
 #include <ggl/error.h>
 #include <ggl/eventstream/decode.h>
+#include <ggl/eventstream/types.h>
 #include <ggl/file.h>
 #include <ggl/log.h>
 #include <ggl/object.h>
 #include <ggl/socket.h>
+#include <ggl/vector.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
-GglError ggl_notify(GglBuffer interface, GglBuffer method, GglMap params) {
-    int conn_fd = -1;
-    GglError ret = ggl_client_send_message(
-        interface, GGL_CORE_BUS_NOTIFY, method, params, &conn_fd
+// Calls and notifications are sent over persistent connections, up to
+// GGL_COREBUS_CLIENT_MAX_INTERFACE_CONNECTIONS per interface so concurrent
+// calls can be handled in parallel by threaded servers. Requests on a
+// connection carry a request id; the server handles requests on a connection
+// in order, so responses arrive in the order requests were written. Each
+// caller takes a ticket (its request id) when sending and waits for its turn
+// to read the response, allowing multiple threads to pipeline calls over a
+// single socket.
+//
+// Servers close connections that go unused for GGL_COREBUS_IDLE_CLOSE_MS.
+// Connections idle for half that are closed rather than reused, so requests
+// are not sent on one the server is closing. A cached connection the server
+// closed for other reasons fails on send, and the request is sent on a new one.
+//
+// Each call has its own deadline. A caller whose deadline passes before its
+// response is read abandons its request; its response is discarded by the
+// next caller to read, so later calls on the connection are unaffected.
+
+/// Time a call waits for its response, matching the socket timeouts.
+#define CALL_TIMEOUT_MS 5000
+
+/// Time a connection may be idle and still be reused.
+#define CONN_REUSE_MS (GGL_COREBUS_IDLE_CLOSE_MS / 2)
+
+typedef struct {
+    int fd;
+    uint8_t interface[GGL_INTERFACE_NAME_MAX_LEN];
+    size_t interface_len;
+    /// Number of callers currently using this connection.
+    uint32_t refs;
+    /// Monotonic time refs last reached 0.
+    int64_t idle_since_ms;
+    /// No new requests may be sent; close when refs reaches 0.
+    bool closing;
+    /// Response stream is unusable; pending callers must fail.
+    bool failed;
+    /// Request id of next request written.
+    uint32_t next_request_id;
+    /// Request id of next response to be read.
+    uint32_t next_response_id;
+    /// Bit i is set if request next_response_id + i was abandoned.
+    uint64_t abandoned;
+    /// Keys sent on this connection, for compact encoding of requests.
+    GglKeyDict key_dict;
+    uint8_t key_mem[GGL_KEY_DICT_MAX_KEYS][GGL_KEY_DICT_MAX_KEY_LEN];
+} ClientConn;
+
+static ClientConn conns[GGL_COREBUS_CLIENT_MAX_CONNECTIONS];
+static pthread_mutex_t conns_mtx = PTHREAD_MUTEX_INITIALIZER;
+/// Signalled when response turns advance or connections are released.
+static pthread_cond_t conns_cond = PTHREAD_COND_INITIALIZER;
+
+// Separate from the send buffer so calls can be written while others wait on
+// responses.
+static uint8_t resp_payload_array[GGL_COREBUS_MAX_MSG_LEN];
+static pthread_mutex_t resp_payload_array_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static void init_conns_cond(void) {
+    // Deadlines are measured on the monotonic clock
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&conns_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// A forked child must not share cached sockets with its parent.
+static void reset_conns_in_child(void) {
+    for (size_t i = 0; i < GGL_COREBUS_CLIENT_MAX_CONNECTIONS; i++) {
+        if (conns[i].interface_len != 0) {
+            ggl_close(conns[i].fd);
+        }
+        conns[i] = (ClientConn) { .fd = -1 };
+    }
+    conns_mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+    init_conns_cond();
+    resp_payload_array_mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+}
+
+__attribute__((constructor)) static void init_conns(void) {
+    init_conns_cond();
+    pthread_atfork(NULL, NULL, reset_conns_in_child);
+}
+
+static int64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t) now.tv_sec * 1000) + (now.tv_nsec / 1000000L);
+}
+
+static bool conn_matches(const ClientConn *conn, GglBuffer interface) {
+    return (conn->interface_len != 0) && !conn->closing
+        && ggl_buffer_eq(
+               (GglBuffer) { .data = (uint8_t *) conn->interface,
+                             .len = conn->interface_len },
+               interface
+        );
+}
+
+static void conn_free(ClientConn *conn) {
+    assert(conn->refs == 0);
+    if (conn->interface_len != 0) {
+        GGL_LOGT(
+            "Closing cached connection to %.*s.",
+            (int) conn->interface_len,
+            conn->interface
+        );
+        ggl_close(conn->fd);
+    }
+    *conn = (ClientConn) { .fd = -1 };
+}
+
+/// Must be called with conns_mtx held.
+/// Closes connections that have been idle too long to reuse.
+static void reap_idle_conns(void) {
+    int64_t now = monotonic_ms();
+    for (size_t i = 0; i < GGL_COREBUS_CLIENT_MAX_CONNECTIONS; i++) {
+        if ((conns[i].interface_len != 0) && (conns[i].refs == 0)
+            && (now - conns[i].idle_since_ms >= CONN_REUSE_MS)) {
+            conn_free(&conns[i]);
+        }
+    }
+}
+
+/// Must be called with conns_mtx held.
+/// Returns the connection to interface with the fewest callers, if any.
+static ClientConn *find_conn(GglBuffer interface, size_t *count) {
+    ClientConn *least_busy = NULL;
+    *count = 0;
+    for (size_t i = 0; i < GGL_COREBUS_CLIENT_MAX_CONNECTIONS; i++) {
+        if (conn_matches(&conns[i], interface)) {
+            *count += 1;
+            if ((least_busy == NULL) || (conns[i].refs < least_busy->refs)) {
+                least_busy = &conns[i];
+            }
+        }
+    }
+    return least_busy;
+}
+
+/// Must be called with conns_mtx held.
+/// Whether to use `found` rather than opening another connection.
+static bool reuse_conn(const ClientConn *found, size_t count) {
+    return (found != NULL)
+        && ((found->refs == 0)
+            || (count >= GGL_COREBUS_CLIENT_MAX_INTERFACE_CONNECTIONS));
+}
+
+/// Must be called with conns_mtx held.
+/// If all slots are in use, waits for one if `wait` is set, else returns NULL.
+static ClientConn *find_free_conn(bool wait) {
+    while (true) {
+        ClientConn *idle = NULL;
+        for (size_t i = 0; i < GGL_COREBUS_CLIENT_MAX_CONNECTIONS; i++) {
+            if (conns[i].interface_len == 0) {
+                return &conns[i];
+            }
+            if ((conns[i].refs == 0) && (idle == NULL)) {
+                idle = &conns[i];
+            }
+        }
+        if (idle != NULL) {
+            conn_free(idle);
+            return idle;
+        }
+        if (!wait) {
+            return NULL;
+        }
+        pthread_cond_wait(&conns_cond, &conns_mtx);
+    }
+}
+
+static GglError acquire_conn(GglBuffer interface, ClientConn **conn) {
+    if (interface.len > GGL_INTERFACE_NAME_MAX_LEN) {
+        GGL_LOGE("Interface name too long.");
+        return GGL_ERR_RANGE;
+    }
+
+    {
+        GGL_MTX_SCOPE_GUARD(&conns_mtx);
+        reap_idle_conns();
+        size_t count = 0;
+        ClientConn *found = find_conn(interface, &count);
+        if (reuse_conn(found, count)) {
+            found->refs += 1;
+            *conn = found;
+            return GGL_ERR_OK;
+        }
+    }
+
+    GGL_LOGT("Connecting to %.*s.", (int) interface.len, interface.data);
+    int fd = -1;
+    GglError ret = ggl_client_connect(interface, &fd);
+
+    GGL_MTX_SCOPE_GUARD(&conns_mtx);
+
+    // Other threads may have connected while the lock was released
+    size_t count = 0;
+    ClientConn *found = find_conn(interface, &count);
+    if (ret != GGL_ERR_OK) {
+        if (found == NULL) {
+            return ret;
+        }
+        // Fall back to pipelining on an existing connection
+        found->refs += 1;
+        *conn = found;
+        return GGL_ERR_OK;
+    }
+
+    ClientConn *new_conn = NULL;
+    if (!reuse_conn(found, count)) {
+        new_conn = find_free_conn(found == NULL);
+    }
+    if (new_conn == NULL) {
+        ggl_close(fd);
+        found->refs += 1;
+        *conn = found;
+        return GGL_ERR_OK;
+    }
+
+    *new_conn = (ClientConn) {
+        .fd = fd,
+        .interface_len = interface.len,
+        .refs = 1,
+    };
+    new_conn->key_dict.mem = new_conn->key_mem;
+    memcpy(new_conn->interface, interface.data, interface.len);
+
+    *conn = new_conn;
+    return GGL_ERR_OK;
+}
+
+static void release_conn(ClientConn *conn) {
+    GGL_MTX_SCOPE_GUARD(&conns_mtx);
+    assert(conn->refs > 0);
+    conn->refs -= 1;
+    if (conn->refs == 0) {
+        conn->idle_since_ms = monotonic_ms();
+        if (conn->closing) {
+            conn_free(conn);
+        }
+    }
+    pthread_cond_broadcast(&conns_cond);
+}
+
+static void cleanup_release_conn(ClientConn **conn) {
+    if (*conn != NULL) {
+        release_conn(*conn);
+    }
+}
+
+static void mark_conn_failed(ClientConn *conn) {
+    GGL_MTX_SCOPE_GUARD(&conns_mtx);
+    conn->closing = true;
+    conn->failed = true;
+    pthread_cond_broadcast(&conns_cond);
+}
+
+static GglError send_request(
+    ClientConn *conn,
+    GglCoreBusRequestType type,
+    GglBuffer method,
+    GglMap params,
+    int send_fd,
+    uint32_t *request_id
+) {
+    // Holding the send buffer lock orders request ids with the socket writes
+    GGL_MTX_SCOPE_GUARD(&ggl_core_bus_client_payload_array_mtx);
+
+    uint32_t id = 0;
+    {
+        GGL_MTX_SCOPE_GUARD(&conns_mtx);
+        if (conn->closing) {
+            return GGL_ERR_NOCONN;
+        }
+        id = conn->next_request_id;
+    }
+
+    GglBuffer segment_mem[GGL_COREBUS_MAX_SEGMENTS];
+    GglBufVec segments = GGL_BUF_VEC(segment_mem);
+    int shm_fd = -1;
+    int32_t header_id = (int32_t) id;
+    GglError ret = ggl_client_encode_request(
+        GGL_BUF(ggl_core_bus_client_payload_array),
+        type,
+        method,
+        params,
+        &header_id,
+        send_fd >= 0,
+        &conn->key_dict,
+        &segments,
+        &shm_fd
     );
     if (ret != GGL_ERR_OK) {
         return ret;
     }
-    ggl_close(conn_fd);
+    GGL_CLEANUP(cleanup_close, shm_fd);
+
+    ret = ggl_socket_writev_with_fd(
+        conn->fd, segments.buf_list, (send_fd >= 0) ? send_fd : shm_fd
+    );
+    if (ret != GGL_ERR_OK) {
+        // Partial writes leave the stream in an unknown state
+        mark_conn_failed(conn);
+        return GGL_ERR_NOCONN;
+    }
+
+    if (type == GGL_CORE_BUS_CALL) {
+        GGL_MTX_SCOPE_GUARD(&conns_mtx);
+        conn->next_request_id += 1;
+    }
+
+    *request_id = id;
     return GGL_ERR_OK;
 }
 
-GglError ggl_call(
+static GglError send_request_with_retry(
     GglBuffer interface,
+    GglCoreBusRequestType type,
     GglBuffer method,
     GglMap params,
+    int send_fd,
+    ClientConn **conn,
+    uint32_t *request_id
+) {
+    GglError ret = GGL_ERR_OK;
+
+    // A cached connection may have been closed by the server (for example on
+    // restart); since the request was not sent, retry with a new connection.
+    for (int attempt = 0; attempt < 2; attempt++) {
+        ret = acquire_conn(interface, conn);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+
+        ret = send_request(*conn, type, method, params, send_fd, request_id);
+        if (ret != GGL_ERR_NOCONN) {
+            return ret;
+        }
+
+        GGL_LOGD(
+            "Cached connection to %.*s unusable; reconnecting.",
+            (int) interface.len,
+            interface.data
+        );
+        release_conn(*conn);
+        *conn = NULL;
+    }
+
+    return ret;
+}
+
+static struct timespec call_deadline(void) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += CALL_TIMEOUT_MS / 1000;
+    deadline.tv_nsec += (long) (CALL_TIMEOUT_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
+
+static int remaining_ms(const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t ms = ((int64_t) (deadline->tv_sec - now.tv_sec) * 1000)
+        + ((deadline->tv_nsec - now.tv_nsec) / 1000000L);
+    if (ms <= 0) {
+        return 0;
+    }
+    return (ms > CALL_TIMEOUT_MS) ? CALL_TIMEOUT_MS : (int) ms;
+}
+
+/// Must be called with conns_mtx held.
+/// A caller may read once every earlier request has been read or abandoned.
+static bool is_turn(const ClientConn *conn, uint32_t request_id) {
+    uint32_t offset = request_id - conn->next_response_id;
+    if (offset == 0) {
+        return true;
+    }
+    if (offset >= 64) {
+        return false;
+    }
+    uint64_t earlier = (UINT64_C(1) << offset) - 1U;
+    return (conn->abandoned & earlier) == earlier;
+}
+
+/// Give up on a request whose response has not been read. Its connection is
+/// not used for new requests, as the server may still be handling it.
+static void abandon_request(ClientConn *conn, uint32_t request_id) {
+    GGL_MTX_SCOPE_GUARD(&conns_mtx);
+    conn->closing = true;
+    uint32_t offset = request_id - conn->next_response_id;
+    if (offset >= 64) {
+        conn->failed = true;
+    } else {
+        conn->abandoned |= UINT64_C(1) << offset;
+    }
+    pthread_cond_broadcast(&conns_cond);
+}
+
+static GglError wait_for_turn(
+    ClientConn *conn, uint32_t request_id, const struct timespec *deadline
+) {
+    {
+        GGL_MTX_SCOPE_GUARD(&conns_mtx);
+        while (!conn->failed && !is_turn(conn, request_id)) {
+            int sys_ret
+                = pthread_cond_timedwait(&conns_cond, &conns_mtx, deadline);
+            if ((sys_ret == ETIMEDOUT) && !is_turn(conn, request_id)) {
+                break;
+            }
+        }
+        if (conn->failed) {
+            return GGL_ERR_NOCONN;
+        }
+        if (is_turn(conn, request_id)) {
+            return GGL_ERR_OK;
+        }
+    }
+
+    GGL_LOGE("Timed out waiting for core bus response.");
+    abandon_request(conn, request_id);
+    return GGL_ERR_FAILURE;
+}
+
+/// Waits until a response can be read, abandoning the request at its deadline.
+static GglError wait_readable(
+    ClientConn *conn, uint32_t request_id, const struct timespec *deadline
+) {
+    struct pollfd fds = { .fd = conn->fd, .events = POLLIN };
+    int sys_ret;
+    do {
+        sys_ret = poll(&fds, 1, remaining_ms(deadline));
+    } while ((sys_ret == -1) && (errno == EINTR));
+
+    if (sys_ret == 0) {
+        GGL_LOGE("Timed out waiting for core bus response.");
+        abandon_request(conn, request_id);
+        return GGL_ERR_FAILURE;
+    }
+    if (sys_ret == -1) {
+        GGL_LOGE("Failed to poll core bus connection: %d.", errno);
+        mark_conn_failed(conn);
+        return GGL_ERR_FAILURE;
+    }
+    return GGL_ERR_OK;
+}
+
+static void finish_turn(ClientConn *conn) {
+    GGL_MTX_SCOPE_GUARD(&conns_mtx);
+    conn->next_response_id += 1;
+    conn->abandoned >>= 1;
+    pthread_cond_broadcast(&conns_cond);
+}
+
+static bool get_response_id(const EventStreamMessage *msg, uint32_t *id) {
+    EventStreamHeaderIter iter = msg->headers;
+    EventStreamHeader header;
+
+    while (eventstream_header_next(&iter, &header) == GGL_ERR_OK) {
+        if (ggl_buffer_eq(header.name, GGL_STR("request_id"))) {
+            if (header.value.type != EVENTSTREAM_INT32) {
+                return false;
+            }
+            *id = (uint32_t) header.value.int32;
+            return true;
+        }
+    }
+    return false;
+}
+
+static GglError read_call_response(
+    ClientConn *conn,
+    uint32_t request_id,
+    const struct timespec *deadline,
     GglError *error,
     GglAlloc *alloc,
     GglObject *result
 ) {
-    int conn = -1;
-    GglError ret = ggl_client_send_message(
-        interface, GGL_CORE_BUS_CALL, method, params, &conn
-    );
+    GglError ret = wait_for_turn(conn, request_id, deadline);
     if (ret != GGL_ERR_OK) {
         return ret;
     }
-    GGL_CLEANUP(cleanup_close, conn);
 
-    GGL_MTX_SCOPE_GUARD(&ggl_core_bus_client_payload_array_mtx);
+    while (true) {
+        // Wait for the response without holding the receive buffer
+        ret = wait_readable(conn, request_id, deadline);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
 
-    GglBuffer recv_buffer = GGL_BUF(ggl_core_bus_client_payload_array);
-    EventStreamMessage msg = { 0 };
-    GGL_LOGT(
-        "Waiting for response from %.*s.", (int) interface.len, interface.data
-    );
-    ret = ggl_client_get_response(
-        ggl_socket_reader(&conn), recv_buffer, error, &msg
-    );
-    if (ret != GGL_ERR_OK) {
-        return ret;
-    }
+        EventStreamPrelude prelude;
+        GGL_CLEANUP_ID(shm_fd, cleanup_close, -1);
+        ret = ggl_client_read_prelude_with_fd(conn->fd, &prelude, &shm_fd);
+        if (ret != GGL_ERR_OK) {
+            mark_conn_failed(conn);
+            return ret;
+        }
+
+        GGL_MTX_SCOPE_GUARD(&resp_payload_array_mtx);
 
-    if (result != NULL) {
-        ret = ggl_deserialize(alloc, true, msg.payload, result);
+        GglBuffer recv_buffer = GGL_BUF(resp_payload_array);
+        EventStreamMessage msg = { 0 };
+        GglError remote_error = GGL_ERR_OK;
+        GglError resp_ret = ggl_client_read_response(
+            ggl_socket_reader(&conn->fd),
+            &prelude,
+            recv_buffer,
+            &remote_error,
+            &msg
+        );
+        if ((resp_ret != GGL_ERR_OK) && (resp_ret != GGL_ERR_REMOTE)) {
+            mark_conn_failed(conn);
+            return resp_ret;
+        }
+
+        uint32_t response_id = 0;
+        if (!get_response_id(&msg, &response_id)
+            || ((int32_t) (response_id - request_id) > 0)) {
+            GGL_LOGE("Core bus response has unexpected request id.");
+            mark_conn_failed(conn);
+            return GGL_ERR_FAILURE;
+        }
+
+        finish_turn(conn);
+
+        if (response_id != request_id) {
+            GGL_LOGD("Discarding response to abandoned core bus request.");
+            continue;
+        }
+
+        if (resp_ret != GGL_ERR_OK) {
+            if (error != NULL) {
+                *error = remote_error;
+            }
+            return resp_ret;
+        }
+
+        GGL_CLEANUP_ID(shm_mapping, ggl_core_bus_shm_unmap, (GglBuffer) { 0 });
+        GglBuffer payload = { 0 };
+        ret = ggl_core_bus_shm_payload(&msg, shm_fd, &shm_mapping, &payload);
         if (ret != GGL_ERR_OK) {
-            GGL_LOGE("Failed to decode response payload.");
             return ret;
         }
+
+        if (result != NULL) {
+            GglCoreBusCodec codec = GGL_CORE_BUS_CODEC_V1;
+            ret = ggl_core_bus_msg_codec(&msg, &codec);
+            if (ret != GGL_ERR_OK) {
+                return ret;
+            }
+
+            ret = ggl_core_bus_decode_payload(
+                alloc, true, codec, NULL, payload, result
+            );
+            if (ret != GGL_ERR_OK) {
+                GGL_LOGE("Failed to decode response payload.");
+                return ret;
+            }
+        }
+
+        return GGL_ERR_OK;
     }
+}
 
+GglError ggl_notify(GglBuffer interface, GglBuffer method, GglMap params) {
+    ClientConn *conn = NULL;
+    uint32_t request_id = 0;
+    GglError ret = send_request_with_retry(
+        interface, GGL_CORE_BUS_NOTIFY, method, params, -1, &conn, &request_id
+    );
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    release_conn(conn);
     return GGL_ERR_OK;
 }
+
+GglError ggl_call(
+    GglBuffer interface,
+    GglBuffer method,
+    GglMap params,
+    GglError *error,
+    GglAlloc *alloc,
+    GglObject *result
+) {
+    return ggl_call_with_fd(
+        interface, method, params, -1, error, alloc, result
+    );
+}
+
+GglError ggl_call_with_fd(
+    GglBuffer interface,
+    GglBuffer method,
+    GglMap params,
+    int send_fd,
+    GglError *error,
+    GglAlloc *alloc,
+    GglObject *result
+) {
+    ClientConn *conn = NULL;
+    uint32_t request_id = 0;
+    GglError ret = send_request_with_retry(
+        interface,
+        GGL_CORE_BUS_CALL,
+        method,
+        params,
+        send_fd,
+        &conn,
+        &request_id
+    );
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    GGL_CLEANUP(cleanup_release_conn, conn);
+    struct timespec deadline = call_deadline();
+
+    GGL_LOGT(
+        "Waiting for response from %.*s.", (int) interface.len, interface.data
+    );
+    return read_call_response(
+        conn, request_id, &deadline, error, alloc, result
+    );
+}
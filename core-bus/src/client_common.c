@@ -4,14 +4,14 @@
 
 #include "client_common.h"
 #include "ggl/core_bus/constants.h"
-#include "object_serde.h"
+#include "ggl/core_bus/object_serde.h"
+#include "message_encode.h"
 #include "types.h"
 #include <assert.h>
 #include <ggl/buffer.h>
 #include <ggl/cleanup.h>
 #include <ggl/error.h>
 #include <ggl/eventstream/decode.h>
-#include <ggl/eventstream/encode.h>
 #include <ggl/eventstream/types.h>
 #include <ggl/file.h>
 #include <ggl/io.h>
@@ -20,6 +20,7 @@
 #include <ggl/socket.h>
 #include <ggl/vector.h>
 #include <pthread.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -27,7 +28,7 @@ uint8_t ggl_core_bus_client_payload_array[GGL_COREBUS_MAX_MSG_LEN];
 pthread_mutex_t ggl_core_bus_client_payload_array_mtx
     = PTHREAD_MUTEX_INITIALIZER;
 
-static GglError interface_connect(GglBuffer interface, int *conn_fd) {
+GglError ggl_client_connect(GglBuffer interface, int *conn_fd) {
     assert(conn_fd != NULL);
 
     uint8_t socket_path_buf
@@ -47,6 +48,54 @@ static GglError interface_connect(GglBuffer interface, int *conn_fd) {
     return ggl_connect(socket_path.buf, conn_fd);
 }
 
+GglError ggl_client_encode_request(
+    GglBuffer buf,
+    GglCoreBusRequestType type,
+    GglBuffer method,
+    GglMap params,
+    const int32_t *request_id,
+    bool attach_fd,
+    GglKeyDict *key_dict,
+    GglBufVec *segments,
+    int *shm_fd
+) {
+    EventStreamHeader headers[4] = {
+        { GGL_STR("method"), { EVENTSTREAM_STRING, .string = method } },
+        { GGL_STR("type"), { EVENTSTREAM_INT32, .int32 = (int32_t) type } },
+    };
+    size_t headers_len = 2;
+    if (request_id != NULL) {
+        headers[headers_len++] = (EventStreamHeader) {
+            GGL_STR("request_id"), { EVENTSTREAM_INT32, .int32 = *request_id }
+        };
+    }
+    if (attach_fd) {
+        headers[headers_len++] = (EventStreamHeader) {
+            GGL_STR("fd"), { EVENTSTREAM_INT32, .int32 = 1 }
+        };
+    }
+
+    GglError ret = ggl_core_bus_encode_message(
+        buf,
+        headers,
+        headers_len,
+        &GGL_OBJ_MAP(params),
+        (key_dict != NULL) ? GGL_CORE_BUS_CODEC_V2_STREAM
+                           : GGL_CORE_BUS_CODEC_V2,
+        key_dict,
+        segments,
+        shm_fd
+    );
+    if ((ret == GGL_ERR_OK) && attach_fd && (*shm_fd >= 0)) {
+        // Only one fd can be passed with a packet
+        GGL_LOGE("Request with an attached fd too large for core bus packet.");
+        ggl_close(*shm_fd);
+        *shm_fd = -1;
+        return GGL_ERR_NOMEM;
+    }
+    return ret;
+}
+
 GglError ggl_client_send_message(
     GglBuffer interface,
     GglCoreBusRequestType type,
@@ -56,7 +105,7 @@ GglError ggl_client_send_message(
 ) {
     int conn = -1;
     GGL_LOGT("Connecting to %.*s.", (int) interface.len, interface.data);
-    GglError ret = interface_connect(interface, &conn);
+    GglError ret = ggl_client_connect(interface, &conn);
     if (ret != GGL_ERR_OK) {
         return ret;
     }
@@ -64,27 +113,29 @@ GglError ggl_client_send_message(
 
     GGL_MTX_SCOPE_GUARD(&ggl_core_bus_client_payload_array_mtx);
 
-    GglBuffer send_buffer = GGL_BUF(ggl_core_bus_client_payload_array);
-
-    EventStreamHeader headers[] = {
-        { GGL_STR("method"), { EVENTSTREAM_STRING, .string = method } },
-        { GGL_STR("type"), { EVENTSTREAM_INT32, .int32 = (int32_t) type } },
-    };
-    size_t headers_len = sizeof(headers) / sizeof(headers[0]);
-
-    ret = eventstream_encode(
-        &send_buffer,
-        headers,
-        headers_len,
-        ggl_serialize_reader(&GGL_OBJ_MAP(params))
+    GglBuffer segment_mem[GGL_COREBUS_MAX_SEGMENTS];
+    GglBufVec segments = GGL_BUF_VEC(segment_mem);
+    int shm_fd = -1;
+
+    ret = ggl_client_encode_request(
+        GGL_BUF(ggl_core_bus_client_payload_array),
+        type,
+        method,
+        params,
+        NULL,
+        false,
+        NULL,
+        &segments,
+        &shm_fd
     );
     if (ret != GGL_ERR_OK) {
         return ret;
     }
+    GGL_CLEANUP(cleanup_close, shm_fd);
 
     GGL_LOGT("Writing data to %.*s.", (int) interface.len, interface.data);
 
-    ret = ggl_socket_write(conn, send_buffer);
+    ret = ggl_socket_writev_with_fd(conn, segments.buf_list, shm_fd);
     if (ret != GGL_ERR_OK) {
         return ret;
     }
@@ -95,40 +146,55 @@ GglError ggl_client_send_message(
     return GGL_ERR_OK;
 }
 
-GglError ggl_client_get_response(
-    GglReader reader,
-    GglBuffer recv_buffer,
-    GglError *error,
-    EventStreamMessage *response
+GglError ggl_client_read_prelude(
+    GglReader reader, EventStreamPrelude *prelude
 ) {
-    GglBuffer prelude_buf = ggl_buffer_substr(recv_buffer, 0, 12);
-    assert(prelude_buf.len == 12);
+    uint8_t prelude_mem[12];
+    GglBuffer prelude_buf = GGL_BUF(prelude_mem);
 
     GglError ret = ggl_reader_call_exact(reader, prelude_buf);
     if (ret != GGL_ERR_OK) {
         return ret;
     }
 
-    EventStreamPrelude prelude;
-    ret = eventstream_decode_prelude(prelude_buf, &prelude);
+    return eventstream_decode_prelude(prelude_buf, prelude);
+}
+
+GglError ggl_client_read_prelude_with_fd(
+    int fd, EventStreamPrelude *prelude, int *shm_fd
+) {
+    uint8_t prelude_mem[12];
+    GglBuffer prelude_buf = GGL_BUF(prelude_mem);
+
+    GglError ret = ggl_socket_read_with_fd(fd, prelude_buf, shm_fd);
     if (ret != GGL_ERR_OK) {
         return ret;
     }
 
-    if (prelude.data_len > recv_buffer.len) {
+    return eventstream_decode_prelude(prelude_buf, prelude);
+}
+
+GglError ggl_client_read_response(
+    GglReader reader,
+    const EventStreamPrelude *prelude,
+    GglBuffer recv_buffer,
+    GglError *error,
+    EventStreamMessage *response
+) {
+    if (prelude->data_len > recv_buffer.len) {
         GGL_LOGE("EventStream packet does not fit in core bus buffer size.");
         return GGL_ERR_NOMEM;
     }
 
     GglBuffer data_section
-        = ggl_buffer_substr(recv_buffer, 0, prelude.data_len);
+        = ggl_buffer_substr(recv_buffer, 0, prelude->data_len);
 
-    ret = ggl_reader_call_exact(reader, data_section);
+    GglError ret = ggl_reader_call_exact(reader, data_section);
     if (ret != GGL_ERR_OK) {
         return ret;
     }
 
-    ret = eventstream_decode(&prelude, data_section, response);
+    ret = eventstream_decode(prelude, data_section, response);
     if (ret != GGL_ERR_OK) {
         return ret;
     }
@@ -156,3 +222,20 @@ GglError ggl_client_get_response(
 
     return GGL_ERR_OK;
 }
+
+GglError ggl_client_get_response(
+    GglReader reader,
+    GglBuffer recv_buffer,
+    GglError *error,
+    EventStreamMessage *response
+) {
+    EventStreamPrelude prelude;
+    GglError ret = ggl_client_read_prelude(reader, &prelude);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    return ggl_client_read_response(
+        reader, &prelude, recv_buffer, error, response
+    );
+}
@@ -5,6 +5,7 @@
 #ifndef CORE_BUS_CLIENT_COMMON_H
 #define CORE_BUS_CLIENT_COMMON_H
 
+#include "ggl/core_bus/object_serde.h"
 #include "types.h"
 #include <sys/types.h>
 #include <ggl/buffer.h>
@@ -13,11 +14,36 @@
 #include <ggl/eventstream/decode.h>
 #include <ggl/io.h>
 #include <ggl/object.h>
+#include <ggl/vector.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 extern uint8_t ggl_core_bus_client_payload_array[GGL_COREBUS_MAX_MSG_LEN];
 extern pthread_mutex_t ggl_core_bus_client_payload_array_mtx;
 
+GglError ggl_client_connect(GglBuffer interface, int *conn_fd);
+
+/// Encode a request packet as `segments`, using `buf` for encoded data.
+/// Large buffers in `params` are referenced in place rather than copied.
+/// `shm_fd` is set as in `ggl_core_bus_encode_message`.
+/// If `request_id` is not NULL, the request is marked as coming from a
+/// persistent connection, and responses will carry the same request id.
+/// If `attach_fd` is set, the request is marked as having an fd passed with it
+/// for the handler, and fails if its payload would need shared memory.
+/// Params are encoded compactly, with `key_dict` as the connection's key
+/// dictionary if not NULL.
+GglError ggl_client_encode_request(
+    GglBuffer buf,
+    GglCoreBusRequestType type,
+    GglBuffer method,
+    GglMap params,
+    const int32_t *request_id,
+    bool attach_fd,
+    GglKeyDict *key_dict,
+    GglBufVec *segments,
+    int *shm_fd
+);
+
 GglError ggl_client_send_message(
     GglBuffer interface,
     GglCoreBusRequestType type,
@@ -26,6 +52,26 @@ GglError ggl_client_send_message(
     int *conn_fd
 );
 
+/// Read a response prelude.
+/// Allows waiting for a response without holding a receive buffer.
+GglError ggl_client_read_prelude(GglReader reader, EventStreamPrelude *prelude);
+
+/// Read a response prelude from a socket, accepting a shared memory payload fd.
+/// `*shm_fd` should be initialized to -1, and closed by the caller if set.
+GglError ggl_client_read_prelude_with_fd(
+    int fd, EventStreamPrelude *prelude, int *shm_fd
+);
+
+/// Read the rest of a response after its prelude.
+/// `response` is populated even if the server responded with an error.
+GglError ggl_client_read_response(
+    GglReader reader,
+    const EventStreamPrelude *prelude,
+    GglBuffer recv_buffer,
+    GglError *error,
+    EventStreamMessage *response
+);
+
 GglError ggl_client_get_response(
     GglReader reader,
     GglBuffer recv_buffer,
@@ -5,7 +5,9 @@
 #include "client_common.h"
 #include "ggl/core_bus/client.h"
 #include "ggl/core_bus/constants.h"
-#include "object_serde.h"
+#include "ggl/core_bus/object_serde.h"
+#include "payload_codec.h"
+#include "shm.h"
 #include "types.h"
 #include <sys/types.h>
 #include <assert.h>
@@ -48,16 +50,24 @@ typedef struct {
 
 static SubCallbacks sub_callbacks[GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS];
 
+/// Keys received on each subscription, for compactly encoded responses.
+/// Only used by the subscription thread after registration.
+static GglKeyDict sub_key_dicts[GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS];
+static uint8_t sub_key_mem[GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS]
+                          [GGL_KEY_DICT_MAX_KEYS][GGL_KEY_DICT_MAX_KEY_LEN];
+
 static GglError reset_sub_state(uint32_t handle, size_t index);
 static GglError call_close_callback(uint32_t handle, size_t index);
 
 static int sub_fds[GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS];
 static uint16_t sub_generations[GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS];
+static uint16_t sub_in_use[GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS];
 
 GglSocketPool pool = {
     .max_fds = GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS,
     .fds = sub_fds,
     .generations = sub_generations,
+    .in_use = sub_in_use,
     .on_register = reset_sub_state,
     .on_release = call_close_callback,
 };
@@ -91,6 +101,7 @@ __attribute__((constructor)) static void start_subscription_thread(void) {
 static GglError reset_sub_state(uint32_t handle, size_t index) {
     (void) handle;
     sub_callbacks[index] = (SubCallbacks) { 0 };
+    sub_key_dicts[index] = (GglKeyDict) { .mem = sub_key_mem[index] };
     return GGL_ERR_OK;
 }
 
@@ -272,6 +283,11 @@ static void call_on_response_callback(void *ctx, size_t index) {
     }
 }
 
+static void get_sub_key_dict(void *ctx, size_t index) {
+    GglKeyDict **dict = ctx;
+    *dict = &sub_key_dicts[index];
+}
+
 static GglError get_subscription_response(uint32_t handle) {
     GGL_LOGD("Handling incoming subscription response.");
 
@@ -282,11 +298,28 @@ static GglError get_subscription_response(uint32_t handle) {
 
     GGL_MTX_SCOPE_GUARD(&sub_resp_payload_array_mtx);
 
+    // A shared memory payload fd is passed with the start of the packet
+    uint8_t prelude_mem[12];
+    GGL_CLEANUP_ID(shm_fd, cleanup_close, -1);
+    GglError ret = ggl_socket_handle_read_with_fd(
+        &pool, handle, GGL_BUF(prelude_mem), &shm_fd
+    );
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    EventStreamPrelude prelude;
+    ret = eventstream_decode_prelude(GGL_BUF(prelude_mem), &prelude);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
     GglBuffer recv_buffer = GGL_BUF(sub_resp_payload_array);
     EventStreamMessage msg = { 0 };
     GglSocketHandleReaderCtx reader_ctx;
-    GglError ret = ggl_client_get_response(
+    ret = ggl_client_read_response(
         ggl_socket_handle_reader(&reader_ctx, &pool, handle),
+        &prelude,
         recv_buffer,
         NULL,
         &msg
@@ -295,11 +328,37 @@ static GglError get_subscription_response(uint32_t handle) {
         return ret;
     }
 
+    // Result references the mapping until the callback returns
+    GGL_CLEANUP_ID(shm_mapping, ggl_core_bus_shm_unmap, (GglBuffer) { 0 });
+    GglBuffer payload = { 0 };
+    ret = ggl_core_bus_shm_payload(&msg, shm_fd, &shm_mapping, &payload);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
     static uint8_t obj_decode_mem[PAYLOAD_MAX_SUBOBJECTS * sizeof(GglObject)];
     GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(obj_decode_mem));
 
+    GglCoreBusCodec codec = GGL_CORE_BUS_CODEC_V1;
+    ret = ggl_core_bus_msg_codec(&msg, &codec);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    GglKeyDict *key_dict = NULL;
+    ret = ggl_socket_handle_protected(
+        get_sub_key_dict, &key_dict, &pool, handle
+    );
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    // Decode failures close the subscription, so the dictionary cannot be left
+    // out of sync with the server's
     GglObject result = GGL_OBJ_NULL();
-    ret = ggl_deserialize(&balloc.alloc, false, msg.payload, &result);
+    ret = ggl_core_bus_decode_payload(
+        &balloc.alloc, false, codec, key_dict, payload, &result
+    );
     if (ret != GGL_ERR_OK) {
         GGL_LOGE("Failed to decode subscription response payload.");
         return ret;
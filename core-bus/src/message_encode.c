@@ -0,0 +1,245 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "message_encode.h"
+#include "ggl/core_bus/constants.h"
+#include "ggl/core_bus/object_serde.h"
+#include "shm.h"
+#include <assert.h>
+#include <ggl/buffer.h>
+#include <ggl/cleanup.h>
+#include <ggl/error.h>
+#include <ggl/eventstream/encode.h>
+#include <ggl/eventstream/types.h>
+#include <ggl/file.h>
+#include <ggl/log.h>
+#include <ggl/object.h>
+#include <ggl/vector.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/// Max headers given for a message.
+#define MAX_HEADERS 4
+
+/// Max headers added to a message: `codec` and `shm_len`.
+#define MAX_ADDED_HEADERS 2
+
+size_t ggl_core_bus_segments_len(GglBufList segments) {
+    size_t len = 0;
+    for (size_t i = 0; i < segments.len; i++) {
+        len += segments.bufs[i].len;
+    }
+    return len;
+}
+
+/// Merge segments that are adjacent in memory.
+static void merge_contiguous(GglBufList *segments) {
+    size_t out = 0;
+    for (size_t i = 0; i < segments->len; i++) {
+        GglBuffer seg = segments->bufs[i];
+        if (seg.len == 0) {
+            continue;
+        }
+        if (out > 0) {
+            GglBuffer *prev = &segments->bufs[out - 1];
+            if (&prev->data[prev->len] == seg.data) {
+                prev->len += seg.len;
+                continue;
+            }
+        }
+        segments->bufs[out] = seg;
+        out += 1;
+    }
+    segments->len = out;
+}
+
+static GglError encode_inline(
+    GglBuffer buf,
+    const EventStreamHeader *headers,
+    size_t header_count,
+    const GglObject *payload,
+    GglKeyDict *dict,
+    GglBufVec *segments
+) {
+    GglBuffer head = buf;
+    GglError ret = eventstream_encode_begin(&head, headers, header_count);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    // Leave room after the serialized data for the CRC
+    if (buf.len - head.len < 4) {
+        GGL_LOGE("Insufficent buffer space to encode packet.");
+        return GGL_ERR_NOMEM;
+    }
+    GglBuffer payload_buf = ggl_buffer_substr(buf, head.len, buf.len - 4);
+
+    // Payload segments go between the head and CRC
+    GglBufVec payload_segments = {
+        .buf_list = { .bufs = &segments->buf_list.bufs[1], .len = 0 },
+        .capacity = segments->capacity - 2,
+    };
+
+    if (payload != NULL) {
+        ret = ggl_serialize_segments(
+            *payload, dict, &payload_buf, &payload_segments
+        );
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    } else {
+        payload_buf.len = 0;
+    }
+
+    uint8_t *crc = &payload_buf.data[payload_buf.len];
+    ret = eventstream_encode_finish(head, payload_segments.buf_list, crc);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    size_t message_len
+        = head.len + ggl_core_bus_segments_len(payload_segments.buf_list) + 4;
+    if (message_len > GGL_COREBUS_MAX_MSG_LEN) {
+        GGL_LOGE(
+            "Message length %zu exceeds core bus maximum of %d.",
+            message_len,
+            GGL_COREBUS_MAX_MSG_LEN
+        );
+        return GGL_ERR_NOMEM;
+    }
+
+    segments->buf_list.bufs[0] = head;
+    segments->buf_list.bufs[payload_segments.buf_list.len + 1]
+        = (GglBuffer) { .data = crc, .len = 4 };
+    segments->buf_list.len = payload_segments.buf_list.len + 2;
+
+    merge_contiguous(&segments->buf_list);
+    return GGL_ERR_OK;
+}
+
+/// Encode with the payload moved to shared memory.
+/// `headers` must have room for one more header.
+static GglError encode_shm(
+    GglBuffer buf,
+    EventStreamHeader *headers,
+    size_t header_count,
+    GglObject payload,
+    size_t payload_len,
+    GglKeyDict *dict,
+    GglBufVec *segments,
+    int *shm_fd
+) {
+    headers[header_count] = (EventStreamHeader) {
+        GGL_STR("shm_len"),
+        { EVENTSTREAM_INT32, .int32 = (int32_t) payload_len },
+    };
+
+    int fd = -1;
+    GglError ret = ggl_core_bus_shm_create(payload, payload_len, dict, &fd);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    GGL_CLEANUP_ID(fd_cleanup, cleanup_close, fd);
+
+    ret = encode_inline(buf, headers, header_count + 1, NULL, NULL, segments);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    GGL_LOGD("Sending %zu byte payload through shared memory.", payload_len);
+
+    // NOLINTNEXTLINE(clang-analyzer-deadcode.DeadStores) false positive
+    fd_cleanup = -1;
+    *shm_fd = fd;
+    return GGL_ERR_OK;
+}
+
+static GglError encode_message(
+    GglBuffer buf,
+    EventStreamHeader *headers,
+    size_t header_count,
+    const GglObject *payload,
+    GglKeyDict *dict,
+    GglBufVec *segments,
+    int *shm_fd
+) {
+    if ((payload != NULL) && (GGL_COREBUS_SHM_MAX_LEN > 0)) {
+        size_t payload_len = 0;
+        GglError ret = ggl_serialized_len(*payload, dict, &payload_len);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+
+        // Headers are small; bound them by what fits in the encode buffer
+        GglBuffer head = buf;
+        ret = eventstream_encode_begin(&head, headers, header_count);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+
+        if (head.len + payload_len + 4 > GGL_COREBUS_MAX_MSG_LEN) {
+            return encode_shm(
+                buf,
+                headers,
+                header_count,
+                *payload,
+                payload_len,
+                dict,
+                segments,
+                shm_fd
+            );
+        }
+    }
+
+    return encode_inline(buf, headers, header_count, payload, dict, segments);
+}
+
+GglError ggl_core_bus_encode_message(
+    GglBuffer buf,
+    const EventStreamHeader *headers,
+    size_t header_count,
+    const GglObject *payload,
+    GglCoreBusCodec codec,
+    GglKeyDict *stream_dict,
+    GglBufVec *segments,
+    int *shm_fd
+) {
+    assert((segments->buf_list.len == 0) && (segments->capacity >= 3));
+    assert((codec != GGL_CORE_BUS_CODEC_V2_STREAM) || (stream_dict != NULL));
+
+    *shm_fd = -1;
+
+    EventStreamHeader all_headers[MAX_HEADERS + MAX_ADDED_HEADERS];
+    if (header_count > MAX_HEADERS) {
+        GGL_LOGE("Too many headers for core bus message.");
+        return GGL_ERR_NOMEM;
+    }
+    if (header_count > 0) {
+        memcpy(all_headers, headers, header_count * sizeof(EventStreamHeader));
+    }
+    size_t all_header_count = header_count;
+
+    GglKeyDict msg_dict = { 0 };
+    GglKeyDict *dict = NULL;
+    if (codec != GGL_CORE_BUS_CODEC_V1) {
+        all_headers[all_header_count] = (EventStreamHeader) {
+            GGL_STR("codec"), { EVENTSTREAM_INT32, .int32 = (int32_t) codec }
+        };
+        all_header_count += 1;
+        dict = (codec == GGL_CORE_BUS_CODEC_V2_STREAM) ? stream_dict
+                                                        : &msg_dict;
+    }
+
+    size_t dict_len = (dict != NULL) ? dict->len : 0;
+
+    GglError ret = encode_message(
+        buf, all_headers, all_header_count, payload, dict, segments, shm_fd
+    );
+    if ((ret != GGL_ERR_OK) && (dict != NULL)) {
+        // Keys from a message that is not sent are not known to the receiver
+        dict->len = dict_len;
+    }
+    return ret;
+}
@@ -0,0 +1,47 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CORE_BUS_MESSAGE_ENCODE_H
+#define CORE_BUS_MESSAGE_ENCODE_H
+
+//! Scatter-gather encoding of core bus messages.
+
+#include "ggl/core_bus/object_serde.h"
+#include "types.h"
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <ggl/eventstream/types.h>
+#include <ggl/object.h>
+#include <ggl/vector.h>
+#include <stddef.h>
+
+/// Max buffers making up an encoded message.
+#define GGL_COREBUS_MAX_SEGMENTS 16
+
+/// Encode a core bus message as a list of buffers to write in order.
+/// Headers, object structure, and small values are written into `buf`. Large
+/// payload buffers are referenced in place, so must outlive the write.
+/// `payload` may be NULL for a message without a payload.
+/// The payload is encoded with `codec`, using `stream_dict` as the key
+/// dictionary for `GGL_CORE_BUS_CODEC_V2_STREAM`. `stream_dict` is left
+/// unchanged if encoding fails.
+/// `segments` should be empty and have capacity for at least 3 buffers.
+/// If the payload is too large for a packet, it is moved to shared memory and
+/// `shm_fd` is set to a memfd to pass with the message and then close;
+/// otherwise it is set to -1.
+GglError ggl_core_bus_encode_message(
+    GglBuffer buf,
+    const EventStreamHeader *headers,
+    size_t header_count,
+    const GglObject *payload,
+    GglCoreBusCodec codec,
+    GglKeyDict *stream_dict,
+    GglBufVec *segments,
+    int *shm_fd
+);
+
+/// Total length of a list of buffers.
+size_t ggl_core_bus_segments_len(GglBufList segments);
+
+#endif
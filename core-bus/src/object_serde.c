@@ -2,15 +2,18 @@
 // Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
 // SPDX-License-Identifier: Apache-2.0
 
-#include "object_serde.h"
+#include "ggl/core_bus/object_serde.h"
 #include <assert.h>
 #include <ggl/alloc.h>
+#include <ggl/buffer.h>
 #include <ggl/bump_alloc.h>
 #include <ggl/constants.h>
 #include <ggl/error.h>
 #include <ggl/io.h>
 #include <ggl/log.h>
 #include <ggl/object.h>
+#include <ggl/vector.h>
+#include <inttypes.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -38,6 +41,46 @@ typedef struct {
     size_t level;
 } NestingState;
 
+/// Output state for serializing with buffers referenced in place.
+typedef struct {
+    GglBumpAlloc *mem;
+    GglBufVec *segments;
+    /// Offset in `mem` where the current unflushed segment starts.
+    size_t start;
+} SegmentState;
+
+/// Type tags of the compact encoding.
+/// Small integers and short buffers, lists, and maps hold their value or length
+/// in the tag's low bits.
+typedef enum {
+    COMPACT_NULL = 0x00,
+    COMPACT_FALSE = 0x01,
+    COMPACT_TRUE = 0x02,
+    /// Followed by zigzag varint.
+    COMPACT_I64 = 0x03,
+    COMPACT_F64 = 0x04,
+    /// Followed by varint length.
+    COMPACT_BUF = 0x05,
+    COMPACT_LIST = 0x06,
+    COMPACT_MAP = 0x07,
+    /// 0x40-0x7F: integers 0-63.
+    COMPACT_SMALL_INT = 0x40,
+    /// 0x80-0xBF: buffers of length 0-63.
+    COMPACT_SHORT_BUF = 0x80,
+    /// 0xC0-0xCF: lists of length 0-15.
+    COMPACT_SHORT_LIST = 0xC0,
+    /// 0xD0-0xDF: maps of length 0-15.
+    COMPACT_SHORT_MAP = 0xD0,
+} CompactTag;
+
+/// Max value held in a small int or short buffer tag.
+#define COMPACT_SMALL_MAX 0x3F
+/// Max length held in a short list or map tag.
+#define COMPACT_SHORT_MAX 0x0F
+
+/// Max bytes in a varint encoding a uint64_t.
+#define VARINT_MAX_LEN 10
+
 static GglError push_parse_state(NestingState *state, NestingLevel level) {
     if (state->level >= GGL_MAX_OBJECT_DEPTH) {
         GGL_LOGE("Packet object exceeded max nesting depth.");
@@ -136,7 +179,29 @@ static GglError read_f64(GglBuffer *buf, GglObject *obj) {
     return GGL_ERR_OK;
 }
 
-static GglError write_buf(GglAlloc *alloc, GglBuffer buffer) {
+/// Add the serialized bytes since the last reference, then a reference.
+/// Returns false if the buffer should be copied instead.
+static bool segment_ref(SegmentState *segs, GglBuffer buffer) {
+    // Keep a segment free for the data after the last reference
+    if ((segs == NULL) || (buffer.len < GGL_SERIALIZE_REF_MIN_LEN)
+        || (segs->segments->capacity - segs->segments->buf_list.len < 3)) {
+        return false;
+    }
+
+    GglBuffer pending = ggl_buffer_substr(
+        segs->mem->buf, segs->start, segs->mem->index
+    );
+    if (pending.len > 0) {
+        (void) ggl_buf_vec_push(segs->segments, pending);
+    }
+    (void) ggl_buf_vec_push(segs->segments, buffer);
+    segs->start = segs->mem->index;
+    return true;
+}
+
+static GglError write_buf(
+    GglAlloc *alloc, SegmentState *segs, GglBuffer buffer
+) {
     assert(alloc != NULL);
 
     if (buffer.len > UINT32_MAX) {
@@ -145,29 +210,38 @@ static GglError write_buf(GglAlloc *alloc, GglBuffer buffer) {
     }
     uint32_t len = (uint32_t) buffer.len;
 
-    uint8_t *buf = GGL_ALLOCN(alloc, uint8_t, sizeof(len) + buffer.len);
+    uint8_t *buf = GGL_ALLOCN(alloc, uint8_t, sizeof(len));
     if (buf == NULL) {
         GGL_LOGE("Insufficient memory to encode packet.");
         return GGL_ERR_NOMEM;
     }
 
     memcpy(buf, &len, sizeof(len));
-    memcpy(&buf[sizeof(len)], buffer.data, len);
+
+    if (segment_ref(segs, buffer)) {
+        return GGL_ERR_OK;
+    }
+
+    buf = GGL_ALLOCN(alloc, uint8_t, buffer.len);
+    if (buf == NULL) {
+        GGL_LOGE("Insufficient memory to encode packet.");
+        return GGL_ERR_NOMEM;
+    }
+
+    memcpy(buf, buffer.data, len);
     return GGL_ERR_OK;
 }
 
-static GglError read_buf_raw(
-    GglAlloc *alloc, bool copy_bufs, GglBuffer *buf, GglBuffer *out
+/// Take a buffer of `len` bytes, copying it into `alloc` if `copy_bufs`.
+static GglError take_buf(
+    GglAlloc *alloc,
+    bool copy_bufs,
+    GglBuffer *buf,
+    size_t len,
+    GglBuffer *out
 ) {
     GglBuffer temp_buf;
-    uint32_t len;
-    GglError ret = buf_take(sizeof(len), buf, &temp_buf);
-    if (ret != GGL_ERR_OK) {
-        return ret;
-    }
-    memcpy(&len, temp_buf.data, sizeof(len));
-
-    ret = buf_take(len, buf, &temp_buf);
+    GglError ret = buf_take(len, buf, &temp_buf);
     if (ret != GGL_ERR_OK) {
         return ret;
     }
@@ -187,6 +261,20 @@ static GglError read_buf_raw(
     return GGL_ERR_OK;
 }
 
+static GglError read_buf_raw(
+    GglAlloc *alloc, bool copy_bufs, GglBuffer *buf, GglBuffer *out
+) {
+    GglBuffer temp_buf;
+    uint32_t len;
+    GglError ret = buf_take(sizeof(len), buf, &temp_buf);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    memcpy(&len, temp_buf.data, sizeof(len));
+
+    return take_buf(alloc, copy_bufs, buf, len, out);
+}
+
 static GglError read_buf(
     GglAlloc *alloc, bool copy_bufs, GglBuffer *buf, GglObject *obj
 ) {
@@ -231,17 +319,9 @@ static GglError write_list(GglAlloc *alloc, NestingState *state, GglList list) {
     return GGL_ERR_OK;
 }
 
-static GglError read_list(
-    GglAlloc *alloc, NestingState *state, GglBuffer *buf, GglObject *obj
+static GglError read_list_len(
+    GglAlloc *alloc, NestingState *state, uint32_t len, GglObject *obj
 ) {
-    GglBuffer temp_buf;
-    uint32_t len;
-    GglError ret = buf_take(sizeof(len), buf, &temp_buf);
-    if (ret != GGL_ERR_OK) {
-        return ret;
-    }
-    memcpy(&len, temp_buf.data, sizeof(len));
-
     GglList val = { .len = len };
 
     if (len > 0) {
@@ -257,7 +337,7 @@ static GglError read_list(
             return GGL_ERR_NOMEM;
         }
 
-        ret = push_parse_state(
+        GglError ret = push_parse_state(
             state,
             (NestingLevel) {
                 .type = HANDLING_OBJ,
@@ -274,6 +354,20 @@ static GglError read_list(
     return GGL_ERR_OK;
 }
 
+static GglError read_list(
+    GglAlloc *alloc, NestingState *state, GglBuffer *buf, GglObject *obj
+) {
+    GglBuffer temp_buf;
+    uint32_t len;
+    GglError ret = buf_take(sizeof(len), buf, &temp_buf);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    memcpy(&len, temp_buf.data, sizeof(len));
+
+    return read_list_len(alloc, state, len, obj);
+}
+
 static GglError write_map(GglAlloc *alloc, NestingState *state, GglMap map) {
     assert(alloc != NULL);
 
@@ -305,17 +399,9 @@ static GglError write_map(GglAlloc *alloc, NestingState *state, GglMap map) {
     return GGL_ERR_OK;
 }
 
-static GglError read_map(
-    GglAlloc *alloc, NestingState *state, GglBuffer *buf, GglObject *obj
+static GglError read_map_len(
+    GglAlloc *alloc, NestingState *state, uint32_t len, GglObject *obj
 ) {
-    GglBuffer temp_buf;
-    uint32_t len;
-    GglError ret = buf_take(sizeof(len), buf, &temp_buf);
-    if (ret != GGL_ERR_OK) {
-        return ret;
-    }
-    memcpy(&len, temp_buf.data, sizeof(len));
-
     GglMap val = { .len = len };
 
     if (len > 0) {
@@ -331,7 +417,7 @@ static GglError read_map(
             return GGL_ERR_NOMEM;
         }
 
-        ret = push_parse_state(
+        GglError ret = push_parse_state(
             state,
             (NestingLevel) {
                 .type = HANDLING_KV,
@@ -348,7 +434,23 @@ static GglError read_map(
     return GGL_ERR_OK;
 }
 
-static GglError write_obj(GglAlloc *alloc, NestingState *state, GglObject obj) {
+static GglError read_map(
+    GglAlloc *alloc, NestingState *state, GglBuffer *buf, GglObject *obj
+) {
+    GglBuffer temp_buf;
+    uint32_t len;
+    GglError ret = buf_take(sizeof(len), buf, &temp_buf);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    memcpy(&len, temp_buf.data, sizeof(len));
+
+    return read_map_len(alloc, state, len, obj);
+}
+
+static GglError write_obj(
+    GglAlloc *alloc, SegmentState *segs, NestingState *state, GglObject obj
+) {
     uint8_t *buf = GGL_ALLOCN(alloc, uint8_t, 1);
     if (buf == NULL) {
         GGL_LOGE("Insufficient memory to encode packet.");
@@ -367,7 +469,7 @@ static GglError write_obj(GglAlloc *alloc, NestingState *state, GglObject obj) {
     case GGL_TYPE_F64:
         return write_f64(alloc, obj.f64);
     case GGL_TYPE_BUF:
-        return write_buf(alloc, obj.buf);
+        return write_buf(alloc, segs, obj.buf);
     case GGL_TYPE_LIST:
         return write_list(alloc, state, obj.list);
     case GGL_TYPE_MAP:
@@ -414,9 +516,411 @@ static GglError read_obj(
     return GGL_ERR_INVALID;
 }
 
-GglError ggl_serialize(GglObject obj, GglBuffer *buf) {
+static GglError write_bytes(GglAlloc *alloc, const uint8_t *data, size_t len) {
+    assert(alloc != NULL);
+
+    if (len == 0) {
+        return GGL_ERR_OK;
+    }
+
+    uint8_t *buf = GGL_ALLOCN(alloc, uint8_t, len);
+    if (buf == NULL) {
+        GGL_LOGE("Insufficient memory to encode packet.");
+        return GGL_ERR_NOMEM;
+    }
+
+    memcpy(buf, data, len);
+    return GGL_ERR_OK;
+}
+
+static GglError write_tag(GglAlloc *alloc, uint8_t tag) {
+    return write_bytes(alloc, &tag, 1);
+}
+
+static size_t varint_len(uint64_t val) {
+    size_t len = 1;
+    for (uint64_t rest = val; rest >= 0x80; rest >>= 7) {
+        len += 1;
+    }
+    return len;
+}
+
+static GglError write_varint(GglAlloc *alloc, uint64_t val) {
+    uint8_t mem[VARINT_MAX_LEN];
+    size_t len = 0;
+    uint64_t rest = val;
+    while (rest >= 0x80) {
+        mem[len] = (uint8_t) ((rest & 0x7F) | 0x80);
+        len += 1;
+        rest >>= 7;
+    }
+    mem[len] = (uint8_t) rest;
+    return write_bytes(alloc, mem, len + 1);
+}
+
+static GglError read_varint(GglBuffer *buf, uint64_t *val) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < VARINT_MAX_LEN; i++) {
+        GglBuffer temp_buf;
+        GglError ret = buf_take(1, buf, &temp_buf);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        uint8_t byte = temp_buf.data[0];
+
+        if ((i == VARINT_MAX_LEN - 1) && (byte > 1)) {
+            break;
+        }
+        result |= (uint64_t) (byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            *val = result;
+            return GGL_ERR_OK;
+        }
+    }
+
+    GGL_LOGE("Packet varint exceeds 64 bits.");
+    return GGL_ERR_PARSE;
+}
+
+static GglError read_varint_len(GglBuffer *buf, uint32_t *len) {
+    uint64_t val = 0;
+    GglError ret = read_varint(buf, &val);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    if (val > UINT32_MAX) {
+        GGL_LOGE("Packet length exceeds bounds.");
+        return GGL_ERR_PARSE;
+    }
+    *len = (uint32_t) val;
+    return GGL_ERR_OK;
+}
+
+static uint64_t zigzag_encode(int64_t val) {
+    return ((uint64_t) val << 1) ^ (uint64_t) (val >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t val) {
+    return (int64_t) (val >> 1) ^ -(int64_t) (val & 1);
+}
+
+static bool key_dict_find(
+    const GglKeyDict *dict, GglBuffer key, size_t *index
+) {
+    for (size_t i = 0; i < dict->len; i++) {
+        if (ggl_buffer_eq(dict->keys[i], key)) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Add a key sent in full, if it is eligible and there is room.
+static void key_dict_add(GglKeyDict *dict, GglBuffer key) {
+    if ((dict->len >= GGL_KEY_DICT_MAX_KEYS)
+        || (key.len > GGL_KEY_DICT_MAX_KEY_LEN)) {
+        return;
+    }
+
+    GglBuffer entry = key;
+    if (dict->mem != NULL) {
+        entry.data = dict->mem[dict->len];
+        if (key.len > 0) {
+            memcpy(entry.data, key.data, key.len);
+        }
+    }
+    dict->keys[dict->len] = entry;
+    dict->len += 1;
+}
+
+/// Length of the compact encoding of a key; adds it to `dict` as encoding
+/// would.
+static size_t compact_key_len(GglKeyDict *dict, GglBuffer key) {
+    size_t index = 0;
+    if (key_dict_find(dict, key, &index)) {
+        return varint_len(((uint64_t) index << 1) | 1);
+    }
+    key_dict_add(dict, key);
+    return varint_len((uint64_t) key.len << 1) + key.len;
+}
+
+/// Keys are a varint of an index into `dict` shifted left with the low bit set,
+/// or of the key length shifted left followed by the key.
+static GglError write_compact_key(
+    GglAlloc *alloc, GglKeyDict *dict, GglBuffer key
+) {
+    size_t index = 0;
+    if (key_dict_find(dict, key, &index)) {
+        return write_varint(alloc, ((uint64_t) index << 1) | 1);
+    }
+
+    GglError ret = write_varint(alloc, (uint64_t) key.len << 1);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    ret = write_bytes(alloc, key.data, key.len);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    key_dict_add(dict, key);
+    return GGL_ERR_OK;
+}
+
+static GglError read_compact_key(
+    GglAlloc *alloc,
+    bool copy_bufs,
+    GglKeyDict *dict,
+    GglBuffer *buf,
+    GglBuffer *out
+) {
+    uint64_t val = 0;
+    GglError ret = read_varint(buf, &val);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    if ((val & 1) == 0) {
+        if ((val >> 1) > buf->len) {
+            GGL_LOGE("Packet decode exceeded bounds.");
+            return GGL_ERR_PARSE;
+        }
+        ret = take_buf(alloc, copy_bufs, buf, (size_t) (val >> 1), out);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        key_dict_add(dict, *out);
+        return GGL_ERR_OK;
+    }
+
+    uint64_t index = val >> 1;
+    if (index >= dict->len) {
+        GGL_LOGE("Packet references unknown key %" PRIu64 ".", index);
+        return GGL_ERR_PARSE;
+    }
+    *out = dict->keys[index];
+
+    if (copy_bufs && (out->len > 0)) {
+        uint8_t *copy = GGL_ALLOCN(alloc, uint8_t, out->len);
+        if (copy == NULL) {
+            GGL_LOGE("Insufficient memory to decode packet.");
+            return GGL_ERR_NOMEM;
+        }
+        memcpy(copy, out->data, out->len);
+        out->data = copy;
+    }
+    return GGL_ERR_OK;
+}
+
+/// Write a tag with a short length, or a tag followed by a varint length.
+static GglError write_compact_len(
+    GglAlloc *alloc,
+    uint8_t short_tag,
+    size_t short_max,
+    uint8_t tag,
+    size_t len
+) {
+    if (len > UINT32_MAX) {
+        GGL_LOGE("Can't encode object of len %zu.", len);
+        return GGL_ERR_RANGE;
+    }
+    if (len <= short_max) {
+        return write_tag(alloc, (uint8_t) (short_tag | len));
+    }
+    GglError ret = write_tag(alloc, tag);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    return write_varint(alloc, len);
+}
+
+static size_t compact_len_len(size_t short_max, size_t len) {
+    return (len <= short_max) ? 1 : 1 + varint_len(len);
+}
+
+static GglError write_compact_buf(
+    GglAlloc *alloc, SegmentState *segs, GglBuffer buffer
+) {
+    GglError ret = write_compact_len(
+        alloc, COMPACT_SHORT_BUF, COMPACT_SMALL_MAX, COMPACT_BUF, buffer.len
+    );
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    if (segment_ref(segs, buffer)) {
+        return GGL_ERR_OK;
+    }
+
+    return write_bytes(alloc, buffer.data, buffer.len);
+}
+
+static GglError write_compact_obj(
+    GglAlloc *alloc, SegmentState *segs, NestingState *state, GglObject obj
+) {
+    GglError ret = GGL_ERR_OK;
+
+    switch (obj.type) {
+    case GGL_TYPE_NULL:
+        return write_tag(alloc, COMPACT_NULL);
+    case GGL_TYPE_BOOLEAN:
+        return write_tag(alloc, obj.boolean ? COMPACT_TRUE : COMPACT_FALSE);
+    case GGL_TYPE_I64:
+        if ((obj.i64 >= 0) && (obj.i64 <= COMPACT_SMALL_MAX)) {
+            return write_tag(alloc, (uint8_t) (COMPACT_SMALL_INT | obj.i64));
+        }
+        ret = write_tag(alloc, COMPACT_I64);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        return write_varint(alloc, zigzag_encode(obj.i64));
+    case GGL_TYPE_F64:
+        ret = write_tag(alloc, COMPACT_F64);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        return write_f64(alloc, obj.f64);
+    case GGL_TYPE_BUF:
+        return write_compact_buf(alloc, segs, obj.buf);
+    case GGL_TYPE_LIST:
+        ret = write_compact_len(
+            alloc,
+            COMPACT_SHORT_LIST,
+            COMPACT_SHORT_MAX,
+            COMPACT_LIST,
+            obj.list.len
+        );
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        return push_parse_state(
+            state,
+            (NestingLevel) {
+                .type = HANDLING_OBJ,
+                .obj_next = obj.list.items,
+                .remaining = (uint32_t) obj.list.len,
+            }
+        );
+    case GGL_TYPE_MAP:
+        ret = write_compact_len(
+            alloc,
+            COMPACT_SHORT_MAP,
+            COMPACT_SHORT_MAX,
+            COMPACT_MAP,
+            obj.map.len
+        );
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        return push_parse_state(
+            state,
+            (NestingLevel) {
+                .type = HANDLING_KV,
+                .kv_next = obj.map.pairs,
+                .remaining = (uint32_t) obj.map.len,
+            }
+        );
+    }
+    return GGL_ERR_INVALID;
+}
+
+static GglError read_compact_obj(
+    GglAlloc *alloc,
+    bool copy_bufs,
+    NestingState *state,
+    GglBuffer *buf,
+    GglObject *obj
+) {
+    assert((buf != NULL) && (obj != NULL));
+
+    GglBuffer temp_buf;
+    GglError ret = buf_take(1, buf, &temp_buf);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    uint8_t tag = temp_buf.data[0];
+    uint32_t len = 0;
+
+    if ((tag & 0xC0) == COMPACT_SMALL_INT) {
+        *obj = GGL_OBJ_I64(tag & COMPACT_SMALL_MAX);
+        return GGL_ERR_OK;
+    }
+    if ((tag & 0xC0) == COMPACT_SHORT_BUF) {
+        GglBuffer val;
+        ret = take_buf(alloc, copy_bufs, buf, tag & COMPACT_SMALL_MAX, &val);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        *obj = GGL_OBJ_BUF(val);
+        return GGL_ERR_OK;
+    }
+    if ((tag & 0xF0) == COMPACT_SHORT_LIST) {
+        return read_list_len(alloc, state, tag & COMPACT_SHORT_MAX, obj);
+    }
+    if ((tag & 0xF0) == COMPACT_SHORT_MAP) {
+        return read_map_len(alloc, state, tag & COMPACT_SHORT_MAX, obj);
+    }
+
+    switch (tag) {
+    case COMPACT_NULL:
+        *obj = GGL_OBJ_NULL();
+        return GGL_ERR_OK;
+    case COMPACT_FALSE:
+        *obj = GGL_OBJ_BOOL(false);
+        return GGL_ERR_OK;
+    case COMPACT_TRUE:
+        *obj = GGL_OBJ_BOOL(true);
+        return GGL_ERR_OK;
+    case COMPACT_I64: {
+        uint64_t val = 0;
+        ret = read_varint(buf, &val);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        *obj = GGL_OBJ_I64(zigzag_decode(val));
+        return GGL_ERR_OK;
+    }
+    case COMPACT_F64:
+        return read_f64(buf, obj);
+    case COMPACT_BUF: {
+        ret = read_varint_len(buf, &len);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        GglBuffer val;
+        ret = take_buf(alloc, copy_bufs, buf, len, &val);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        *obj = GGL_OBJ_BUF(val);
+        return GGL_ERR_OK;
+    }
+    case COMPACT_LIST:
+        ret = read_varint_len(buf, &len);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        return read_list_len(alloc, state, len, obj);
+    case COMPACT_MAP:
+        ret = read_varint_len(buf, &len);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        return read_map_len(alloc, state, len, obj);
+    default:
+        break;
+    }
+    return GGL_ERR_INVALID;
+}
+
+static GglError serialize(
+    GglObject obj, GglKeyDict *dict, GglBuffer *buf, GglBufVec *segments
+) {
     assert(buf != NULL);
     GglBumpAlloc mem = ggl_bump_alloc_init(*buf);
+    SegmentState segs = { .mem = &mem, .segments = segments };
+    SegmentState *segs_ptr = (segments != NULL) ? &segs : NULL;
 
     NestingState state = {
         .levels = { {
@@ -436,18 +940,27 @@ GglError ggl_serialize(GglObject obj, GglBuffer *buf) {
         }
 
         if (level->type == HANDLING_OBJ) {
-            GglError ret = write_obj(&mem.alloc, &state, *level->obj_next);
+            GglError ret = (dict != NULL)
+                ? write_compact_obj(
+                      &mem.alloc, segs_ptr, &state, *level->obj_next
+                  )
+                : write_obj(&mem.alloc, segs_ptr, &state, *level->obj_next);
             if (ret != GGL_ERR_OK) {
                 return ret;
             }
             level->remaining -= 1;
             level->obj_next = &level->obj_next[1];
         } else if (level->type == HANDLING_KV) {
-            GglError ret = write_buf(&mem.alloc, level->kv_next->key);
+            GglError ret = (dict != NULL)
+                ? write_compact_key(&mem.alloc, dict, level->kv_next->key)
+                : write_buf(&mem.alloc, segs_ptr, level->kv_next->key);
             if (ret != GGL_ERR_OK) {
                 return ret;
             }
-            ret = write_obj(&mem.alloc, &state, level->kv_next->val);
+            GglObject val = level->kv_next->val;
+            ret = (dict != NULL)
+                ? write_compact_obj(&mem.alloc, segs_ptr, &state, val)
+                : write_obj(&mem.alloc, segs_ptr, &state, val);
             if (ret != GGL_ERR_OK) {
                 return ret;
             }
@@ -458,12 +971,157 @@ GglError ggl_serialize(GglObject obj, GglBuffer *buf) {
         }
     } while (state.level > 0);
 
+    if (segments != NULL) {
+        GglBuffer pending
+            = ggl_buffer_substr(mem.buf, segs.start, mem.index);
+        if (pending.len > 0) {
+            GglError ret = ggl_buf_vec_push(segments, pending);
+            if (ret != GGL_ERR_OK) {
+                GGL_LOGE("Insufficient segments to encode packet.");
+                return ret;
+            }
+        }
+    }
+
     buf->len = mem.index;
     return GGL_ERR_OK;
 }
 
+GglError ggl_serialize(GglObject obj, GglKeyDict *dict, GglBuffer *buf) {
+    return serialize(obj, dict, buf, NULL);
+}
+
+GglError ggl_serialize_segments(
+    GglObject obj, GglKeyDict *dict, GglBuffer *buf, GglBufVec *segments
+) {
+    assert(segments != NULL);
+    return serialize(obj, dict, buf, segments);
+}
+
+/// Length of an object excluding its children.
+static size_t obj_own_len(GglObject obj, bool compact) {
+    switch (obj.type) {
+    case GGL_TYPE_NULL:
+        return 1;
+    case GGL_TYPE_BOOLEAN:
+        return compact ? 1 : 2;
+    case GGL_TYPE_I64:
+        if (!compact) {
+            return 1 + sizeof(int64_t);
+        }
+        if ((obj.i64 >= 0) && (obj.i64 <= COMPACT_SMALL_MAX)) {
+            return 1;
+        }
+        return 1 + varint_len(zigzag_encode(obj.i64));
+    case GGL_TYPE_F64:
+        return 1 + sizeof(double);
+    case GGL_TYPE_BUF:
+        return (compact ? compact_len_len(COMPACT_SMALL_MAX, obj.buf.len)
+                        : 1 + sizeof(uint32_t))
+            + obj.buf.len;
+    case GGL_TYPE_LIST:
+        return compact ? compact_len_len(COMPACT_SHORT_MAX, obj.list.len)
+                       : 1 + sizeof(uint32_t);
+    case GGL_TYPE_MAP:
+        return compact ? compact_len_len(COMPACT_SHORT_MAX, obj.map.len)
+                       : 1 + sizeof(uint32_t);
+    }
+    return 0;
+}
+
+static GglError serialized_len(GglObject obj, GglKeyDict *dict, size_t *len) {
+    size_t total = 0;
+
+    NestingState state = {
+        .levels = { {
+            .type = HANDLING_OBJ,
+            .obj_next = &obj,
+            .remaining = 1,
+        } },
+        .level = 1,
+    };
+
+    do {
+        NestingLevel *level = &state.levels[state.level - 1];
+
+        if (level->remaining == 0) {
+            state.level -= 1;
+            continue;
+        }
+
+        GglObject val;
+        if (level->type == HANDLING_OBJ) {
+            val = *level->obj_next;
+            level->obj_next = &level->obj_next[1];
+        } else {
+            GglBuffer key = level->kv_next->key;
+            total += (dict != NULL) ? compact_key_len(dict, key)
+                                    : sizeof(uint32_t) + key.len;
+            val = level->kv_next->val;
+            level->kv_next = &level->kv_next[1];
+        }
+        level->remaining -= 1;
+
+        total += obj_own_len(val, dict != NULL);
+
+        GglError ret = GGL_ERR_OK;
+        switch (val.type) {
+        case GGL_TYPE_NULL:
+        case GGL_TYPE_BOOLEAN:
+        case GGL_TYPE_I64:
+        case GGL_TYPE_F64:
+        case GGL_TYPE_BUF:
+            break;
+        case GGL_TYPE_LIST:
+            ret = push_parse_state(
+                &state,
+                (NestingLevel) {
+                    .type = HANDLING_OBJ,
+                    .obj_next = val.list.items,
+                    .remaining = (uint32_t) val.list.len,
+                }
+            );
+            break;
+        case GGL_TYPE_MAP:
+            ret = push_parse_state(
+                &state,
+                (NestingLevel) {
+                    .type = HANDLING_KV,
+                    .kv_next = val.map.pairs,
+                    .remaining = (uint32_t) val.map.len,
+                }
+            );
+            break;
+        default:
+            return GGL_ERR_INVALID;
+        }
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    } while (state.level > 0);
+
+    *len = total;
+    return GGL_ERR_OK;
+}
+
+GglError ggl_serialized_len(GglObject obj, GglKeyDict *dict, size_t *len) {
+    assert(len != NULL);
+
+    // Keys added while measuring are forgotten; entries past len are unused
+    size_t dict_len = (dict != NULL) ? dict->len : 0;
+    GglError ret = serialized_len(obj, dict, len);
+    if (dict != NULL) {
+        dict->len = dict_len;
+    }
+    return ret;
+}
+
 GglError ggl_deserialize(
-    GglAlloc *alloc, bool copy_bufs, GglBuffer buf, GglObject *obj
+    GglAlloc *alloc,
+    bool copy_bufs,
+    GglKeyDict *dict,
+    GglBuffer buf,
+    GglObject *obj
 ) {
     assert(obj != NULL);
 
@@ -487,22 +1145,27 @@ GglError ggl_deserialize(
         }
 
         if (level->type == HANDLING_OBJ) {
-            GglError ret
-                = read_obj(alloc, copy_bufs, &state, &rest, level->obj_next);
+            GglError ret = (dict != NULL)
+                ? read_compact_obj(
+                      alloc, copy_bufs, &state, &rest, level->obj_next
+                  )
+                : read_obj(alloc, copy_bufs, &state, &rest, level->obj_next);
             if (ret != GGL_ERR_OK) {
                 return ret;
             }
             level->remaining -= 1;
             level->obj_next = &level->obj_next[1];
         } else if (level->type == HANDLING_KV) {
-            GglError ret
-                = read_buf_raw(alloc, copy_bufs, &rest, &level->kv_next->key);
+            GglKV *kv = level->kv_next;
+            GglError ret = (dict != NULL)
+                ? read_compact_key(alloc, copy_bufs, dict, &rest, &kv->key)
+                : read_buf_raw(alloc, copy_bufs, &rest, &kv->key);
             if (ret != GGL_ERR_OK) {
                 return ret;
             }
-            ret = read_obj(
-                alloc, copy_bufs, &state, &rest, &level->kv_next->val
-            );
+            ret = (dict != NULL)
+                ? read_compact_obj(alloc, copy_bufs, &state, &rest, &kv->val)
+                : read_obj(alloc, copy_bufs, &state, &rest, &kv->val);
             if (ret != GGL_ERR_OK) {
                 return ret;
             }
@@ -531,7 +1194,7 @@ static GglError obj_read(void *ctx, GglBuffer *buf) {
         return GGL_ERR_INVALID;
     }
 
-    return ggl_serialize(*obj, buf);
+    return ggl_serialize(*obj, NULL, buf);
 }
 
 GglReader ggl_serialize_reader(GglObject *obj) {
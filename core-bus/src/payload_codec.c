@@ -0,0 +1,69 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "payload_codec.h"
+#include "ggl/core_bus/object_serde.h"
+#include "types.h"
+#include <ggl/alloc.h>
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <ggl/eventstream/decode.h>
+#include <ggl/eventstream/types.h>
+#include <ggl/log.h>
+#include <ggl/object.h>
+#include <stdbool.h>
+
+GglError ggl_core_bus_msg_codec(
+    const EventStreamMessage *msg, GglCoreBusCodec *codec
+) {
+    EventStreamHeaderIter iter = msg->headers;
+    EventStreamHeader header;
+
+    while (eventstream_header_next(&iter, &header) == GGL_ERR_OK) {
+        if (ggl_buffer_eq(header.name, GGL_STR("codec"))) {
+            if (header.value.type != EVENTSTREAM_INT32) {
+                GGL_LOGE("Codec header not int.");
+                return GGL_ERR_PARSE;
+            }
+            switch (header.value.int32) {
+            case GGL_CORE_BUS_CODEC_V1:
+            case GGL_CORE_BUS_CODEC_V2:
+            case GGL_CORE_BUS_CODEC_V2_STREAM:
+                *codec = (GglCoreBusCodec) header.value.int32;
+                return GGL_ERR_OK;
+            default:
+                GGL_LOGE("Unsupported codec %d.", header.value.int32);
+                return GGL_ERR_UNSUPPORTED;
+            }
+        }
+    }
+
+    *codec = GGL_CORE_BUS_CODEC_V1;
+    return GGL_ERR_OK;
+}
+
+GglError ggl_core_bus_decode_payload(
+    GglAlloc *alloc,
+    bool copy_bufs,
+    GglCoreBusCodec codec,
+    GglKeyDict *stream_dict,
+    GglBuffer payload,
+    GglObject *obj
+) {
+    GglKeyDict msg_dict = { 0 };
+
+    switch (codec) {
+    case GGL_CORE_BUS_CODEC_V1:
+        return ggl_deserialize(alloc, copy_bufs, NULL, payload, obj);
+    case GGL_CORE_BUS_CODEC_V2:
+        return ggl_deserialize(alloc, copy_bufs, &msg_dict, payload, obj);
+    case GGL_CORE_BUS_CODEC_V2_STREAM:
+        if (stream_dict == NULL) {
+            GGL_LOGE("Streaming codec used where not supported.");
+            return GGL_ERR_UNSUPPORTED;
+        }
+        return ggl_deserialize(alloc, copy_bufs, stream_dict, payload, obj);
+    }
+    return GGL_ERR_INVALID;
+}
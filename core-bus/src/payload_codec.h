@@ -0,0 +1,36 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CORE_BUS_PAYLOAD_CODEC_H
+#define CORE_BUS_PAYLOAD_CODEC_H
+
+//! Payload encoding selection for received core bus messages.
+
+#include "ggl/core_bus/object_serde.h"
+#include "types.h"
+#include <ggl/alloc.h>
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <ggl/eventstream/decode.h>
+#include <ggl/object.h>
+#include <stdbool.h>
+
+/// Get the payload encoding of a received message from its `codec` header.
+GglError ggl_core_bus_msg_codec(
+    const EventStreamMessage *msg, GglCoreBusCodec *codec
+);
+
+/// Decode a received payload in the given encoding.
+/// `stream_dict` is the connection's key dictionary, or NULL if the connection
+/// does not keep one. Arguments are otherwise as for `ggl_deserialize`.
+GglError ggl_core_bus_decode_payload(
+    GglAlloc *alloc,
+    bool copy_bufs,
+    GglCoreBusCodec codec,
+    GglKeyDict *stream_dict,
+    GglBuffer payload,
+    GglObject *obj
+);
+
+#endif
@@ -4,7 +4,10 @@
 
 #include "ggl/core_bus/server.h"
 #include "ggl/core_bus/constants.h"
-#include "object_serde.h"
+#include "ggl/core_bus/object_serde.h"
+#include "message_encode.h"
+#include "payload_codec.h"
+#include "shm.h"
 #include "types.h"
 #include <sys/types.h>
 #include <assert.h>
@@ -15,17 +18,24 @@
 #include <ggl/eventstream/decode.h>
 #include <ggl/eventstream/encode.h>
 #include <ggl/eventstream/types.h>
+#include <ggl/file.h>
 #include <ggl/io.h>
 #include <ggl/log.h>
 #include <ggl/object.h>
+#include <ggl/socket.h>
 #include <ggl/socket_handle.h>
 #include <ggl/socket_server.h>
+#include <ggl/socket_epoll.h>
 #include <ggl/vector.h>
 #include <pthread.h>
+#include <stdalign.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #define PAYLOAD_VALUE_MAX_SUBOBJECTS 200
 
@@ -39,34 +49,115 @@ typedef struct {
     void *ctx;
 } SubCleanupCallback;
 
+/// Encode buffer for subscription responses, which may be sent from any thread.
 static uint8_t encode_array[GGL_COREBUS_MAX_MSG_LEN];
 static pthread_mutex_t encode_array_mtx = PTHREAD_MUTEX_INITIALIZER;
 
-static GglCoreBusRequestType client_request_types[GGL_COREBUS_MAX_CLIENTS];
+/// State for a thread handling client requests.
+typedef struct {
+    alignas(GglObject) uint8_t payload_deserialize_mem
+        [PAYLOAD_VALUE_MAX_SUBOBJECTS * sizeof(GglObject)];
+    uint8_t payload_array[GGL_COREBUS_MAX_MSG_LEN];
+    uint8_t encode_array[GGL_COREBUS_MAX_MSG_LEN];
+    /// Set to a handle when calling handler.
+    /// ggl_sub_respond blocks if this is the response handle.
+    _Atomic(uint32_t) current_handle;
+    /// Fd passed with the request being handled, or -1.
+    int request_fd;
+} WorkerState;
+
+static WorkerState workers[GGL_COREBUS_MAX_WORKERS];
+static atomic_size_t workers_started = 0;
+/// Set for threads handling client requests.
+static _Thread_local WorkerState *worker = NULL;
+
+/// Serializes handlers not marked thread-safe.
+static pthread_mutex_t handler_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/// Per-request state for a connection.
+/// Persistent connections carry a request id on each request; responses echo
+/// it and the connection is kept open for further requests.
+typedef struct {
+    GglCoreBusRequestType type;
+    bool persistent;
+    int32_t request_id;
+    GglCoreBusCodec codec;
+} RequestState;
+
+static RequestState client_request_state[GGL_COREBUS_MAX_CLIENTS];
 static SubCleanupCallback subscription_cleanup[GGL_COREBUS_MAX_CLIENTS];
 
+/// Keys received on each persistent connection, for compactly encoded
+/// requests. Only used by the worker handling the connection.
+static GglKeyDict request_key_dicts[GGL_COREBUS_MAX_CLIENTS];
+static uint8_t request_key_mem[GGL_COREBUS_MAX_CLIENTS][GGL_KEY_DICT_MAX_KEYS]
+                              [GGL_KEY_DICT_MAX_KEY_LEN];
+
+/// Keys sent on each subscription, for compactly encoded responses.
+/// Dictionaries are only used with `encode_array_mtx` held. Their committed
+/// lengths are protected by the pool, and advance only once a response has
+/// been sent or queued.
+static GglKeyDict sub_key_dicts[GGL_COREBUS_MAX_CLIENTS];
+static uint8_t sub_key_mem[GGL_COREBUS_MAX_CLIENTS][GGL_KEY_DICT_MAX_KEYS]
+                          [GGL_KEY_DICT_MAX_KEY_LEN];
+static size_t sub_key_dict_lens[GGL_COREBUS_MAX_CLIENTS];
+
+static_assert(
+    GGL_COREBUS_SUB_QUEUE_LEN >= GGL_COREBUS_MAX_MSG_LEN,
+    "Subscription queue must be able to hold a max size message."
+);
+
+/// Ring buffer of unsent subscription response bytes.
+/// Queue data is made up of whole eventstream messages, except that the first
+/// `in_flight` bytes are the remainder of a partially sent message.
+typedef struct {
+    /// Buffer taken from sub_queue_mem while data is queued, else NULL.
+    uint8_t *mem;
+    size_t head;
+    size_t len;
+    size_t in_flight;
+    GglSubQueuePolicy policy;
+    /// fd has been added to the writable epoll
+    bool watched;
+    /// Logged that responses are being dropped
+    bool dropping;
+} SubQueue;
+
+static SubQueue sub_queues[GGL_COREBUS_MAX_CLIENTS];
+/// Queue buffers are shared by subscriptions that have data queued; all
+/// accesses are made under the pool lock.
+static uint8_t sub_queue_mem[GGL_COREBUS_SUB_QUEUES][GGL_COREBUS_SUB_QUEUE_LEN];
+static bool sub_queue_mem_used[GGL_COREBUS_SUB_QUEUES];
+/// Epoll for subscription sockets with queued data waiting to be writable.
+static int sub_queue_epoll_fd = -1;
+
 static GglError reset_client_state(uint32_t handle, size_t index);
-static GglError close_subscription(uint32_t handle, size_t index);
+static GglError release_client_state(uint32_t handle, size_t index);
+
+/// Handle of each connection, or 0, for finding idle connections.
+static _Atomic(uint32_t) client_handles[GGL_COREBUS_MAX_CLIENTS];
+/// Monotonic time each connection last finished a request, or -1 while a
+/// request is being handled.
+static int64_t client_idle_since_ms[GGL_COREBUS_MAX_CLIENTS];
 
 static int32_t client_fds[GGL_COREBUS_MAX_CLIENTS];
 static uint16_t client_generations[GGL_COREBUS_MAX_CLIENTS];
+static uint16_t client_in_use[GGL_COREBUS_MAX_CLIENTS];
 
 static GglSocketPool pool = {
     .max_fds = GGL_COREBUS_MAX_CLIENTS,
     .fds = client_fds,
     .generations = client_generations,
+    .in_use = client_in_use,
     .on_register = reset_client_state,
-    .on_release = close_subscription,
+    .on_release = release_client_state,
 };
 
 __attribute__((constructor)) static void init_client_pool(void) {
     ggl_socket_pool_init(&pool);
 }
 
-/// Set to a handle when calling handler.
-/// ggl_sub_respond blocks if this is the response handle.
-static _Atomic(uint32_t) current_handle = 0;
-/// Cond var for when current_handle is cleared
+/// Cond var for when a worker's current_handle is cleared
 static pthread_cond_t current_handle_cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t current_handle_mtx = PTHREAD_MUTEX_INITIALIZER;
 
@@ -76,29 +167,60 @@ static inline void cleanup_socket_handle(const uint32_t *handle) {
     }
 }
 
+static int64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t) now.tv_sec * 1000) + (now.tv_nsec / 1000000L);
+}
+
 static GglError reset_client_state(uint32_t handle, size_t index) {
-    (void) handle;
-    client_request_types[index] = GGL_CORE_BUS_CALL;
+    atomic_store_explicit(&client_handles[index], handle, memory_order_release);
+    client_idle_since_ms[index] = monotonic_ms();
+    client_request_state[index] = (RequestState) {
+        .type = GGL_CORE_BUS_CALL,
+        .codec = GGL_CORE_BUS_CODEC_V1,
+    };
+    request_key_dicts[index] = (GglKeyDict) { .mem = request_key_mem[index] };
+    sub_key_dict_lens[index] = 0;
     subscription_cleanup[index].fn = NULL;
     subscription_cleanup[index].ctx = NULL;
+    sub_queues[index] = (SubQueue) { .policy = GGL_SUB_QUEUE_DISCONNECT };
     return GGL_ERR_OK;
 }
 
-static GglError close_subscription(uint32_t handle, size_t index) {
+static void sub_queue_release_mem(SubQueue *queue) {
+    if (queue->mem != NULL) {
+        size_t slot = (size_t) (queue->mem - sub_queue_mem[0])
+            / GGL_COREBUS_SUB_QUEUE_LEN;
+        sub_queue_mem_used[slot] = false;
+    }
+    *queue = (SubQueue) { .policy = queue->policy,
+                          .watched = queue->watched,
+                          .dropping = queue->dropping };
+}
+
+static GglError release_client_state(uint32_t handle, size_t index) {
+    atomic_store_explicit(&client_handles[index], 0, memory_order_release);
+    sub_queue_release_mem(&sub_queues[index]);
     if (subscription_cleanup[index].fn != NULL) {
         subscription_cleanup[index].fn(subscription_cleanup[index].ctx, handle);
     }
     return GGL_ERR_OK;
 }
 
-static void set_request_type(void *ctx, size_t index) {
-    GglCoreBusRequestType *type = ctx;
-    client_request_types[index] = *type;
+static void set_request_state(void *ctx, size_t index) {
+    RequestState *state = ctx;
+    client_request_state[index] = *state;
 }
 
-static void get_request_type(void *ctx, size_t index) {
-    GglCoreBusRequestType *type = ctx;
-    *type = client_request_types[index];
+static void get_request_state(void *ctx, size_t index) {
+    RequestState *state = ctx;
+    *state = client_request_state[index];
+}
+
+static void get_request_key_dict(void *ctx, size_t index) {
+    GglKeyDict **dict = ctx;
+    *dict = &request_key_dicts[index];
 }
 
 static void set_subscription_cleanup(void *ctx, size_t index) {
@@ -106,24 +228,72 @@ static void set_subscription_cleanup(void *ctx, size_t index) {
     subscription_cleanup[index] = *type;
 }
 
+static void set_client_busy(void *ctx, size_t index) {
+    (void) ctx;
+    client_idle_since_ms[index] = -1;
+}
+
+static void set_client_idle(void *ctx, size_t index) {
+    (void) ctx;
+    client_idle_since_ms[index] = monotonic_ms();
+}
+
+static void cleanup_client_idle(const uint32_t *handle) {
+    ggl_socket_handle_protected(set_client_idle, NULL, &pool, *handle);
+}
+
+static WorkerState *get_worker(void) {
+    if (worker == NULL) {
+        size_t index = atomic_fetch_add(&workers_started, 1);
+        assert(index < GGL_COREBUS_MAX_WORKERS);
+        worker = &workers[index];
+        worker->request_fd = -1;
+    }
+    return worker;
+}
+
+static void cleanup_request_fd(WorkerState **state) {
+    if ((*state)->request_fd >= 0) {
+        ggl_close((*state)->request_fd);
+        (*state)->request_fd = -1;
+    }
+}
+
 static void set_current_handle(uint32_t handle) {
-    atomic_store_explicit(&current_handle, handle, memory_order_release);
+    atomic_store_explicit(
+        &get_worker()->current_handle, handle, memory_order_release
+    );
 }
 
 static uint32_t get_current_handle(void) {
-    return atomic_load_explicit(&current_handle, memory_order_acquire);
+    if (worker == NULL) {
+        return 0;
+    }
+    return atomic_load_explicit(&worker->current_handle, memory_order_acquire);
 }
 
 static void clear_current_handle(void) {
     GGL_MTX_SCOPE_GUARD(&current_handle_mtx);
-    atomic_store_explicit(&current_handle, 0, memory_order_release);
+    atomic_store_explicit(&worker->current_handle, 0, memory_order_release);
     pthread_cond_broadcast(&current_handle_cond);
 }
 
+static bool handle_in_handler(uint32_t handle) {
+    for (size_t i = 0; i < GGL_COREBUS_MAX_WORKERS; i++) {
+        if (handle
+            == atomic_load_explicit(
+                &workers[i].current_handle, memory_order_acquire
+            )) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static void wait_while_current_handle(uint32_t handle) {
-    if (handle == get_current_handle()) {
+    if (handle_in_handler(handle)) {
         GGL_MTX_SCOPE_GUARD(&current_handle_mtx);
-        while (handle == get_current_handle()) {
+        while (handle_in_handler(handle)) {
             pthread_cond_wait(&current_handle_cond, &current_handle_mtx);
         }
     }
@@ -135,45 +305,118 @@ static void cleanup_current_handle(const uint32_t *handle) {
     }
 }
 
-static void send_err_response(uint32_t handle, GglError error) {
-    assert(error != GGL_ERR_OK); // Returning error ok is invalid
-
-    GGL_MTX_SCOPE_GUARD(&encode_array_mtx);
-
-    GglBuffer send_buffer = GGL_BUF(encode_array);
+static GglError write_err_response(
+    uint32_t handle, GglError error, const RequestState *state
+) {
+    GglBuffer send_buffer = GGL_BUF(get_worker()->encode_array);
 
     EventStreamHeader resp_headers[] = {
         { GGL_STR("error"), { EVENTSTREAM_INT32, .int32 = (int32_t) error } },
+        { GGL_STR("request_id"),
+          { EVENTSTREAM_INT32,
+            .int32 = (state != NULL) ? state->request_id : 0 } },
     };
     size_t resp_headers_len = sizeof(resp_headers) / sizeof(resp_headers[0]);
+    if ((state == NULL) || !state->persistent) {
+        resp_headers_len -= 1;
+    }
 
     GglError ret = eventstream_encode(
         &send_buffer, resp_headers, resp_headers_len, GGL_NULL_READER
     );
-
-    if (ret == GGL_ERR_OK) {
-        ggl_socket_handle_write(&pool, handle, send_buffer);
+    if (ret != GGL_ERR_OK) {
+        return ret;
     }
 
+    return ggl_socket_handle_write(&pool, handle, send_buffer);
+}
+
+/// Send an error for a malformed packet and close the connection.
+static void send_err_response(uint32_t handle, GglError error) {
+    assert(error != GGL_ERR_OK); // Returning error ok is invalid
+
+    write_err_response(handle, error, NULL);
     ggl_socket_handle_close(&pool, handle);
 }
 
+/// Send an error for a request whose state has been recorded.
+/// Persistent connections remain open.
+static void send_request_err_response(uint32_t handle, GglError error) {
+    assert(error != GGL_ERR_OK); // Returning error ok is invalid
+
+    RequestState state = { 0 };
+    GglError ret
+        = ggl_socket_handle_protected(get_request_state, &state, &pool, handle);
+    if (ret != GGL_ERR_OK) {
+        return;
+    }
+
+    if (!state.persistent) {
+        send_err_response(handle, error);
+        return;
+    }
+
+    // Notifications do not get responses
+    if (state.type != GGL_CORE_BUS_NOTIFY) {
+        ret = write_err_response(handle, error, &state);
+        if (ret != GGL_ERR_OK) {
+            ggl_socket_handle_close(&pool, handle);
+        }
+    }
+}
+
+static void run_handler(
+    GglRpcMethodDesc *handler, GglMap params, uint32_t handle
+) {
+    set_current_handle(handle);
+
+    GglError ret = handler->handler(handler->ctx, params, handle);
+
+    // Handler must either error, or succeed after calling ggl_respond
+    // or ggl_sub_accept. Both of those clear current_handle
+    assert(get_current_handle() == ((ret == GGL_ERR_OK) ? 0 : handle));
+
+    if (ret != GGL_ERR_OK) {
+        send_request_err_response(handle, ret);
+        clear_current_handle();
+    }
+}
+
+static void call_handler(
+    GglRpcMethodDesc *handler, GglMap params, uint32_t handle
+) {
+    if (handler->thread_safe) {
+        run_handler(handler, params, handle);
+        return;
+    }
+
+    GGL_MTX_SCOPE_GUARD(&handler_mtx);
+    run_handler(handler, params, handle);
+}
+
 // TODO: Split this function up
 // NOLINTNEXTLINE(readability-function-cognitive-complexity)
 static GglError client_ready(void *ctx, uint32_t handle) {
     GGL_LOGD("Handling client data for handle %d.", handle);
     InterfaceCtx *interface = ctx;
 
-    static pthread_mutex_t client_handler_mtx = PTHREAD_MUTEX_INITIALIZER;
-    GGL_MTX_SCOPE_GUARD(&client_handler_mtx);
+    WorkerState *state_mem = get_worker();
 
-    static uint8_t payload_array[GGL_COREBUS_MAX_MSG_LEN];
+    GglError ret
+        = ggl_socket_handle_protected(set_client_busy, NULL, &pool, handle);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    GGL_CLEANUP(cleanup_client_idle, handle);
 
-    GglBuffer recv_buffer = GGL_BUF(payload_array);
+    GglBuffer recv_buffer = GGL_BUF(state_mem->payload_array);
     GglBuffer prelude_buf = ggl_buffer_substr(recv_buffer, 0, 12);
     assert(prelude_buf.len == 12);
 
-    GglError ret = ggl_socket_handle_read(&pool, handle, prelude_buf);
+    // A shared memory payload fd is passed with the start of the packet
+    GGL_CLEANUP_ID(shm_fd, cleanup_close, -1);
+
+    ret = ggl_socket_handle_read_with_fd(&pool, handle, prelude_buf, &shm_fd);
     if (ret != GGL_ERR_OK) {
         return ret;
     }
@@ -211,6 +454,8 @@ static GglError client_ready(void *ctx, uint32_t handle) {
     bool method_set = false;
     GglCoreBusRequestType type = GGL_CORE_BUS_CALL;
     bool type_set = false;
+    bool has_request_fd = false;
+    RequestState state = { 0 };
 
     {
         EventStreamHeaderIter iter = msg.headers;
@@ -243,6 +488,16 @@ static GglError client_ready(void *ctx, uint32_t handle) {
                     return GGL_ERR_OK;
                 }
                 type_set = true;
+            } else if (ggl_buffer_eq(header.name, GGL_STR("request_id"))) {
+                if (header.value.type != EVENTSTREAM_INT32) {
+                    GGL_LOGE("Request id header not int.");
+                    send_err_response(handle, GGL_ERR_INVALID);
+                    return GGL_ERR_OK;
+                }
+                state.persistent = true;
+                state.request_id = header.value.int32;
+            } else if (ggl_buffer_eq(header.name, GGL_STR("fd"))) {
+                has_request_fd = true;
             }
         }
     }
@@ -253,37 +508,99 @@ static GglError client_ready(void *ctx, uint32_t handle) {
         return GGL_ERR_OK;
     }
 
+    ret = ggl_core_bus_msg_codec(&msg, &state.codec);
+    if (ret != GGL_ERR_OK) {
+        send_err_response(handle, ret);
+        return GGL_ERR_OK;
+    }
+
+    // Keys of a stream are only known if every request on it is decoded
+    bool key_stream = state.codec == GGL_CORE_BUS_CODEC_V2_STREAM;
+    if (key_stream && !state.persistent) {
+        GGL_LOGE("Codec requires a persistent connection.");
+        send_err_response(handle, GGL_ERR_INVALID);
+        return GGL_ERR_OK;
+    }
+
+    if (state.persistent && (type == GGL_CORE_BUS_SUBSCRIBE)) {
+        GGL_LOGE("Subscriptions require a dedicated connection.");
+        send_err_response(handle, GGL_ERR_INVALID);
+        return GGL_ERR_OK;
+    }
+
+    state.type = type;
+
+    GGL_LOGT("Setting request state.");
+    ret = ggl_socket_handle_protected(set_request_state, &state, &pool, handle);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    // An fd passed for the handler is not a shared memory payload
+    if (has_request_fd) {
+        if (shm_fd < 0) {
+            GGL_LOGE("Request fd missing.");
+            send_request_err_response(handle, GGL_ERR_INVALID);
+            return GGL_ERR_OK;
+        }
+        state_mem->request_fd = shm_fd;
+        shm_fd = -1;
+    }
+    // Closed if the handler does not take it
+    GGL_CLEANUP(cleanup_request_fd, state_mem);
+
+    // Params reference the mapping until the handler returns
+    GGL_CLEANUP_ID(shm_mapping, ggl_core_bus_shm_unmap, (GglBuffer) { 0 });
+    GglBuffer payload = { 0 };
+    ret = ggl_core_bus_shm_payload(&msg, shm_fd, &shm_mapping, &payload);
+    if (ret != GGL_ERR_OK) {
+        if (key_stream) {
+            send_err_response(handle, ret);
+        } else {
+            send_request_err_response(handle, ret);
+        }
+        return GGL_ERR_OK;
+    }
+
     GglMap params = { 0 };
 
-    if (msg.payload.len > 0) {
-        static uint8_t payload_deserialize_mem
-            [PAYLOAD_VALUE_MAX_SUBOBJECTS * sizeof(GglObject)];
+    if (payload.len > 0) {
         GglBumpAlloc balloc
-            = ggl_bump_alloc_init(GGL_BUF(payload_deserialize_mem));
+            = ggl_bump_alloc_init(GGL_BUF(state_mem->payload_deserialize_mem));
+
+        GglKeyDict *key_dict = NULL;
+        if (key_stream) {
+            ret = ggl_socket_handle_protected(
+                get_request_key_dict, &key_dict, &pool, handle
+            );
+            if (ret != GGL_ERR_OK) {
+                return ret;
+            }
+        }
 
         GglObject payload_obj = GGL_OBJ_NULL();
-        ret = ggl_deserialize(&balloc.alloc, false, msg.payload, &payload_obj);
+        ret = ggl_core_bus_decode_payload(
+            &balloc.alloc, false, state.codec, key_dict, payload, &payload_obj
+        );
         if (ret != GGL_ERR_OK) {
             GGL_LOGE("Failed to decode request payload.");
-            send_err_response(handle, ret);
+            if (key_stream) {
+                send_err_response(handle, ret);
+            } else {
+                send_request_err_response(handle, ret);
+            }
             return GGL_ERR_OK;
         }
 
         if (payload_obj.type != GGL_TYPE_MAP) {
             GGL_LOGE("Request payload is not a map.");
-            send_err_response(handle, GGL_ERR_INVALID);
+            send_request_err_response(handle, GGL_ERR_INVALID);
             return GGL_ERR_OK;
         }
 
         params = payload_obj.map;
     }
 
-    GGL_LOGT("Setting request type.");
-    ret = ggl_socket_handle_protected(set_request_type, &type, &pool, handle);
-    if (ret != GGL_ERR_OK) {
-        return ret;
-    }
-
     GGL_LOGD(
         "Dispatching request for method %.*s.", (int) method.len, method.data
     );
@@ -293,36 +610,399 @@ static GglError client_ready(void *ctx, uint32_t handle) {
         if (ggl_buffer_eq(method, handler->name)) {
             if (handler->is_subscription != (type == GGL_CORE_BUS_SUBSCRIBE)) {
                 GGL_LOGE("Request type is unsupported for method.");
-                send_err_response(handle, GGL_ERR_INVALID);
+                send_request_err_response(handle, GGL_ERR_INVALID);
                 return GGL_ERR_OK;
             }
 
-            set_current_handle(handle);
+            call_handler(handler, params, handle);
+            return GGL_ERR_OK;
+        }
+    }
 
-            ret = handler->handler(handler->ctx, params, handle);
+    GGL_LOGW("No handler for method %.*s.", (int) method.len, method.data);
 
-            // Handler must either error, or succeed after calling ggl_respond
-            // or ggl_sub_accept. Both of those clear current_handle
-            assert(get_current_handle() == ((ret == GGL_ERR_OK) ? 0 : handle));
+    send_request_err_response(handle, GGL_ERR_NOENTRY);
+    return GGL_ERR_OK;
+}
 
-            if (ret != GGL_ERR_OK) {
-                send_err_response(handle, ret);
-                clear_current_handle();
-            }
+static size_t sub_queue_msg_len(const uint8_t *mem, size_t pos) {
+    // Eventstream messages start with big-endian total length
+    size_t len = 0;
+    for (size_t i = 0; i < 4; i++) {
+        len = (len << 8) | mem[(pos + i) % GGL_COREBUS_SUB_QUEUE_LEN];
+    }
+    return len;
+}
+
+/// Take a queue buffer if the queue does not have one.
+/// Returns false if none are free.
+static bool sub_queue_take_mem(SubQueue *queue) {
+    if (queue->mem != NULL) {
+        return true;
+    }
+    for (size_t i = 0; i < GGL_COREBUS_SUB_QUEUES; i++) {
+        if (!sub_queue_mem_used[i]) {
+            sub_queue_mem_used[i] = true;
+            queue->mem = sub_queue_mem[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static void sub_queue_push(SubQueue *queue, GglBufList msg) {
+    assert(queue->mem != NULL);
+    assert(
+        GGL_COREBUS_SUB_QUEUE_LEN - queue->len >= ggl_core_bus_segments_len(msg)
+    );
+    uint8_t *mem = queue->mem;
+    for (size_t i = 0; i < msg.len; i++) {
+        GglBuffer seg = msg.bufs[i];
+        size_t tail = (queue->head + queue->len) % GGL_COREBUS_SUB_QUEUE_LEN;
+        size_t first = GGL_COREBUS_SUB_QUEUE_LEN - tail;
+        if (first > seg.len) {
+            first = seg.len;
+        }
+        memcpy(&mem[tail], seg.data, first);
+        memcpy(mem, &seg.data[first], seg.len - first);
+        queue->len += seg.len;
+    }
+}
+
+/// Remove sent bytes from the front of the queue.
+static void sub_queue_consume(SubQueue *queue, size_t len) {
+    size_t rest = len;
+    while (rest > 0) {
+        if (queue->in_flight == 0) {
+            queue->in_flight = sub_queue_msg_len(queue->mem, queue->head);
+        }
+        size_t step = (rest < queue->in_flight) ? rest : queue->in_flight;
+        queue->head = (queue->head + step) % GGL_COREBUS_SUB_QUEUE_LEN;
+        queue->len -= step;
+        queue->in_flight -= step;
+        rest -= step;
+    }
+    if (queue->len == 0) {
+        // Free the buffer for other subscriptions
+        sub_queue_release_mem(queue);
+    }
+}
+
+/// Drop the oldest message that has not started sending.
+static bool sub_queue_drop_oldest(SubQueue *queue) {
+    if (queue->len <= queue->in_flight) {
+        return false;
+    }
+    uint8_t *mem = queue->mem;
+    size_t msg_len = sub_queue_msg_len(
+        mem, (queue->head + queue->in_flight) % GGL_COREBUS_SUB_QUEUE_LEN
+    );
+    // Shift the partially sent message over the dropped one
+    for (size_t i = queue->in_flight; i > 0; i--) {
+        mem[(queue->head + msg_len + i - 1) % GGL_COREBUS_SUB_QUEUE_LEN]
+            = mem[(queue->head + i - 1) % GGL_COREBUS_SUB_QUEUE_LEN];
+    }
+    queue->head = (queue->head + msg_len) % GGL_COREBUS_SUB_QUEUE_LEN;
+    queue->len -= msg_len;
+    return true;
+}
 
+/// Make room for a message according to the queue's policy.
+/// Returns false if the message should not be queued.
+static bool sub_queue_make_room(
+    SubQueue *queue, uint32_t handle, size_t len, GglError *err
+) {
+    bool fits = true;
+    bool dropped = false;
+    while (GGL_COREBUS_SUB_QUEUE_LEN - queue->len < len) {
+        if (queue->policy == GGL_SUB_QUEUE_DISCONNECT) {
+            GGL_LOGW("Subscription %u queue full; closing.", handle);
+            *err = GGL_ERR_NOMEM;
+            return false;
+        }
+        dropped = true;
+        if ((queue->policy == GGL_SUB_QUEUE_DROP_OLDEST)
+            && sub_queue_drop_oldest(queue)) {
+            continue;
+        }
+        fits = false;
+        break;
+    }
+    if (dropped && !queue->dropping) {
+        GGL_LOGW("Subscription %u queue full; dropping responses.", handle);
+    }
+    queue->dropping = dropped;
+    return fits;
+}
+
+/// Write as much as possible without blocking.
+/// `bufs` is advanced past the written data. `send_fd` is passed with the
+/// first written bytes, if any.
+static GglError send_nonblocking(int fd, GglBufList *bufs, int send_fd) {
+    int pending_fd = send_fd;
+    while (bufs->len > 0) {
+        size_t remaining = ggl_core_bus_segments_len(*bufs);
+        GglError ret = ggl_socket_writev_partial(fd, bufs, pending_fd, true);
+        if (ret == GGL_ERR_RETRY) {
+            continue;
+        }
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        if (ggl_core_bus_segments_len(*bufs) == remaining) {
+            // Socket is full
             return GGL_ERR_OK;
         }
+        pending_fd = -1;
     }
+    return GGL_ERR_OK;
+}
 
-    GGL_LOGW("No handler for method %.*s.", (int) method.len, method.data);
+static GglError sub_queue_watch(
+    SubQueue *queue, size_t index, uint32_t handle
+) {
+    if (queue->watched) {
+        return ggl_socket_epoll_rearm_writable(
+            sub_queue_epoll_fd, client_fds[index], handle
+        );
+    }
+    GglError ret = ggl_socket_epoll_add_writable(
+        sub_queue_epoll_fd, client_fds[index], handle
+    );
+    queue->watched = (ret == GGL_ERR_OK);
+    return ret;
+}
+
+/// Send queued data; watches for writability if any remains.
+static GglError sub_queue_flush(
+    SubQueue *queue, size_t index, uint32_t handle
+) {
+    while (queue->len > 0) {
+        size_t chunk = GGL_COREBUS_SUB_QUEUE_LEN - queue->head;
+        if (chunk > queue->len) {
+            chunk = queue->len;
+        }
+        GglBuffer buf = { .data = &queue->mem[queue->head], .len = chunk };
+        GglBufList rest = { .bufs = &buf, .len = 1 };
+        GglError ret = send_nonblocking(client_fds[index], &rest, -1);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        size_t unsent = ggl_core_bus_segments_len(rest);
+        sub_queue_consume(queue, chunk - unsent);
+        if (unsent > 0) {
+            return sub_queue_watch(queue, index, handle);
+        }
+    }
+    return GGL_ERR_OK;
+}
+
+typedef struct {
+    uint32_t handle;
+    /// Message segments; entries are used as scratch space.
+    GglBufList msg;
+    /// Shared memory payload fd to pass with the message, or -1.
+    int shm_fd;
+    /// Key dictionary the message was encoded with, if streaming keys.
+    GglKeyDict *key_dict;
+    GglError ret;
+} SubQueueSendArgs;
+
+/// Handle a message that cannot be sent or queued as if the queue were full.
+static void sub_queue_reject(SubQueue *queue, uint32_t handle, GglError *err) {
+    if (queue->policy == GGL_SUB_QUEUE_DISCONNECT) {
+        GGL_LOGW("Subscription %u queue full; closing.", handle);
+        *err = GGL_ERR_NOMEM;
+        return;
+    }
+    if (!queue->dropping) {
+        GGL_LOGW("Subscription %u queue full; dropping responses.", handle);
+    }
+    queue->dropping = true;
+}
+
+static void sub_queue_send_msg(SubQueueSendArgs *args, size_t index) {
+    SubQueue *queue = &sub_queues[index];
+    size_t msg_len = ggl_core_bus_segments_len(args->msg);
+
+    // Passed fds cannot be queued, so shared memory payloads must start
+    // sending immediately.
+    if ((args->shm_fd >= 0) && (queue->len > 0)) {
+        sub_queue_reject(queue, args->handle, &args->ret);
+        return;
+    }
+
+    if (queue->len > 0) {
+        // Already waiting on writable; keep ordering behind queued data
+        if (sub_queue_make_room(queue, args->handle, msg_len, &args->ret)) {
+            sub_queue_push(queue, args->msg);
+        }
+        return;
+    }
+
+    // Only the part the socket does not take now is copied into the queue
+    GglBufList rest = args->msg;
+    args->ret = send_nonblocking(client_fds[index], &rest, args->shm_fd);
+    if ((args->ret != GGL_ERR_OK) || (rest.len == 0)) {
+        return;
+    }
+
+    size_t unsent = ggl_core_bus_segments_len(rest);
+    if ((args->shm_fd >= 0) && (unsent == msg_len)) {
+        sub_queue_reject(queue, args->handle, &args->ret);
+        return;
+    }
+    if (!sub_queue_take_mem(queue)) {
+        if (unsent < msg_len) {
+            // The rest of a partially sent message can't be dropped
+            GGL_LOGW("No queue for subscription %u; closing.", args->handle);
+            args->ret = GGL_ERR_NOMEM;
+            return;
+        }
+        sub_queue_reject(queue, args->handle, &args->ret);
+        return;
+    }
+    sub_queue_push(queue, rest);
+    queue->in_flight = (unsent < msg_len) ? unsent : 0;
+    args->ret = sub_queue_watch(queue, index, args->handle);
+}
+
+static void sub_queue_send(void *ctx, size_t index) {
+    SubQueueSendArgs *args = ctx;
+    sub_queue_send_msg(args, index);
+
+    if ((args->ret == GGL_ERR_OK) && (args->key_dict != NULL)) {
+        // Keys added by the message will be known to the subscriber
+        sub_key_dict_lens[index] = args->key_dict->len;
+    }
+}
 
-    send_err_response(handle, GGL_ERR_NOENTRY);
+typedef struct {
+    uint32_t handle;
+    GglError ret;
+} SubQueueFlushArgs;
+
+static void sub_queue_writable_action(void *ctx, size_t index) {
+    SubQueueFlushArgs *args = ctx;
+    args->ret = sub_queue_flush(&sub_queues[index], index, args->handle);
+}
+
+static GglError sub_queue_writable(void *ctx, uint64_t data) {
+    (void) ctx;
+    if (data > UINT32_MAX) {
+        GGL_LOGE("Invalid data returned from epoll.");
+        return GGL_ERR_FAILURE;
+    }
+    uint32_t handle = (uint32_t) data;
+
+    SubQueueFlushArgs args = { .handle = handle };
+    GglError ret = ggl_socket_handle_protected(
+        sub_queue_writable_action, &args, &pool, handle
+    );
+    if ((ret == GGL_ERR_OK) && (args.ret != GGL_ERR_OK)) {
+        ggl_socket_handle_close(&pool, handle);
+    }
+    return GGL_ERR_OK;
+}
+
+static void *sub_queue_thread(void *ctx) {
+    (void) ctx;
+    ggl_socket_epoll_run(sub_queue_epoll_fd, sub_queue_writable, NULL);
+
+    GGL_LOGE("Subscription queue thread exited.");
+    _Exit(1);
+}
+
+static GglError start_sub_queue_thread(void) {
+    GglError ret = ggl_socket_epoll_create(&sub_queue_epoll_fd);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    pthread_t thread = { 0 };
+    int sys_ret = pthread_create(&thread, NULL, sub_queue_thread, NULL);
+    if (sys_ret != 0) {
+        GGL_LOGE("Failed to create subscription queue thread.");
+        return GGL_ERR_FATAL;
+    }
+    pthread_detach(thread);
+    return GGL_ERR_OK;
+}
+
+typedef struct {
+    int64_t now_ms;
+    bool idle;
+} IdleCheckArgs;
+
+static void check_client_idle(void *ctx, size_t index) {
+    IdleCheckArgs *args = ctx;
+    int64_t since = client_idle_since_ms[index];
+    // Subscriptions are expected to go without requests
+    args->idle = (client_request_state[index].type != GGL_CORE_BUS_SUBSCRIBE)
+        && (since >= 0) && (args->now_ms - since >= GGL_COREBUS_IDLE_CLOSE_MS);
+}
+
+static void close_idle_clients(void) {
+    for (size_t i = 0; i < GGL_COREBUS_MAX_CLIENTS; i++) {
+        uint32_t handle
+            = atomic_load_explicit(&client_handles[i], memory_order_acquire);
+        if (handle == 0) {
+            continue;
+        }
+        IdleCheckArgs args = { .now_ms = monotonic_ms() };
+        GglError ret = ggl_socket_handle_protected(
+            check_client_idle, &args, &pool, handle
+        );
+        if ((ret == GGL_ERR_OK) && args.idle) {
+            GGL_LOGD("Closing idle connection %u.", handle);
+            ggl_socket_handle_close(&pool, handle);
+        }
+    }
+}
+
+static void *idle_close_thread(void *ctx) {
+    (void) ctx;
+    // Connections are closed within a quarter of the limit past it
+    struct timespec interval
+        = { .tv_sec = (GGL_COREBUS_IDLE_CLOSE_MS / 4) / 1000,
+            .tv_nsec = ((GGL_COREBUS_IDLE_CLOSE_MS / 4) % 1000) * 1000000L };
+    while (true) {
+        nanosleep(&interval, NULL);
+        close_idle_clients();
+    }
+    return NULL;
+}
+
+static GglError start_idle_close_thread(void) {
+    pthread_t thread = { 0 };
+    int sys_ret = pthread_create(&thread, NULL, idle_close_thread, NULL);
+    if (sys_ret != 0) {
+        GGL_LOGE("Failed to create idle connection thread.");
+        return GGL_ERR_FATAL;
+    }
+    pthread_detach(thread);
     return GGL_ERR_OK;
 }
 
 GglError ggl_listen(
     GglBuffer interface, GglRpcMethodDesc *handlers, size_t handlers_len
 ) {
+    return ggl_listen_threaded(interface, handlers, handlers_len, 1);
+}
+
+GglError ggl_listen_threaded(
+    GglBuffer interface,
+    GglRpcMethodDesc *handlers,
+    size_t handlers_len,
+    size_t worker_count
+) {
+    if ((worker_count == 0) || (worker_count > GGL_COREBUS_MAX_WORKERS)) {
+        GGL_LOGE(
+            "Worker count must be between 1 and %d.", GGL_COREBUS_MAX_WORKERS
+        );
+        return GGL_ERR_RANGE;
+    }
+
     uint8_t socket_path_buf
         [GGL_INTERFACE_SOCKET_PREFIX_LEN + GGL_INTERFACE_NAME_MAX_LEN]
         = GGL_INTERFACE_SOCKET_PREFIX;
@@ -343,10 +1023,26 @@ GglError ggl_listen(
         socket_path.buf.data
     );
 
+    ret = start_sub_queue_thread();
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    ret = start_idle_close_thread();
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
     InterfaceCtx ctx = { .handlers = handlers, .handlers_len = handlers_len };
 
-    return ggl_socket_server_listen(
-        &interface, socket_path.buf, 0660, &pool, client_ready, &ctx
+    return ggl_socket_server_listen_threaded(
+        &interface,
+        socket_path.buf,
+        0660,
+        &pool,
+        client_ready,
+        &ctx,
+        worker_count
     );
 }
 
@@ -356,42 +1052,75 @@ void ggl_respond(uint32_t handle, GglObject value) {
     assert(handle == get_current_handle());
     GGL_CLEANUP(cleanup_current_handle, handle);
 
-    GGL_LOGT("Retrieving request type for %d.", handle);
-    GglCoreBusRequestType type = GGL_CORE_BUS_CALL;
+    GGL_LOGT("Retrieving request state for %d.", handle);
+    RequestState state = { 0 };
     GglError ret
-        = ggl_socket_handle_protected(get_request_type, &type, &pool, handle);
+        = ggl_socket_handle_protected(get_request_state, &state, &pool, handle);
     if (ret != GGL_ERR_OK) {
         return;
     }
 
-    GGL_CLEANUP(cleanup_socket_handle, handle);
+    // Persistent connections are kept open unless the response fails
+    GGL_CLEANUP_ID(
+        handle_cleanup, cleanup_socket_handle, state.persistent ? 0 : handle
+    );
 
-    if (type == GGL_CORE_BUS_NOTIFY) {
-        GGL_LOGT("Skipping response and closing notify %d.", handle);
+    if (state.type == GGL_CORE_BUS_NOTIFY) {
+        GGL_LOGT("Skipping response to notify %d.", handle);
         return;
     }
 
-    assert(type == GGL_CORE_BUS_CALL);
-
-    GGL_MTX_SCOPE_GUARD(&encode_array_mtx);
+    assert(state.type == GGL_CORE_BUS_CALL);
 
-    GglBuffer send_buffer = GGL_BUF(encode_array);
-
-    ret = eventstream_encode(
-        &send_buffer, NULL, 0, ggl_serialize_reader(&value)
+    EventStreamHeader resp_headers[] = {
+        { GGL_STR("request_id"),
+          { EVENTSTREAM_INT32, .int32 = state.request_id } },
+    };
+    size_t resp_headers_len = state.persistent ? 1 : 0;
+
+    GglBuffer segment_mem[GGL_COREBUS_MAX_SEGMENTS];
+    GglBufVec segments = GGL_BUF_VEC(segment_mem);
+    int shm_fd = -1;
+
+    // Responses do not share a key dictionary with the request stream
+    ret = ggl_core_bus_encode_message(
+        GGL_BUF(worker->encode_array),
+        resp_headers,
+        resp_headers_len,
+        &value,
+        (state.codec == GGL_CORE_BUS_CODEC_V1) ? GGL_CORE_BUS_CODEC_V1
+                                               : GGL_CORE_BUS_CODEC_V2,
+        NULL,
+        &segments,
+        &shm_fd
     );
     if (ret != GGL_ERR_OK) {
+        handle_cleanup = handle;
         return;
     }
+    GGL_CLEANUP(cleanup_close, shm_fd);
 
-    ret = ggl_socket_handle_write(&pool, handle, send_buffer);
+    ret = ggl_socket_handle_writev_with_fd(
+        &pool, handle, segments.buf_list, shm_fd
+    );
     if (ret != GGL_ERR_OK) {
+        handle_cleanup = handle;
         return;
     }
 
     GGL_LOGT("Completed call response to %d.", handle);
 }
 
+GglError ggl_take_request_fd(uint32_t handle, int *fd) {
+    if ((worker == NULL) || (handle != get_current_handle())
+        || (worker->request_fd < 0)) {
+        return GGL_ERR_NOENTRY;
+    }
+    *fd = worker->request_fd;
+    worker->request_fd = -1;
+    return GGL_ERR_OK;
+}
+
 void ggl_sub_accept(
     uint32_t handle, GglServerSubCloseCallback on_close, void *ctx
 ) {
@@ -415,9 +1144,7 @@ void ggl_sub_accept(
 
     GGL_CLEANUP_ID(handle_cleanup, cleanup_socket_handle, handle);
 
-    GGL_MTX_SCOPE_GUARD(&encode_array_mtx);
-
-    GglBuffer send_buffer = GGL_BUF(encode_array);
+    GglBuffer send_buffer = GGL_BUF(worker->encode_array);
 
     EventStreamHeader resp_headers[] = {
         { GGL_STR("accepted"), { EVENTSTREAM_INT32, .int32 = 1 } },
@@ -441,17 +1168,45 @@ void ggl_sub_accept(
     GGL_LOGT("Successfully accepted subscription %d.", handle);
 }
 
+typedef struct {
+    GglCoreBusCodec codec;
+    GglKeyDict *key_dict;
+} SubEncodeState;
+
+/// Must be called with `encode_array_mtx` held.
+static void get_sub_encode_state(void *ctx, size_t index) {
+    SubEncodeState *encode = ctx;
+
+    if (client_request_state[index].codec == GGL_CORE_BUS_CODEC_V1) {
+        *encode = (SubEncodeState) { .codec = GGL_CORE_BUS_CODEC_V1 };
+        return;
+    }
+
+    // Dropped responses would leave the subscriber missing keys
+    if (sub_queues[index].policy != GGL_SUB_QUEUE_DISCONNECT) {
+        *encode = (SubEncodeState) { .codec = GGL_CORE_BUS_CODEC_V2 };
+        return;
+    }
+
+    // Discard keys added by responses that were not sent
+    sub_key_dicts[index].mem = sub_key_mem[index];
+    sub_key_dicts[index].len = sub_key_dict_lens[index];
+    *encode = (SubEncodeState) { .codec = GGL_CORE_BUS_CODEC_V2_STREAM,
+                                 .key_dict = &sub_key_dicts[index] };
+}
+
 void ggl_sub_respond(uint32_t handle, GglObject value) {
     GGL_LOGT("Responding to %d.", handle);
 
+    GglError ret = GGL_ERR_OK;
+
 #ifndef NDEBUG
-    GglCoreBusRequestType type = GGL_CORE_BUS_CALL;
-    GglError ret
-        = ggl_socket_handle_protected(get_request_type, &type, &pool, handle);
+    RequestState state = { 0 };
+    ret = ggl_socket_handle_protected(get_request_state, &state, &pool, handle);
     if (ret != GGL_ERR_OK) {
         return;
     }
-    assert(type == GGL_CORE_BUS_SUBSCRIBE);
+    assert(state.type == GGL_CORE_BUS_SUBSCRIBE);
 #endif
 
     wait_while_current_handle(handle);
@@ -460,19 +1215,41 @@ void ggl_sub_respond(uint32_t handle, GglObject value) {
 
     GGL_MTX_SCOPE_GUARD(&encode_array_mtx);
 
-    GglBuffer send_buffer = GGL_BUF(encode_array);
-
-    ret = eventstream_encode(
-        &send_buffer, NULL, 0, ggl_serialize_reader(&value)
+    SubEncodeState encode = { 0 };
+    ret = ggl_socket_handle_protected(
+        get_sub_encode_state, &encode, &pool, handle
     );
     if (ret != GGL_ERR_OK) {
         return;
     }
 
-    ret = ggl_socket_handle_write(&pool, handle, send_buffer);
+    GglBuffer segment_mem[GGL_COREBUS_MAX_SEGMENTS];
+    GglBufVec segments = GGL_BUF_VEC(segment_mem);
+    int shm_fd = -1;
+
+    ret = ggl_core_bus_encode_message(
+        GGL_BUF(encode_array),
+        NULL,
+        0,
+        &value,
+        encode.codec,
+        encode.key_dict,
+        &segments,
+        &shm_fd
+    );
     if (ret != GGL_ERR_OK) {
         return;
     }
+    GGL_CLEANUP(cleanup_close, shm_fd);
+
+    SubQueueSendArgs args = { .handle = handle,
+                              .msg = segments.buf_list,
+                              .shm_fd = shm_fd,
+                              .key_dict = encode.key_dict };
+    ret = ggl_socket_handle_protected(sub_queue_send, &args, &pool, handle);
+    if ((ret != GGL_ERR_OK) || (args.ret != GGL_ERR_OK)) {
+        return;
+    }
 
     // Keep subscription handle on successful subscription response
     // NOLINTNEXTLINE(clang-analyzer-deadcode.DeadStores) false positive
@@ -481,6 +1258,15 @@ void ggl_sub_respond(uint32_t handle, GglObject value) {
     GGL_LOGT("Sent response to %d.", handle);
 }
 
+static void set_sub_queue_policy(void *ctx, size_t index) {
+    GglSubQueuePolicy *policy = ctx;
+    sub_queues[index].policy = *policy;
+}
+
+void ggl_sub_set_queue_policy(uint32_t handle, GglSubQueuePolicy policy) {
+    ggl_socket_handle_protected(set_sub_queue_policy, &policy, &pool, handle);
+}
+
 void ggl_server_sub_close(uint32_t handle) {
     ggl_socket_handle_close(&pool, handle);
 }
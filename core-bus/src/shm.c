@@ -0,0 +1,156 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "shm.h"
+#include "ggl/core_bus/constants.h"
+#include "ggl/core_bus/object_serde.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ggl/buffer.h>
+#include <ggl/cleanup.h>
+#include <ggl/error.h>
+#include <ggl/eventstream/decode.h>
+#include <ggl/eventstream/types.h>
+#include <ggl/file.h>
+#include <ggl/log.h>
+#include <ggl/object.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+
+static_assert(
+    GGL_COREBUS_SHM_MAX_LEN <= INT32_MAX,
+    "Shared memory payload length must fit in a header."
+);
+
+/// Seals preventing the sender from changing the payload once sent.
+#define REQUIRED_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
+GglError ggl_core_bus_shm_create(
+    GglObject payload, size_t len, GglKeyDict *dict, int *fd
+) {
+    if ((len == 0) || (len > GGL_COREBUS_SHM_MAX_LEN)) {
+        GGL_LOGE(
+            "Payload length %zu exceeds shared memory maximum of %d.",
+            len,
+            GGL_COREBUS_SHM_MAX_LEN
+        );
+        return GGL_ERR_NOMEM;
+    }
+
+    int memfd = memfd_create("ggl-core-bus", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0) {
+        GGL_LOGE("Failed to create memfd: %d.", errno);
+        return GGL_ERR_FAILURE;
+    }
+    GGL_CLEANUP_ID(memfd_cleanup, cleanup_close, memfd);
+
+    if (ftruncate(memfd, (off_t) len) != 0) {
+        GGL_LOGE("Failed to size memfd: %d.", errno);
+        return GGL_ERR_NOMEM;
+    }
+
+    void *mem = mmap(NULL, len, PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (mem == MAP_FAILED) {
+        GGL_LOGE("Failed to map memfd: %d.", errno);
+        return GGL_ERR_NOMEM;
+    }
+
+    GglBuffer buf = { .data = mem, .len = len };
+    GglError ret = ggl_serialize(payload, dict, &buf);
+    munmap(mem, len);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    assert(buf.len == len);
+
+    // Write seal requires no writable mappings remain
+    if (fcntl(memfd, F_ADD_SEALS, REQUIRED_SEALS | F_SEAL_SEAL) != 0) {
+        GGL_LOGE("Failed to seal memfd: %d.", errno);
+        return GGL_ERR_FAILURE;
+    }
+
+    // NOLINTNEXTLINE(clang-analyzer-deadcode.DeadStores) false positive
+    memfd_cleanup = -1;
+    *fd = memfd;
+    return GGL_ERR_OK;
+}
+
+static GglError map_payload(int shm_fd, int32_t len, GglBuffer *mapping) {
+    if (shm_fd < 0) {
+        GGL_LOGE("Shared memory payload sent without a memfd.");
+        return GGL_ERR_INVALID;
+    }
+
+    if ((len <= 0) || (len > GGL_COREBUS_SHM_MAX_LEN)) {
+        GGL_LOGE("Shared memory payload length %d out of range.", len);
+        return GGL_ERR_RANGE;
+    }
+
+    // Unsealed memory could be changed or truncated by the sender while read
+    int seals = fcntl(shm_fd, F_GET_SEALS);
+    if ((seals < 0) || ((seals & REQUIRED_SEALS) != REQUIRED_SEALS)) {
+        GGL_LOGE("Shared memory payload is not sealed.");
+        return GGL_ERR_INVALID;
+    }
+
+    struct stat st;
+    if ((fstat(shm_fd, &st) != 0) || (st.st_size != len)) {
+        GGL_LOGE("Shared memory payload size does not match header.");
+        return GGL_ERR_INVALID;
+    }
+
+    void *mem = mmap(NULL, (size_t) len, PROT_READ, MAP_PRIVATE, shm_fd, 0);
+    if (mem == MAP_FAILED) {
+        GGL_LOGE("Failed to map shared memory payload: %d.", errno);
+        return GGL_ERR_NOMEM;
+    }
+
+    *mapping = (GglBuffer) { .data = mem, .len = (size_t) len };
+    return GGL_ERR_OK;
+}
+
+GglError ggl_core_bus_shm_payload(
+    const EventStreamMessage *msg,
+    int shm_fd,
+    GglBuffer *mapping,
+    GglBuffer *payload
+) {
+    *mapping = (GglBuffer) { 0 };
+
+    EventStreamHeaderIter iter = msg->headers;
+    EventStreamHeader header;
+
+    while (eventstream_header_next(&iter, &header) == GGL_ERR_OK) {
+        if (ggl_buffer_eq(header.name, GGL_STR("shm_len"))) {
+            if (header.value.type != EVENTSTREAM_INT32) {
+                GGL_LOGE("Shared memory length header not int.");
+                return GGL_ERR_INVALID;
+            }
+            if (msg->payload.len != 0) {
+                GGL_LOGE("Packet has both inline and shared memory payload.");
+                return GGL_ERR_INVALID;
+            }
+            GglError ret = map_payload(shm_fd, header.value.int32, mapping);
+            if (ret != GGL_ERR_OK) {
+                return ret;
+            }
+            *payload = *mapping;
+            return GGL_ERR_OK;
+        }
+    }
+
+    *payload = msg->payload;
+    return GGL_ERR_OK;
+}
+
+void ggl_core_bus_shm_unmap(GglBuffer *mapping) {
+    if (mapping->data != NULL) {
+        munmap(mapping->data, mapping->len);
+        *mapping = (GglBuffer) { 0 };
+    }
+}
@@ -0,0 +1,44 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CORE_BUS_SHM_H
+#define CORE_BUS_SHM_H
+
+//! Shared memory transport for large core bus payloads.
+//!
+//! A payload too large for a core bus packet is serialized into a sealed
+//! memfd. The packet is sent without a payload and with a `shm_len` header
+//! holding the payload length, and the memfd is passed with it using
+//! SCM_RIGHTS. The receiver maps the memfd instead of reading the payload
+//! through the socket.
+
+#include "ggl/core_bus/object_serde.h"
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <ggl/eventstream/decode.h>
+#include <ggl/object.h>
+#include <stddef.h>
+
+/// Serialize a payload of `len` bytes into a new sealed memfd.
+/// `dict` is as for `ggl_serialize`.
+GglError ggl_core_bus_shm_create(
+    GglObject payload, size_t len, GglKeyDict *dict, int *fd
+);
+
+/// Get a received message's payload.
+/// If the message was sent with a shared memory payload, `shm_fd` is mapped
+/// into `mapping`, which must be released with `ggl_core_bus_shm_unmap`.
+/// Otherwise `mapping` is set to an empty buffer. `payload` is set to the
+/// payload in either case. `shm_fd` is not closed.
+GglError ggl_core_bus_shm_payload(
+    const EventStreamMessage *msg,
+    int shm_fd,
+    GglBuffer *mapping,
+    GglBuffer *payload
+);
+
+/// Release a mapping from `ggl_core_bus_shm_payload`.
+void ggl_core_bus_shm_unmap(GglBuffer *mapping);
+
+#endif
@@ -21,4 +21,16 @@ typedef enum {
     GGL_CORE_BUS_SUBSCRIBE,
 } GglCoreBusRequestType;
 
+/// Payload encodings.
+/// Messages not using V1 carry a `codec` header with the encoding used.
+/// Responses use the encoding of their request.
+typedef enum {
+    GGL_CORE_BUS_CODEC_V1 = 1,
+    /// Compact encoding, with a key dictionary for the message.
+    GGL_CORE_BUS_CODEC_V2 = 2,
+    /// Compact encoding, with a key dictionary kept for the connection.
+    /// Only used where messages are never dropped.
+    GGL_CORE_BUS_CODEC_V2_STREAM = 3,
+} GglCoreBusCodec;
+
 #endif
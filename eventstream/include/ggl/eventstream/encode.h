@@ -12,6 +12,7 @@
 #include <ggl/error.h>
 #include <ggl/io.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /// Encode an EventStream packet into a buffer.
 /// Payload must fail if it does not fit in provided buffer.
@@ -22,4 +23,19 @@ GglError eventstream_encode(
     GglReader payload
 );
 
+/// Encode the prelude and headers of an EventStream packet into a buffer.
+/// For packets whose payload is sent from separate buffers; complete with
+/// `eventstream_encode_finish`. `buf` is set to the encoded part.
+GglError eventstream_encode_begin(
+    GglBuffer *buf, const EventStreamHeader *headers, size_t header_count
+);
+
+/// Complete a packet started with `eventstream_encode_begin`.
+/// Fills in the prelude in `head` and computes the message CRC over `head`
+/// and each payload segment in place. The packet is `head`, followed by the
+/// payload segments, followed by the 4 bytes written to `crc`.
+GglError eventstream_encode_finish(
+    GglBuffer head, GglBufList payload, uint8_t crc[4]
+);
+
 #endif
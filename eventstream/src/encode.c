@@ -100,11 +100,8 @@ static GglError header_encode(GglAlloc *alloc, EventStreamHeader header) {
     return GGL_ERR_OK;
 }
 
-GglError eventstream_encode(
-    GglBuffer *buf,
-    const EventStreamHeader *headers,
-    size_t header_count,
-    GglReader payload
+GglError eventstream_encode_begin(
+    GglBuffer *buf, const EventStreamHeader *headers, size_t header_count
 ) {
     assert((headers == NULL) ? (header_count == 0) : true);
 
@@ -112,67 +109,95 @@ GglError eventstream_encode(
         buf->len = UINT32_MAX;
     }
 
-    GglBuffer buf_copy = *buf;
-
-    if (buf_copy.len < 12) {
+    if (buf->len < 12) {
         GGL_LOGE("Insufficent buffer space to encode packet.");
         return GGL_ERR_NOMEM;
     }
-    uint8_t *prelude = buf_copy.data;
-    buf_copy = ggl_buffer_substr(buf_copy, 12, SIZE_MAX);
 
-    uint8_t *message_len_p = prelude;
-    uint8_t *headers_len_p = &prelude[4];
-    uint8_t *prelude_crc_p = &prelude[8];
+    GglBumpAlloc bump_alloc
+        = ggl_bump_alloc_init(ggl_buffer_substr(*buf, 12, SIZE_MAX));
 
-    uint32_t headers_len = 0;
+    for (size_t i = 0; i < header_count; i++) {
+        GglError err = header_encode(&bump_alloc.alloc, headers[i]);
+        if (err != GGL_ERR_OK) {
+            return err;
+        }
+    }
 
-    if (headers != NULL) {
-        GglBumpAlloc bump_alloc = ggl_bump_alloc_init(buf_copy);
+    buf->len = 12 + bump_alloc.index;
+    return GGL_ERR_OK;
+}
 
-        for (size_t i = 0; i < header_count; i++) {
-            GglError err = header_encode(&bump_alloc.alloc, headers[i]);
-            if (err != GGL_ERR_OK) {
-                return err;
-            }
-        }
+GglError eventstream_encode_finish(
+    GglBuffer head, GglBufList payload, uint8_t crc[4]
+) {
+    assert(head.len >= 12);
 
-        headers_len = (uint32_t) bump_alloc.index;
-        buf_copy = ggl_buffer_substr(buf_copy, headers_len, SIZE_MAX);
+    size_t payload_len = 0;
+    for (size_t i = 0; i < payload.len; i++) {
+        payload_len += payload.bufs[i].len;
     }
 
-    write_be_u32(headers_len, headers_len_p);
-
-    GglBuffer payload_buf = buf_copy;
-    GglError err = ggl_reader_call(payload, &payload_buf);
-    if (err != GGL_ERR_OK) {
-        return err;
+    if (payload_len > UINT32_MAX - head.len - 4) {
+        GGL_LOGE("Payload too large to encode packet.");
+        return GGL_ERR_RANGE;
     }
-    buf_copy = ggl_buffer_substr(buf_copy, payload_buf.len, SIZE_MAX);
 
-    uint32_t message_len = 12 + headers_len + (uint32_t) payload_buf.len + 4;
+    uint8_t *prelude = head.data;
+    uint32_t headers_len = (uint32_t) head.len - 12;
+    uint32_t message_len = (uint32_t) (head.len + payload_len + 4);
 
-    write_be_u32(message_len, message_len_p);
+    write_be_u32(message_len, prelude);
+    write_be_u32(headers_len, &prelude[4]);
 
     uint32_t prelude_crc
         = ggl_update_crc(0, (GglBuffer) { .data = prelude, .len = 8 });
 
-    write_be_u32(prelude_crc, prelude_crc_p);
+    write_be_u32(prelude_crc, &prelude[8]);
 
-    uint32_t message_crc = ggl_update_crc(
-        prelude_crc,
-        (GglBuffer) { .data = &prelude[8], .len = message_len - 8 - 4 }
-    );
+    uint32_t message_crc
+        = ggl_update_crc(prelude_crc, ggl_buffer_substr(head, 8, SIZE_MAX));
+    for (size_t i = 0; i < payload.len; i++) {
+        message_crc = ggl_update_crc(message_crc, payload.bufs[i]);
+    }
+
+    write_be_u32(message_crc, crc);
+
+    return GGL_ERR_OK;
+}
+
+GglError eventstream_encode(
+    GglBuffer *buf,
+    const EventStreamHeader *headers,
+    size_t header_count,
+    GglReader payload
+) {
+    GglBuffer head = *buf;
+    GglError err = eventstream_encode_begin(&head, headers, header_count);
+    if (err != GGL_ERR_OK) {
+        return err;
+    }
+
+    GglBuffer payload_buf = ggl_buffer_substr(*buf, head.len, SIZE_MAX);
+    err = ggl_reader_call(payload, &payload_buf);
+    if (err != GGL_ERR_OK) {
+        return err;
+    }
 
-    if (buf_copy.len < 4) {
+    size_t used = head.len + payload_buf.len;
+    if (buf->len - used < 4) {
         GGL_LOGE("Insufficent buffer space to encode packet.");
         return GGL_ERR_NOMEM;
     }
-    uint8_t *message_crc_p = buf_copy.data;
 
-    write_be_u32(message_crc, message_crc_p);
+    err = eventstream_encode_finish(
+        head, (GglBufList) { .bufs = &payload_buf, .len = 1 }, &buf->data[used]
+    );
+    if (err != GGL_ERR_OK) {
+        return err;
+    }
 
-    buf->len = message_len;
+    buf->len = used + 4;
 
     return GGL_ERR_OK;
 }
@@ -146,7 +146,8 @@ void gg_fleet_statusd_start_server(void) {
     GglRpcMethodDesc handlers[] = { { GGL_STR("send_fleet_status_update"),
                                       false,
                                       send_fleet_status_update,
-                                      NULL } };
+                                      NULL,
+                                      false } };
     size_t handlers_len = sizeof(handlers) / sizeof(handlers[0]);
 
     GglError ret
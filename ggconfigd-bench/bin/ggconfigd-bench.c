@@ -0,0 +1,73 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ggconfigd-bench.h"
+#include <argp.h>
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <ggl/version.h>
+#include <stdint.h>
+
+__attribute__((visibility("default"))) const char *argp_program_version
+    = GGL_VERSION;
+
+static char doc[] = "ggconfigd-bench -- gg_config read and write benchmark "
+                    "against a running ggconfigd";
+
+static struct argp_option opts[] = {
+    { "mode",
+      'm',
+      "read|read-map|write|deploy|all",
+      0,
+      "Operations to run",
+      0 },
+    { "count", 'c', "count", 0, "Operations per mode", 0 },
+    { "keys", 'k', "count", 0, "Values in the benchmark map", 0 },
+    { 0 }
+};
+
+static uint32_t parse_u32(char *arg, struct argp_state *state) {
+    int64_t val = 0;
+    GglError ret = ggl_str_to_int64(ggl_buffer_from_null_term(arg), &val);
+    if ((ret != GGL_ERR_OK) || (val < 0) || (val > UINT32_MAX)) {
+        // NOLINTNEXTLINE(concurrency-mt-unsafe)
+        argp_error(state, "Invalid number: %s", arg);
+    }
+    return (uint32_t) val;
+}
+
+static error_t arg_parser(int key, char *arg, struct argp_state *state) {
+    GgconfigdBenchArgs *args = state->input;
+    switch (key) {
+    case 'm':
+        args->mode = arg;
+        break;
+    case 'c':
+        args->count = parse_u32(arg, state);
+        break;
+    case 'k':
+        args->keys = parse_u32(arg, state);
+        break;
+    case ARGP_KEY_END:
+        // All options have defaults in run_ggconfigd_bench.
+        break;
+    default:
+        return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = { opts, arg_parser, 0, doc, 0, 0, 0 };
+
+int main(int argc, char **argv) {
+    static GgconfigdBenchArgs args = { 0 };
+
+    // NOLINTNEXTLINE(concurrency-mt-unsafe)
+    argp_parse(&argp, argc, argv, 0, 0, &args);
+
+    GglError ret = run_ggconfigd_bench(&args);
+    if (ret != GGL_ERR_OK) {
+        return 1;
+    }
+}
@@ -0,0 +1,19 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef GGCONFIGD_BENCH_H
+#define GGCONFIGD_BENCH_H
+
+#include <ggl/error.h>
+#include <stdint.h>
+
+typedef struct {
+    char *mode;
+    uint32_t count;
+    uint32_t keys;
+} GgconfigdBenchArgs;
+
+GglError run_ggconfigd_bench(GgconfigdBenchArgs *args);
+
+#endif
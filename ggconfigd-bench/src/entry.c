@@ -0,0 +1,313 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ggconfigd-bench.h"
+#include <ggl/buffer.h>
+#include <ggl/bump_alloc.h>
+#include <ggl/core_bus/constants.h>
+#include <ggl/core_bus/gg_config.h>
+#include <ggl/error.h>
+#include <ggl/log.h>
+#include <ggl/object.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Drives a running ggconfigd over the gg_config core bus interface. Values are
+// written under a dedicated root key, then read back one value at a time and as
+// a whole map, measuring per-operation latency and overall operation rate.
+// The deploy mode replays the writes a deployment makes for each of its
+// components. Results include core bus round trips, so compare runs on the
+// same device.
+
+#define BENCH_MAX_SAMPLES (1024 * 1024)
+#define BENCH_MAX_KEYS 256
+#define BENCH_KEY_LEN 8
+
+static uint64_t samples[BENCH_MAX_SAMPLES];
+static uint8_t key_names[BENCH_MAX_KEYS][BENCH_KEY_LEN];
+static GglKV bench_kvs[BENCH_MAX_KEYS];
+static uint8_t read_mem[GGL_COREBUS_MAX_MSG_LEN];
+
+static const GglBuffer BENCH_ROOT = GGL_STR("ggconfigd_bench");
+static const GglBuffer BENCH_MAP = GGL_STR("values");
+static const GglBuffer BENCH_ARN
+    = GGL_STR("arn:aws:greengrass:us-west-2:123456789012:components:bench");
+
+// Writes per component in the deploy mode
+#define DEPLOY_STEPS 5
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000U) + (uint64_t) ts.tv_nsec;
+}
+
+static GglBuffer key_name(uint32_t index) {
+    return (GglBuffer) { .data = key_names[index],
+                         .len = strnlen(
+                             (char *) key_names[index], BENCH_KEY_LEN
+                         ) };
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(size_t total, size_t per_mille) {
+    size_t index = (total * per_mille) / 1000;
+    if (index >= total) {
+        index = total - 1;
+    }
+    return (double) samples[index] / 1000.0;
+}
+
+static void report(
+    GgconfigdBenchArgs *args, const char *mode, uint64_t elapsed
+) {
+    qsort(samples, args->count, sizeof(samples[0]), compare_u64);
+
+    GGL_LOGI(
+        "%s: %u keys, %u operations in %.3f s (%.0f ops/s); latency p50 %.1f "
+        "us, p99 %.1f us, p999 %.1f us.",
+        mode,
+        args->keys,
+        args->count,
+        (double) elapsed / 1e9,
+        (double) args->count * 1e9 / (double) elapsed,
+        percentile_us(args->count, 500),
+        percentile_us(args->count, 990),
+        percentile_us(args->count, 999)
+    );
+}
+
+static GglError write_bench_map(GgconfigdBenchArgs *args) {
+    for (uint32_t i = 0; i < args->keys; i++) {
+        // NOLINTNEXTLINE(cert-err33-c)
+        snprintf((char *) key_names[i], BENCH_KEY_LEN, "k%u", i);
+        bench_kvs[i] = (GglKV) { key_name(i), GGL_OBJ_BUF(GGL_STR("value")) };
+    }
+
+    GglError ret = ggl_gg_config_write(
+        GGL_BUF_LIST(BENCH_ROOT, BENCH_MAP),
+        GGL_OBJ_MAP((GglMap) { .pairs = bench_kvs, .len = args->keys }),
+        NULL
+    );
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGE("Failed to write benchmark values.");
+    }
+    return ret;
+}
+
+static GglError bench_read(GgconfigdBenchArgs *args) {
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < args->count; i++) {
+        GglBuffer result = GGL_BUF(read_mem);
+        uint64_t op_start = now_ns();
+        GglError ret = ggl_gg_config_read_str(
+            GGL_BUF_LIST(BENCH_ROOT, BENCH_MAP, key_name(i % args->keys)),
+            &result
+        );
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGE("Benchmark read failed.");
+            return ret;
+        }
+        samples[i] = now_ns() - op_start;
+    }
+    report(args, "read", now_ns() - start);
+    return GGL_ERR_OK;
+}
+
+static GglError bench_read_map(GgconfigdBenchArgs *args) {
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < args->count; i++) {
+        GglBumpAlloc alloc = ggl_bump_alloc_init(GGL_BUF(read_mem));
+        GglObject result;
+        uint64_t op_start = now_ns();
+        GglError ret = ggl_gg_config_read(
+            GGL_BUF_LIST(BENCH_ROOT, BENCH_MAP), &alloc.alloc, &result
+        );
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGE("Benchmark map read failed.");
+            return ret;
+        }
+        samples[i] = now_ns() - op_start;
+    }
+    report(args, "read-map", now_ns() - start);
+    return GGL_ERR_OK;
+}
+
+static GglError bench_write(GgconfigdBenchArgs *args) {
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < args->count; i++) {
+        uint64_t op_start = now_ns();
+        GglError ret = ggl_gg_config_write(
+            GGL_BUF_LIST(BENCH_ROOT, BENCH_MAP, key_name(i % args->keys)),
+            GGL_OBJ_I64(i),
+            NULL
+        );
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGE("Benchmark write failed.");
+            return ret;
+        }
+        samples[i] = now_ns() - op_start;
+    }
+    report(args, "write", now_ns() - start);
+    return GGL_ERR_OK;
+}
+
+// One write of a deployment of component, as made by ggdeploymentd
+static GglError deploy_write(
+    uint32_t step, GglBuffer component, int64_t round
+) {
+    switch (step) {
+    case 0:
+        return ggl_gg_config_write(
+            GGL_BUF_LIST(BENCH_ROOT, GGL_STR("services"), component),
+            GGL_OBJ_MAP(GGL_MAP({ GGL_STR("arn"), GGL_OBJ_BUF(BENCH_ARN) })),
+            NULL
+        );
+    case 1: {
+        uint8_t version_mem[24];
+        // NOLINTNEXTLINE(cert-err33-c)
+        snprintf(
+            (char *) version_mem, sizeof(version_mem), "1.0.%" PRId64, round
+        );
+        return ggl_gg_config_write(
+            GGL_BUF_LIST(
+                BENCH_ROOT, GGL_STR("services"), component, GGL_STR("version")
+            ),
+            GGL_OBJ_BUF(ggl_buffer_from_null_term((char *) version_mem)),
+            NULL
+        );
+    }
+    case 2:
+        return ggl_gg_config_write(
+            GGL_BUF_LIST(
+                BENCH_ROOT,
+                GGL_STR("services"),
+                component,
+                GGL_STR("configuration")
+            ),
+            GGL_OBJ_MAP(GGL_MAP(
+                { GGL_STR("logLevel"), GGL_OBJ_BUF(GGL_STR("INFO")) },
+                { GGL_STR("port"), GGL_OBJ_I64(8000 + round) },
+                { GGL_STR("enabled"), GGL_OBJ_BOOL(true) },
+                { GGL_STR("topics"),
+                  GGL_OBJ_LIST(GGL_LIST(
+                      GGL_OBJ_BUF(GGL_STR("telemetry")),
+                      GGL_OBJ_BUF(GGL_STR("commands"))
+                  )) },
+                { GGL_STR("limits"),
+                  GGL_OBJ_MAP(GGL_MAP(
+                      { GGL_STR("memory"), GGL_OBJ_I64(1024) },
+                      { GGL_STR("cpus"), GGL_OBJ_F64(0.5) }
+                  )) }
+            )),
+            NULL
+        );
+    case 3:
+        return ggl_gg_config_write(
+            GGL_BUF_LIST(
+                BENCH_ROOT, GGL_STR("services"), component, GGL_STR("configArn")
+            ),
+            GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(BENCH_ARN))),
+            NULL
+        );
+    default:
+        return ggl_gg_config_write(
+            GGL_BUF_LIST(
+                BENCH_ROOT, GGL_STR("system"), GGL_STR("fleetStatusSequenceNum")
+            ),
+            GGL_OBJ_I64(round),
+            NULL
+        );
+    }
+}
+
+static GglError bench_deploy(GgconfigdBenchArgs *args) {
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < args->count; i++) {
+        uint32_t component = (i / DEPLOY_STEPS) % args->keys;
+        int64_t round = i / (DEPLOY_STEPS * args->keys);
+        uint64_t op_start = now_ns();
+        GglError ret
+            = deploy_write(i % DEPLOY_STEPS, key_name(component), round);
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGE("Benchmark deployment write failed.");
+            return ret;
+        }
+        samples[i] = now_ns() - op_start;
+    }
+    report(args, "deploy", now_ns() - start);
+    return GGL_ERR_OK;
+}
+
+static bool mode_enabled(GgconfigdBenchArgs *args, const char *mode) {
+    return (strcmp(args->mode, "all") == 0) || (strcmp(args->mode, mode) == 0);
+}
+
+GglError run_ggconfigd_bench(GgconfigdBenchArgs *args) {
+    if (args->mode == NULL) {
+        args->mode = "all";
+    }
+    if (args->count == 0) {
+        args->count = 10000;
+    }
+    if (args->keys == 0) {
+        args->keys = 16;
+    }
+
+    if (!mode_enabled(args, "read") && !mode_enabled(args, "read-map")
+        && !mode_enabled(args, "write") && !mode_enabled(args, "deploy")) {
+        GGL_LOGE("Unknown benchmark mode %s.", args->mode);
+        return GGL_ERR_INVALID;
+    }
+    if (args->count > BENCH_MAX_SAMPLES) {
+        GGL_LOGE("At most %d operations are supported.", BENCH_MAX_SAMPLES);
+        return GGL_ERR_RANGE;
+    }
+    if (args->keys > BENCH_MAX_KEYS) {
+        GGL_LOGE("At most %d keys are supported.", BENCH_MAX_KEYS);
+        return GGL_ERR_RANGE;
+    }
+
+    GglError ret = write_bench_map(args);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    if (mode_enabled(args, "read")) {
+        ret = bench_read(args);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+    if (mode_enabled(args, "read-map")) {
+        ret = bench_read_map(args);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+    if (mode_enabled(args, "write")) {
+        ret = bench_write(args);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+    if (mode_enabled(args, "deploy")) {
+        ret = bench_deploy(args);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+    return GGL_ERR_OK;
+}
@@ -5,8 +5,10 @@
 #include "ggconfigd.h"
 #include <argp.h>
 #include <ggl/buffer.h>
+#include <ggl/error.h>
 #include <ggl/object.h>
 #include <ggl/version.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 __attribute__((visibility("default"))) const char *argp_program_version
@@ -17,15 +19,34 @@ static char doc[] = "ggconfigd -- Greengrass Nucleus Lite configuration daemon";
 static struct argp_option opts[] = {
     { "config-file", 'c', "path", 0, "Configuration file to use", 0 },
     { "config-dir", 'C', "path", 0, "Directory to look for config files", 0 },
+    { "db-profile",
+      'p',
+      "full|wal",
+      0,
+      "Database durability profile (default full)",
+      0 },
+    { "db-mmap-size", 'm', "bytes", 0, "Override database mmap I/O size", 0 },
+    { "db-cache-size", 's', "KiB", 0, "Override database cache size", 0 },
     { 0 }
 };
 
 static GglBuffer config_path = GGL_STR("/etc/greengrass/config.yaml");
 static GglBuffer config_dir = GGL_STR("/etc/greengrass/config.d");
+static GgconfigdDbProfile db_profile;
+static int64_t db_mmap_size = -1;
+static int64_t db_cache_size = -1;
+
+static int64_t parse_size(char *arg, struct argp_state *state) {
+    int64_t val = 0;
+    GglError ret = ggl_str_to_int64(ggl_buffer_from_null_term(arg), &val);
+    if ((ret != GGL_ERR_OK) || (val < 0)) {
+        // NOLINTNEXTLINE(concurrency-mt-unsafe)
+        argp_error(state, "Invalid size: %s", arg);
+    }
+    return val;
+}
 
 static error_t arg_parser(int key, char *arg, struct argp_state *state) {
-    (void) arg;
-    (void) state;
     switch (key) {
     case 'c':
         config_path = ggl_buffer_from_null_term(arg);
@@ -33,6 +54,20 @@ static error_t arg_parser(int key, char *arg, struct argp_state *state) {
     case 'C':
         config_dir = ggl_buffer_from_null_term(arg);
         break;
+    case 'p':
+        if (!ggconfig_db_profile_from_name(
+                ggl_buffer_from_null_term(arg), &db_profile
+            )) {
+            // NOLINTNEXTLINE(concurrency-mt-unsafe)
+            argp_error(state, "Unknown database profile: %s", arg);
+        }
+        break;
+    case 'm':
+        db_mmap_size = parse_size(arg, state);
+        break;
+    case 's':
+        db_cache_size = parse_size(arg, state);
+        break;
     case ARGP_KEY_END:
         break;
     default:
@@ -48,9 +83,19 @@ static void exit_cleanup(void) {
 }
 
 int main(int argc, char **argv) {
+    ggconfig_db_profile_from_name(GGL_STR("full"), &db_profile);
+
     // NOLINTNEXTLINE(concurrency-mt-unsafe)
     argp_parse(&argp, argc, argv, 0, 0, NULL);
 
+    if (db_mmap_size >= 0) {
+        db_profile.mmap_size = db_mmap_size;
+    }
+    if (db_cache_size >= 0) {
+        db_profile.cache_size_kib = db_cache_size;
+    }
+    ggconfig_set_db_profile(db_profile);
+
     atexit(exit_cleanup);
 
     ggconfig_open();
@@ -9,19 +9,103 @@
 #include <ggl/error.h>
 #include <ggl/object.h>
 #include <ggl/vector.h>
+#include <stdbool.h>
 #include <stdint.h>
 
-// TODO: we could save this static memory by having json decoding done as we
-// read each object in the db_interface layer.
-// For now, set to something slightly smaller than GGCONFIGD_MAX_DB_READ_BYTES
-#define GGCONFIGD_MAX_OBJECT_DECODE_BYTES 9000
+/// Number of distinct keys, and bytes of their names, whose subscribers a
+/// single write transaction can notify individually. Further changes are
+/// reported to their deepest tracked parent key.
+#define GGCONFIGD_MAX_CHANGED_KEYS 512
+#define GGCONFIGD_BATCH_KEY_BYTES (16 * 1024)
 
+/// Bytes of key names kept for a key path reused across writes. Longer paths
+/// are looked up again, or can not be imported from a config file.
+#define GGCONFIGD_KEY_PATH_BYTES 1024
+
+/// Bytes of a list value, and items of the lists or maps within it being read
+/// at once, read from a config file.
+#define GGCONFIGD_IMPORT_VALUE_BYTES (64 * 1024)
+#define GGCONFIGD_IMPORT_MAX_ITEMS 256
+
+/// Keys and bytes of key names and decoded values held by the in-memory
+/// configuration cache. Larger configurations are read from the database until
+/// a snapshot import or failed write lets the cache be loaded again.
+/// Can be configured with `-DGGCONFIGD_CACHE_MAX_KEYS=<N>` and
+/// `-DGGCONFIGD_CACHE_MEM_BYTES=<N>`.
+#ifndef GGCONFIGD_CACHE_MAX_KEYS
+#define GGCONFIGD_CACHE_MAX_KEYS 1024
+#endif
+#ifndef GGCONFIGD_CACHE_MEM_BYTES
+#define GGCONFIGD_CACHE_MEM_BYTES (64 * 1024)
+#endif
+
+/// Configuration subscriptions that can be open at once, and the number of
+/// hash buckets (a power of two) they are indexed in by key.
+#define GGCONFIGD_MAX_SUBSCRIPTIONS 256
+#define GGCONFIGD_SUBSCRIPTION_BUCKETS 64
+
+/// Subscriptions that can have a notification debounce window, and bytes of
+/// key names kept for each pending notification. Pending paths that do not fit
+/// are notified as a change to their deepest parent that does.
+#define GGCONFIGD_MAX_DEBOUNCED_SUBSCRIPTIONS 32
+#define GGCONFIGD_DEBOUNCE_PATH_BYTES 256
+
+/// Idle time after the last commit before the write-ahead log is checkpointed
+/// into the database, and the log size in pages at which a commit checkpoints
+/// it regardless of activity.
+#define GGCONFIGD_CHECKPOINT_IDLE_MS 2000
+#define GGCONFIGD_WAL_AUTOCHECKPOINT_PAGES 4000
+
+/// Time a database connection waits for another to release its lock, such as
+/// a write overlapping a checkpoint, before failing.
+#define GGCONFIGD_BUSY_TIMEOUT_MS 5000
+
+/// Trade-off between durability and write cost of the configuration database.
+typedef enum {
+    /// Rollback journal synced on every commit. Committed writes survive power
+    /// loss.
+    GGCONFIGD_DURABILITY_FULL,
+    /// Write-ahead log synced when checkpointed. Committed writes survive a
+    /// daemon crash; a power loss may drop the latest commits, but never leaves
+    /// the database inconsistent.
+    GGCONFIGD_DURABILITY_WAL,
+} GgconfigdDurability;
+
+/// Database tuning, applied by ggconfig_open.
+typedef struct {
+    GgconfigdDurability durability;
+    /// Bytes of the database read through mmap; 0 disables mmap I/O.
+    int64_t mmap_size;
+    /// Page cache size in KiB.
+    int64_t cache_size_kib;
+} GgconfigdDbProfile;
+
+/// Profiles selectable by name. "full" keeps sqlite's defaults, "wal" trades
+/// the durability of the latest commits for cheaper writes.
+bool ggconfig_db_profile_from_name(GglBuffer name, GgconfigdDbProfile *profile);
+
+/// Set the tuning used by the next ggconfig_open.
+void ggconfig_set_db_profile(GgconfigdDbProfile profile);
+
+/// Start a write transaction. Writes until the matching commit or rollback are
+/// applied atomically and their subscribers are notified once on commit.
+GglError ggconfig_write_begin(void);
+GglError ggconfig_write_commit(void);
+void ggconfig_write_rollback(void);
+
+/// Write a value other than a map at key_path.
 GglError ggconfig_write_value_at_key(
-    GglList *key_path, GglBuffer *value, int64_t timestamp
+    GglList *key_path, GglObject value, int64_t timestamp
 );
 GglError ggconfig_get_value_from_key(GglList *key_path, GglObject *value);
 GglError ggconfig_get_key_notification(GglList *key_path, uint32_t handle);
 GglError ggconfig_open(void);
+
+/// Write a snapshot of the whole configuration to fd.
+GglError ggconfig_export_snapshot(int fd);
+/// Replace the whole configuration with the snapshot read from fd, in one
+/// transaction. The configuration is unchanged if the snapshot is invalid.
+GglError ggconfig_import_snapshot(int fd);
 GglError ggconfig_close(void);
 
 void ggconfigd_start_server(void);
@@ -33,5 +117,7 @@ GglError process_nonmap(
     GglObjVec *key_path, GglObject value, int64_t timestamp
 );
 GglError process_map(GglObjVec *key_path, GglMap *the_map, int64_t timestamp);
+/// Write value (a map or a single value) at key_path in one transaction.
+GglError process_write(GglObjVec *key_path, GglObject value, int64_t timestamp);
 
 #endif
@@ -0,0 +1,149 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "checkpointer.h"
+#include "ggconfigd.h"
+#include <ggl/cleanup.h>
+#include <ggl/error.h>
+#include <ggl/log.h>
+#include <pthread.h>
+#include <sqlite3.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Guards the commit state; held by request handlers on commit and by the
+// checkpoint thread while deciding when to run.
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond;
+static bool checkpointer_running = false;
+static bool commits_pending = false;
+static uint64_t last_commit_ms = 0;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000U) + ((uint64_t) ts.tv_nsec / 1000000U);
+}
+
+void checkpointer_note_commit(void) {
+    GGL_MTX_SCOPE_GUARD(&mtx);
+
+    if (!checkpointer_running) {
+        return;
+    }
+    last_commit_ms = now_ms();
+    if (!commits_pending) {
+        commits_pending = true;
+        pthread_cond_signal(&cond);
+    }
+}
+
+static void wait_for_idle(void) {
+    GGL_MTX_SCOPE_GUARD(&mtx);
+
+    while (true) {
+        if (!commits_pending) {
+            pthread_cond_wait(&cond, &mtx);
+            continue;
+        }
+
+        uint64_t idle_at = last_commit_ms + GGCONFIGD_CHECKPOINT_IDLE_MS;
+        if (now_ms() >= idle_at) {
+            commits_pending = false;
+            return;
+        }
+
+        struct timespec deadline = {
+            .tv_sec = (time_t) (idle_at / 1000U),
+            .tv_nsec = (long) ((idle_at % 1000U) * 1000000U),
+        };
+        pthread_cond_timedwait(&cond, &mtx, &deadline);
+    }
+}
+
+static void *checkpoint_thread(void *ctx) {
+    // A separate connection, so request handlers are not held up by
+    // checkpoints. Both connections wait out each other's locks, as a
+    // truncating checkpoint blocks writes while it runs.
+    sqlite3 *db = ctx;
+
+    while (true) {
+        wait_for_idle();
+
+        // Truncating keeps the log file from holding on to flash space. If
+        // writes kept the lock past the busy timeout, the checkpoint is
+        // retried once they go idle.
+        int log_frames = 0;
+        int checkpointed_frames = 0;
+        int rc = sqlite3_wal_checkpoint_v2(
+            db,
+            NULL,
+            SQLITE_CHECKPOINT_TRUNCATE,
+            &log_frames,
+            &checkpointed_frames
+        );
+        if (rc == SQLITE_OK) {
+            GGL_LOGD(
+                "Checkpointed %d of %d log frames.",
+                checkpointed_frames,
+                log_frames
+            );
+        } else {
+            GGL_LOGD("Checkpoint deferred: %s", sqlite3_errmsg(db));
+            checkpointer_note_commit();
+        }
+    }
+
+    return NULL;
+}
+
+GglError checkpointer_start(const char *db_path) {
+    GGL_MTX_SCOPE_GUARD(&mtx);
+
+    if (checkpointer_running) {
+        return GGL_ERR_OK;
+    }
+
+    sqlite3 *db = NULL;
+    int rc = sqlite3_open_v2(db_path, &db, SQLITE_OPEN_READWRITE, NULL);
+    if (rc != SQLITE_OK) {
+        GGL_LOGE(
+            "Failed to open database for checkpointing: %s", sqlite3_errmsg(db)
+        );
+        sqlite3_close(db);
+        return GGL_ERR_FAILURE;
+    }
+    sqlite3_busy_timeout(db, GGCONFIGD_BUSY_TIMEOUT_MS);
+    // A new database is only marked as WAL by its first commit, which may come
+    // after this connection would otherwise have read the journal mode.
+    rc = sqlite3_exec(db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        GGL_LOGE(
+            "Failed to use write-ahead log for checkpointing: %s",
+            sqlite3_errmsg(db)
+        );
+        sqlite3_close(db);
+        return GGL_ERR_FAILURE;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_t thread;
+    int ret = pthread_create(&thread, NULL, checkpoint_thread, db);
+    if (ret != 0) {
+        GGL_LOGE("Failed to start checkpoint thread.");
+        sqlite3_close(db);
+        return GGL_ERR_FAILURE;
+    }
+    pthread_detach(thread);
+
+    checkpointer_running = true;
+    return GGL_ERR_OK;
+}
@@ -0,0 +1,22 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef GGCONFIGD_CHECKPOINTER_H
+#define GGCONFIGD_CHECKPOINTER_H
+
+//! Idle write-ahead log checkpointing
+//!
+//! Copies the write-ahead log back into the database once no commits have
+//! been made for GGCONFIGD_CHECKPOINT_IDLE_MS, so commits do not pay for
+//! checkpoints while the configuration is being written.
+
+#include <ggl/error.h>
+
+/// Start checkpointing the database at db_path, which must stay valid.
+GglError checkpointer_start(const char *db_path);
+
+/// Record a commit, delaying the next checkpoint until writes go idle.
+void checkpointer_note_commit(void);
+
+#endif
@@ -0,0 +1,295 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "config_cache.h"
+#include "ggconfigd.h"
+#include "helpers.h"
+#include <ggl/alloc.h>
+#include <ggl/buffer.h>
+#include <ggl/bump_alloc.h>
+#include <ggl/error.h>
+#include <ggl/log.h>
+#include <ggl/object.h>
+#include <inttypes.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NO_NODE UINT32_MAX
+
+// Node 0 is a virtual root whose children are the root keys. Nodes are kept
+// sorted by key id; the database never reuses ids, so new keys are appended.
+typedef struct {
+    int64_t key_id;
+    GglBuffer key;
+    GglObject value;
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t last_child;
+    uint32_t next_sibling;
+    bool has_value;
+} CacheNode;
+
+typedef enum {
+    CACHE_STALE,
+    CACHE_READY,
+    CACHE_DISABLED,
+} CacheState;
+
+static CacheState cache_state = CACHE_STALE;
+static CacheNode nodes[GGCONFIGD_CACHE_MAX_KEYS + 1];
+static uint32_t nodes_len = 0;
+
+// Key names and decoded values. Replaced values are not reclaimed; when this
+// runs out the cache is reloaded, which compacts it.
+alignas(max_align_t) static uint8_t cache_mem[GGCONFIGD_CACHE_MEM_BYTES];
+static size_t cache_mem_used = 0;
+
+void config_cache_clear(void) {
+    cache_state = CACHE_STALE;
+    nodes[0] = (CacheNode) { .key_id = 0,
+                             .parent = NO_NODE,
+                             .first_child = NO_NODE,
+                             .last_child = NO_NODE,
+                             .next_sibling = NO_NODE };
+    nodes_len = 1;
+    cache_mem_used = 0;
+}
+
+static uint32_t find_node_by_id(int64_t key_id) {
+    uint32_t low = 0;
+    uint32_t high = nodes_len;
+    while (low < high) {
+        uint32_t mid = low + ((high - low) / 2);
+        if (nodes[mid].key_id < key_id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if ((low < nodes_len) && (nodes[low].key_id == key_id)) {
+        return low;
+    }
+    return NO_NODE;
+}
+
+static GglError copy_to_cache(GglBumpAlloc *balloc, GglBuffer *buf) {
+    uint8_t *mem = GGL_ALLOCN(&balloc->alloc, uint8_t, buf->len);
+    if (mem == NULL) {
+        return GGL_ERR_NOMEM;
+    }
+    memcpy(mem, buf->data, buf->len);
+    buf->data = mem;
+    return GGL_ERR_OK;
+}
+
+static GglError add_node(
+    int64_t key_id, uint32_t parent, GglBuffer key, uint32_t *node_out
+) {
+    if (nodes_len > GGCONFIGD_CACHE_MAX_KEYS) {
+        GGL_LOGW(
+            "Configuration has more than %d keys; not caching it. Set "
+            "GGCONFIGD_CACHE_MAX_KEYS to cache larger configurations.",
+            GGCONFIGD_CACHE_MAX_KEYS
+        );
+        return GGL_ERR_NOMEM;
+    }
+    if (key_id <= nodes[nodes_len - 1].key_id) {
+        GGL_LOGE("Key id %" PRId64 " added to cache out of order.", key_id);
+        return GGL_ERR_FAILURE;
+    }
+
+    GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(cache_mem));
+    balloc.index = cache_mem_used;
+    GglError ret = copy_to_cache(&balloc, &key);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    cache_mem_used = balloc.index;
+
+    uint32_t node = nodes_len++;
+    nodes[node] = (CacheNode) { .key_id = key_id,
+                                .key = key,
+                                .parent = parent,
+                                .first_child = NO_NODE,
+                                .last_child = NO_NODE,
+                                .next_sibling = NO_NODE };
+    if (nodes[parent].last_child == NO_NODE) {
+        nodes[parent].first_child = node;
+    } else {
+        nodes[nodes[parent].last_child].next_sibling = node;
+    }
+    nodes[parent].last_child = node;
+    *node_out = node;
+    return GGL_ERR_OK;
+}
+
+static GglError set_node_value(uint32_t node, GglObject value) {
+    GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(cache_mem));
+    balloc.index = cache_mem_used;
+    GglError ret = ggl_obj_deep_copy(&value, &balloc.alloc);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    cache_mem_used = balloc.index;
+
+    nodes[node].value = value;
+    nodes[node].has_value = true;
+    return GGL_ERR_OK;
+}
+
+GglError config_cache_load_key(
+    int64_t key_id, int64_t parent_id, GglBuffer key, GglObject *value
+) {
+    uint32_t parent = find_node_by_id(parent_id);
+    if (parent == NO_NODE) {
+        GGL_LOGE(
+            "Parent %" PRId64 " of key id %" PRId64 " not in cache.",
+            parent_id,
+            key_id
+        );
+        return GGL_ERR_FAILURE;
+    }
+
+    uint32_t node;
+    GglError ret = add_node(key_id, parent, key, &node);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    if (value != NULL) {
+        return set_node_value(node, *value);
+    }
+    return GGL_ERR_OK;
+}
+
+void config_cache_load_done(GglError load_result) {
+    if (load_result != GGL_ERR_OK) {
+        GGL_LOGW("Configuration cache disabled; reading from the database.");
+        cache_state = CACHE_DISABLED;
+        return;
+    }
+    GGL_LOGD(
+        "Cached %" PRIu32 " keys using %zu bytes.",
+        nodes_len - 1,
+        cache_mem_used
+    );
+    cache_state = CACHE_READY;
+}
+
+bool config_cache_needs_load(void) {
+    return cache_state == CACHE_STALE;
+}
+
+void config_cache_invalidate(void) {
+    // A disabled cache is retried, as the configuration may now fit
+    if (cache_state != CACHE_STALE) {
+        GGL_LOGD("Configuration cache invalidated.");
+        cache_state = CACHE_STALE;
+    }
+}
+
+void config_cache_write(GglList *key_path, GglList key_ids, GglObject value) {
+    if (cache_state != CACHE_READY) {
+        return;
+    }
+
+    uint32_t parent = 0;
+    for (size_t i = 0; i < key_ids.len; i++) {
+        uint32_t node = find_node_by_id(key_ids.items[i].i64);
+        if (node == NO_NODE) {
+            GglError ret = add_node(
+                key_ids.items[i].i64, parent, key_path->items[i].buf, &node
+            );
+            if (ret != GGL_ERR_OK) {
+                config_cache_invalidate();
+                return;
+            }
+        }
+        parent = node;
+    }
+
+    GglError ret = set_node_value(parent, value);
+    if (ret != GGL_ERR_OK) {
+        config_cache_invalidate();
+    }
+}
+
+static GglError find_node_by_path(GglList *key_path, uint32_t *node_out) {
+    uint32_t node = 0;
+    for (size_t i = 0; i < key_path->len; i++) {
+        uint32_t child = nodes[node].first_child;
+        while ((child != NO_NODE)
+               && !ggl_buffer_eq(nodes[child].key, key_path->items[i].buf)) {
+            child = nodes[child].next_sibling;
+        }
+        if (child == NO_NODE) {
+            return GGL_ERR_NOENTRY;
+        }
+        node = child;
+    }
+    *node_out = node;
+    return GGL_ERR_OK;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static GglError read_node(uint32_t node, GglAlloc *alloc, GglObject *value) {
+    if (nodes[node].has_value) {
+        *value = nodes[node].value;
+        return GGL_ERR_OK;
+    }
+
+    size_t children_count = 0;
+    for (uint32_t child = nodes[node].first_child; child != NO_NODE;
+         child = nodes[child].next_sibling) {
+        children_count++;
+    }
+    if (children_count == 0) {
+        GGL_LOGE(
+            "no value or children keys found for key id %" PRId64,
+            nodes[node].key_id
+        );
+        return GGL_ERR_FAILURE;
+    }
+
+    GglKV *pairs = GGL_ALLOCN(alloc, GglKV, children_count);
+    if (pairs == NULL) {
+        GGL_LOGE(
+            "no more memory to allocate kvs for key id %" PRId64,
+            nodes[node].key_id
+        );
+        return GGL_ERR_NOMEM;
+    }
+
+    size_t i = 0;
+    for (uint32_t child = nodes[node].first_child; child != NO_NODE;
+         child = nodes[child].next_sibling) {
+        pairs[i].key = nodes[child].key;
+        GglError ret = read_node(child, alloc, &pairs[i].val);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        i++;
+    }
+
+    *value = GGL_OBJ_MAP((GglMap) { .pairs = pairs, .len = children_count });
+    return GGL_ERR_OK;
+}
+
+GglError config_cache_read(
+    GglList *key_path, GglAlloc *alloc, GglObject *value
+) {
+    if (cache_state != CACHE_READY) {
+        return GGL_ERR_UNSUPPORTED;
+    }
+
+    uint32_t node;
+    GglError ret = find_node_by_path(key_path, &node);
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGI("key %s not found", print_key_path(key_path));
+        return ret;
+    }
+    return read_node(node, alloc, value);
+}
@@ -0,0 +1,54 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef GGCONFIGD_CONFIG_CACHE_H
+#define GGCONFIGD_CONFIG_CACHE_H
+
+//! In-memory mirror of the configuration tree
+//!
+//! Holds every key with its value, so reads are served without touching the
+//! database. The database stays the durable
+//! store; the cache is loaded from it and kept coherent by the write path.
+//! When it can not be kept coherent it is marked stale and reloaded before
+//! the next read. If the configuration does not fit, the cache is disabled and
+//! reads go to the database until it is invalidated.
+
+#include <ggl/alloc.h>
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <ggl/object.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/// Empty the cache before loading it from the database.
+void config_cache_clear(void);
+
+/// Add a key read from the database. Keys must be added in increasing key id
+/// order. parent_id is 0 for root keys and value is NULL for maps. The key and
+/// value are copied.
+GglError config_cache_load_key(
+    int64_t key_id, int64_t parent_id, GglBuffer key, GglObject *value
+);
+
+/// Finish loading. If load failed, the cache is disabled.
+void config_cache_load_done(GglError load_result);
+
+/// Whether the cache must be loaded before it can serve reads.
+bool config_cache_needs_load(void);
+
+/// Discard the cache contents; it will be loaded again before the next read.
+/// This also retries loading a cache disabled by an earlier load.
+void config_cache_invalidate(void);
+
+/// Store a copy of the value written at key_path, whose key ids are key_ids.
+void config_cache_write(GglList *key_path, GglList key_ids, GglObject value);
+
+/// Read the value or map at key_path. Map pairs are allocated from alloc;
+/// keys and values point into the cache and are valid until the next write.
+/// Returns GGL_ERR_UNSUPPORTED if the cache can not serve reads.
+GglError config_cache_read(
+    GglList *key_path, GglAlloc *alloc, GglObject *value
+);
+
+#endif
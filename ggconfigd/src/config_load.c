@@ -6,6 +6,7 @@
 #include "ggconfigd.h"
 #include <fcntl.h>
 #include <ggl/buffer.h>
+#include <ggl/alloc.h>
 #include <ggl/bump_alloc.h>
 #include <ggl/cleanup.h>
 #include <ggl/constants.h>
@@ -14,48 +15,398 @@
 #include <ggl/log.h>
 #include <ggl/object.h>
 #include <ggl/vector.h>
-#include <ggl/yaml_decode.h>
 #include <string.h>
+#include <yaml.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-static GglError ggconfig_load_file_fd(int fd) {
-    static uint8_t file_mem[8192];
-    GglBuffer config_file = GGL_BUF(file_mem);
+// Config files are imported from libyaml's event stream, writing each value as
+// soon as it is parsed, in one transaction per file. Only the key path of the
+// value being parsed is held in memory, plus the value itself if it is a list.
+//
+// The items of lists and maps within a value are gathered on scratch stacks
+// shared by the nested lists and maps being read, and copied into the value's
+// memory once each is complete, keeping the recursion's stack use small.
+
+typedef struct {
+    yaml_parser_t parser;
+    GglObjVec key_path;
+    size_t path_mem_used;
+    size_t items_used;
+    size_t pairs_used;
+} ConfigImport;
+
+// Values from config files are written with an old timestamp, so they do not
+// replace values written since.
+static const int64_t CONFIG_FILE_TIMESTAMP = 2;
 
-    GglError ret = ggl_file_read(fd, &config_file);
+static GglObject path_items[GGL_MAX_OBJECT_DEPTH];
+static uint8_t path_mem[GGCONFIGD_KEY_PATH_BYTES];
+static uint8_t value_mem[GGCONFIGD_IMPORT_VALUE_BYTES];
+static GglObject item_scratch[GGCONFIGD_IMPORT_MAX_ITEMS];
+static GglKV pair_scratch[GGCONFIGD_IMPORT_MAX_ITEMS];
+
+static void cleanup_yaml_parser_delete(yaml_parser_t **parser) {
+    yaml_parser_delete(*parser);
+}
+
+static void cleanup_yaml_event_delete(yaml_event_t **event) {
+    yaml_event_delete(*event);
+}
+
+static int read_config_fd(
+    void *ctx, unsigned char *buffer, size_t size, size_t *size_read
+) {
+    int *fd = ctx;
+    GglBuffer buf = { .data = buffer, .len = size };
+    GglError ret = ggl_file_read(*fd, &buf);
     if (ret != GGL_ERR_OK) {
         GGL_LOGE("Failed to read config file.");
-        return GGL_ERR_FAILURE;
+        return 0;
     }
+    *size_read = buf.len;
+    return 1;
+}
 
-    static uint8_t decode_mem[500 * sizeof(GglObject)];
-    GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(decode_mem));
+static GglError next_event(ConfigImport *import, yaml_event_t *event) {
+    if (!yaml_parser_parse(&import->parser, event)) {
+        GGL_LOGE(
+            "Failed to parse config file at line %zu: %s.",
+            import->parser.problem_mark.line + 1,
+            (import->parser.problem != NULL) ? import->parser.problem : "error"
+        );
+        return GGL_ERR_PARSE;
+    }
+    return GGL_ERR_OK;
+}
 
-    GglObject config_obj;
-    ret = ggl_yaml_decode_destructive(config_file, &balloc.alloc, &config_obj);
-    if (ret != GGL_ERR_OK) {
-        GGL_LOGE("Failed to parse config file.");
-        return GGL_ERR_FAILURE;
+static GglError copy_scalar(
+    yaml_event_t *event, GglAlloc *alloc, GglBuffer *buf
+) {
+    GglBuffer scalar = { .data = event->data.scalar.value,
+                         .len = event->data.scalar.length };
+    uint8_t *copy = GGL_ALLOCN(alloc, uint8_t, scalar.len);
+    if ((copy == NULL) && (scalar.len > 0)) {
+        GGL_LOGE("Insufficient memory to read config file value.");
+        return GGL_ERR_NOMEM;
     }
+    if (scalar.len > 0) {
+        memcpy(copy, scalar.data, scalar.len);
+    }
+    *buf = (GglBuffer) { .data = copy, .len = scalar.len };
+    return GGL_ERR_OK;
+}
+
+static GglError read_value(
+    ConfigImport *import,
+    yaml_event_t *event,
+    size_t depth,
+    GglAlloc *alloc,
+    GglObject *value
+);
 
-    GglObjVec key_path = GGL_OBJ_VEC((GglObject[GGL_MAX_OBJECT_DEPTH]) { 0 });
+// NOLINTNEXTLINE(misc-no-recursion)
+static GglError read_sequence(
+    ConfigImport *import, size_t depth, GglAlloc *alloc, GglObject *value
+) {
+    size_t base = import->items_used;
+    size_t len = 0;
 
-    if (config_obj.type == GGL_TYPE_MAP) {
-        ret = process_map(&key_path, &config_obj.map, 2);
+    while (true) {
+        yaml_event_t event;
+        GglError ret = next_event(import, &event);
         if (ret != GGL_ERR_OK) {
             return ret;
         }
-    } else {
-        ret = process_nonmap(&key_path, config_obj, 2);
+        GGL_CLEANUP(cleanup_yaml_event_delete, &event);
+
+        if (event.type == YAML_SEQUENCE_END_EVENT) {
+            break;
+        }
+        if (base + len >= GGCONFIGD_IMPORT_MAX_ITEMS) {
+            GGL_LOGE(
+                "Config file lists can have at most %d items.",
+                GGCONFIGD_IMPORT_MAX_ITEMS
+            );
+            return GGL_ERR_NOMEM;
+        }
+        // Nested lists gather their items after this one's
+        import->items_used = base + len + 1;
+        ret = read_value(
+            import, &event, depth + 1, alloc, &item_scratch[base + len]
+        );
         if (ret != GGL_ERR_OK) {
             return ret;
         }
+        len++;
     }
+    import->items_used = base;
 
+    GglObject *list_items = GGL_ALLOCN(alloc, GglObject, len);
+    if ((list_items == NULL) && (len > 0)) {
+        GGL_LOGE("Insufficient memory to read config file list.");
+        return GGL_ERR_NOMEM;
+    }
+    if (len > 0) {
+        memcpy(list_items, &item_scratch[base], len * sizeof(GglObject));
+    }
+    *value = GGL_OBJ_LIST((GglList) { .items = list_items, .len = len });
     return GGL_ERR_OK;
 }
 
+// NOLINTNEXTLINE(misc-no-recursion)
+static GglError read_mapping(
+    ConfigImport *import, size_t depth, GglAlloc *alloc, GglObject *value
+) {
+    size_t base = import->pairs_used;
+    size_t len = 0;
+
+    while (true) {
+        yaml_event_t key_event;
+        GglError ret = next_event(import, &key_event);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        GGL_CLEANUP(cleanup_yaml_event_delete, &key_event);
+
+        if (key_event.type == YAML_MAPPING_END_EVENT) {
+            break;
+        }
+        if (key_event.type != YAML_SCALAR_EVENT) {
+            GGL_LOGE("Config file map keys must be strings.");
+            return GGL_ERR_PARSE;
+        }
+        if (base + len >= GGCONFIGD_IMPORT_MAX_ITEMS) {
+            GGL_LOGE(
+                "Config file maps in lists can have at most %d keys.",
+                GGCONFIGD_IMPORT_MAX_ITEMS
+            );
+            return GGL_ERR_NOMEM;
+        }
+        GglKV *pair = &pair_scratch[base + len];
+        ret = copy_scalar(&key_event, alloc, &pair->key);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+
+        yaml_event_t event;
+        ret = next_event(import, &event);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        GGL_CLEANUP(cleanup_yaml_event_delete, &event);
+
+        // Nested maps gather their pairs after this one's
+        import->pairs_used = base + len + 1;
+        ret = read_value(import, &event, depth + 1, alloc, &pair->val);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        len++;
+    }
+    import->pairs_used = base;
+
+    GglKV *map_pairs = GGL_ALLOCN(alloc, GglKV, len);
+    if ((map_pairs == NULL) && (len > 0)) {
+        GGL_LOGE("Insufficient memory to read config file map.");
+        return GGL_ERR_NOMEM;
+    }
+    if (len > 0) {
+        memcpy(map_pairs, &pair_scratch[base], len * sizeof(GglKV));
+    }
+    *value = GGL_OBJ_MAP((GglMap) { .pairs = map_pairs, .len = len });
+    return GGL_ERR_OK;
+}
+
+// Read the value starting with event into an object. Used for values that are
+// stored whole: scalars and lists.
+// NOLINTNEXTLINE(misc-no-recursion)
+static GglError read_value(
+    ConfigImport *import,
+    yaml_event_t *event,
+    size_t depth,
+    GglAlloc *alloc,
+    GglObject *value
+) {
+    if (depth >= GGL_MAX_OBJECT_DEPTH) {
+        GGL_LOGE("Config file value is nested too deeply.");
+        return GGL_ERR_RANGE;
+    }
+
+    switch (event->type) {
+    case YAML_SCALAR_EVENT: {
+        GglBuffer buf;
+        GglError ret = copy_scalar(event, alloc, &buf);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        *value = GGL_OBJ_BUF(buf);
+        return GGL_ERR_OK;
+    }
+    case YAML_SEQUENCE_START_EVENT:
+        return read_sequence(import, depth, alloc, value);
+    case YAML_MAPPING_START_EVENT:
+        return read_mapping(import, depth, alloc, value);
+    case YAML_ALIAS_EVENT:
+        GGL_LOGE("Config file aliases are not supported.");
+        return GGL_ERR_UNSUPPORTED;
+    default:
+        GGL_LOGE("Unexpected event in config file.");
+        return GGL_ERR_PARSE;
+    }
+}
+
+static GglError push_key(ConfigImport *import, yaml_event_t *key_event) {
+    size_t len = key_event->data.scalar.length;
+    if ((import->key_path.list.len >= import->key_path.capacity)
+        || (len > sizeof(path_mem) - import->path_mem_used)) {
+        GGL_LOGE("Config file key path is too long.");
+        return GGL_ERR_NOMEM;
+    }
+
+    uint8_t *key = &path_mem[import->path_mem_used];
+    memcpy(key, key_event->data.scalar.value, len);
+    import->path_mem_used += len;
+    return ggl_obj_vec_push(
+        &import->key_path, GGL_OBJ_BUF((GglBuffer) { .data = key, .len = len })
+    );
+}
+
+static GglError pop_key(ConfigImport *import) {
+    GglObject key = GGL_OBJ_NULL();
+    GglError ret = ggl_obj_vec_pop(&import->key_path, &key);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    import->path_mem_used -= key.buf.len;
+    return GGL_ERR_OK;
+}
+
+static GglError import_value(ConfigImport *import, yaml_event_t *event) {
+    GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(value_mem));
+    GglObject value;
+    GglError ret = read_value(
+        import, event, import->key_path.list.len, &balloc.alloc, &value
+    );
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    return ggconfig_write_value_at_key(
+        &import->key_path.list, value, CONFIG_FILE_TIMESTAMP
+    );
+}
+
+// Write each value of the map whose start event was just parsed
+// NOLINTNEXTLINE(misc-no-recursion)
+static GglError import_mapping(ConfigImport *import) {
+    while (true) {
+        yaml_event_t key_event;
+        GglError ret = next_event(import, &key_event);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        GGL_CLEANUP(cleanup_yaml_event_delete, &key_event);
+
+        if (key_event.type == YAML_MAPPING_END_EVENT) {
+            return GGL_ERR_OK;
+        }
+        if (key_event.type != YAML_SCALAR_EVENT) {
+            GGL_LOGE("Config file map keys must be strings.");
+            return GGL_ERR_PARSE;
+        }
+        ret = push_key(import, &key_event);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+
+        yaml_event_t event;
+        ret = next_event(import, &event);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        GGL_CLEANUP(cleanup_yaml_event_delete, &event);
+
+        if (event.type == YAML_MAPPING_START_EVENT) {
+            ret = import_mapping(import);
+        } else {
+            ret = import_value(import, &event);
+        }
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        ret = pop_key(import);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+}
+
+// Import the first document of the stream. The values of a map are written at
+// their key paths; any other value is written at the empty key path, which is
+// rejected.
+static GglError import_document(ConfigImport *import) {
+    while (true) {
+        yaml_event_t event;
+        GglError ret = next_event(import, &event);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        GGL_CLEANUP(cleanup_yaml_event_delete, &event);
+
+        switch (event.type) {
+        case YAML_STREAM_START_EVENT:
+        case YAML_DOCUMENT_START_EVENT:
+            break;
+        case YAML_DOCUMENT_END_EVENT:
+        case YAML_STREAM_END_EVENT:
+            return GGL_ERR_OK;
+        case YAML_MAPPING_START_EVENT:
+            ret = import_mapping(import);
+            if (ret != GGL_ERR_OK) {
+                return ret;
+            }
+            break;
+        default:
+            // An empty file parses as an empty scalar
+            if ((event.type == YAML_SCALAR_EVENT)
+                && (event.data.scalar.length == 0)) {
+                break;
+            }
+            ret = import_value(import, &event);
+            if (ret != GGL_ERR_OK) {
+                return ret;
+            }
+            break;
+        }
+    }
+}
+
+static GglError ggconfig_load_file_fd(int fd) {
+    ConfigImport import = { .key_path = GGL_OBJ_VEC(path_items) };
+    if (!yaml_parser_initialize(&import.parser)) {
+        GGL_LOGE("Failed to initialize yaml parser.");
+        return GGL_ERR_NOMEM;
+    }
+    GGL_CLEANUP(cleanup_yaml_parser_delete, &import.parser);
+    yaml_parser_set_input(&import.parser, read_config_fd, &fd);
+
+    GglError ret = ggconfig_write_begin();
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    ret = import_document(&import);
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGE("Failed to load config file.");
+        ggconfig_write_rollback();
+        return ret;
+    }
+
+    return ggconfig_write_commit();
+}
+
 GglError ggconfig_load_file(GglBuffer path) {
     int fd;
     GglError ret = ggl_file_open(path, O_RDONLY, 0, &fd);
@@ -4,13 +4,15 @@
 
 #include "ggconfigd.h"
 #include "helpers.h"
+#include "notify_debounce.h"
+#include "subscriber_index.h"
+#include <sys/stat.h>
 #include <ggl/buffer.h>
-#include <ggl/bump_alloc.h>
+#include <ggl/cleanup.h>
 #include <ggl/constants.h>
 #include <ggl/core_bus/server.h>
 #include <ggl/error.h>
-#include <ggl/json_decode.h>
-#include <ggl/json_encode.h>
+#include <ggl/file.h>
 #include <ggl/list.h>
 #include <ggl/log.h>
 #include <ggl/map.h>
@@ -19,84 +21,7 @@
 #include <inttypes.h>
 #include <time.h>
 #include <stdbool.h>
-
-/// Given a GglObject of (possibly nested) GglMaps and/or GglBuffer(s),
-/// decode all the GglBuffers from json to their appropriate GGL object types.
-// NOLINTNEXTLINE(misc-no-recursion)
-static GglError decode_object_destructive(
-    GglObject *obj, GglBumpAlloc *bump_alloc
-) {
-    GglError return_err = GGL_ERR_FAILURE;
-    if (obj->type == GGL_TYPE_BUF) {
-        GGL_LOGD(
-            "given buffer to decode: %.*s", (int) obj->buf.len, obj->buf.data
-        );
-        GglObject return_object;
-        GglError json_decode_err = ggl_json_decode_destructive(
-            obj->buf, &(bump_alloc->alloc), &return_object
-        );
-        if (json_decode_err != GGL_ERR_OK) {
-            GGL_LOGE(
-                "decode json failed with error code: %d", (int) json_decode_err
-            );
-            return GGL_ERR_FAILURE;
-        }
-
-        obj->type = return_object.type;
-        switch (return_object.type) {
-        case GGL_TYPE_BOOLEAN:
-            obj->boolean = return_object.boolean;
-            return_err = GGL_ERR_OK;
-            break;
-        case GGL_TYPE_I64:
-            obj->i64 = return_object.i64;
-            return_err = GGL_ERR_OK;
-            break;
-        case GGL_TYPE_F64:
-            obj->f64 = return_object.f64;
-            return_err = GGL_ERR_OK;
-            break;
-        case GGL_TYPE_BUF:
-            obj->buf = return_object.buf;
-            return_err = GGL_ERR_OK;
-            break;
-        case GGL_TYPE_LIST:
-            obj->list = return_object.list;
-            return_err = GGL_ERR_OK;
-            break;
-        case GGL_TYPE_NULL:
-            return_err = GGL_ERR_OK;
-            break;
-        default:
-            GGL_LOGE("decoded unexpected type: %d", (int) return_object.type);
-            return_err = GGL_ERR_FAILURE;
-            break;
-        }
-    } else if (obj->type == GGL_TYPE_MAP) {
-        GGL_LOGD("given map to decode with length: %d", (int) obj->map.len);
-        for (size_t i = 0; i < obj->map.len; i++) {
-            GglError decode_err = decode_object_destructive(
-                &(obj->map.pairs[i].val), bump_alloc
-            );
-            if (decode_err != GGL_ERR_OK) {
-                GGL_LOGE(
-                    "decode map value at index %d and key %.*s failed with "
-                    "error code: %d",
-                    (int) i,
-                    (int) obj->map.pairs[i].key.len,
-                    obj->map.pairs[i].key.data,
-                    (int) decode_err
-                );
-                return decode_err;
-            }
-        }
-        return_err = GGL_ERR_OK;
-    } else {
-        GGL_LOGE("given unexpected type to decode: %d", (int) obj->type);
-        return_err = GGL_ERR_FAILURE;
-    }
-    return return_err;
-}
+#include <stdint.h>
 
 static GglError rpc_read(void *ctx, GglMap params, uint32_t handle) {
     (void) ctx;
@@ -122,15 +47,16 @@ static GglError rpc_read(void *ctx, GglMap params, uint32_t handle) {
         return err;
     }
 
-    static uint8_t object_decode_memory[GGCONFIGD_MAX_OBJECT_DECODE_BYTES];
-    GglBumpAlloc object_alloc
-        = ggl_bump_alloc_init(GGL_BUF(object_decode_memory));
-    decode_object_destructive(&value, &object_alloc);
-
     ggl_respond(handle, value);
     return GGL_ERR_OK;
 }
 
+static void subscription_close(void *ctx, uint32_t handle) {
+    (void) ctx;
+    subscriber_index_remove(handle);
+    notify_debounce_remove(handle);
+}
+
 static GglError rpc_subscribe(void *ctx, GglMap params, uint32_t handle) {
     (void) ctx;
 
@@ -149,50 +75,52 @@ static GglError rpc_subscribe(void *ctx, GglMap params, uint32_t handle) {
         return GGL_ERR_RANGE;
     }
 
+    uint32_t debounce_ms = 0;
+    GglObject *debounce_obj;
+    if (ggl_map_get(params, GGL_STR("debounce_ms"), &debounce_obj)) {
+        if ((debounce_obj->type != GGL_TYPE_I64) || (debounce_obj->i64 < 0)
+            || (debounce_obj->i64 > UINT32_MAX)) {
+            GGL_LOGE("subscribe received invalid debounce_ms argument.");
+            return GGL_ERR_INVALID;
+        }
+        debounce_ms = (uint32_t) debounce_obj->i64;
+    }
+
     ret = ggconfig_get_key_notification(&key_path->list, handle);
     if (ret != GGL_ERR_OK) {
         return ret;
     }
 
-    ggl_sub_accept(handle, NULL, NULL);
+    if (debounce_ms > 0) {
+        ret = notify_debounce_add(handle, debounce_ms);
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGW("Notifications to %u will not be debounced.", handle);
+        }
+    }
+
+    ggl_sub_accept(handle, subscription_close, NULL);
     return GGL_ERR_OK;
 }
 
 GglError process_nonmap(
     GglObjVec *key_path, GglObject value, int64_t timestamp
 ) {
-    uint8_t value_string[1024] = { 0 };
-    GglBuffer value_buffer
-        = { .data = value_string, .len = sizeof(value_string) };
-    GGL_LOGT("Starting json encode.");
-    GglError error = ggl_json_encode(value, &value_buffer);
-    if (error != GGL_ERR_OK) {
-        GGL_LOGE(
-            "Json encode failed for key %s.", print_key_path(&key_path->list)
-        );
-        return error;
-    }
     GGL_LOGT("Writing value.");
-    error = ggconfig_write_value_at_key(
-        &key_path->list, &value_buffer, timestamp
-    );
+    GglError error
+        = ggconfig_write_value_at_key(&key_path->list, value, timestamp);
     if (error != GGL_ERR_OK) {
         return error;
     }
 
     GGL_LOGT(
-        "Wrote %s = %.*s %" PRId64,
+        "Wrote %s with type %d %" PRId64,
         print_key_path(&key_path->list),
-        (int) value_buffer.len,
-        value_buffer.data,
+        (int) value.type,
         timestamp
     );
     return GGL_ERR_OK;
 }
 
-// TODO: This processing of maps should probably happen in the db_interface
-// layer so that merges can be made atomic. Currently it's possible for a subset
-// of the writes in a merge to fail while the rest succeed.
 // NOLINTNEXTLINE(misc-no-recursion)
 GglError process_map(GglObjVec *key_path, GglMap *the_map, int64_t timestamp) {
     GglError error = GGL_ERR_OK;
@@ -220,6 +148,27 @@ GglError process_map(GglObjVec *key_path, GglMap *the_map, int64_t timestamp) {
     return error;
 }
 
+GglError process_write(
+    GglObjVec *key_path, GglObject value, int64_t timestamp
+) {
+    GglError error = ggconfig_write_begin();
+    if (error != GGL_ERR_OK) {
+        return error;
+    }
+
+    if (value.type == GGL_TYPE_MAP) {
+        error = process_map(key_path, &value.map, timestamp);
+    } else {
+        error = process_nonmap(key_path, value, timestamp);
+    }
+    if (error != GGL_ERR_OK) {
+        ggconfig_write_rollback();
+        return error;
+    }
+
+    return ggconfig_write_commit();
+}
+
 static GglError rpc_write(void *ctx, GglMap params, uint32_t handle) {
     (void) ctx;
 
@@ -262,28 +211,100 @@ static GglError rpc_write(void *ctx, GglMap params, uint32_t handle) {
     }
     GGL_LOGD("Timestamp %." PRId64, timestamp);
 
-    if (value_obj->type == GGL_TYPE_MAP) {
-        GglError error = process_map(&key_path, &value_obj->map, timestamp);
-        if (error != GGL_ERR_OK) {
-            return error;
-        }
-    } else {
-        GglError error = process_nonmap(&key_path, *value_obj, timestamp);
-        if (error != GGL_ERR_OK) {
-            return error;
-        }
+    ret = process_write(&key_path, *value_obj, timestamp);
+    if (ret != GGL_ERR_OK) {
+        return ret;
     }
 
     ggl_respond(handle, GGL_OBJ_NULL());
     return GGL_ERR_OK;
 }
 
+/// Take the snapshot file passed by the client, which must be a regular file.
+/// ggconfigd does not open snapshot paths itself, so a client can only export
+/// to or import from files it can open.
+static GglError take_snapshot_fd(uint32_t handle, int *fd) {
+    int snapshot_fd = -1;
+    GglError ret = ggl_take_request_fd(handle, &snapshot_fd);
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGE("Snapshot file not passed with request.");
+        return GGL_ERR_INVALID;
+    }
+
+    struct stat st;
+    if ((fstat(snapshot_fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+        GGL_LOGE("Snapshot fd is not a regular file.");
+        ggl_close(snapshot_fd);
+        return GGL_ERR_INVALID;
+    }
+
+    *fd = snapshot_fd;
+    return GGL_ERR_OK;
+}
+
+static GglError rpc_export(void *ctx, GglMap params, uint32_t handle) {
+    (void) ctx;
+    (void) params;
+
+    int fd = -1;
+    GglError ret = take_snapshot_fd(handle, &fd);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    GGL_CLEANUP(cleanup_close, fd);
+
+    ret = ggconfig_export_snapshot(fd);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    ret = ggl_fsync(fd);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    GGL_LOGI("Exported configuration.");
+    ggl_respond(handle, GGL_OBJ_NULL());
+    return GGL_ERR_OK;
+}
+
+static GglError rpc_import(void *ctx, GglMap params, uint32_t handle) {
+    (void) ctx;
+    (void) params;
+
+    int fd = -1;
+    GglError ret = take_snapshot_fd(handle, &fd);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    GGL_CLEANUP(cleanup_close, fd);
+
+    ret = ggconfig_import_snapshot(fd);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    // Imported keys have new ids, so subscribers must subscribe again.
+    subscriber_index_close_all();
+
+    GGL_LOGI("Imported configuration.");
+    ggl_respond(handle, GGL_OBJ_NULL());
+    return GGL_ERR_OK;
+}
+
 void ggconfigd_start_server(void) {
     GglRpcMethodDesc handlers[]
-        = { { GGL_STR("read"), false, rpc_read, NULL },
-            { GGL_STR("write"), false, rpc_write, NULL },
-            { GGL_STR("subscribe"), true, rpc_subscribe, NULL } };
+        = { { GGL_STR("read"), false, rpc_read, NULL, false },
+            { GGL_STR("write"), false, rpc_write, NULL, false },
+            { GGL_STR("subscribe"), true, rpc_subscribe, NULL, false },
+            { GGL_STR("export"), false, rpc_export, NULL, false },
+            { GGL_STR("import"), false, rpc_import, NULL, false } };
     size_t handlers_len = sizeof(handlers) / sizeof(handlers[0]);
 
-    ggl_listen(GGL_STR("gg_config"), handlers, handlers_len);
+    notify_debounce_start();
+    // Handlers share the database connection and are run one at a time, but
+    // requests are received and decoded in parallel, so a client that is slow
+    // to send does not hold up the others.
+    ggl_listen_threaded(
+        GGL_STR("gg_config"), handlers, handlers_len, GGL_COREBUS_MAX_WORKERS
+    );
 }
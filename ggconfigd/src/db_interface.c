@@ -2,17 +2,24 @@
 // Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
 // SPDX-License-Identifier: Apache-2.0
 
+#include "checkpointer.h"
+#include "config_cache.h"
 #include "embeds.h"
 #include "ggconfigd.h"
 #include "ggl/alloc.h"
 #include "helpers.h"
+#include "notify_debounce.h"
+#include "snapshot.h"
+#include "subscriber_index.h"
 #include <ggl/buffer.h>
 #include <ggl/bump_alloc.h>
 #include <ggl/cleanup.h>
 #include <ggl/constants.h>
 #include <ggl/core_bus/constants.h>
+#include <ggl/core_bus/object_serde.h>
 #include <ggl/core_bus/server.h>
 #include <ggl/error.h>
+#include <ggl/json_decode.h>
 #include <ggl/log.h>
 #include <ggl/object.h>
 #include <ggl/vector.h>
@@ -20,6 +27,7 @@
 #include <sqlite3.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 static inline void cleanup_sqlite3_finalize(sqlite3_stmt **p) {
     if (*p != NULL) {
@@ -27,16 +35,345 @@ static inline void cleanup_sqlite3_finalize(sqlite3_stmt **p) {
     }
 }
 
+static inline void cleanup_sqlite3_reset(sqlite3_stmt **p) {
+    if (*p != NULL) {
+        sqlite3_reset(*p);
+        sqlite3_clear_bindings(*p);
+    }
+}
+
 static bool config_initialized = false;
 static sqlite3 *config_database;
 static const char *config_database_name = "config.db";
 
+// sqlite's defaults: a 2 MB page cache and no mmap I/O.
+static const GgconfigdDbProfile DB_PROFILE_FULL
+    = { .durability = GGCONFIGD_DURABILITY_FULL,
+        .mmap_size = 0,
+        .cache_size_kib = 2000 };
+// Configurations are small, so the whole database fits in the mmap window.
+static const GgconfigdDbProfile DB_PROFILE_WAL
+    = { .durability = GGCONFIGD_DURABILITY_WAL,
+        .mmap_size = 16 * 1024 * 1024,
+        .cache_size_kib = 4096 };
+static GgconfigdDbProfile db_profile = DB_PROFILE_FULL;
+
+// Statements are prepared once per open database and reused; each user resets
+// its statement on scope exit with cleanup_sqlite3_reset. A cached statement
+// can only be stepped by one user at a time, so callers must not recurse while
+// holding one.
+#undef EMBED_FILE
+#define EMBED_FILE(file, symbol) symbol##_STMT,
+typedef enum {
+    EMBED_FILE_LIST
+    GGL_SQL_STMT_COUNT
+} GglSqlStmt;
+#undef EMBED_FILE
+
+#define EMBED_FILE(file, symbol) symbol,
+static const char *const stmt_sql[GGL_SQL_STMT_COUNT] = { EMBED_FILE_LIST };
+#undef EMBED_FILE
+
+static sqlite3_stmt *stmt_cache[GGL_SQL_STMT_COUNT];
+
+static sqlite3_stmt *get_stmt(GglSqlStmt id) {
+    if (stmt_cache[id] == NULL) {
+        int rc = sqlite3_prepare_v3(
+            config_database,
+            stmt_sql[id],
+            -1,
+            SQLITE_PREPARE_PERSISTENT,
+            &stmt_cache[id],
+            NULL
+        );
+        if (rc != SQLITE_OK) {
+            GGL_LOGE(
+                "Failed to prepare statement %d: %s",
+                (int) id,
+                sqlite3_errmsg(config_database)
+            );
+            stmt_cache[id] = NULL;
+        }
+    }
+    return stmt_cache[id];
+}
+
+static void stmt_cache_clear(void) {
+    for (size_t i = 0; i < GGL_SQL_STMT_COUNT; i++) {
+        sqlite3_finalize(stmt_cache[i]);
+        stmt_cache[i] = NULL;
+    }
+}
+
 static void sqlite_logger(void *ctx, int err_code, const char *str) {
     (void) ctx;
     (void) err_code;
     GGL_LOGE("sqlite: %s", str);
 }
 
+// Type of a stored value, kept in the type column of valueTable. These values
+// are part of the database format.
+typedef enum {
+    STORED_TYPE_NULL = 0,
+    STORED_TYPE_BOOLEAN = 1,
+    STORED_TYPE_I64 = 2,
+    STORED_TYPE_F64 = 3,
+    STORED_TYPE_BUF = 4,
+    STORED_TYPE_LIST = 5,
+} StoredValueType;
+
+/// Bind value's type to parameter type_param and value to the next parameter.
+/// Scalars are stored as sqlite values and lists in the core bus object
+/// encoding; maps are stored as keys, not values.
+static GglError bind_value(
+    sqlite3_stmt *stmt, int type_param, GglObject value
+) {
+    static uint8_t value_encode_mem[GGL_COREBUS_MAX_MSG_LEN];
+    int value_param = type_param + 1;
+
+    switch (value.type) {
+    case GGL_TYPE_NULL:
+        sqlite3_bind_int(stmt, type_param, STORED_TYPE_NULL);
+        sqlite3_bind_null(stmt, value_param);
+        return GGL_ERR_OK;
+    case GGL_TYPE_BOOLEAN:
+        sqlite3_bind_int(stmt, type_param, STORED_TYPE_BOOLEAN);
+        sqlite3_bind_int(stmt, value_param, value.boolean ? 1 : 0);
+        return GGL_ERR_OK;
+    case GGL_TYPE_I64:
+        sqlite3_bind_int(stmt, type_param, STORED_TYPE_I64);
+        sqlite3_bind_int64(stmt, value_param, value.i64);
+        return GGL_ERR_OK;
+    case GGL_TYPE_F64:
+        sqlite3_bind_int(stmt, type_param, STORED_TYPE_F64);
+        sqlite3_bind_double(stmt, value_param, value.f64);
+        return GGL_ERR_OK;
+    case GGL_TYPE_BUF:
+        sqlite3_bind_int(stmt, type_param, STORED_TYPE_BUF);
+        sqlite3_bind_text(
+            stmt,
+            value_param,
+            (char *) value.buf.data,
+            (int) value.buf.len,
+            SQLITE_STATIC
+        );
+        return GGL_ERR_OK;
+    case GGL_TYPE_LIST: {
+        GglBuffer encoded = GGL_BUF(value_encode_mem);
+        GglError ret = ggl_serialize(value, NULL, &encoded);
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGE("Failed to encode list value.");
+            return ret;
+        }
+        sqlite3_bind_int(stmt, type_param, STORED_TYPE_LIST);
+        sqlite3_bind_blob(
+            stmt,
+            value_param,
+            encoded.data,
+            (int) encoded.len,
+            SQLITE_STATIC
+        );
+        return GGL_ERR_OK;
+    }
+    case GGL_TYPE_MAP:
+        break;
+    }
+    GGL_LOGE("Can not store a value of type %d.", (int) value.type);
+    return GGL_ERR_INVALID;
+}
+
+static GglError copy_column_text(
+    sqlite3_stmt *stmt, int column, GglAlloc *alloc, GglBuffer *out
+) {
+    const uint8_t *text = sqlite3_column_text(stmt, column);
+    size_t len = (size_t) sqlite3_column_bytes(stmt, column);
+    uint8_t *mem = GGL_ALLOCN(alloc, uint8_t, len);
+    if (mem == NULL) {
+        return GGL_ERR_NOMEM;
+    }
+    memcpy(mem, text, len);
+    *out = (GglBuffer) { .data = mem, .len = len };
+    return GGL_ERR_OK;
+}
+
+/// Read a value stored by bind_value from column type_col and the next column,
+/// copying its data into alloc.
+static GglError column_value(
+    sqlite3_stmt *stmt, int type_col, GglAlloc *alloc, GglObject *value
+) {
+    int value_col = type_col + 1;
+
+    switch (sqlite3_column_int(stmt, type_col)) {
+    case STORED_TYPE_NULL:
+        *value = GGL_OBJ_NULL();
+        return GGL_ERR_OK;
+    case STORED_TYPE_BOOLEAN:
+        *value = GGL_OBJ_BOOL(sqlite3_column_int(stmt, value_col) != 0);
+        return GGL_ERR_OK;
+    case STORED_TYPE_I64:
+        *value = GGL_OBJ_I64(sqlite3_column_int64(stmt, value_col));
+        return GGL_ERR_OK;
+    case STORED_TYPE_F64:
+        *value = GGL_OBJ_F64(sqlite3_column_double(stmt, value_col));
+        return GGL_ERR_OK;
+    case STORED_TYPE_BUF: {
+        GglBuffer buf;
+        GglError ret = copy_column_text(stmt, value_col, alloc, &buf);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        *value = GGL_OBJ_BUF(buf);
+        return GGL_ERR_OK;
+    }
+    case STORED_TYPE_LIST: {
+        GglBuffer encoded = {
+            .data = (uint8_t *) sqlite3_column_blob(stmt, value_col),
+            .len = (size_t) sqlite3_column_bytes(stmt, value_col),
+        };
+        GglError ret = ggl_deserialize(alloc, true, NULL, encoded, value);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        if (value->type != GGL_TYPE_LIST) {
+            GGL_LOGE(
+                "Stored list value decoded to type %d.", (int) value->type
+            );
+            return GGL_ERR_PARSE;
+        }
+        return GGL_ERR_OK;
+    }
+    default:
+        break;
+    }
+    GGL_LOGE(
+        "Unknown stored value type %d.", sqlite3_column_int(stmt, type_col)
+    );
+    return GGL_ERR_PARSE;
+}
+
+static GglError cache_load_keys(void) {
+    static uint8_t value_mem[GGL_COREBUS_MAX_MSG_LEN];
+    sqlite3_stmt *stmt = get_stmt(GGL_SQL_GET_ALL_KEYS_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, stmt);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        GglBuffer key;
+        key.data = (uint8_t *) sqlite3_column_text(stmt, 2);
+        key.len = (size_t) sqlite3_column_bytes(stmt, 2);
+
+        GglObject value;
+        GglObject *value_ptr = NULL;
+        if (sqlite3_column_type(stmt, 3) != SQLITE_NULL) {
+            GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(value_mem));
+            GglError ret = column_value(stmt, 3, &balloc.alloc, &value);
+            if (ret != GGL_ERR_OK) {
+                return ret;
+            }
+            value_ptr = &value;
+        }
+
+        GglError ret = config_cache_load_key(
+            sqlite3_column_int64(stmt, 0),
+            sqlite3_column_int64(stmt, 1),
+            key,
+            value_ptr
+        );
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+    if (rc != SQLITE_DONE) {
+        GGL_LOGE(
+            "Failed to read keys for cache: %s", sqlite3_errmsg(config_database)
+        );
+        return GGL_ERR_FAILURE;
+    }
+    return GGL_ERR_OK;
+}
+
+static void cache_load(void) {
+    config_cache_clear();
+    sqlite3_exec(config_database, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    GglError ret = cache_load_keys();
+    sqlite3_exec(config_database, "END TRANSACTION", NULL, NULL, NULL);
+    config_cache_load_done(ret);
+}
+
+bool ggconfig_db_profile_from_name(
+    GglBuffer name, GgconfigdDbProfile *profile
+) {
+    if (ggl_buffer_eq(name, GGL_STR("full"))) {
+        *profile = DB_PROFILE_FULL;
+        return true;
+    }
+    if (ggl_buffer_eq(name, GGL_STR("wal"))) {
+        *profile = DB_PROFILE_WAL;
+        return true;
+    }
+    return false;
+}
+
+void ggconfig_set_db_profile(GgconfigdDbProfile profile) {
+    db_profile = profile;
+}
+
+static int journal_mode_callback(
+    void *ctx, int columns, char **values, char **names
+) {
+    (void) names;
+    bool *wal_active = ctx;
+    *wal_active = (columns == 1) && (values[0] != NULL)
+        && (strcmp(values[0], "wal") == 0);
+    return 0;
+}
+
+// The journal mode is stored in the database file, so it is set for both
+// profiles to switch a database back from WAL.
+static void apply_db_profile(void) {
+    bool use_wal = db_profile.durability == GGCONFIGD_DURABILITY_WAL;
+    bool wal_active = false;
+    sqlite3_exec(
+        config_database,
+        use_wal ? "PRAGMA journal_mode=WAL" : "PRAGMA journal_mode=DELETE",
+        journal_mode_callback,
+        &wal_active,
+        NULL
+    );
+    if (use_wal && !wal_active) {
+        GGL_LOGW(
+            "Could not enable the write-ahead log; using the rollback journal."
+        );
+    }
+
+    char pragmas[256];
+    // NOLINTNEXTLINE(cert-err33-c)
+    snprintf(
+        pragmas,
+        sizeof(pragmas),
+        "PRAGMA synchronous=%s; PRAGMA mmap_size=%" PRId64
+        "; PRAGMA cache_size=-%" PRId64 "; PRAGMA wal_autocheckpoint=%d;",
+        wal_active ? "NORMAL" : "FULL",
+        db_profile.mmap_size,
+        db_profile.cache_size_kib,
+        GGCONFIGD_WAL_AUTOCHECKPOINT_PAGES
+    );
+    char *err_message = NULL;
+    int rc = sqlite3_exec(config_database, pragmas, NULL, NULL, &err_message);
+    if (rc != SQLITE_OK) {
+        GGL_LOGW("Failed to tune configuration database: %s", err_message);
+        sqlite3_free(err_message);
+    }
+
+    if (wal_active) {
+        GGL_LOGI("Configuration database is using the write-ahead log.");
+        GglError ret = checkpointer_start(config_database_name);
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGW("Write-ahead log will only be checkpointed on commit.");
+        }
+    }
+}
+
 /// create the database to the correct schema
 static GglError create_database(void) {
     GGL_LOGI("Initializing new configuration database.");
@@ -51,6 +388,130 @@ static GglError create_database(void) {
     return GGL_ERR_OK;
 }
 
+static GglError get_database_version(GglBuffer *version) {
+    static uint8_t version_mem[16];
+
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(config_database, GGL_SQL_GET_VERSION, -1, &stmt, NULL);
+    GGL_CLEANUP(cleanup_sqlite3_finalize, stmt);
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        GGL_LOGE(
+            "Failed to read configuration database version: %s",
+            sqlite3_errmsg(config_database)
+        );
+        return GGL_ERR_FAILURE;
+    }
+
+    GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(version_mem));
+    GglError ret = copy_column_text(stmt, 0, &balloc.alloc, version);
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGE("Unexpected configuration database version.");
+    }
+    return ret;
+}
+
+/// Move values stored as json text by database version 0.1 into the typed
+/// valueTable.
+static GglError migrate_json_values(void) {
+    static uint8_t value_mem[GGL_COREBUS_MAX_MSG_LEN];
+
+    sqlite3_stmt *read_stmt;
+    sqlite3_prepare_v2(
+        config_database, GGL_SQL_GET_JSON_VALUES, -1, &read_stmt, NULL
+    );
+    GGL_CLEANUP(cleanup_sqlite3_finalize, read_stmt);
+
+    int rc;
+    while ((rc = sqlite3_step(read_stmt)) == SQLITE_ROW) {
+        int64_t key_id = sqlite3_column_int64(read_stmt, 0);
+
+        GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(value_mem));
+        GglBuffer json;
+        GglObject value;
+        GglError ret = copy_column_text(read_stmt, 1, &balloc.alloc, &json);
+        if (ret == GGL_ERR_OK) {
+            ret = ggl_json_decode_destructive(json, &balloc.alloc, &value);
+        }
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGE("Failed to decode value of key id %" PRId64 ".", key_id);
+            return ret;
+        }
+
+        sqlite3_stmt *insert_stmt = get_stmt(GGL_SQL_VALUE_INSERT_STMT);
+        GGL_CLEANUP(cleanup_sqlite3_reset, insert_stmt);
+        sqlite3_bind_int64(insert_stmt, 1, key_id);
+        ret = bind_value(insert_stmt, 2, value);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        sqlite3_bind_int64(
+            insert_stmt, 4, sqlite3_column_int64(read_stmt, 2)
+        );
+        if (sqlite3_step(insert_stmt) != SQLITE_DONE) {
+            GGL_LOGE(
+                "Failed to migrate value of key id %" PRId64 ": %s",
+                key_id,
+                sqlite3_errmsg(config_database)
+            );
+            return GGL_ERR_FAILURE;
+        }
+    }
+    if (rc != SQLITE_DONE) {
+        GGL_LOGE(
+            "Failed to read values to migrate: %s",
+            sqlite3_errmsg(config_database)
+        );
+        return GGL_ERR_FAILURE;
+    }
+    return GGL_ERR_OK;
+}
+
+/// Bring a database created by an older version to the current schema. Each
+/// migration is applied in a single transaction.
+static GglError migrate_database(void) {
+    GglBuffer version;
+    GglError ret = get_database_version(&version);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    if (ggl_buffer_eq(version, GGL_STR("0.2"))) {
+        return GGL_ERR_OK;
+    }
+    if (!ggl_buffer_eq(version, GGL_STR("0.1"))) {
+        GGL_LOGE(
+            "Unsupported configuration database version %.*s.",
+            (int) version.len,
+            version.data
+        );
+        return GGL_ERR_UNSUPPORTED;
+    }
+
+    GGL_LOGI("Migrating configuration database to typed values.");
+    sqlite3_exec(
+        config_database, "BEGIN IMMEDIATE TRANSACTION", NULL, NULL, NULL
+    );
+    int rc = sqlite3_exec(
+        config_database, GGL_SQL_MIGRATE_TYPED_VALUES, NULL, NULL, NULL
+    );
+    ret = (rc == SQLITE_OK) ? migrate_json_values() : GGL_ERR_FAILURE;
+    if (ret == GGL_ERR_OK) {
+        rc = sqlite3_exec(
+            config_database, GGL_SQL_FINISH_TYPED_VALUES, NULL, NULL, NULL
+        );
+        ret = (rc == SQLITE_OK) ? GGL_ERR_OK : GGL_ERR_FAILURE;
+    }
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGE(
+            "Failed to migrate configuration database: %s",
+            sqlite3_errmsg(config_database)
+        );
+        sqlite3_exec(config_database, "ROLLBACK", NULL, NULL, NULL);
+        return ret;
+    }
+    sqlite3_exec(config_database, "END TRANSACTION", NULL, NULL, NULL);
+    return GGL_ERR_OK;
+}
+
 GglError ggconfig_open(void) {
     GglError return_err = GGL_ERR_FAILURE;
     if (config_initialized == false) {
@@ -70,6 +531,9 @@ GglError ggconfig_open(void) {
             return_err = GGL_ERR_FAILURE;
         } else {
             GGL_LOGI("Config database Opened");
+            // Checkpoints lock out writes while they run
+            sqlite3_busy_timeout(config_database, GGCONFIGD_BUSY_TIMEOUT_MS);
+            apply_db_profile();
 
             sqlite3_stmt *stmt;
             sqlite3_prepare_v2(
@@ -79,7 +543,14 @@ GglError ggconfig_open(void) {
 
             if (sqlite3_step(stmt) == SQLITE_ROW) {
                 GGL_LOGI("found keyTable");
-                return_err = GGL_ERR_OK;
+                // Finish this read so the migration can drop tables
+                sqlite3_reset(stmt);
+                return_err = migrate_database();
+                if (return_err != GGL_ERR_OK) {
+                    stmt_cache_clear();
+                    sqlite3_close(config_database);
+                    return return_err;
+                }
             } else {
                 return_err = create_database();
                 char *err_message = 0;
@@ -101,17 +572,8 @@ GglError ggconfig_open(void) {
                 }
             }
         }
-        // create a temporary table for subscriber data
-        char *err_message = 0;
-        rc = sqlite3_exec(
-            config_database, GGL_SQL_CREATE_SUB_TABLE, NULL, NULL, &err_message
-        );
-        if (rc) {
-            GGL_LOGE("Failed to create temporary table %s", err_message);
-            sqlite3_free(err_message);
-            return_err = GGL_ERR_FAILURE;
-        }
         config_initialized = true;
+        cache_load();
     } else {
         return_err = GGL_ERR_OK;
     }
@@ -119,6 +581,8 @@ GglError ggconfig_open(void) {
 }
 
 GglError ggconfig_close(void) {
+    config_cache_clear();
+    stmt_cache_clear();
     sqlite3_close(config_database);
     config_initialized = false;
     return GGL_ERR_OK;
@@ -126,11 +590,8 @@ GglError ggconfig_close(void) {
 
 static GglError key_insert(GglBuffer *key, int64_t *id_output) {
     GGL_LOGD("insert %.*s", (int) key->len, (char *) key->data);
-    sqlite3_stmt *key_insert_stmt;
-    sqlite3_prepare_v2(
-        config_database, GGL_SQL_KEY_INSERT, -1, &key_insert_stmt, NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, key_insert_stmt);
+    sqlite3_stmt *key_insert_stmt = get_stmt(GGL_SQL_KEY_INSERT_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, key_insert_stmt);
     sqlite3_bind_text(
         key_insert_stmt, 1, (char *) key->data, (int) key->len, SQLITE_STATIC
     );
@@ -155,11 +616,8 @@ static GglError value_is_present_for_key(
 ) {
     GGL_LOGD("Checking id %" PRId64, key_id);
 
-    sqlite3_stmt *find_value_stmt;
-    sqlite3_prepare_v2(
-        config_database, GGL_SQL_VALUE_PRESENT, -1, &find_value_stmt, NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, find_value_stmt);
+    sqlite3_stmt *find_value_stmt = get_stmt(GGL_SQL_VALUE_PRESENT_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, find_value_stmt);
     sqlite3_bind_int64(find_value_stmt, 1, key_id);
     int rc = sqlite3_step(find_value_stmt);
     if (rc == SQLITE_ROW) {
@@ -197,15 +655,9 @@ static GglError find_key_with_parent(
         key->data,
         parent_key_id
     );
-    sqlite3_stmt *find_element_stmt;
-    sqlite3_prepare_v2(
-        config_database,
-        GGL_SQL_GET_KEY_WITH_PARENT,
-        -1,
-        &find_element_stmt,
-        NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, find_element_stmt);
+    sqlite3_stmt *find_element_stmt
+        = get_stmt(GGL_SQL_GET_KEY_WITH_PARENT_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, find_element_stmt);
     sqlite3_bind_text(
         find_element_stmt, 1, (char *) key->data, (int) key->len, SQLITE_STATIC
     );
@@ -248,11 +700,8 @@ static GglError get_or_create_key_at_root(GglBuffer *key, int64_t *id_output) {
     GGL_LOGD("Checking %.*s", (int) key->len, (char *) key->data);
     int64_t id = 0;
 
-    sqlite3_stmt *root_check_stmt;
-    sqlite3_prepare_v2(
-        config_database, GGL_SQL_GET_ROOT_KEY, -1, &root_check_stmt, NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, root_check_stmt);
+    sqlite3_stmt *root_check_stmt = get_stmt(GGL_SQL_GET_ROOT_KEY_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, root_check_stmt);
     sqlite3_bind_text(
         root_check_stmt, 1, (char *) key->data, (int) key->len, SQLITE_STATIC
     );
@@ -280,15 +729,8 @@ static GglError get_or_create_key_at_root(GglBuffer *key, int64_t *id_output) {
 }
 
 static GglError relation_insert(int64_t id, int64_t parent) {
-    sqlite3_stmt *relation_insert_stmt;
-    sqlite3_prepare_v2(
-        config_database,
-        GGL_SQL_INSERT_RELATION,
-        -1,
-        &relation_insert_stmt,
-        NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, relation_insert_stmt);
+    sqlite3_stmt *relation_insert_stmt = get_stmt(GGL_SQL_INSERT_RELATION_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, relation_insert_stmt);
     sqlite3_bind_int64(relation_insert_stmt, 1, id);
     sqlite3_bind_int64(relation_insert_stmt, 2, parent);
     int rc = sqlite3_step(relation_insert_stmt);
@@ -306,23 +748,17 @@ static GglError relation_insert(int64_t id, int64_t parent) {
 }
 
 static GglError value_insert(
-    int64_t key_id, GglBuffer *value, int64_t timestamp
+    int64_t key_id, GglObject value, int64_t timestamp
 ) {
     GglError return_err = GGL_ERR_FAILURE;
-    sqlite3_stmt *value_insert_stmt;
-    sqlite3_prepare_v2(
-        config_database, GGL_SQL_VALUE_INSERT, -1, &value_insert_stmt, NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, value_insert_stmt);
+    sqlite3_stmt *value_insert_stmt = get_stmt(GGL_SQL_VALUE_INSERT_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, value_insert_stmt);
     sqlite3_bind_int64(value_insert_stmt, 1, key_id);
-    sqlite3_bind_text(
-        value_insert_stmt,
-        2,
-        (char *) value->data,
-        (int) value->len,
-        SQLITE_STATIC
-    );
-    sqlite3_bind_int64(value_insert_stmt, 3, timestamp);
+    GglError ret = bind_value(value_insert_stmt, 2, value);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    sqlite3_bind_int64(value_insert_stmt, 4, timestamp);
     int rc = sqlite3_step(value_insert_stmt);
     if (rc == SQLITE_DONE || rc == SQLITE_OK) {
         GGL_LOGD("value insert successful");
@@ -339,24 +775,18 @@ static GglError value_insert(
 }
 
 static GglError value_update(
-    int64_t key_id, GglBuffer *value, int64_t timestamp
+    int64_t key_id, GglObject value, int64_t timestamp
 ) {
     GglError return_err = GGL_ERR_FAILURE;
 
-    sqlite3_stmt *update_value_stmt;
-    sqlite3_prepare_v2(
-        config_database, GGL_SQL_VALUE_UPDATE, -1, &update_value_stmt, NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, update_value_stmt);
-    sqlite3_bind_text(
-        update_value_stmt,
-        1,
-        (char *) value->data,
-        (int) value->len,
-        SQLITE_STATIC
-    );
-    sqlite3_bind_int64(update_value_stmt, 2, timestamp);
-    sqlite3_bind_int64(update_value_stmt, 3, key_id);
+    sqlite3_stmt *update_value_stmt = get_stmt(GGL_SQL_VALUE_UPDATE_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, update_value_stmt);
+    GglError ret = bind_value(update_value_stmt, 1, value);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    sqlite3_bind_int64(update_value_stmt, 3, timestamp);
+    sqlite3_bind_int64(update_value_stmt, 4, key_id);
     int rc = sqlite3_step(update_value_stmt);
     if (rc == SQLITE_DONE || rc == SQLITE_OK) {
         GGL_LOGD("value update successful");
@@ -375,11 +805,8 @@ static GglError value_update(
 static GglError value_get_timestamp(
     int64_t id, int64_t *existing_timestamp_output
 ) {
-    sqlite3_stmt *get_timestamp_stmt;
-    sqlite3_prepare_v2(
-        config_database, GGL_SQL_GET_TIMESTAMP, -1, &get_timestamp_stmt, NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, get_timestamp_stmt);
+    sqlite3_stmt *get_timestamp_stmt = get_stmt(GGL_SQL_GET_TIMESTAMP_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, get_timestamp_stmt);
     sqlite3_bind_int64(get_timestamp_stmt, 1, id);
     int rc = sqlite3_step(get_timestamp_stmt);
     if (rc == SQLITE_ROW) {
@@ -403,11 +830,8 @@ static GglError value_get_timestamp(
 static GglError get_key_ids(GglList *key_path, GglObjVec *key_ids_output) {
     GGL_LOGD("searching for %s", print_key_path(key_path));
 
-    sqlite3_stmt *find_element_stmt;
-    sqlite3_prepare_v2(
-        config_database, GGL_SQL_FIND_ELEMENT, -1, &find_element_stmt, NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, find_element_stmt);
+    sqlite3_stmt *find_element_stmt = get_stmt(GGL_SQL_FIND_ELEMENT_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, find_element_stmt);
 
     for (size_t index = 0; index < key_path->len; index++) {
         GglBuffer *key = &key_path->items[index].buf;
@@ -465,43 +889,51 @@ static GglError get_key_ids(GglList *key_path, GglObjVec *key_ids_output) {
 // undefined if the key_path fully exists already. Thus it should only be used
 // within a transaction and after checking that the key_path does not fully
 // exist.
-// key_ids_output must point to an empty GglObjVec with capacity
-// MAX_KEY_PATH_DEPTH
+// key_ids_output must point to a GglObjVec with capacity GGL_MAX_OBJECT_DEPTH.
+// It may already hold the ids of a prefix of key_path that are known to be
+// maps; creation then resumes after that prefix.
 static GglError create_key_path(GglList *key_path, GglObjVec *key_ids_output) {
-    GglBuffer root_key_buffer = key_path->items[0].buf;
-    int64_t parent_key_id;
-    GglError err = get_or_create_key_at_root(&root_key_buffer, &parent_key_id);
-    if (err != GGL_ERR_OK) {
-        return err;
-    }
-    ggl_obj_vec_push(key_ids_output, GGL_OBJ_I64(parent_key_id));
-    bool value_is_present_for_root_key;
-    err = value_is_present_for_key(
-        parent_key_id, &value_is_present_for_root_key
-    );
-    if (err != GGL_ERR_OK) {
-        GGL_LOGE(
-            "failed to check for value for root key %.*s with id %" PRId64
-            " with error %s",
-            (int) root_key_buffer.len,
-            root_key_buffer.data,
-            parent_key_id,
-            ggl_strerror(err)
-        );
-        return err;
-    }
-    if (value_is_present_for_root_key) {
-        GGL_LOGW(
-            "value already present for root key %.*s with id %" PRId64,
-            (int) root_key_buffer.len,
-            root_key_buffer.data,
-            parent_key_id
+    size_t start = key_ids_output->list.len;
+    if (start == 0) {
+        GglBuffer root_key_buffer = key_path->items[0].buf;
+        int64_t root_key_id;
+        GglError err
+            = get_or_create_key_at_root(&root_key_buffer, &root_key_id);
+        if (err != GGL_ERR_OK) {
+            return err;
+        }
+        ggl_obj_vec_push(key_ids_output, GGL_OBJ_I64(root_key_id));
+        bool value_is_present_for_root_key;
+        err = value_is_present_for_key(
+            root_key_id, &value_is_present_for_root_key
         );
-        return GGL_ERR_FAILURE;
+        if (err != GGL_ERR_OK) {
+            GGL_LOGE(
+                "failed to check for value for root key %.*s with id %" PRId64
+                " with error %s",
+                (int) root_key_buffer.len,
+                root_key_buffer.data,
+                root_key_id,
+                ggl_strerror(err)
+            );
+            return err;
+        }
+        if (value_is_present_for_root_key) {
+            GGL_LOGW(
+                "value already present for root key %.*s with id %" PRId64,
+                (int) root_key_buffer.len,
+                root_key_buffer.data,
+                root_key_id
+            );
+            return GGL_ERR_FAILURE;
+        }
+        start = 1;
     }
 
+    GglError err = GGL_ERR_OK;
+    int64_t parent_key_id = key_ids_output->list.items[start - 1].i64;
     int64_t current_key_id = parent_key_id;
-    for (size_t index = 1; index < key_path->len; index++) {
+    for (size_t index = start; index < key_path->len; index++) {
         GglBuffer current_key_buffer = key_path->items[index].buf;
         err = find_key_with_parent(
             &current_key_buffer, parent_key_id, &current_key_id
@@ -552,11 +984,8 @@ static GglError child_is_present_for_key(
 ) {
     GglError return_err = GGL_ERR_FAILURE;
 
-    sqlite3_stmt *child_check_stmt;
-    sqlite3_prepare_v2(
-        config_database, GGL_SQL_HAS_CHILD, -1, &child_check_stmt, NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, child_check_stmt);
+    sqlite3_stmt *child_check_stmt = get_stmt(GGL_SQL_HAS_CHILD_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, child_check_stmt);
     sqlite3_bind_int64(child_check_stmt, 1, key_id);
     int rc = sqlite3_step(child_check_stmt);
     if (rc == SQLITE_ROW) {
@@ -572,109 +1001,294 @@ static GglError child_is_present_for_key(
     return return_err;
 }
 
-static GglError notify_single_key(
+static void notify_single_key(
     int64_t notify_key_id, GglList *changed_key_path
 ) {
-    // TODO: read this comment copied from the JAVA and ensure this implements a
-    // similar functionality A subscriber is told what Topic changed, but must
-    // look in the Topic to get the new value.  There is no "old value"
-    // provided, although the publish framework endeavors to suppress notifying
-    // when the new value is the same as the old value. Subscribers do not
-    // necessarily get notified on every change.  If a sequence of changes
-    // happen in rapid succession, they may be collapsed into one notification.
-    // This usually happens when a compound change occurs.
-
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(
-        config_database, GGL_SQL_GET_SUBSCRIBERS, -1, &stmt, NULL
+    // A subscriber is told what key changed, and must read it to get the new
+    // value. Changes in one write transaction are collapsed into one
+    // notification per key, and debounced subscriptions further collapse
+    // changes made in rapid succession.
+
+    // Handles are copied out so the index is not locked while responding, as
+    // a failed response closes the subscription.
+    uint32_t handles[GGCONFIGD_MAX_SUBSCRIPTIONS];
+    size_t handles_len = subscriber_index_get(
+        notify_key_id, handles, GGCONFIGD_MAX_SUBSCRIPTIONS
     );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, stmt);
-    sqlite3_bind_int64(stmt, 1, notify_key_id);
-    int rc = 0;
     GGL_LOGD(
-        "notifying subscribers on key with id %" PRId64
+        "notifying %zu subscribers on key with id %" PRId64
         " that key %s has changed",
+        handles_len,
         notify_key_id,
         print_key_path(changed_key_path)
     );
-    do {
-        rc = sqlite3_step(stmt);
-        switch (rc) {
-        case SQLITE_DONE:
-            GGL_LOGD("DONE");
-            break;
-        case SQLITE_ROW: {
-            uint32_t handle = (uint32_t) sqlite3_column_int64(stmt, 0);
-            GGL_LOGD("Sending to %u", handle);
-            ggl_sub_respond(handle, GGL_OBJ_LIST(*changed_key_path));
-        } break;
-        default:
-            GGL_LOGE(
-                "Unexpected rc %d while getting handles to notify for key with "
-                "id %" PRId64 " with error: %s",
-                rc,
-                notify_key_id,
-                sqlite3_errmsg(config_database)
-            );
-            return GGL_ERR_FAILURE;
-            break;
-        }
-    } while (rc == SQLITE_ROW);
+    for (size_t i = 0; i < handles_len; i++) {
+        GGL_LOGD("Sending to %u", handles[i]);
+        notify_subscriber(handles[i], changed_key_path);
+    }
+}
 
-    return GGL_ERR_OK;
+// State of the write transaction currently in progress. Every leaf write
+// happens inside one; ggconfig_write_value_at_key opens an implicit
+// single-write transaction when no batch is active.
+static bool write_batch_active = false;
+
+// Ids of the intermediate keys of the previous write in the batch. Writes of a
+// map visit its leaves depth first, so consecutive leaves share most of their
+// path and only the keys past the shared prefix need to be looked up. Keys are
+// copied, as callers may reuse their key path memory between writes.
+static GglBuffer prefix_cache_keys[GGL_MAX_OBJECT_DEPTH];
+static int64_t prefix_cache_ids[GGL_MAX_OBJECT_DEPTH];
+static uint8_t prefix_cache_mem[GGCONFIGD_KEY_PATH_BYTES];
+static size_t prefix_cache_len = 0;
+
+#define NO_CHANGED_KEY UINT32_MAX
+
+// A key on the path of at least one changed value in the batch. cover is the
+// deepest changed key whose path is a prefix of every change under this key;
+// subscribers of this key are notified once, with the path of cover.
+typedef struct {
+    int64_t key_id;
+    GglBuffer key;
+    uint32_t parent;
+    uint32_t depth;
+    uint32_t cover;
+} ChangedKey;
+
+static ChangedKey changed_keys[GGCONFIGD_MAX_CHANGED_KEYS];
+static uint32_t changed_keys_len = 0;
+static bool changed_keys_overflow = false;
+static uint8_t changed_key_mem[GGCONFIGD_BATCH_KEY_BYTES];
+static size_t changed_key_mem_used = 0;
+
+static void write_batch_reset(void) {
+    write_batch_active = false;
+    prefix_cache_len = 0;
+    changed_keys_len = 0;
+    changed_keys_overflow = false;
+    changed_key_mem_used = 0;
 }
 
-// Given a key path and the ids of the keys in that path, notify each key along
-// the path that the value at the tip of the key path has changed
-static GglError notify_nested_key(GglList *key_path, GglObjVec key_ids) {
-    GglError return_err = GGL_ERR_OK;
-    for (size_t i = 0; i < key_ids.list.len; i++) {
-        GglError err = notify_single_key(key_ids.list.items[i].i64, key_path);
-        if (err != GGL_ERR_OK) {
-            return_err = GGL_ERR_FAILURE;
-        }
+static uint32_t changed_key_lca(uint32_t a, uint32_t b) {
+    while (changed_keys[a].depth > changed_keys[b].depth) {
+        a = changed_keys[a].parent;
     }
-    return return_err;
+    while (changed_keys[b].depth > changed_keys[a].depth) {
+        b = changed_keys[b].parent;
+    }
+    while (a != b) {
+        a = changed_keys[a].parent;
+        b = changed_keys[b].parent;
+    }
+    return a;
 }
 
-GglError ggconfig_write_value_at_key(
-    GglList *key_path, GglBuffer *value, int64_t timestamp
+static uint32_t changed_key_get_or_add(
+    int64_t key_id, GglBuffer key, uint32_t parent, uint32_t depth
 ) {
-    if (config_initialized == false) {
-        return GGL_ERR_FAILURE;
+    // Depth-first writes touch recently added keys; search from the end.
+    for (uint32_t i = changed_keys_len; i > 0; i--) {
+        if (changed_keys[i - 1].key_id == key_id) {
+            return i - 1;
+        }
     }
+    if ((changed_keys_len >= GGCONFIGD_MAX_CHANGED_KEYS)
+        || (key.len > sizeof(changed_key_mem) - changed_key_mem_used)) {
+        return NO_CHANGED_KEY;
+    }
+    uint8_t *key_copy = &changed_key_mem[changed_key_mem_used];
+    memcpy(key_copy, key.data, key.len);
+    changed_key_mem_used += key.len;
+    changed_keys[changed_keys_len] = (ChangedKey) { .key_id = key_id,
+                                                    .key = { .data = key_copy,
+                                                             .len = key.len },
+                                                    .parent = parent,
+                                                    .depth = depth,
+                                                    .cover = NO_CHANGED_KEY };
+    return changed_keys_len++;
+}
 
-    GGL_LOGI(
-        "starting request to insert/update key: %s", print_key_path(key_path)
-    );
-
-    sqlite3_exec(config_database, "BEGIN TRANSACTION", NULL, NULL, NULL);
-
+// Add the value at the tip of key_path to the batch's change set
+static void record_change(GglList *key_path, GglObjVec key_ids) {
+    uint32_t chain[GGL_MAX_OBJECT_DEPTH];
+    uint32_t chain_len = 0;
+    uint32_t parent = NO_CHANGED_KEY;
+    for (size_t i = 0; i < key_ids.list.len; i++) {
+        uint32_t node = changed_key_get_or_add(
+            key_ids.list.items[i].i64,
+            key_path->items[i].buf,
+            parent,
+            (uint32_t) i
+        );
+        if (node == NO_CHANGED_KEY) {
+            if (!changed_keys_overflow) {
+                GGL_LOGW(
+                    "Write changes more than %d keys; notifying %s as a "
+                    "change to its deepest tracked parent.",
+                    GGCONFIGD_MAX_CHANGED_KEYS,
+                    print_key_path(key_path)
+                );
+                changed_keys_overflow = true;
+            }
+            break;
+        }
+        chain[chain_len++] = node;
+        parent = node;
+    }
+    if (chain_len == 0) {
+        return;
+    }
+
+    uint32_t tip = chain[chain_len - 1];
+    for (uint32_t i = 0; i < chain_len; i++) {
+        ChangedKey *changed = &changed_keys[chain[i]];
+        changed->cover = (changed->cover == NO_CHANGED_KEY)
+            ? tip
+            : changed_key_lca(changed->cover, tip);
+    }
+}
+
+static void notify_changes(void) {
+    for (uint32_t i = 0; i < changed_keys_len; i++) {
+        GglObject path_items[GGL_MAX_OBJECT_DEPTH];
+        GglList path = { .items = path_items,
+                         .len = changed_keys[changed_keys[i].cover].depth + 1 };
+        for (uint32_t node = changed_keys[i].cover; node != NO_CHANGED_KEY;
+             node = changed_keys[node].parent) {
+            path_items[changed_keys[node].depth]
+                = GGL_OBJ_BUF(changed_keys[node].key);
+        }
+
+        notify_single_key(changed_keys[i].key_id, &path);
+    }
+}
+
+GglError ggconfig_write_begin(void) {
+    if (config_initialized == false) {
+        return GGL_ERR_FAILURE;
+    }
+    if (write_batch_active) {
+        GGL_LOGE("A config write transaction is already in progress.");
+        return GGL_ERR_FAILURE;
+    }
+
+    // Taking the write lock up front waits out a checkpoint holding it. A
+    // deferred transaction would fail without waiting when its first write
+    // finds its read snapshot outdated by the checkpoint.
+    int rc = sqlite3_exec(
+        config_database, "BEGIN IMMEDIATE TRANSACTION", NULL, NULL, NULL
+    );
+    if (rc != SQLITE_OK) {
+        GGL_LOGE(
+            "Failed to begin write transaction: %s",
+            sqlite3_errmsg(config_database)
+        );
+        return GGL_ERR_FAILURE;
+    }
+    write_batch_reset();
+    write_batch_active = true;
+    return GGL_ERR_OK;
+}
+
+GglError ggconfig_write_commit(void) {
+    if (!write_batch_active) {
+        return GGL_ERR_FAILURE;
+    }
+
+    int rc = sqlite3_exec(config_database, "END TRANSACTION", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        GGL_LOGE(
+            "Failed to commit write transaction: %s",
+            sqlite3_errmsg(config_database)
+        );
+        ggconfig_write_rollback();
+        return GGL_ERR_FAILURE;
+    }
+
+    write_batch_active = false;
+    checkpointer_note_commit();
+    notify_changes();
+    write_batch_reset();
+    return GGL_ERR_OK;
+}
+
+void ggconfig_write_rollback(void) {
+    if (!write_batch_active) {
+        return;
+    }
+    sqlite3_exec(config_database, "ROLLBACK", NULL, NULL, NULL);
+    write_batch_reset();
+    config_cache_invalidate();
+}
+
+// Look up the ids of key_path, resuming after the prefix already in key_ids.
+static GglError get_key_ids_from(GglList *key_path, GglObjVec *key_ids) {
+    if (key_ids->list.len == 0) {
+        return get_key_ids(key_path, key_ids);
+    }
+    for (size_t i = key_ids->list.len; i < key_path->len; i++) {
+        int64_t id;
+        GglError err = find_key_with_parent(
+            &key_path->items[i].buf, key_ids->list.items[i - 1].i64, &id
+        );
+        if (err != GGL_ERR_OK) {
+            return err;
+        }
+        ggl_obj_vec_push(key_ids, GGL_OBJ_I64(id));
+    }
+    return GGL_ERR_OK;
+}
+
+static void prefix_cache_update(GglList *key_path, GglObjVec key_ids) {
+    size_t used = 0;
+    prefix_cache_len = 0;
+    for (size_t i = 0; i < key_path->len - 1; i++) {
+        GglBuffer key = key_path->items[i].buf;
+        if (key.len > sizeof(prefix_cache_mem) - used) {
+            break;
+        }
+        memcpy(&prefix_cache_mem[used], key.data, key.len);
+        prefix_cache_keys[i]
+            = (GglBuffer) { .data = &prefix_cache_mem[used], .len = key.len };
+        prefix_cache_ids[i] = key_ids.list.items[i].i64;
+        used += key.len;
+        prefix_cache_len++;
+    }
+}
+
+static GglError write_value_in_batch(
+    GglList *key_path, GglObject value, int64_t timestamp
+) {
     GglObject ids_array[GGL_MAX_OBJECT_DEPTH];
     GglObjVec ids = { .list = { .items = ids_array, .len = 0 },
                       .capacity = GGL_MAX_OBJECT_DEPTH };
+
+    size_t cached = 0;
+    while ((cached < prefix_cache_len) && (cached < key_path->len - 1)
+           && ggl_buffer_eq(
+               prefix_cache_keys[cached], key_path->items[cached].buf
+           )) {
+        ggl_obj_vec_push(&ids, GGL_OBJ_I64(prefix_cache_ids[cached]));
+        cached++;
+    }
+
     int64_t last_key_id;
-    GglError err = get_key_ids(key_path, &ids);
+    GglError err = get_key_ids_from(key_path, &ids);
     if (err == GGL_ERR_NOENTRY) {
-        ids.list.len = 0; // Reset the ids vector to be populated fresh
+        ids.list.len = cached; // Cached ids are known maps; create the rest
         err = create_key_path(key_path, &ids);
         if (err != GGL_ERR_OK) {
-            sqlite3_exec(config_database, "ROLLBACK", NULL, NULL, NULL);
             return err;
         }
 
         last_key_id = ids.list.items[ids.list.len - 1].i64;
-        value_insert(last_key_id, value, timestamp);
-        sqlite3_exec(config_database, "END TRANSACTION", NULL, NULL, NULL);
-        err = notify_nested_key(key_path, ids);
+        err = value_insert(last_key_id, value, timestamp);
         if (err != GGL_ERR_OK) {
-            GGL_LOGE(
-                "Failed to notify all subscribers about update for key path %s "
-                "with error %s",
-                print_key_path(key_path),
-                ggl_strerror(err)
-            );
+            return err;
         }
+        config_cache_write(key_path, ids.list, value);
+        prefix_cache_update(key_path, ids);
+        record_change(key_path, ids);
         return GGL_ERR_OK;
     }
     if (err != GGL_ERR_OK) {
@@ -683,7 +1297,6 @@ GglError ggconfig_write_value_at_key(
             print_key_path(key_path),
             ggl_strerror(err)
         );
-        sqlite3_exec(config_database, "ROLLBACK", NULL, NULL, NULL);
         return err;
     }
     last_key_id = ids.list.items[ids.list.len - 1].i64;
@@ -697,7 +1310,6 @@ GglError ggconfig_write_value_at_key(
             last_key_id,
             ggl_strerror(err)
         );
-        sqlite3_exec(config_database, "ROLLBACK", NULL, NULL, NULL);
         return err;
     }
     if (child_is_present) {
@@ -707,13 +1319,14 @@ GglError ggconfig_write_value_at_key(
             print_key_path(key_path),
             last_key_id
         );
-        sqlite3_exec(config_database, "ROLLBACK", NULL, NULL, NULL);
         return GGL_ERR_FAILURE;
     }
 
     // we now know that the key already exists and does not have a child.
     // Therefore, it stores a value currently.
 
+    prefix_cache_update(key_path, ids);
+
     int64_t existing_timestamp;
     err = value_get_timestamp(last_key_id, &existing_timestamp);
     if (err != GGL_ERR_OK) {
@@ -724,7 +1337,6 @@ GglError ggconfig_write_value_at_key(
             last_key_id,
             ggl_strerror(err)
         );
-        sqlite3_exec(config_database, "ROLLBACK", NULL, NULL, NULL);
         return err;
     }
     if (existing_timestamp > timestamp) {
@@ -735,7 +1347,6 @@ GglError ggconfig_write_value_at_key(
             existing_timestamp,
             timestamp
         );
-        sqlite3_exec(config_database, "END TRANSACTION", NULL, NULL, NULL);
         return GGL_ERR_OK;
     }
 
@@ -748,147 +1359,180 @@ GglError ggconfig_write_value_at_key(
             last_key_id,
             ggl_strerror(err)
         );
-        sqlite3_exec(config_database, "ROLLBACK", NULL, NULL, NULL);
         return err;
     }
-    sqlite3_exec(config_database, "END TRANSACTION", NULL, NULL, NULL);
-
-    err = notify_nested_key(key_path, ids);
-    if (err != GGL_ERR_OK) {
-        GGL_LOGE(
-            "failed to notify subscribers about update for key path %s with "
-            "error %s",
-            print_key_path(key_path),
-            ggl_strerror(err)
-        );
-    }
+    config_cache_write(key_path, ids.list, value);
+    record_change(key_path, ids);
     return GGL_ERR_OK;
 }
 
-static GglError read_value_at_key(
-    int64_t key_id, GglObject *value, GglAlloc *alloc
+GglError ggconfig_write_value_at_key(
+    GglList *key_path, GglObject value, int64_t timestamp
 ) {
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(config_database, GGL_SQL_READ_VALUE, -1, &stmt, NULL);
-    GGL_CLEANUP(cleanup_sqlite3_finalize, stmt);
-    sqlite3_bind_int64(stmt, 1, key_id);
-    int rc = sqlite3_step(stmt);
-    if (rc == SQLITE_DONE) {
-        GGL_LOGI("no value found for key id %" PRId64, key_id);
-        return GGL_ERR_NOENTRY;
-    }
-    if (rc != SQLITE_ROW) {
-        GGL_LOGE(
-            "failed to read value for key id %" PRId64
-            " with rc %d and error %s",
-            key_id,
-            rc,
-            sqlite3_errmsg(config_database)
-        );
+    if (config_initialized == false) {
         return GGL_ERR_FAILURE;
     }
-    const uint8_t *value_string = sqlite3_column_text(stmt, 0);
-    unsigned long value_length = (unsigned long) sqlite3_column_bytes(stmt, 0);
-    uint8_t *string_buffer = GGL_ALLOCN(alloc, uint8_t, value_length);
-    if (!string_buffer) {
-        GGL_LOGE(
-            "no more memory to allocate value for key id %" PRId64, key_id
-        );
-        return GGL_ERR_NOMEM;
+    if (key_path->len == 0) {
+        GGL_LOGE("Can not write a value without a key.");
+        return GGL_ERR_INVALID;
     }
-    value->type = GGL_TYPE_BUF;
-    value->buf.data = string_buffer;
-    memcpy(string_buffer, value_string, value_length);
-    value->buf.len = value_length;
 
-    GGL_LOGD(
-        "value read: %.*s", (int) value->buf.len, (char *) value->buf.data
+    GGL_LOGI(
+        "starting request to insert/update key: %s", print_key_path(key_path)
     );
-    return GGL_ERR_OK;
-}
 
-/// read_key_recursive will read the map or buffer at key_id and store it into
-/// value.
-// NOLINTNEXTLINE(misc-no-recursion)
-static GglError read_key_recursive(
-    int64_t key_id, GglObject *value, GglAlloc *alloc
-) {
-    GGL_LOGD("reading key id %" PRId64, key_id);
+    if (write_batch_active) {
+        return write_value_in_batch(key_path, value, timestamp);
+    }
 
-    bool value_is_present;
-    GglError err = value_is_present_for_key(key_id, &value_is_present);
+    GglError err = ggconfig_write_begin();
     if (err != GGL_ERR_OK) {
         return err;
     }
-    if (value_is_present) {
-        return read_value_at_key(key_id, value, alloc);
+    err = write_value_in_batch(key_path, value, timestamp);
+    if (err != GGL_ERR_OK) {
+        ggconfig_write_rollback();
+        return err;
     }
+    return ggconfig_write_commit();
+}
 
-    // at this point we know the key should be a map, because it's not a value
-    sqlite3_stmt *read_children_stmt;
-    sqlite3_prepare_v2(
-        config_database, GGL_SQL_GET_CHILDREN, -1, &read_children_stmt, NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, read_children_stmt);
-    sqlite3_bind_int64(read_children_stmt, 1, key_id);
-
-    // read children count
-    size_t children_count = 0;
-    while (sqlite3_step(read_children_stmt) == SQLITE_ROW) {
-        children_count++;
+// Fill value with the stored value or map of the row's key, allocating room
+// for the map's children. is_map is set if the key is a map.
+static GglError read_subtree_row_value(
+    sqlite3_stmt *stmt, GglAlloc *alloc, GglObject *value, bool *is_map
+) {
+    int64_t key_id = sqlite3_column_int64(stmt, 0);
+    if (sqlite3_column_type(stmt, 3) != SQLITE_NULL) {
+        GglError err = column_value(stmt, 3, alloc, value);
+        if (err != GGL_ERR_OK) {
+            GGL_LOGE(
+                "failed to read value for key id %" PRId64 " with error %s",
+                key_id,
+                ggl_strerror(err)
+            );
+            return err;
+        }
+        *is_map = false;
+        return GGL_ERR_OK;
     }
-    if (children_count == 0) {
+
+    int64_t children_count = sqlite3_column_int64(stmt, 5);
+    if (children_count <= 0) {
         GGL_LOGE("no value or children keys found for key id %" PRId64, key_id);
         return GGL_ERR_FAILURE;
     }
-    GGL_LOGD(
-        "the number of children keys for key id %" PRId64 " is %zd",
-        key_id,
-        children_count
-    );
-
-    // create the kvs for the children
-    GglKV *kv_buffer = GGL_ALLOCN(alloc, GglKV, children_count);
-    if (!kv_buffer) {
+    GglKV *pairs = GGL_ALLOCN(alloc, GglKV, (size_t) children_count);
+    if (pairs == NULL) {
         GGL_LOGE("no more memory to allocate kvs for key id %" PRId64, key_id);
         return GGL_ERR_NOMEM;
     }
-    GglKVVec kv_buffer_vec = { .map = (GglMap) { .pairs = kv_buffer, .len = 0 },
-                               .capacity = children_count };
-
-    // read the children
-    sqlite3_reset(read_children_stmt);
-    while (sqlite3_step(read_children_stmt) == SQLITE_ROW) {
-        int64_t child_key_id = sqlite3_column_int64(read_children_stmt, 0);
-        const uint8_t *child_key_name
-            = sqlite3_column_text(read_children_stmt, 1);
-        unsigned long child_key_name_length
-            = (unsigned long) sqlite3_column_bytes(read_children_stmt, 1);
-        uint8_t *child_key_name_memory
-            = GGL_ALLOCN(alloc, uint8_t, child_key_name_length);
-        if (!child_key_name_memory) {
+    *value = GGL_OBJ_MAP((GglMap) { .pairs = pairs, .len = 0 });
+    *is_map = true;
+    return GGL_ERR_OK;
+}
+
+typedef struct {
+    int64_t key_id;
+    GglMap *map;
+    size_t capacity;
+} SubtreeParent;
+
+/// Read the map or value at key_id and all keys under it into value, using a
+/// single query. Rows arrive depth first, so each key's parent is on the stack
+/// of maps that are still being filled.
+static GglError read_subtree(
+    int64_t key_id, GglObject *value, GglAlloc *alloc
+) {
+    GGL_LOGD("reading subtree of key id %" PRId64, key_id);
+
+    sqlite3_stmt *stmt = get_stmt(GGL_SQL_GET_SUBTREE_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, stmt);
+    sqlite3_bind_int64(stmt, 1, key_id);
+
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW) {
+        GGL_LOGE(
+            "failed to read key id %" PRId64 " with rc %d and error %s",
+            key_id,
+            rc,
+            sqlite3_errmsg(config_database)
+        );
+        return GGL_ERR_FAILURE;
+    }
+
+    bool is_map;
+    GglError err = read_subtree_row_value(stmt, alloc, value, &is_map);
+    if ((err != GGL_ERR_OK) || !is_map) {
+        return err;
+    }
+
+    SubtreeParent stack[GGL_MAX_OBJECT_DEPTH];
+    size_t stack_len = 1;
+    stack[0] = (SubtreeParent) {
+        .key_id = key_id,
+        .map = &value->map,
+        .capacity = (size_t) sqlite3_column_int64(stmt, 5),
+    };
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int64_t child_id = sqlite3_column_int64(stmt, 0);
+        int64_t parent_id = sqlite3_column_int64(stmt, 1);
+        while ((stack_len > 0) && (stack[stack_len - 1].key_id != parent_id)) {
+            stack_len--;
+        }
+        if (stack_len == 0) {
             GGL_LOGE(
-                "no more memory to allocate value for key id %" PRId64, key_id
+                "key id %" PRId64 " read out of order under key id %" PRId64,
+                child_id,
+                key_id
             );
-            return GGL_ERR_NOMEM;
+            return GGL_ERR_FAILURE;
+        }
+        SubtreeParent *parent = &stack[stack_len - 1];
+        if (parent->map->len >= parent->capacity) {
+            GGL_LOGE(
+                "key id %" PRId64 " has more children than counted", parent_id
+            );
+            return GGL_ERR_FAILURE;
         }
-        memcpy(child_key_name_memory, child_key_name, child_key_name_length);
-
-        GglBuffer child_key_name_buffer
-            = { .data = child_key_name_memory, .len = child_key_name_length };
-        GglKV child_kv = { .key = child_key_name_buffer };
-
-        read_key_recursive(child_key_id, &child_kv.val, alloc);
 
-        err = ggl_kv_vec_push(&kv_buffer_vec, child_kv);
+        GglKV *kv = &parent->map->pairs[parent->map->len];
+        err = copy_column_text(stmt, 2, alloc, &kv->key);
         if (err != GGL_ERR_OK) {
-            GGL_LOGE("error pushing kv with error %s", ggl_strerror(err));
+            GGL_LOGE(
+                "no more memory to allocate key for key id %" PRId64, child_id
+            );
             return err;
         }
-    }
+        err = read_subtree_row_value(stmt, alloc, &kv->val, &is_map);
+        if (err != GGL_ERR_OK) {
+            return err;
+        }
+        parent->map->len++;
 
-    value->type = GGL_TYPE_MAP;
-    value->map = kv_buffer_vec.map;
+        if (is_map) {
+            if (stack_len >= GGL_MAX_OBJECT_DEPTH) {
+                GGL_LOGE(
+                    "subtree of key id %" PRId64 " is nested too deeply", key_id
+                );
+                return GGL_ERR_NOMEM;
+            }
+            stack[stack_len++] = (SubtreeParent) {
+                .key_id = child_id,
+                .map = &kv->val.map,
+                .capacity = (size_t) sqlite3_column_int64(stmt, 5),
+            };
+        }
+    }
+    if (rc != SQLITE_DONE) {
+        GGL_LOGE(
+            "failed to read subtree of key id %" PRId64 " with error %s",
+            key_id,
+            sqlite3_errmsg(config_database)
+        );
+        return GGL_ERR_FAILURE;
+    }
     return GGL_ERR_OK;
 }
 
@@ -897,9 +1541,22 @@ GglError ggconfig_get_value_from_key(GglList *key_path, GglObject *value) {
         return GGL_ERR_FAILURE;
     }
 
+    if (key_path->len == 0) {
+        GGL_LOGE("Can not read a value without a key.");
+        return GGL_ERR_INVALID;
+    }
+
     static uint8_t key_value_memory[GGL_COREBUS_MAX_MSG_LEN];
     GglBumpAlloc bumper = ggl_bump_alloc_init(GGL_BUF(key_value_memory));
 
+    if (config_cache_needs_load()) {
+        cache_load();
+    }
+    GglError cache_err = config_cache_read(key_path, &bumper.alloc, value);
+    if (cache_err != GGL_ERR_UNSUPPORTED) {
+        return cache_err;
+    }
+
     sqlite3_exec(config_database, "BEGIN TRANSACTION", NULL, NULL, NULL);
     GGL_LOGI("starting request for key: %s", print_key_path(key_path));
     GglObject ids_array[GGL_MAX_OBJECT_DEPTH];
@@ -915,14 +1572,12 @@ GglError ggconfig_get_value_from_key(GglList *key_path, GglObject *value) {
         return err;
     }
     int64_t key_id = ids.list.items[ids.list.len - 1].i64;
-    err = read_key_recursive(key_id, value, &bumper.alloc);
+    err = read_subtree(key_id, value, &bumper.alloc);
     sqlite3_exec(config_database, "END TRANSACTION", NULL, NULL, NULL);
     return err;
 }
 
 GglError ggconfig_get_key_notification(GglList *key_path, uint32_t handle) {
-    GglError return_err = GGL_ERR_FAILURE;
-
     if (config_initialized == false) {
         return GGL_ERR_FAILURE;
     }
@@ -950,23 +1605,309 @@ GglError ggconfig_get_key_notification(GglList *key_path, uint32_t handle) {
         handle & 0x0000FFFF,
         print_key_path(key_path)
     );
-    // insert the key & handle data into the subscriber database
-    GGL_LOGD("INSERT %" PRId64 ", %" PRIu32, key_id, handle);
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(
-        config_database, GGL_SQL_ADD_SUBSCRIPTION, -1, &stmt, NULL
-    );
-    GGL_CLEANUP(cleanup_sqlite3_finalize, stmt);
-    sqlite3_bind_int64(stmt, 1, key_id);
-    sqlite3_bind_int64(stmt, 2, handle);
-    int rc = sqlite3_step(stmt);
     sqlite3_exec(config_database, "END TRANSACTION", NULL, NULL, NULL);
-    if (SQLITE_DONE != rc) {
-        GGL_LOGE("%d %s", rc, sqlite3_errmsg(config_database));
-    } else {
-        GGL_LOGT("Success");
-        return_err = GGL_ERR_OK;
+    return subscriber_index_add(key_id, handle);
+}
+
+// Fill record's value from the value columns starting at type_col. Numbers
+// are encoded into number_mem.
+static GglError column_snapshot_value(
+    sqlite3_stmt *stmt,
+    int type_col,
+    uint8_t number_mem[8],
+    SnapshotRecord *record
+) {
+    int value_col = type_col + 1;
+    int type = sqlite3_column_int(stmt, type_col);
+
+    switch (type) {
+    case STORED_TYPE_NULL:
+        record->value = (GglBuffer) { 0 };
+        break;
+    case STORED_TYPE_BOOLEAN:
+        number_mem[0] = (sqlite3_column_int(stmt, value_col) != 0) ? 1 : 0;
+        record->value = (GglBuffer) { .data = number_mem, .len = 1 };
+        break;
+    case STORED_TYPE_I64:
+        snapshot_u64_to_le(
+            (uint64_t) sqlite3_column_int64(stmt, value_col), number_mem
+        );
+        record->value = (GglBuffer) { .data = number_mem, .len = 8 };
+        break;
+    case STORED_TYPE_F64: {
+        double f64 = sqlite3_column_double(stmt, value_col);
+        uint64_t bits;
+        memcpy(&bits, &f64, sizeof(bits));
+        snapshot_u64_to_le(bits, number_mem);
+        record->value = (GglBuffer) { .data = number_mem, .len = 8 };
+        break;
+    }
+    case STORED_TYPE_BUF:
+    case STORED_TYPE_LIST:
+        record->value = (GglBuffer) {
+            .data = (uint8_t *) sqlite3_column_blob(stmt, value_col),
+            .len = (size_t) sqlite3_column_bytes(stmt, value_col),
+        };
+        break;
+    default:
+        GGL_LOGE("Unknown stored value type %d.", type);
+        return GGL_ERR_PARSE;
     }
 
-    return return_err;
+    record->value_type = (uint8_t) type;
+    return GGL_ERR_OK;
+}
+
+static GglError export_keys(void) {
+    sqlite3_stmt *stmt = get_stmt(GGL_SQL_GET_ALL_KEYS_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, stmt);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        uint8_t number_mem[8];
+        SnapshotRecord record = {
+            .key_id = sqlite3_column_int64(stmt, 0),
+            .parent_id = sqlite3_column_int64(stmt, 1),
+            .key = { .data = (uint8_t *) sqlite3_column_text(stmt, 2),
+                     .len = (size_t) sqlite3_column_bytes(stmt, 2) },
+            .value_type = SNAPSHOT_NO_VALUE,
+        };
+        if (sqlite3_column_type(stmt, 3) != SQLITE_NULL) {
+            GglError ret
+                = column_snapshot_value(stmt, 3, number_mem, &record);
+            if (ret != GGL_ERR_OK) {
+                return ret;
+            }
+            record.timestamp = sqlite3_column_int64(stmt, 5);
+        }
+
+        GglError ret = snapshot_write_record(&record);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+    if (rc != SQLITE_DONE) {
+        GGL_LOGE(
+            "Failed to read keys for snapshot: %s",
+            sqlite3_errmsg(config_database)
+        );
+        return GGL_ERR_FAILURE;
+    }
+    return GGL_ERR_OK;
+}
+
+GglError ggconfig_export_snapshot(int fd) {
+    if (config_initialized == false) {
+        return GGL_ERR_FAILURE;
+    }
+
+    GglError ret = snapshot_write_begin(fd);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    // Read in one transaction for a consistent snapshot
+    sqlite3_exec(config_database, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    ret = export_keys();
+    sqlite3_exec(config_database, "END TRANSACTION", NULL, NULL, NULL);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    return snapshot_write_end();
+}
+
+/// Bind a snapshot record's value type to parameter type_param and its value
+/// to the next parameter.
+static GglError bind_snapshot_value(
+    sqlite3_stmt *stmt, int type_param, const SnapshotRecord *record
+) {
+    int value_param = type_param + 1;
+    GglBuffer value = record->value;
+
+    switch (record->value_type) {
+    case STORED_TYPE_NULL:
+        sqlite3_bind_null(stmt, value_param);
+        break;
+    case STORED_TYPE_BOOLEAN:
+        if (value.len != 1) {
+            return GGL_ERR_PARSE;
+        }
+        sqlite3_bind_int(stmt, value_param, value.data[0] != 0);
+        break;
+    case STORED_TYPE_I64:
+        if (value.len != 8) {
+            return GGL_ERR_PARSE;
+        }
+        sqlite3_bind_int64(
+            stmt, value_param, (int64_t) snapshot_u64_from_le(value.data)
+        );
+        break;
+    case STORED_TYPE_F64: {
+        if (value.len != 8) {
+            return GGL_ERR_PARSE;
+        }
+        uint64_t bits = snapshot_u64_from_le(value.data);
+        double f64;
+        memcpy(&f64, &bits, sizeof(f64));
+        sqlite3_bind_double(stmt, value_param, f64);
+        break;
+    }
+    case STORED_TYPE_BUF:
+        sqlite3_bind_text(
+            stmt,
+            value_param,
+            (char *) value.data,
+            (int) value.len,
+            SQLITE_STATIC
+        );
+        break;
+    case STORED_TYPE_LIST:
+        sqlite3_bind_blob(
+            stmt, value_param, value.data, (int) value.len, SQLITE_STATIC
+        );
+        break;
+    default:
+        return GGL_ERR_PARSE;
+    }
+
+    sqlite3_bind_int(stmt, type_param, record->value_type);
+    return GGL_ERR_OK;
+}
+
+static GglError import_record(const SnapshotRecord *record) {
+    sqlite3_stmt *key_stmt = get_stmt(GGL_SQL_KEY_INSERT_WITH_ID_STMT);
+    GGL_CLEANUP(cleanup_sqlite3_reset, key_stmt);
+    sqlite3_bind_int64(key_stmt, 1, record->key_id);
+    sqlite3_bind_text(
+        key_stmt,
+        2,
+        (char *) record->key.data,
+        (int) record->key.len,
+        SQLITE_STATIC
+    );
+    if (sqlite3_step(key_stmt) != SQLITE_DONE) {
+        return GGL_ERR_FAILURE;
+    }
+
+    if (record->parent_id != 0) {
+        sqlite3_stmt *relation_stmt = get_stmt(GGL_SQL_INSERT_RELATION_STMT);
+        GGL_CLEANUP(cleanup_sqlite3_reset, relation_stmt);
+        sqlite3_bind_int64(relation_stmt, 1, record->key_id);
+        sqlite3_bind_int64(relation_stmt, 2, record->parent_id);
+        if (sqlite3_step(relation_stmt) != SQLITE_DONE) {
+            return GGL_ERR_FAILURE;
+        }
+    }
+
+    if (record->value_type != SNAPSHOT_NO_VALUE) {
+        sqlite3_stmt *value_stmt = get_stmt(GGL_SQL_VALUE_INSERT_STMT);
+        GGL_CLEANUP(cleanup_sqlite3_reset, value_stmt);
+        sqlite3_bind_int64(value_stmt, 1, record->key_id);
+        GglError ret = bind_snapshot_value(value_stmt, 2, record);
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGE(
+                "Invalid value of type %d for key id %" PRId64 " in snapshot.",
+                record->value_type,
+                record->key_id
+            );
+            return ret;
+        }
+        sqlite3_bind_int64(value_stmt, 4, record->timestamp);
+        if (sqlite3_step(value_stmt) != SQLITE_DONE) {
+            return GGL_ERR_FAILURE;
+        }
+    }
+
+    return GGL_ERR_OK;
+}
+
+static GglError import_keys(void) {
+    int rc = sqlite3_exec(
+        config_database, GGL_SQL_CLEAR_CONFIG, NULL, NULL, NULL
+    );
+    if (rc != SQLITE_OK) {
+        GGL_LOGE(
+            "Failed to clear configuration: %s",
+            sqlite3_errmsg(config_database)
+        );
+        return GGL_ERR_FAILURE;
+    }
+
+    int64_t last_key_id = 0;
+    size_t count = 0;
+    while (true) {
+        SnapshotRecord record;
+        bool end;
+        GglError ret = snapshot_read_record(&record, &end);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        if (end) {
+            break;
+        }
+
+        // Keys are ordered with parents first, which keeps the tree acyclic.
+        if ((record.key_id <= last_key_id) || (record.parent_id < 0)
+            || (record.parent_id >= record.key_id)) {
+            GGL_LOGE(
+                "Snapshot key id %" PRId64 " with parent %" PRId64
+                " is out of order.",
+                record.key_id,
+                record.parent_id
+            );
+            return GGL_ERR_PARSE;
+        }
+        last_key_id = record.key_id;
+
+        ret = import_record(&record);
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGE(
+                "Failed to import key id %" PRId64 ": %s",
+                record.key_id,
+                sqlite3_errmsg(config_database)
+            );
+            return ret;
+        }
+        count++;
+    }
+
+    GGL_LOGI("Imported %zu keys from snapshot.", count);
+    return GGL_ERR_OK;
+}
+
+GglError ggconfig_import_snapshot(int fd) {
+    if ((config_initialized == false) || write_batch_active) {
+        return GGL_ERR_FAILURE;
+    }
+
+    GglError ret = snapshot_read_begin(fd);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    sqlite3_exec(
+        config_database, "BEGIN IMMEDIATE TRANSACTION", NULL, NULL, NULL
+    );
+    ret = import_keys();
+    if (ret == GGL_ERR_OK) {
+        int rc = sqlite3_exec(
+            config_database, "END TRANSACTION", NULL, NULL, NULL
+        );
+        if (rc != SQLITE_OK) {
+            GGL_LOGE(
+                "Failed to commit snapshot import: %s",
+                sqlite3_errmsg(config_database)
+            );
+            ret = GGL_ERR_FAILURE;
+        }
+    }
+    if (ret != GGL_ERR_OK) {
+        sqlite3_exec(config_database, "ROLLBACK", NULL, NULL, NULL);
+        return ret;
+    }
+
+    config_cache_invalidate();
+    checkpointer_note_commit();
+    return GGL_ERR_OK;
 }
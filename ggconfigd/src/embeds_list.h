@@ -7,8 +7,13 @@
 
 #define EMBED_FILE_LIST \
     EMBED_FILE(sql/create_db.sql, GGL_SQL_CREATE_DB) \
-    EMBED_FILE(sql/create_sub_table.sql, GGL_SQL_CREATE_SUB_TABLE) \
+    EMBED_FILE(sql/get_version.sql, GGL_SQL_GET_VERSION) \
+    EMBED_FILE(sql/migrate_typed_values.sql, GGL_SQL_MIGRATE_TYPED_VALUES) \
+    EMBED_FILE(sql/get_json_values.sql, GGL_SQL_GET_JSON_VALUES) \
+    EMBED_FILE(sql/finish_typed_values.sql, GGL_SQL_FINISH_TYPED_VALUES) \
     EMBED_FILE(sql/key_insert.sql, GGL_SQL_KEY_INSERT) \
+    EMBED_FILE(sql/key_insert_with_id.sql, GGL_SQL_KEY_INSERT_WITH_ID) \
+    EMBED_FILE(sql/clear_config.sql, GGL_SQL_CLEAR_CONFIG) \
     EMBED_FILE(sql/check_initialized.sql, GGL_SQL_CHECK_INITALIZED) \
     EMBED_FILE(sql/value_present.sql, GGL_SQL_VALUE_PRESENT) \
     EMBED_FILE(sql/get_key_with_parent.sql, GGL_SQL_GET_KEY_WITH_PARENT) \
@@ -19,10 +24,8 @@
     EMBED_FILE(sql/get_timestamp.sql, GGL_SQL_GET_TIMESTAMP) \
     EMBED_FILE(sql/find_element.sql, GGL_SQL_FIND_ELEMENT) \
     EMBED_FILE(sql/has_child.sql, GGL_SQL_HAS_CHILD) \
-    EMBED_FILE(sql/get_subscribers.sql, GGL_SQL_GET_SUBSCRIBERS) \
-    EMBED_FILE(sql/read_value.sql, GGL_SQL_READ_VALUE) \
-    EMBED_FILE(sql/get_children.sql, GGL_SQL_GET_CHILDREN) \
-    EMBED_FILE(sql/add_subscription.sql, GGL_SQL_ADD_SUBSCRIPTION) \
+    EMBED_FILE(sql/get_subtree.sql, GGL_SQL_GET_SUBTREE) \
+    EMBED_FILE(sql/get_all_keys.sql, GGL_SQL_GET_ALL_KEYS) \
     EMBED_FILE(sql/create_index.sql, GGL_SQL_CREATE_INDEX)
 
 #endif
@@ -0,0 +1,206 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "notify_debounce.h"
+#include "ggconfigd.h"
+#include <ggl/buffer.h>
+#include <ggl/cleanup.h>
+#include <ggl/constants.h>
+#include <ggl/core_bus/server.h>
+#include <ggl/error.h>
+#include <ggl/log.h>
+#include <ggl/object.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    bool in_use;
+    uint32_t handle;
+    uint32_t window_ms;
+    uint64_t last_sent_ms;
+    bool pending;
+    size_t path_len;
+    GglBuffer path[GGL_MAX_OBJECT_DEPTH];
+    uint8_t path_mem[GGCONFIGD_DEBOUNCE_PATH_BYTES];
+} DebouncedSub;
+
+// Guards subs; held by request handlers and the flush thread. Released
+// around ggl_sub_respond, which may run close callbacks that take it.
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond;
+static bool flush_thread_running = false;
+static DebouncedSub subs[GGCONFIGD_MAX_DEBOUNCED_SUBSCRIPTIONS];
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000U) + ((uint64_t) ts.tv_nsec / 1000000U);
+}
+
+static DebouncedSub *find_sub(uint32_t handle) {
+    for (size_t i = 0; i < GGCONFIGD_MAX_DEBOUNCED_SUBSCRIPTIONS; i++) {
+        if (subs[i].in_use && (subs[i].handle == handle)) {
+            return &subs[i];
+        }
+    }
+    return NULL;
+}
+
+// Pending notifications are for the common parent of the changed keys. Keys
+// past the path memory are dropped, notifying their parent instead.
+static void merge_pending(DebouncedSub *sub, GglList *key_path) {
+    if (sub->pending) {
+        size_t len = 0;
+        while ((len < sub->path_len) && (len < key_path->len)
+               && ggl_buffer_eq(sub->path[len], key_path->items[len].buf)) {
+            len++;
+        }
+        sub->path_len = len;
+        return;
+    }
+
+    size_t used = 0;
+    sub->path_len = 0;
+    for (size_t i = 0; i < key_path->len; i++) {
+        GglBuffer key = key_path->items[i].buf;
+        if (key.len > sizeof(sub->path_mem) - used) {
+            break;
+        }
+        memcpy(&sub->path_mem[used], key.data, key.len);
+        sub->path[sub->path_len++]
+            = (GglBuffer) { .data = &sub->path_mem[used], .len = key.len };
+        used += key.len;
+    }
+    sub->pending = true;
+}
+
+void notify_subscriber(uint32_t handle, GglList *key_path) {
+    {
+        GGL_MTX_SCOPE_GUARD(&mtx);
+
+        DebouncedSub *sub = find_sub(handle);
+        if (sub != NULL) {
+            uint64_t now = now_ms();
+            if (sub->pending || (now - sub->last_sent_ms < sub->window_ms)) {
+                GGL_LOGD("Debouncing notification to %u.", handle);
+                merge_pending(sub, key_path);
+                pthread_cond_signal(&cond);
+                return;
+            }
+            sub->last_sent_ms = now;
+        }
+    }
+
+    ggl_sub_respond(handle, GGL_OBJ_LIST(*key_path));
+}
+
+GglError notify_debounce_add(uint32_t handle, uint32_t window_ms) {
+    GGL_MTX_SCOPE_GUARD(&mtx);
+
+    if (!flush_thread_running) {
+        return GGL_ERR_FAILURE;
+    }
+    for (size_t i = 0; i < GGCONFIGD_MAX_DEBOUNCED_SUBSCRIPTIONS; i++) {
+        if (!subs[i].in_use) {
+            subs[i] = (DebouncedSub) { .in_use = true,
+                                       .handle = handle,
+                                       .window_ms = window_ms };
+            return GGL_ERR_OK;
+        }
+    }
+    return GGL_ERR_NOMEM;
+}
+
+void notify_debounce_remove(uint32_t handle) {
+    GGL_MTX_SCOPE_GUARD(&mtx);
+
+    DebouncedSub *sub = find_sub(handle);
+    if (sub != NULL) {
+        sub->in_use = false;
+    }
+}
+
+static void *flush_thread(void *ctx) {
+    (void) ctx;
+
+    GglObject path_items[GGL_MAX_OBJECT_DEPTH];
+    uint8_t path_mem[GGCONFIGD_DEBOUNCE_PATH_BYTES];
+
+    GGL_MTX_SCOPE_GUARD(&mtx);
+
+    while (true) {
+        uint64_t now = now_ms();
+        uint64_t next_due = UINT64_MAX;
+        DebouncedSub *due = NULL;
+        for (size_t i = 0; i < GGCONFIGD_MAX_DEBOUNCED_SUBSCRIPTIONS; i++) {
+            if (!subs[i].in_use || !subs[i].pending) {
+                continue;
+            }
+            uint64_t due_ms = subs[i].last_sent_ms + subs[i].window_ms;
+            if (due_ms <= now) {
+                due = &subs[i];
+                break;
+            }
+            if (due_ms < next_due) {
+                next_due = due_ms;
+            }
+        }
+
+        if (due == NULL) {
+            if (next_due == UINT64_MAX) {
+                pthread_cond_wait(&cond, &mtx);
+            } else {
+                struct timespec deadline = {
+                    .tv_sec = (time_t) (next_due / 1000U),
+                    .tv_nsec = (long) ((next_due % 1000U) * 1000000U),
+                };
+                pthread_cond_timedwait(&cond, &mtx, &deadline);
+            }
+            continue;
+        }
+
+        uint32_t handle = due->handle;
+        GglList path = { .items = path_items, .len = due->path_len };
+        memcpy(path_mem, due->path_mem, sizeof(path_mem));
+        for (size_t i = 0; i < due->path_len; i++) {
+            path_items[i] = GGL_OBJ_BUF((GglBuffer) {
+                .data = &path_mem[due->path[i].data - due->path_mem],
+                .len = due->path[i].len,
+            });
+        }
+        due->pending = false;
+        due->last_sent_ms = now;
+
+        pthread_mutex_unlock(&mtx);
+        GGL_LOGD("Sending debounced notification to %u.", handle);
+        ggl_sub_respond(handle, GGL_OBJ_LIST(path));
+        pthread_mutex_lock(&mtx);
+    }
+
+    return NULL;
+}
+
+GglError notify_debounce_start(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_t thread;
+    int ret = pthread_create(&thread, NULL, flush_thread, NULL);
+    if (ret != 0) {
+        GGL_LOGE("Failed to start notification debounce thread.");
+        return GGL_ERR_FAILURE;
+    }
+    pthread_detach(thread);
+
+    GGL_MTX_SCOPE_GUARD(&mtx);
+    flush_thread_running = true;
+    return GGL_ERR_OK;
+}
@@ -0,0 +1,31 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef GGCONFIGD_NOTIFY_DEBOUNCE_H
+#define GGCONFIGD_NOTIFY_DEBOUNCE_H
+
+//! Debounced subscription notifications
+//!
+//! A debounced subscription is notified at most once per window. Changes made
+//! within the window after a notification are collapsed into one notification
+//! for the deepest key covering all of them, sent when the window ends.
+
+#include <ggl/error.h>
+#include <ggl/object.h>
+#include <stdint.h>
+
+/// Start the thread that sends notifications delayed by a debounce window.
+GglError notify_debounce_start(void);
+
+/// Debounce notifications of subscription handle with a window of window_ms.
+GglError notify_debounce_add(uint32_t handle, uint32_t window_ms);
+
+/// Stop debouncing notifications of a closed subscription.
+void notify_debounce_remove(uint32_t handle);
+
+/// Notify subscription handle that the key at key_path changed. Sent now unless
+/// the subscription is within its debounce window.
+void notify_subscriber(uint32_t handle, GglList *key_path);
+
+#endif
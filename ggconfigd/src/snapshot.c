@@ -0,0 +1,260 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "snapshot.h"
+#include <ggl/buffer.h>
+#include <ggl/core_bus/constants.h>
+#include <ggl/error.h>
+#include <ggl/file.h>
+#include <ggl/log.h>
+#include <ggl/object.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNAPSHOT_FORMAT_VERSION 1U
+
+static const GglBuffer SNAPSHOT_MAGIC = GGL_STR("GGCS");
+
+// Snapshots are written and read through one buffer, by request handlers,
+// which are run one at a time.
+static int snapshot_fd = -1;
+static uint8_t io_mem[64 * 1024];
+static size_t io_pos = 0;
+static size_t io_len = 0;
+
+// Keys and values are at most a core bus message, as they were written as one.
+static uint8_t key_mem[GGL_COREBUS_MAX_MSG_LEN];
+static uint8_t value_mem[GGL_COREBUS_MAX_MSG_LEN];
+
+void snapshot_u64_to_le(uint64_t value, uint8_t out[8]) {
+    for (size_t i = 0; i < 8; i++) {
+        out[i] = (uint8_t) (value >> (8 * i));
+    }
+}
+
+uint64_t snapshot_u64_from_le(const uint8_t in[8]) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; i++) {
+        value |= (uint64_t) in[i] << (8 * i);
+    }
+    return value;
+}
+
+static GglError flush(void) {
+    GglError ret = ggl_file_write(
+        snapshot_fd, (GglBuffer) { .data = io_mem, .len = io_len }
+    );
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGE("Failed to write snapshot.");
+        return ret;
+    }
+    io_len = 0;
+    return GGL_ERR_OK;
+}
+
+static GglError put(GglBuffer data) {
+    while (data.len > 0) {
+        if (io_len == sizeof(io_mem)) {
+            GglError ret = flush();
+            if (ret != GGL_ERR_OK) {
+                return ret;
+            }
+        }
+        size_t chunk = sizeof(io_mem) - io_len;
+        if (chunk > data.len) {
+            chunk = data.len;
+        }
+        memcpy(&io_mem[io_len], data.data, chunk);
+        io_len += chunk;
+        data = ggl_buffer_substr(data, chunk, SIZE_MAX);
+    }
+    return GGL_ERR_OK;
+}
+
+static GglError put_u64(uint64_t value) {
+    uint8_t bytes[8];
+    snapshot_u64_to_le(value, bytes);
+    return put(GGL_BUF(bytes));
+}
+
+static GglError put_sized(GglBuffer data) {
+    if (data.len > UINT32_MAX) {
+        return GGL_ERR_RANGE;
+    }
+    uint8_t len[4];
+    for (size_t i = 0; i < 4; i++) {
+        len[i] = (uint8_t) (data.len >> (8 * i));
+    }
+    GglError ret = put(GGL_BUF(len));
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    return put(data);
+}
+
+GglError snapshot_write_begin(int fd) {
+    snapshot_fd = fd;
+    io_len = 0;
+
+    GglError ret = put(SNAPSHOT_MAGIC);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    uint8_t version[4] = { SNAPSHOT_FORMAT_VERSION, 0, 0, 0 };
+    return put(GGL_BUF(version));
+}
+
+GglError snapshot_write_record(const SnapshotRecord *record) {
+    GglError ret = put_u64((uint64_t) record->key_id);
+    if (ret == GGL_ERR_OK) {
+        ret = put_u64((uint64_t) record->parent_id);
+    }
+    if (ret == GGL_ERR_OK) {
+        ret = put_sized(record->key);
+    }
+    if (ret == GGL_ERR_OK) {
+        uint8_t value_type[1] = { record->value_type };
+        ret = put(GGL_BUF(value_type));
+    }
+    if ((ret == GGL_ERR_OK) && (record->value_type != SNAPSHOT_NO_VALUE)) {
+        ret = put_u64((uint64_t) record->timestamp);
+        if (ret == GGL_ERR_OK) {
+            ret = put_sized(record->value);
+        }
+    }
+    return ret;
+}
+
+GglError snapshot_write_end(void) {
+    GglError ret = put_u64(0);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    return flush();
+}
+
+static GglError take(GglBuffer out) {
+    while (out.len > 0) {
+        if (io_pos == io_len) {
+            GglBuffer rest = GGL_BUF(io_mem);
+            GglError ret = ggl_file_read(snapshot_fd, &rest);
+            if (ret != GGL_ERR_OK) {
+                GGL_LOGE("Failed to read snapshot.");
+                return ret;
+            }
+            if (rest.len == 0) {
+                GGL_LOGE("Snapshot is truncated.");
+                return GGL_ERR_PARSE;
+            }
+            io_pos = 0;
+            io_len = rest.len;
+        }
+        size_t chunk = io_len - io_pos;
+        if (chunk > out.len) {
+            chunk = out.len;
+        }
+        memcpy(out.data, &io_mem[io_pos], chunk);
+        io_pos += chunk;
+        out = ggl_buffer_substr(out, chunk, SIZE_MAX);
+    }
+    return GGL_ERR_OK;
+}
+
+static GglError take_u64(uint64_t *value) {
+    uint8_t bytes[8];
+    GglError ret = take(GGL_BUF(bytes));
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    *value = snapshot_u64_from_le(bytes);
+    return GGL_ERR_OK;
+}
+
+static GglError take_sized(GglBuffer mem, GglBuffer *data) {
+    uint8_t len_bytes[4];
+    GglError ret = take(GGL_BUF(len_bytes));
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    size_t len = 0;
+    for (size_t i = 0; i < 4; i++) {
+        len |= (size_t) len_bytes[i] << (8 * i);
+    }
+    if (len > mem.len) {
+        GGL_LOGE("Snapshot field of %zu bytes is too large.", len);
+        return GGL_ERR_NOMEM;
+    }
+    *data = ggl_buffer_substr(mem, 0, len);
+    return take(*data);
+}
+
+GglError snapshot_read_begin(int fd) {
+    snapshot_fd = fd;
+    io_pos = 0;
+    io_len = 0;
+
+    uint8_t header[8];
+    GglError ret = take(GGL_BUF(header));
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    if (!ggl_buffer_eq(
+            ggl_buffer_substr(GGL_BUF(header), 0, 4), SNAPSHOT_MAGIC
+        )) {
+        GGL_LOGE("File is not a configuration snapshot.");
+        return GGL_ERR_PARSE;
+    }
+    uint32_t version = (uint32_t) header[4] | ((uint32_t) header[5] << 8)
+        | ((uint32_t) header[6] << 16) | ((uint32_t) header[7] << 24);
+    if (version != SNAPSHOT_FORMAT_VERSION) {
+        GGL_LOGE("Unsupported snapshot format version %u.", version);
+        return GGL_ERR_UNSUPPORTED;
+    }
+    return GGL_ERR_OK;
+}
+
+GglError snapshot_read_record(SnapshotRecord *record, bool *end) {
+    uint64_t key_id;
+    GglError ret = take_u64(&key_id);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    if (key_id == 0) {
+        *end = true;
+        return GGL_ERR_OK;
+    }
+    *end = false;
+
+    uint64_t parent_id;
+    ret = take_u64(&parent_id);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    *record = (SnapshotRecord) { .key_id = (int64_t) key_id,
+                                 .parent_id = (int64_t) parent_id };
+
+    ret = take_sized(GGL_BUF(key_mem), &record->key);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    uint8_t value_type[1];
+    ret = take(GGL_BUF(value_type));
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    record->value_type = value_type[0];
+    if (record->value_type == SNAPSHOT_NO_VALUE) {
+        return GGL_ERR_OK;
+    }
+
+    uint64_t timestamp;
+    ret = take_u64(&timestamp);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    record->timestamp = (int64_t) timestamp;
+    return take_sized(GGL_BUF(value_mem), &record->value);
+}
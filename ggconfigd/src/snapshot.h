@@ -0,0 +1,55 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef GGCONFIGD_SNAPSHOT_H
+#define GGCONFIGD_SNAPSHOT_H
+
+//! Configuration snapshot file format
+//!
+//! A snapshot is the magic "GGCS" and a u32 format version, followed by one
+//! record per key in increasing key id order, and ends with a record with key
+//! id 0. Integers are little endian. A record is:
+//!
+//! - i64 key id, i64 parent key id (0 for root keys)
+//! - u32 key length, key
+//! - u8 value type (SNAPSHOT_NO_VALUE for keys holding a map)
+//! - for values: i64 timestamp, u32 value length, value
+
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SNAPSHOT_NO_VALUE 0xFF
+
+typedef struct {
+    int64_t key_id;
+    int64_t parent_id;
+    GglBuffer key;
+    uint8_t value_type;
+    int64_t timestamp;
+    GglBuffer value;
+} SnapshotRecord;
+
+/// Start writing a snapshot to fd.
+GglError snapshot_write_begin(int fd);
+
+/// Append a record to the snapshot being written.
+GglError snapshot_write_record(const SnapshotRecord *record);
+
+/// Write the end of the snapshot and flush it.
+GglError snapshot_write_end(void);
+
+/// Start reading a snapshot from fd, checking its header.
+GglError snapshot_read_begin(int fd);
+
+/// Read the next record. Its buffers are valid until the next read. Sets end
+/// instead at the end of the snapshot.
+GglError snapshot_read_record(SnapshotRecord *record, bool *end);
+
+/// Encode or decode a little endian u64 value, used for numeric values.
+void snapshot_u64_to_le(uint64_t value, uint8_t out[8]);
+uint64_t snapshot_u64_from_le(const uint8_t in[8]);
+
+#endif
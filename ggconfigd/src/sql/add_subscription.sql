@@ -1,4 +0,0 @@
-INSERT INTO
-  subscriberTable (keyid, handle)
-VALUES
-  (?, ?);
@@ -0,0 +1,5 @@
+DELETE FROM valueTable;
+
+DELETE FROM relationTable;
+
+DELETE FROM keyTable;
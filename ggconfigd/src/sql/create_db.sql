@@ -12,8 +12,9 @@ CREATE TABLE relationTable (
 );
 
 CREATE TABLE valueTable (
-  'keyid' INT UNIQUE NOT NULL,
-  'value' TEXT NOT NULL,
+  'keyid' INTEGER PRIMARY KEY NOT NULL,
+  'type' INT NOT NULL,
+  'value' BLOB,
   'timeStamp' INTEGER NOT NULL,
   FOREIGN KEY (keyid) REFERENCES keyTable (keyid)
 );
@@ -23,4 +24,4 @@ CREATE TABLE version ('version' TEXT DEFAULT '0.1');
 INSERT INTO
   version (version)
 VALUES
-  (0.1);
+  ('0.2');
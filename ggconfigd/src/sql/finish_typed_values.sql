@@ -0,0 +1,5 @@
+DROP TABLE jsonValueTable;
+
+UPDATE version
+SET
+  version = '0.2';
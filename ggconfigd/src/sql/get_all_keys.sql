@@ -0,0 +1,13 @@
+SELECT
+  kt.keyid,
+  rt.parentid,
+  kt.keyvalue,
+  vt.type,
+  vt.value,
+  vt.timeStamp
+FROM
+  keyTable kt
+  LEFT JOIN relationTable rt ON kt.keyid = rt.keyid
+  LEFT JOIN valueTable vt ON kt.keyid = vt.keyid
+ORDER BY
+  kt.keyid;
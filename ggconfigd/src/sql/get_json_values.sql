@@ -0,0 +1,6 @@
+SELECT
+  keyid,
+  value,
+  timeStamp
+FROM
+  jsonValueTable;
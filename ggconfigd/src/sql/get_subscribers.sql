@@ -1,8 +0,0 @@
-SELECT
-  handle
-FROM
-  subscriberTable S
-  LEFT JOIN keyTable K
-WHERE
-  S.keyid = K.keyid
-  AND K.keyid = ?;
@@ -0,0 +1,50 @@
+WITH RECURSIVE
+  subtree (keyid, parentid, depth, keyvalue) AS (
+    SELECT
+      ?,
+      NULL,
+      0,
+      NULL
+    UNION ALL
+    SELECT
+      kt.keyid,
+      rt.parentid,
+      st.depth + 1,
+      kt.keyvalue
+    FROM
+      subtree st
+      JOIN relationTable rt ON st.keyid = rt.parentid
+      JOIN keyTable kt ON rt.keyid = kt.keyid
+    ORDER BY
+      3 DESC
+  )
+SELECT
+  keyid,
+  parentid,
+  keyvalue,
+  (
+    SELECT
+      type
+    FROM
+      valueTable vt
+    WHERE
+      vt.keyid = subtree.keyid
+  ),
+  (
+    SELECT
+      value
+    FROM
+      valueTable vt
+    WHERE
+      vt.keyid = subtree.keyid
+  ),
+  (
+    SELECT
+      COUNT(*)
+    FROM
+      relationTable ct
+    WHERE
+      ct.parentid = subtree.keyid
+  )
+FROM
+  subtree;
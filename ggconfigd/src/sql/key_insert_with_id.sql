@@ -0,0 +1,4 @@
+INSERT INTO
+  keyTable (keyid, keyvalue)
+VALUES
+  (?, ?);
@@ -0,0 +1,10 @@
+ALTER TABLE valueTable
+RENAME TO jsonValueTable;
+
+CREATE TABLE valueTable (
+  'keyid' INTEGER PRIMARY KEY NOT NULL,
+  'type' INT NOT NULL,
+  'value' BLOB,
+  'timeStamp' INTEGER NOT NULL,
+  FOREIGN KEY (keyid) REFERENCES keyTable (keyid)
+);
@@ -1,6 +0,0 @@
-SELECT
-  value
-FROM
-  valueTable
-WHERE
-  keyid = ?;
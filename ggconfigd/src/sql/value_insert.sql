@@ -1,4 +1,4 @@
 INSERT INTO
-  valueTable (keyid, value, timeStamp)
+  valueTable (keyid, type, value, timeStamp)
 VALUES
-  (?, ?, ?)
+  (?, ?, ?, ?)
@@ -1,5 +1,6 @@
 UPDATE valueTable
 SET
+  type = ?,
   value = ?,
   timeStamp = ?
 WHERE
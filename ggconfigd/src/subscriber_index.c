@@ -0,0 +1,108 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "subscriber_index.h"
+#include "ggconfigd.h"
+#include <ggl/cleanup.h>
+#include <ggl/core_bus/server.h>
+#include <ggl/error.h>
+#include <ggl/log.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Subscriptions are chained per bucket of key ids. Links hold an index plus
+// one, so zero-initialized links are empty.
+typedef struct {
+    bool in_use;
+    int64_t key_id;
+    uint32_t handle;
+    uint32_t next;
+} Subscriber;
+
+// Subscriptions are closed from whichever thread runs the close callback.
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static Subscriber subscribers[GGCONFIGD_MAX_SUBSCRIPTIONS];
+static uint32_t buckets[GGCONFIGD_SUBSCRIPTION_BUCKETS];
+
+static uint32_t *bucket_for(int64_t key_id) {
+    // Key ids are assigned sequentially, so low bits spread them evenly
+    return &buckets[(uint64_t) key_id % GGCONFIGD_SUBSCRIPTION_BUCKETS];
+}
+
+GglError subscriber_index_add(int64_t key_id, uint32_t handle) {
+    GGL_MTX_SCOPE_GUARD(&mtx);
+
+    for (uint32_t i = 0; i < GGCONFIGD_MAX_SUBSCRIPTIONS; i++) {
+        if (!subscribers[i].in_use) {
+            uint32_t *bucket = bucket_for(key_id);
+            subscribers[i] = (Subscriber) { .in_use = true,
+                                            .key_id = key_id,
+                                            .handle = handle,
+                                            .next = *bucket };
+            *bucket = i + 1;
+            return GGL_ERR_OK;
+        }
+    }
+
+    GGL_LOGE(
+        "Can not have more than %d configuration subscriptions.",
+        GGCONFIGD_MAX_SUBSCRIPTIONS
+    );
+    return GGL_ERR_NOMEM;
+}
+
+void subscriber_index_remove(uint32_t handle) {
+    GGL_MTX_SCOPE_GUARD(&mtx);
+
+    for (uint32_t i = 0; i < GGCONFIGD_MAX_SUBSCRIPTIONS; i++) {
+        if (!subscribers[i].in_use || (subscribers[i].handle != handle)) {
+            continue;
+        }
+
+        uint32_t *link = bucket_for(subscribers[i].key_id);
+        while (*link != i + 1) {
+            link = &subscribers[*link - 1].next;
+        }
+        *link = subscribers[i].next;
+        subscribers[i].in_use = false;
+        return;
+    }
+}
+
+size_t subscriber_index_get(
+    int64_t key_id, uint32_t *handles, size_t capacity
+) {
+    GGL_MTX_SCOPE_GUARD(&mtx);
+
+    size_t len = 0;
+    for (uint32_t link = *bucket_for(key_id); (link != 0) && (len < capacity);
+         link = subscribers[link - 1].next) {
+        if (subscribers[link - 1].key_id == key_id) {
+            handles[len++] = subscribers[link - 1].handle;
+        }
+    }
+    return len;
+}
+
+void subscriber_index_close_all(void) {
+    uint32_t handles[GGCONFIGD_MAX_SUBSCRIPTIONS];
+    size_t len = 0;
+
+    {
+        GGL_MTX_SCOPE_GUARD(&mtx);
+
+        for (uint32_t i = 0; i < GGCONFIGD_MAX_SUBSCRIPTIONS; i++) {
+            if (subscribers[i].in_use) {
+                handles[len++] = subscribers[i].handle;
+            }
+        }
+    }
+
+    // Closing runs the close callback, which removes the subscription.
+    for (size_t i = 0; i < len; i++) {
+        ggl_server_sub_close(handles[i]);
+    }
+}
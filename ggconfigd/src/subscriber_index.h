@@ -0,0 +1,29 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef GGCONFIGD_SUBSCRIBER_INDEX_H
+#define GGCONFIGD_SUBSCRIBER_INDEX_H
+
+//! Subscription handles by the key id they are subscribed to
+
+#include <ggl/error.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Subscribe handle to changes of key_id.
+GglError subscriber_index_add(int64_t key_id, uint32_t handle);
+
+/// Remove the subscription of a closed handle.
+void subscriber_index_remove(uint32_t handle);
+
+/// Copy up to capacity handles subscribed to key_id into handles, returning the
+/// number copied.
+size_t subscriber_index_get(
+    int64_t key_id, uint32_t *handles, size_t capacity
+);
+
+/// Close all subscriptions, for when key ids are no longer valid.
+void subscriber_index_close_all(void);
+
+#endif
@@ -37,7 +37,8 @@ void ggdeploymentd_start_server(void) {
     GglRpcMethodDesc handlers[] = { { GGL_STR("create_local_deployment"),
                                       false,
                                       create_local_deployment,
-                                      NULL } };
+                                      NULL,
+                                      false } };
     size_t handlers_len = sizeof(handlers) / sizeof(handlers[0]);
 
     GglError ret = ggl_listen(GGL_STR("gg_deployment"), handlers, handlers_len);
@@ -174,17 +174,19 @@ GglError run_gghealthd(void) {
         return error;
     }
     static GglRpcMethodDesc handlers[]
-        = { { GGL_STR("get_status"), false, get_status, NULL },
-            { GGL_STR("update_status"), false, update_status, NULL },
-            { GGL_STR("get_health"), false, get_health, NULL },
+        = { { GGL_STR("get_status"), false, get_status, NULL, false },
+            { GGL_STR("update_status"), false, update_status, NULL, false },
+            { GGL_STR("get_health"), false, get_health, NULL, false },
             { GGL_STR("subscribe_to_deployment_updates"),
               true,
               subscribe_to_deployment_updates,
-              NULL },
+              NULL,
+              false },
             { GGL_STR("subscribe_to_lifecycle_completion"),
               true,
               subscribe_to_lifecycle_completion,
-              NULL } };
+              NULL,
+              false } };
     static const size_t HANDLERS_LEN = sizeof(handlers) / sizeof(handlers[0]);
 
     ggl_listen(GGL_STR("gg_health"), handlers, HANDLERS_LEN);
@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "ggipcd.h"
+#include "ipc_dispatch.h"
 #include "ipc_server.h"
 #include <ggl/buffer.h>
 #include <ggl/core_bus/gg_config.h>
@@ -18,13 +19,18 @@
 uint8_t default_socket_path[PATH_MAX];
 
 GglError run_ggipcd(GglIpcArgs *args) {
+    GglError ret = ggl_ipc_dispatch_init();
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
     const char *socket_name = NULL;
     const char *socket_path;
     if (args->socket_path != NULL) {
         socket_path = args->socket_path;
     } else {
         GglBuffer path_buf = GGL_BUF(default_socket_path);
-        GglError ret = ggl_gg_config_read_str(
+        ret = ggl_gg_config_read_str(
             GGL_BUF_LIST(GGL_STR("system"), GGL_STR("rootPath")), &path_buf
         );
         if (ret != GGL_ERR_OK) {
@@ -7,22 +7,165 @@
 #include <assert.h>
 #include <ggl/buffer.h>
 #include <ggl/bump_alloc.h>
+#include <ggl/cleanup.h>
 #include <ggl/core_bus/gg_config.h>
 #include <ggl/error.h>
 #include <ggl/list.h>
 #include <ggl/log.h>
 #include <ggl/map.h>
 #include <ggl/object.h>
+#include <pthread.h>
 #include <string.h>
+#include <time.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-static GglError policy_match(
-    GglMap policy,
-    GglBuffer operation,
-    GglBuffer resource,
-    GglIpcPolicyResourceMatcher *matcher
+/// Minimum time between attempts to subscribe to policy changes.
+#define RESUBSCRIBE_INTERVAL_MS 1000U
+
+/// An operation of a policy, with the range of that policy's resources.
+typedef struct {
+    uint32_t hash;
+    GglBuffer name;
+    uint16_t resource_start;
+    uint16_t resource_count;
+} CompiledOperation;
+
+/// A component's compiled policies for a service.
+typedef struct {
+    bool in_use;
+    uint32_t hash;
+    GglBuffer component;
+    GglBuffer service;
+    /// Result when no policy allows a request; GGL_ERR_NOENTRY unless the
+    /// policies are invalid.
+    GglError deny_result;
+    uint16_t operation_count;
+    uint16_t resource_count;
+    uint16_t segment_count;
+    size_t mem_used;
+    CompiledOperation operations[GGL_IPC_POLICY_MAX_OPERATIONS];
+    GglIpcPolicyResource resources[GGL_IPC_POLICY_MAX_RESOURCES];
+    GglBuffer segments[GGL_IPC_POLICY_MAX_SEGMENTS];
+    uint8_t mem[GGL_IPC_POLICY_MAX_BYTES];
+} PolicyCacheEntry;
+
+// Looked up by IPC handlers and invalidated by the configuration subscription.
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static PolicyCacheEntry cache[GGL_IPC_POLICY_CACHE_ENTRIES];
+static size_t next_victim = 0;
+// Incremented on each invalidation, so policies read before it are not cached.
+static uint64_t generation = 0;
+static bool subscribed = false;
+static uint64_t last_subscribe_ms = 0;
+
+static uint32_t hash_buffer(GglBuffer buf) {
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < buf.len; i++) {
+        hash ^= buf.data[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static uint32_t entry_hash(GglBuffer component, GglBuffer service) {
+    return hash_buffer(component) ^ (hash_buffer(service) * 2654435761U);
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000U) + ((uint64_t) ts.tv_nsec / 1000000U);
+}
+
+static GglError entry_alloc(
+    PolicyCacheEntry *entry, size_t len, GglBuffer *out
+) {
+    if (len > sizeof(entry->mem) - entry->mem_used) {
+        return GGL_ERR_NOMEM;
+    }
+    *out = (GglBuffer) { .data = &entry->mem[entry->mem_used], .len = len };
+    entry->mem_used += len;
+    return GGL_ERR_OK;
+}
+
+static GglError entry_copy(
+    PolicyCacheEntry *entry, GglBuffer buf, GglBuffer *out
 ) {
+    GglError ret = entry_alloc(entry, buf.len, out);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    if (buf.len > 0) {
+        memcpy(out->data, buf.data, buf.len);
+    }
+    return GGL_ERR_OK;
+}
+
+static GglError compile_resource(PolicyCacheEntry *entry, GglBuffer resource) {
+    if (entry->resource_count >= GGL_IPC_POLICY_MAX_RESOURCES) {
+        return GGL_ERR_NOMEM;
+    }
+    GglIpcPolicyResource *compiled = &entry->resources[entry->resource_count];
+
+    GglError ret = entry_copy(entry, resource, &compiled->raw);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    // Resolving escapes only removes characters
+    GglBuffer pattern;
+    ret = entry_alloc(entry, resource.len, &pattern);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    compiled->segments = &entry->segments[entry->segment_count];
+    compiled->segment_count = 0;
+    bool in_escape = false;
+    size_t write_pos = 0;
+    size_t segment_start = 0;
+    for (size_t i = 0; i <= resource.len; i++) {
+        bool segment_end = i == resource.len;
+        if (!segment_end) {
+            uint8_t c = resource.data[i];
+            if (in_escape) {
+                if (c == (uint8_t) '}') {
+                    in_escape = false;
+                    continue;
+                }
+            } else {
+                if ((c == (uint8_t) '$') && (i < resource.len - 1)
+                    && (resource.data[i + 1] == (uint8_t) '{')) {
+                    in_escape = true;
+                    i += 1;
+                    continue;
+                }
+                segment_end = c == (uint8_t) '*';
+            }
+            if (!segment_end) {
+                pattern.data[write_pos] = c;
+                write_pos += 1;
+                continue;
+            }
+        }
+
+        if (entry->segment_count >= GGL_IPC_POLICY_MAX_SEGMENTS) {
+            return GGL_ERR_NOMEM;
+        }
+        entry->segments[entry->segment_count]
+            = ggl_buffer_substr(pattern, segment_start, write_pos);
+        entry->segment_count += 1;
+        compiled->segment_count += 1;
+        segment_start = write_pos;
+    }
+
+    entry->resource_count += 1;
+    return GGL_ERR_OK;
+}
+
+static GglError compile_policy(PolicyCacheEntry *entry, GglMap policy) {
     GglObject *operations_obj;
     GglObject *resources_obj;
     GglError ret = ggl_map_validate(
@@ -32,47 +175,310 @@ static GglError policy_match(
             { GGL_STR("resources"), true, GGL_TYPE_LIST, &resources_obj },
         )
     );
-    if (ret != GGL_ERR_OK) {
-        return GGL_ERR_CONFIG;
+    if ((ret != GGL_ERR_OK)
+        || (ggl_list_type_check(operations_obj->list, GGL_TYPE_BUF)
+            != GGL_ERR_OK)
+        || (ggl_list_type_check(resources_obj->list, GGL_TYPE_BUF)
+            != GGL_ERR_OK)) {
+        // Malformed policies allow nothing, but do not affect other policies
+        GGL_LOGW("Skipping invalid accessControl policy.");
+        return GGL_ERR_OK;
+    }
+
+    uint16_t resource_start = entry->resource_count;
+    GGL_LIST_FOREACH(resource, resources_obj->list) {
+        ret = compile_resource(entry, resource->buf);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
     }
-    GglList policy_operations = operations_obj->list;
-    GglList policy_resources = resources_obj->list;
+    uint16_t resource_count = entry->resource_count - resource_start;
 
-    ret = ggl_list_type_check(policy_operations, GGL_TYPE_BUF);
+    GGL_LIST_FOREACH(operation, operations_obj->list) {
+        if (entry->operation_count >= GGL_IPC_POLICY_MAX_OPERATIONS) {
+            return GGL_ERR_NOMEM;
+        }
+        CompiledOperation *compiled
+            = &entry->operations[entry->operation_count];
+        ret = entry_copy(entry, operation->buf, &compiled->name);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        compiled->hash = hash_buffer(operation->buf);
+        compiled->resource_start = resource_start;
+        compiled->resource_count = resource_count;
+        entry->operation_count += 1;
+    }
+
+    return GGL_ERR_OK;
+}
+
+static GglError compile_policies(
+    PolicyCacheEntry *entry,
+    GglBuffer component,
+    GglBuffer service,
+    GglObject policies
+) {
+    *entry = (PolicyCacheEntry) { .in_use = true,
+                                  .hash = entry_hash(component, service),
+                                  .deny_result = GGL_ERR_NOENTRY };
+
+    GglError ret = entry_copy(entry, component, &entry->component);
     if (ret != GGL_ERR_OK) {
-        return GGL_ERR_CONFIG;
+        return ret;
+    }
+    ret = entry_copy(entry, service, &entry->service);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    if (policies.type != GGL_TYPE_MAP) {
+        GGL_LOGE("Configuration's accessControl is not a map.");
+        entry->deny_result = GGL_ERR_CONFIG;
+        return GGL_ERR_OK;
+    }
+
+    GGL_MAP_FOREACH(policy_kv, policies.map) {
+        if (policy_kv->val.type != GGL_TYPE_MAP) {
+            // Policies before an invalid one still apply
+            GGL_LOGE("Policy value is not a map.");
+            entry->deny_result = GGL_ERR_CONFIG;
+            return GGL_ERR_OK;
+        }
+        ret = compile_policy(entry, policy_kv->val.map);
+        if (ret != GGL_ERR_OK) {
+            GGL_LOGW(
+                "Policies of component %.*s for service %.*s are too large to "
+                "cache; checking them on each request.",
+                (int) component.len,
+                component.data,
+                (int) service.len,
+                service.data
+            );
+            return ret;
+        }
     }
-    ret = ggl_list_type_check(policy_resources, GGL_TYPE_BUF);
+
+    return GGL_ERR_OK;
+}
+
+static GglError entry_check(
+    const PolicyCacheEntry *entry,
+    GglBuffer operation,
+    GglBuffer resource,
+    GglIpcPolicyResourceMatcher *matcher
+) {
+    uint32_t hash = hash_buffer(operation);
+    for (size_t i = 0; i < entry->operation_count; i++) {
+        const CompiledOperation *op = &entry->operations[i];
+        if ((op->hash != hash) || !ggl_buffer_eq(op->name, operation)) {
+            continue;
+        }
+        for (size_t j = 0; j < op->resource_count; j++) {
+            const GglIpcPolicyResource *policy_resource
+                = &entry->resources[op->resource_start + j];
+            if (ggl_buffer_eq(GGL_STR("*"), policy_resource->raw)
+                || matcher(resource, policy_resource)) {
+                return GGL_ERR_OK;
+            }
+        }
+    }
+    return entry->deny_result;
+}
+
+/// Whether a policy resource read from configuration allows resource.
+static bool uncompiled_resource_match(
+    GglBuffer resource,
+    GglBuffer policy_resource,
+    GglIpcPolicyResourceMatcher *matcher
+) {
+    if (ggl_buffer_eq(GGL_STR("*"), policy_resource)) {
+        return true;
+    }
+
+    // Compiled alone, so only a single resource must fit in an entry
+    static PolicyCacheEntry resource_entry;
+    resource_entry = (PolicyCacheEntry) { 0 };
+    GglError ret = compile_resource(&resource_entry, policy_resource);
     if (ret != GGL_ERR_OK) {
+        GGL_LOGW("Skipping accessControl resource too large to match.");
+        return false;
+    }
+    return matcher(resource, &resource_entry.resources[0]);
+}
+
+/// Check policies too large for a cache entry as read from configuration,
+/// with the same result compiling them would have.
+static GglError uncompiled_check(
+    GglObject policies,
+    GglBuffer operation,
+    GglBuffer resource,
+    GglIpcPolicyResourceMatcher *matcher
+) {
+    if (policies.type != GGL_TYPE_MAP) {
         return GGL_ERR_CONFIG;
     }
 
-    GGL_LIST_FOREACH(policy_operation, policy_operations) {
-        if (ggl_buffer_eq(operation, policy_operation->buf)) {
-            GGL_LIST_FOREACH(policy_resource, policy_resources) {
-                if (ggl_buffer_eq(GGL_STR("*"), policy_resource->buf)
-                    || matcher(resource, policy_resource->buf)) {
+    GGL_MAP_FOREACH(policy_kv, policies.map) {
+        if (policy_kv->val.type != GGL_TYPE_MAP) {
+            return GGL_ERR_CONFIG;
+        }
+
+        GglObject *operations_obj;
+        GglObject *resources_obj;
+        GglError ret = ggl_map_validate(
+            policy_kv->val.map,
+            GGL_MAP_SCHEMA(
+                { GGL_STR("operations"), true, GGL_TYPE_LIST, &operations_obj },
+                { GGL_STR("resources"), true, GGL_TYPE_LIST, &resources_obj },
+            )
+        );
+        if ((ret != GGL_ERR_OK)
+            || (ggl_list_type_check(operations_obj->list, GGL_TYPE_BUF)
+                != GGL_ERR_OK)
+            || (ggl_list_type_check(resources_obj->list, GGL_TYPE_BUF)
+                != GGL_ERR_OK)) {
+            continue;
+        }
+
+        GGL_LIST_FOREACH(policy_operation, operations_obj->list) {
+            if (!ggl_buffer_eq(operation, policy_operation->buf)) {
+                continue;
+            }
+            GGL_LIST_FOREACH(policy_resource, resources_obj->list) {
+                if (uncompiled_resource_match(
+                        resource, policy_resource->buf, matcher
+                    )) {
                     return GGL_ERR_OK;
                 }
             }
-            return GGL_ERR_FAILURE;
+            break;
         }
     }
 
     return GGL_ERR_NOENTRY;
 }
 
-GglError ggl_ipc_auth(
-    const GglIpcOperationInfo *info,
-    GglBuffer resource,
-    GglIpcPolicyResourceMatcher *matcher
+static PolicyCacheEntry *find_entry(GglBuffer component, GglBuffer service) {
+    uint32_t hash = entry_hash(component, service);
+    for (size_t i = 0; i < GGL_IPC_POLICY_CACHE_ENTRIES; i++) {
+        if (cache[i].in_use && (cache[i].hash == hash)
+            && ggl_buffer_eq(cache[i].component, component)
+            && ggl_buffer_eq(cache[i].service, service)) {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+static PolicyCacheEntry *victim_entry(void) {
+    for (size_t i = 0; i < GGL_IPC_POLICY_CACHE_ENTRIES; i++) {
+        if (!cache[i].in_use) {
+            return &cache[i];
+        }
+    }
+    PolicyCacheEntry *entry = &cache[next_victim];
+    next_victim = (next_victim + 1) % GGL_IPC_POLICY_CACHE_ENTRIES;
+    return entry;
+}
+
+static void invalidate_all(void) {
+    for (size_t i = 0; i < GGL_IPC_POLICY_CACHE_ENTRIES; i++) {
+        cache[i].in_use = false;
+    }
+    generation += 1;
+}
+
+static GglError policy_change_callback(
+    void *ctx, uint32_t handle, GglObject data
 ) {
-    assert(info != NULL);
+    (void) ctx;
+    (void) handle;
 
-    static uint8_t policy_mem[4096];
-    GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(policy_mem));
+    if ((data.type != GGL_TYPE_LIST)
+        || (ggl_list_type_check(data.list, GGL_TYPE_BUF) != GGL_ERR_OK)) {
+        GGL_LOGE("Received invalid configuration change notification.");
+        return GGL_ERR_FAILURE;
+    }
+    GglObject *path = data.list.items;
+    size_t path_len = data.list.len;
 
-    GglObject policies;
+    // Only changes to services/<component>/configuration/accessControl/
+    // <service>, or keys containing it, affect policies.
+    bool in_configuration = (path_len < 3)
+        || ggl_buffer_eq(path[2].buf, GGL_STR("configuration"));
+    bool in_access_control = (path_len < 4)
+        || ggl_buffer_eq(path[3].buf, GGL_STR("accessControl"));
+    if (!in_configuration || !in_access_control) {
+        return GGL_ERR_OK;
+    }
+
+    GGL_MTX_SCOPE_GUARD(&mtx);
+
+    if (path_len < 2) {
+        invalidate_all();
+        return GGL_ERR_OK;
+    }
+    for (size_t i = 0; i < GGL_IPC_POLICY_CACHE_ENTRIES; i++) {
+        bool affected = cache[i].in_use
+            && ggl_buffer_eq(cache[i].component, path[1].buf)
+            && ((path_len < 5) || ggl_buffer_eq(cache[i].service, path[4].buf));
+        if (affected) {
+            cache[i].in_use = false;
+        }
+    }
+    generation += 1;
+    return GGL_ERR_OK;
+}
+
+static void policy_change_close_callback(void *ctx, uint32_t handle) {
+    (void) ctx;
+    (void) handle;
+
+    GGL_LOGW("Configuration subscription closed; not caching IPC policies.");
+
+    GGL_MTX_SCOPE_GUARD(&mtx);
+    subscribed = false;
+    invalidate_all();
+}
+
+/// Returns whether policy changes are being tracked, subscribing if needed.
+static bool policy_changes_tracked(void) {
+    {
+        GGL_MTX_SCOPE_GUARD(&mtx);
+        if (subscribed) {
+            return true;
+        }
+        uint64_t now = now_ms();
+        if ((last_subscribe_ms != 0)
+            && (now - last_subscribe_ms < RESUBSCRIBE_INTERVAL_MS)) {
+            return false;
+        }
+        last_subscribe_ms = now;
+    }
+
+    // Policies cached before this point may have changed untracked
+    GglError ret = ggl_gg_config_subscribe(
+        GGL_BUF_LIST(GGL_STR("services")),
+        policy_change_callback,
+        policy_change_close_callback,
+        NULL,
+        NULL
+    );
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGW("Failed to subscribe to policy changes; not caching them.");
+        return false;
+    }
+
+    GGL_MTX_SCOPE_GUARD(&mtx);
+    invalidate_all();
+    subscribed = true;
+    return true;
+}
+
+static GglError read_policies(
+    const GglIpcOperationInfo *info, GglAlloc *alloc, GglObject *policies
+) {
     GglError ret = ggl_gg_config_read(
         GGL_BUF_LIST(
             GGL_STR("services"),
@@ -81,8 +487,8 @@ GglError ggl_ipc_auth(
             GGL_STR("accessControl"),
             info->service
         ),
-        &balloc.alloc,
-        &policies
+        alloc,
+        policies
     );
     if (ret != GGL_ERR_OK) {
         GGL_LOGE(
@@ -92,89 +498,105 @@ GglError ggl_ipc_auth(
             (int) info->component.len,
             info->component.data
         );
-        return ret;
     }
+    return ret;
+}
 
-    if (policies.type != GGL_TYPE_MAP) {
-        GGL_LOGE("Configuration's accessControl is not a map.");
-        return GGL_ERR_CONFIG;
+GglError ggl_ipc_auth(
+    const GglIpcOperationInfo *info,
+    GglBuffer resource,
+    GglIpcPolicyResourceMatcher *matcher
+) {
+    assert(info != NULL);
+
+    uint64_t read_generation;
+    {
+        GGL_MTX_SCOPE_GUARD(&mtx);
+        PolicyCacheEntry *entry = find_entry(info->component, info->service);
+        if (entry != NULL) {
+            return entry_check(entry, info->operation, resource, matcher);
+        }
+        read_generation = generation;
     }
 
-    GglMap policy_map = policies.map;
+    bool cacheable = policy_changes_tracked();
+    if (cacheable) {
+        GGL_MTX_SCOPE_GUARD(&mtx);
+        // Subscribing invalidates the cache
+        read_generation = generation;
+    }
 
-    GGL_MAP_FOREACH(policy_kv, policy_map) {
-        GglObject policy = policy_kv->val;
-        if (policy.type != GGL_TYPE_MAP) {
-            GGL_LOGE("Policy value is not a map.");
-            return GGL_ERR_CONFIG;
+    uint8_t policy_mem[4096];
+    GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(policy_mem));
+    GglObject policies;
+    GglError ret = read_policies(info, &balloc.alloc, &policies);
+    if (ret == GGL_ERR_NOENTRY) {
+        // No policies for the service deny all its operations
+        policies = GGL_OBJ_MAP((GglMap) { 0 });
+    } else if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    GGL_MTX_SCOPE_GUARD(&mtx);
+
+    // Compile in place if the result can be kept, else in a spare entry
+    static PolicyCacheEntry uncached_entry;
+    PolicyCacheEntry *entry = &uncached_entry;
+    if (cacheable && (generation == read_generation)) {
+        entry = find_entry(info->component, info->service);
+        if (entry == NULL) {
+            entry = victim_entry();
         }
+    }
 
-        ret = policy_match(policy.map, info->operation, resource, matcher);
-        if (ret == GGL_ERR_OK) {
-            return GGL_ERR_OK;
+    ret = compile_policies(entry, info->component, info->service, policies);
+    if (ret != GGL_ERR_OK) {
+        entry->in_use = false;
+        if (ret != GGL_ERR_NOMEM) {
+            return ret;
         }
+        return uncompiled_check(policies, info->operation, resource, matcher);
+    }
+    if (entry == &uncached_entry) {
+        entry->in_use = false;
     }
 
-    return GGL_ERR_NOENTRY;
+    GGL_LOGD(
+        "Compiled %u operations of component %.*s for service %.*s.",
+        entry->operation_count,
+        (int) info->component.len,
+        info->component.data,
+        (int) info->service.len,
+        info->service.data
+    );
+    return entry_check(entry, info->operation, resource, matcher);
 }
 
 bool ggl_ipc_default_policy_matcher(
-    GglBuffer request_resource, GglBuffer policy_resource
+    GglBuffer request_resource, const GglIpcPolicyResource *policy_resource
 ) {
-    GglBuffer pattern = policy_resource;
-    bool in_escape = false;
-    size_t write_pos = 0;
-    for (size_t i = 0; i < pattern.len; i++) {
-        uint8_t c = pattern.data[i];
-        if (in_escape) {
-            if (c == (uint8_t) '}') {
-                in_escape = false;
-                continue;
-            }
-        } else {
-            if (c == (uint8_t) '*') {
-                pattern.data[write_pos] = (uint8_t) '\0';
-                write_pos += 1;
-                continue;
-            }
-            if ((c == (uint8_t) '$') && (i < pattern.len - 1)
-                && (pattern.data[i + 1] == (uint8_t) '{')) {
-                in_escape = true;
-                i += 1;
-                continue;
-            }
-        }
+    const GglBuffer *segments = policy_resource->segments;
+    size_t last = policy_resource->segment_count - 1;
 
-        pattern.data[write_pos] = c;
-        write_pos += 1;
+    if (last == 0) {
+        return ggl_buffer_eq(request_resource, segments[0]);
     }
-    pattern.len = write_pos;
 
-    GglBuffer remaining = request_resource;
-    size_t start = 0;
-    for (size_t i = 0; i < pattern.len; i++) {
-        if (pattern.data[i] == (uint8_t) '\0') {
-            GglBuffer segment = ggl_buffer_substr(pattern, start, i);
-            bool match;
-            size_t match_start = 0;
-            if (start == 0) {
-                match = ggl_buffer_has_prefix(remaining, segment);
-            } else {
-                match = ggl_buffer_contains(remaining, segment, &match_start);
-            }
-            if (!match) {
-                return false;
-            }
-            remaining = ggl_buffer_substr(
-                remaining, match_start + segment.len, SIZE_MAX
-            );
-            start = i + 1;
-        }
+    if (!ggl_buffer_has_prefix(request_resource, segments[0])) {
+        return false;
     }
+    GglBuffer remaining
+        = ggl_buffer_substr(request_resource, segments[0].len, SIZE_MAX);
 
-    if (start == 0) {
-        return ggl_buffer_eq(remaining, pattern);
+    for (size_t i = 1; i < last; i++) {
+        size_t match_start = 0;
+        if (!ggl_buffer_contains(remaining, segments[i], &match_start)) {
+            return false;
+        }
+        remaining = ggl_buffer_substr(
+            remaining, match_start + segments[i].len, SIZE_MAX
+        );
     }
-    GglBuffer segment = ggl_buffer_substr(pattern, start, SIZE_MAX);
-    return ggl_buffer_has_suffix(remaining, segment);
+
+    return ggl_buffer_has_suffix(remaining, segments[last]);
 }
@@ -9,11 +9,51 @@
 #include <ggl/buffer.h>
 #include <ggl/error.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+/// Maximum number of component and service pairs with cached policies.
+/// Can be configured with `-DGGL_IPC_POLICY_CACHE_ENTRIES=<N>`.
+#ifndef GGL_IPC_POLICY_CACHE_ENTRIES
+#define GGL_IPC_POLICY_CACHE_ENTRIES 32
+#endif
+
+/// Maximum size of the strings in one component's policies for a service.
+/// Policies over this or the limits below are not cached, and are read from
+/// configuration on each request.
+/// Can be configured with `-DGGL_IPC_POLICY_MAX_BYTES=<N>`.
+#ifndef GGL_IPC_POLICY_MAX_BYTES
+#define GGL_IPC_POLICY_MAX_BYTES 2048
+#endif
+
+/// Maximum number of operations, resources, and wildcard separated resource
+/// segments in one component's policies for a service.
+#ifndef GGL_IPC_POLICY_MAX_OPERATIONS
+#define GGL_IPC_POLICY_MAX_OPERATIONS 32
+#endif
+#ifndef GGL_IPC_POLICY_MAX_RESOURCES
+#define GGL_IPC_POLICY_MAX_RESOURCES 32
+#endif
+#ifndef GGL_IPC_POLICY_MAX_SEGMENTS
+#define GGL_IPC_POLICY_MAX_SEGMENTS 64
+#endif
+
+/// A policy resource, with its wildcards compiled.
+typedef struct {
+    /// Resource as configured.
+    GglBuffer raw;
+    /// Text between `*` wildcards, with `${}` escapes resolved. A resource
+    /// without wildcards has one segment.
+    const GglBuffer *segments;
+    size_t segment_count;
+} GglIpcPolicyResource;
 
 typedef bool GglIpcPolicyResourceMatcher(
-    GglBuffer request_resource, GglBuffer policy_resource
+    GglBuffer request_resource, const GglIpcPolicyResource *policy_resource
 );
 
+/// Check whether the calling component's accessControl policies allow the
+/// operation on resource. Policies are compiled on first use and cached until
+/// their configuration changes.
 GglError ggl_ipc_auth(
     const GglIpcOperationInfo *info,
     GglBuffer resource,
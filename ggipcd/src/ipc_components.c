@@ -8,11 +8,14 @@
 #include <ggl/base64.h>
 #include <ggl/buffer.h>
 #include <ggl/bump_alloc.h>
+#include <ggl/cleanup.h>
 #include <ggl/error.h>
 #include <ggl/log.h>
 #include <ggl/object.h>
 #include <ggl/rand.h>
+#include <pthread.h>
 #include <string.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -45,7 +48,11 @@ static uint8_t component_names[GGL_MAX_GENERIC_COMPONENTS]
                               [MAX_COMPONENT_NAME_LENGTH];
 static uint8_t component_name_lengths[GGL_MAX_GENERIC_COMPONENTS];
 
-static GglComponentHandle registered_components = 0;
+/// Serializes registration, as clients connect from multiple threads.
+static pthread_mutex_t registration_mtx = PTHREAD_MUTEX_INITIALIZER;
+/// A component's entry is filled in before it is counted, so registered
+/// entries can be read without the lock.
+static _Atomic(GglComponentHandle) registered_components = 0;
 
 GglBuffer ggl_ipc_components_get_name(GglComponentHandle component_handle) {
     assert(component_handle != 0);
@@ -105,6 +112,8 @@ GglError ggl_ipc_components_get_handle(
             return GGL_ERR_INVALID;
         }
 
+        GGL_MTX_SCOPE_GUARD(&registration_mtx);
+
         for (GglComponentHandle i = 1; i <= registered_components; i++) {
             if (ggl_buffer_eq(svcuid, ggl_ipc_components_get_name(i))) {
                 *component_handle = i;
@@ -113,9 +122,9 @@ GglError ggl_ipc_components_get_handle(
         }
 
         if (registered_components < GGL_MAX_GENERIC_COMPONENTS) {
-            registered_components += 1;
-            *component_handle = registered_components;
+            *component_handle = registered_components + 1;
             set_component_name(*component_handle, svcuid);
+            registered_components += 1;
             return GGL_ERR_OK;
         }
 
@@ -149,6 +158,8 @@ GglError ggl_ipc_components_register(
         return ret;
     }
 
+    GGL_MTX_SCOPE_GUARD(&registration_mtx);
+
     for (GglComponentHandle i = 1; i <= registered_components; i++) {
         if (ggl_buffer_eq(component_name, ggl_ipc_components_get_name(i))) {
             *component_handle = i;
@@ -173,14 +184,14 @@ GglError ggl_ipc_components_register(
         component_name.data
     );
 
-    registered_components += 1;
-    *component_handle = registered_components;
+    *component_handle = registered_components + 1;
     set_component_name(*component_handle, component_name);
 
     ret = ggl_rand_fill(GGL_BUF(svcuids[*component_handle - 1]));
     if (ret != GGL_ERR_OK) {
         return GGL_ERR_FATAL;
     }
+    registered_components += 1;
     get_svcuid(*component_handle, svcuid);
 
     return GGL_ERR_OK;
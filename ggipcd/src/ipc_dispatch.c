@@ -5,11 +5,15 @@
 #include "ipc_dispatch.h"
 #include "ipc_server.h"
 #include "ipc_service.h"
+#include <ggl/alloc.h>
 #include <ggl/buffer.h>
-#include <ggl/bump_alloc.h>
 #include <ggl/error.h>
 #include <ggl/log.h>
 #include <ggl/object.h>
+#include <inttypes.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -21,65 +25,164 @@ static const GglIpcService *const SERVICE_TABLE[]
 static const size_t SERVICE_COUNT
     = sizeof(SERVICE_TABLE) / sizeof(SERVICE_TABLE[0]);
 
-GglError ggl_ipc_handle_operation(
-    GglBuffer operation, GglMap args, uint32_t handle, int32_t stream_id
-) {
+/// Number of operation hash table slots; a power of two at least twice the
+/// number of operations.
+#define DISPATCH_SLOTS 64
+
+/// Minimum time between info logs of an operation.
+#define OPERATION_LOG_INTERVAL_MS 10000U
+
+typedef struct {
+    const GglIpcService *service;
+    const GglIpcOperation *operation;
+    uint32_t hash;
+    // Requests since the operation was last logged at info level. Updated
+    // concurrently by the IPC worker threads.
+    _Atomic(uint32_t) unlogged;
+    _Atomic(uint64_t) last_logged_ms;
+} DispatchSlot;
+
+static DispatchSlot dispatch_table[DISPATCH_SLOTS];
+
+static uint32_t hash_buffer(GglBuffer buf) {
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < buf.len; i++) {
+        hash ^= buf.data[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+GglError ggl_ipc_dispatch_init(void) {
+    size_t operation_count = 0;
     for (size_t i = 0; i < SERVICE_COUNT; i++) {
         const GglIpcService *service = SERVICE_TABLE[i];
-        GGL_LOGT(
-            "Matching against service: %.*s.",
-            (int) service->name.len,
-            service->name.data
-        );
-
         for (size_t j = 0; j < service->operation_count; j++) {
-            const GglIpcOperation *service_op = &service->operations[j];
-
-            GGL_LOGT(
-                "Matching against operation: %.*s.",
-                (int) service_op->name.len,
-                service_op->name.data
-            );
-
-            if (ggl_buffer_eq(operation, service_op->name)) {
-                GglIpcOperationInfo info = {
-                    .service = service->name,
-                    .operation = operation,
-                };
-                GglError ret
-                    = ggl_ipc_get_component_name(handle, &info.component);
-                if (ret != GGL_ERR_OK) {
+            const GglIpcOperation *operation = &service->operations[j];
+
+            // Keeps probe sequences short, and ensures they end
+            if ((operation_count + 1) * 2 > DISPATCH_SLOTS) {
+                GGL_LOGE("Too many IPC operations for dispatch table.");
+                return GGL_ERR_NOMEM;
+            }
+
+            uint32_t hash = hash_buffer(operation->name);
+            size_t slot = hash % DISPATCH_SLOTS;
+            while (dispatch_table[slot].operation != NULL) {
+                if (ggl_buffer_eq(
+                        dispatch_table[slot].operation->name, operation->name
+                    )) {
                     GGL_LOGE(
-                        "Failed component name lookup for IPC operation %.*s",
-                        (int) operation.len,
-                        operation.data
+                        "Duplicate IPC operation %.*s.",
+                        (int) operation->name.len,
+                        operation->name.data
                     );
-                    return ret;
+                    return GGL_ERR_CONFIG;
                 }
-
-                GGL_LOGI(
-                    "Received IPC operation %.*s from component %.*s.",
-                    (int) operation.len,
-                    operation.data,
-                    (int) info.component.len,
-                    info.component.data
-                );
-                static uint8_t resp_mem
-                    [(GGL_IPC_PAYLOAD_MAX_SUBOBJECTS * sizeof(GglObject))
-                     + GGL_IPC_MAX_MSG_LEN];
-                GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(resp_mem));
-
-                return service_op->handler(
-                    &info, args, handle, stream_id, &balloc.alloc
-                );
+                slot = (slot + 1) % DISPATCH_SLOTS;
             }
+            dispatch_table[slot] = (DispatchSlot) {
+                .service = service,
+                .operation = operation,
+                .hash = hash,
+            };
+            operation_count += 1;
         }
     }
+    return GGL_ERR_OK;
+}
+
+static DispatchSlot *lookup_operation(GglBuffer operation) {
+    uint32_t hash = hash_buffer(operation);
+    for (size_t slot = hash % DISPATCH_SLOTS;
+         dispatch_table[slot].operation != NULL;
+         slot = (slot + 1) % DISPATCH_SLOTS) {
+        if ((dispatch_table[slot].hash == hash)
+            && ggl_buffer_eq(dispatch_table[slot].operation->name, operation)) {
+            return &dispatch_table[slot];
+        }
+    }
+    return NULL;
+}
 
-    GGL_LOGW(
-        "Unhandled operation requested: %.*s.",
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ((uint64_t) ts.tv_sec * 1000U) + ((uint64_t) ts.tv_nsec / 1000000U);
+}
+
+static void log_operation(DispatchSlot *slot, GglBuffer component) {
+    GglBuffer operation = slot->operation->name;
+    GGL_LOGD(
+        "Received IPC operation %.*s from component %.*s.",
+        (int) operation.len,
+        operation.data,
+        (int) component.len,
+        component.data
+    );
+
+    // Frequent operations are logged at info level once per interval, with
+    // the count of requests from all components
+    atomic_fetch_add_explicit(&slot->unlogged, 1, memory_order_relaxed);
+    uint64_t now = now_ms();
+    uint64_t last = atomic_load_explicit(
+        &slot->last_logged_ms, memory_order_relaxed
+    );
+    if ((last != 0) && (now - last < OPERATION_LOG_INTERVAL_MS)) {
+        return;
+    }
+    // Only the thread that advances the timestamp logs the count
+    bool claimed = atomic_compare_exchange_strong_explicit(
+        &slot->last_logged_ms,
+        &last,
+        now,
+        memory_order_relaxed,
+        memory_order_relaxed
+    );
+    if (!claimed) {
+        return;
+    }
+    GGL_LOGI(
+        "Received IPC operation %.*s (%" PRIu32 " since last logged).",
         (int) operation.len,
-        operation.data
+        operation.data,
+        atomic_exchange_explicit(&slot->unlogged, 0, memory_order_relaxed)
     );
-    return GGL_ERR_NOENTRY;
+}
+
+GglError ggl_ipc_handle_operation(
+    GglBuffer operation,
+    GglMap args,
+    uint32_t handle,
+    int32_t stream_id,
+    GglAlloc *alloc
+) {
+    DispatchSlot *slot = lookup_operation(operation);
+    if (slot == NULL) {
+        GGL_LOGW(
+            "Unhandled operation requested: %.*s.",
+            (int) operation.len,
+            operation.data
+        );
+        return GGL_ERR_NOENTRY;
+    }
+
+    GglIpcOperationInfo info = {
+        .service = slot->service->name,
+        .operation = operation,
+    };
+    GglError ret = ggl_ipc_get_component_name(handle, &info.component);
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGE(
+            "Failed component name lookup for IPC operation %.*s",
+            (int) operation.len,
+            operation.data
+        );
+        return ret;
+    }
+
+    log_operation(slot, info.component);
+
+    return slot->operation->handler(&info, args, handle, stream_id, alloc);
 }
@@ -5,13 +5,24 @@
 #ifndef GGL_IPC_DISPATCH_H
 #define GGL_IPC_DISPATCH_H
 
+#include <ggl/alloc.h>
 #include <ggl/buffer.h>
 #include <ggl/error.h>
 #include <ggl/object.h>
 #include <stdint.h>
 
+/// Index the IPC services' operations for dispatch. Must be called before
+/// handling requests.
+GglError ggl_ipc_dispatch_init(void);
+
+/// Handle an IPC operation request. `alloc` provides the handler's memory for
+/// building its response.
 GglError ggl_ipc_handle_operation(
-    GglBuffer operation, GglMap args, uint32_t handle, int32_t stream_id
+    GglBuffer operation,
+    GglMap args,
+    uint32_t handle,
+    int32_t stream_id,
+    GglAlloc *alloc
 );
 
 #endif
@@ -27,37 +27,114 @@
 #include <ggl/socket_server.h>
 #include <pthread.h>
 #include <string.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-/// Maximum number of GG IPC clients.
-/// Can be configured with `-DGGL_IPC_MAX_CLIENTS=<N>`.
-#ifndef GGL_IPC_MAX_CLIENTS
-#define GGL_IPC_MAX_CLIENTS 50
-#endif
-
 static_assert(
     GGL_IPC_MAX_MSG_LEN >= 16, "Minimum EventStream packet size is 16."
 );
 
+/// Encode buffer for responses sent from threads other than the workers, such
+/// as subscription responses.
 static uint8_t resp_array[GGL_IPC_MAX_MSG_LEN];
 static pthread_mutex_t resp_array_mtx = PTHREAD_MUTEX_INITIALIZER;
 
+/// State for a thread handling client requests.
+typedef struct {
+    uint8_t payload_array[GGL_IPC_MAX_MSG_LEN];
+    alignas(GglObject) uint8_t json_decode_mem
+        [GGL_IPC_PAYLOAD_MAX_SUBOBJECTS * sizeof(GglObject)];
+    /// Memory for the operation handler's response.
+    alignas(GglObject) uint8_t operation_mem
+        [(GGL_IPC_PAYLOAD_MAX_SUBOBJECTS * sizeof(GglObject))
+         + GGL_IPC_MAX_MSG_LEN];
+    uint8_t resp_array[GGL_IPC_MAX_MSG_LEN];
+} WorkerState;
+
+static WorkerState workers[GGL_IPC_MAX_WORKERS];
+static atomic_size_t workers_started = 0;
+/// Set for threads handling client requests.
+static _Thread_local WorkerState *worker = NULL;
+
+/// Keeps packets to a client whole when written from multiple threads.
+static pthread_mutex_t client_write_mtx[GGL_IPC_MAX_CLIENTS];
+
 static GglComponentHandle client_components[GGL_IPC_MAX_CLIENTS];
 
 static GglError reset_client_state(uint32_t handle, size_t index);
-static GglError release_client_subscriptions(uint32_t handle, size_t index);
+static void release_client_subscriptions(uint32_t handle);
 
 static GglSocketPool pool = {
     .max_fds = GGL_IPC_MAX_CLIENTS,
     .fds = (int32_t[GGL_IPC_MAX_CLIENTS]) { 0 },
     .generations = (uint16_t[GGL_IPC_MAX_CLIENTS]) { 0 },
+    .in_use = (uint16_t[GGL_IPC_MAX_CLIENTS]) { 0 },
     .on_register = reset_client_state,
-    .on_release = release_client_subscriptions,
+    .on_close = release_client_subscriptions,
 };
 
 __attribute__((constructor)) static void init_client_pool(void) {
     ggl_socket_pool_init(&pool);
+    for (size_t i = 0; i < GGL_IPC_MAX_CLIENTS; i++) {
+        pthread_mutex_init(&client_write_mtx[i], NULL);
+    }
+}
+
+static WorkerState *get_worker(void) {
+    if (worker == NULL) {
+        size_t index = atomic_fetch_add(&workers_started, 1);
+        assert(index < GGL_IPC_MAX_WORKERS);
+        worker = &workers[index];
+    }
+    return worker;
+}
+
+static GglError write_packet(uint32_t handle, GglBuffer packet) {
+    // Handles from the pool are the slot index plus one in the low bits
+    size_t index = (size_t) (handle & UINT16_MAX) - 1U;
+    if (index >= GGL_IPC_MAX_CLIENTS) {
+        GGL_LOGE("Invalid handle %u.", handle);
+        return GGL_ERR_INVALID;
+    }
+
+    GGL_MTX_SCOPE_GUARD(&client_write_mtx[index]);
+    return ggl_socket_handle_write(&pool, handle, packet);
+}
+
+static GglError encode_packet(
+    GglBuffer buf,
+    uint32_t handle,
+    const EventStreamHeader *headers,
+    size_t header_count,
+    GglReader payload
+) {
+    GglError ret = eventstream_encode(&buf, headers, header_count, payload);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    return write_packet(handle, buf);
+}
+
+/// Encode and send a packet to a client. Workers encode into their own buffer.
+static GglError send_packet(
+    uint32_t handle,
+    const EventStreamHeader *headers,
+    size_t header_count,
+    GglReader payload
+) {
+    if (worker != NULL) {
+        return encode_packet(
+            GGL_BUF(worker->resp_array), handle, headers, header_count, payload
+        );
+    }
+
+    GGL_MTX_SCOPE_GUARD(&resp_array_mtx);
+    return encode_packet(
+        GGL_BUF(resp_array), handle, headers, header_count, payload
+    );
 }
 
 static GglError reset_client_state(uint32_t handle, size_t index) {
@@ -66,17 +143,17 @@ static GglError reset_client_state(uint32_t handle, size_t index) {
     return GGL_ERR_OK;
 }
 
-static GglError release_client_subscriptions(uint32_t handle, size_t index) {
-    (void) index;
-    return ggl_ipc_release_subscriptions_for_conn(handle);
+// Not done under the pool lock, as subscription responses hold the core bus
+// subscription lock while writing to clients.
+static void release_client_subscriptions(uint32_t handle) {
+    (void) ggl_ipc_release_subscriptions_for_conn(handle);
 }
 
 static GglError deserialize_payload(GglBuffer payload, GglMap *out) {
     GglObject obj;
 
-    static uint8_t
-        json_decode_mem[GGL_IPC_PAYLOAD_MAX_SUBOBJECTS * sizeof(GglObject)];
-    GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(json_decode_mem));
+    GglBumpAlloc balloc
+        = ggl_bump_alloc_init(GGL_BUF(get_worker()->json_decode_mem));
 
     GGL_LOGT(
         "Deserializing payload %.*s", (int) payload.len, (char *) payload.data
@@ -119,11 +196,8 @@ static GglError complete_conn_init(
         return ret;
     }
 
-    GGL_MTX_SCOPE_GUARD(&resp_array_mtx);
-    GglBuffer resp_buffer = GGL_BUF(resp_array);
-
-    ret = eventstream_encode(
-        &resp_buffer,
+    ret = send_packet(
+        handle,
         (EventStreamHeader[]) {
             { GGL_STR(":message-type"),
               { EVENTSTREAM_INT32, .int32 = EVENTSTREAM_CONNECT_ACK } },
@@ -139,11 +213,6 @@ static GglError complete_conn_init(
         return ret;
     }
 
-    ret = ggl_socket_handle_write(&pool, handle, resp_buffer);
-    if (ret != GGL_ERR_OK) {
-        return ret;
-    }
-
     GGL_LOGD("Successful connection.");
     return GGL_ERR_OK;
 }
@@ -261,12 +330,9 @@ static GglError handle_conn_init(
     );
 }
 
-static GglError send_stream_error(uint32_t handle, int32_t stream_id) {
+GglError ggl_ipc_stream_error_send(uint32_t handle, int32_t stream_id) {
     GGL_LOGE("Sending error on client %u stream %d.", handle, stream_id);
 
-    GGL_MTX_SCOPE_GUARD(&resp_array_mtx);
-    GglBuffer resp_buffer = GGL_BUF(resp_array);
-
     // TODO: Match classic error response
     EventStreamHeader resp_headers[] = {
         { GGL_STR(":message-type"),
@@ -279,14 +345,7 @@ static GglError send_stream_error(uint32_t handle, int32_t stream_id) {
     const size_t RESP_HEADERS_LEN
         = sizeof(resp_headers) / sizeof(resp_headers[0]);
 
-    GglError ret = eventstream_encode(
-        &resp_buffer, resp_headers, RESP_HEADERS_LEN, GGL_NULL_READER
-    );
-    if (ret != GGL_ERR_OK) {
-        return ret;
-    }
-
-    return ggl_socket_handle_write(&pool, handle, resp_buffer);
+    return send_packet(handle, resp_headers, RESP_HEADERS_LEN, GGL_NULL_READER);
 }
 
 static GglError handle_stream_operation(
@@ -333,8 +392,14 @@ static GglError handle_stream_operation(
         return ret;
     }
 
+    GglBumpAlloc balloc
+        = ggl_bump_alloc_init(GGL_BUF(get_worker()->operation_mem));
     return ggl_ipc_handle_operation(
-        operation, payload_data, handle, common_headers.stream_id
+        operation,
+        payload_data,
+        handle,
+        common_headers.stream_id,
+        &balloc.alloc
     );
 }
 
@@ -354,7 +419,7 @@ static GglError handle_operation(
     }
 
     if (ret != GGL_ERR_OK) {
-        return send_stream_error(handle, common_headers.stream_id);
+        return ggl_ipc_stream_error_send(handle, common_headers.stream_id);
     }
 
     return GGL_ERR_OK;
@@ -380,11 +445,8 @@ GglError ggl_ipc_get_component_name(
     return GGL_ERR_OK;
 }
 
-static GglError client_ready(void *ctx, uint32_t handle) {
-    (void) ctx;
-
-    static uint8_t payload_array[GGL_IPC_MAX_MSG_LEN];
-    GglBuffer recv_buffer = GGL_BUF(payload_array);
+static GglError handle_packet(uint32_t handle) {
+    GglBuffer recv_buffer = GGL_BUF(get_worker()->payload_array);
     GglBuffer prelude_buf = ggl_buffer_substr(recv_buffer, 0, 12);
     assert(prelude_buf.len == 12);
 
@@ -443,8 +505,13 @@ static GglError client_ready(void *ctx, uint32_t handle) {
     return handle_operation(handle, &msg, common_headers);
 }
 
+static GglError client_ready(void *ctx, uint32_t handle) {
+    (void) ctx;
+    return handle_packet(handle);
+}
+
 GglError ggl_ipc_listen(const char *socket_name, const char *socket_path) {
-    return ggl_socket_server_listen(
+    return ggl_socket_server_listen_threaded(
         &(GglBuffer) { .data = (uint8_t *) socket_name,
                        .len = strlen(socket_name) },
         (GglBuffer) { .data = (uint8_t *) socket_path,
@@ -452,7 +519,8 @@ GglError ggl_ipc_listen(const char *socket_name, const char *socket_path) {
         0666,
         &pool,
         client_ready,
-        NULL
+        NULL,
+        GGL_IPC_MAX_WORKERS
     );
 }
 
@@ -462,9 +530,6 @@ GglError ggl_ipc_response_send(
     GglBuffer service_model_type,
     GglObject response
 ) {
-    GGL_MTX_SCOPE_GUARD(&resp_array_mtx);
-    GglBuffer resp_buffer = GGL_BUF(resp_array);
-
     EventStreamHeader resp_headers[] = {
         { GGL_STR(":message-type"),
           { EVENTSTREAM_INT32, .int32 = EVENTSTREAM_APPLICATION_MESSAGE } },
@@ -482,12 +547,7 @@ GglError ggl_ipc_response_send(
         resp_headers_len -= 1;
     }
 
-    GglError ret = eventstream_encode(
-        &resp_buffer, resp_headers, resp_headers_len, ggl_json_reader(&response)
+    return send_packet(
+        handle, resp_headers, resp_headers_len, ggl_json_reader(&response)
     );
-    if (ret != GGL_ERR_OK) {
-        return ret;
-    }
-
-    return ggl_socket_handle_write(&pool, handle, resp_buffer);
 }
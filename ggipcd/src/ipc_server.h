@@ -18,6 +18,20 @@
 
 #define GGL_IPC_PAYLOAD_MAX_SUBOBJECTS 50
 
+/// Maximum number of GG IPC clients.
+/// Can be configured with `-DGGL_IPC_MAX_CLIENTS=<N>`.
+#ifndef GGL_IPC_MAX_CLIENTS
+#define GGL_IPC_MAX_CLIENTS 50
+#endif
+
+/// Maximum number of threads handling IPC requests. Requests from different
+/// clients are handled in parallel; each client's requests are handled in
+/// order.
+/// Can be configured with `-DGGL_IPC_MAX_WORKERS=<N>`.
+#ifndef GGL_IPC_MAX_WORKERS
+#define GGL_IPC_MAX_WORKERS 4
+#endif
+
 /// Start the GG-IPC server on a given socket
 GglError ggl_ipc_listen(const char *socket_name, const char *socket_path);
 
@@ -29,6 +43,9 @@ GglError ggl_ipc_response_send(
     GglObject response
 );
 
+/// Send an error terminating a stream to an IPC client.
+GglError ggl_ipc_stream_error_send(uint32_t handle, int32_t stream_id);
+
 /// Get the component name associated with a client.
 /// component_name is an out parameter only.
 GglError ggl_ipc_get_component_name(uint32_t handle, GglBuffer *component_name);
@@ -6,127 +6,304 @@
 #include "ipc_server.h"
 #include <sys/types.h>
 #include <assert.h>
+#include <ggl/buffer.h>
 #include <ggl/bump_alloc.h>
 #include <ggl/cleanup.h>
 #include <ggl/core_bus/client.h>
 #include <ggl/error.h>
+#include <ggl/json_encode.h>
 #include <ggl/log.h>
 #include <ggl/object.h>
 #include <pthread.h>
+#include <string.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
-#define GGL_IPC_MAX_SUBSCRIPTIONS GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS
+/// Maximum number of IPC subscriptions over all clients.
+/// Can be configured with `-DGGL_IPC_MAX_SUBSCRIPTIONS=<N>`.
+#ifndef GGL_IPC_MAX_SUBSCRIPTIONS
+#define GGL_IPC_MAX_SUBSCRIPTIONS 256
+#endif
+
+/// Maximum length of the interface, method, and encoded parameters that
+/// identify a core bus subscription shared by IPC subscriptions. Larger
+/// subscriptions are not shared.
+/// Can be configured with `-DGGL_IPC_SUBSCRIPTION_KEY_MAX=<N>`.
+#ifndef GGL_IPC_SUBSCRIPTION_KEY_MAX
+#define GGL_IPC_SUBSCRIPTION_KEY_MAX 512
+#endif
+
+#define GGL_IPC_MAX_UPSTREAMS GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS
 
 static_assert(
-    GGL_IPC_MAX_SUBSCRIPTIONS <= GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS,
-    "IPC max subscriptions exceededs core bus max subscriptions."
+    GGL_IPC_MAX_SUBSCRIPTIONS < UINT16_MAX,
+    "IPC subscription links must fit in 16 bits."
 );
 
-static uint32_t subs_resp_handle[GGL_IPC_MAX_SUBSCRIPTIONS];
-static int32_t subs_stream_id[GGL_IPC_MAX_SUBSCRIPTIONS];
-static uint32_t subs_recv_handle[GGL_IPC_MAX_SUBSCRIPTIONS];
+// Upstreams are indexed by core bus handle, and streams are listed by IPC
+// client handle. Handles hold a pool index plus one in their low 16 bits, and
+// a generation in their high bits, so a stale handle never matches its slot.
+// Links hold a stream index plus one, so zero-initialized links are empty.
+
+/// A core bus subscription, shared by the IPC subscriptions with the same
+/// interface, method, and parameters.
+typedef struct {
+    /// Guards recv_handle and the stream list, so delivering a response only
+    /// locks its own subscription.
+    pthread_mutex_t mtx;
+    /// Zero when the slot is free.
+    uint32_t recv_handle;
+    uint16_t first;
+    uint16_t refs;
+    bool shared;
+    uint32_t key_hash;
+    size_t key_len;
+    uint8_t key[GGL_IPC_SUBSCRIPTION_KEY_MAX];
+} Upstream;
+
+/// An IPC subscription stream, receiving responses of its upstream.
+typedef struct {
+    /// Zero when the slot is free.
+    uint32_t resp_handle;
+    int32_t stream_id;
+    GglIpcSubscribeCallback on_response;
+    uint16_t upstream;
+    uint16_t upstream_next;
+    uint16_t conn_next;
+} Downstream;
+
+static Upstream upstreams[GGL_IPC_MAX_UPSTREAMS];
+static Downstream downstreams[GGL_IPC_MAX_SUBSCRIPTIONS];
+static uint16_t conn_first[GGL_IPC_MAX_CLIENTS];
+
+// Guards stream allocation, the per-client lists, and subscription keys. Taken
+// before an upstream's mutex when both are needed.
 static pthread_mutex_t subs_state_mtx = PTHREAD_MUTEX_INITIALIZER;
 
-static GglError init_subs_index(
-    uint32_t resp_handle, int32_t stream_id, size_t *index
-) {
-    assert(resp_handle != 0);
+// Serializes binding, so only one core bus subscription per key is created.
+static pthread_mutex_t bind_mtx = PTHREAD_MUTEX_INITIALIZER;
 
-    GGL_MTX_SCOPE_GUARD(&subs_state_mtx);
-
-    for (size_t i = 0; i < GGL_IPC_MAX_SUBSCRIPTIONS; i++) {
-        if (subs_resp_handle[i] == 0) {
-            subs_resp_handle[i] = resp_handle;
-            subs_stream_id[i] = stream_id;
-            *index = i;
-            return GGL_ERR_OK;
-        }
+__attribute__((constructor)) static void init_upstreams(void) {
+    for (size_t i = 0; i < GGL_IPC_MAX_UPSTREAMS; i++) {
+        pthread_mutex_init(&upstreams[i].mtx, NULL);
     }
+}
 
-    GGL_LOGE("Exceeded maximum tracked subscriptions.");
-    return GGL_ERR_NOMEM;
+/// Get the slot for a handle's pool index, or NULL if out of range.
+static Upstream *upstream_slot(uint32_t recv_handle) {
+    uint32_t index = recv_handle & UINT16_MAX;
+    if ((index == 0) || (index > GGL_IPC_MAX_UPSTREAMS)) {
+        return NULL;
+    }
+    return &upstreams[index - 1];
 }
 
-static void release_subs_index(size_t index, uint32_t resp_handle) {
-    GGL_MTX_SCOPE_GUARD(&subs_state_mtx);
+static uint16_t *conn_list(uint32_t resp_handle) {
+    uint32_t index = resp_handle & UINT16_MAX;
+    assert((index != 0) && (index <= GGL_IPC_MAX_CLIENTS));
+    return &conn_first[index - 1];
+}
 
-    if (subs_resp_handle[index] == resp_handle) {
-        subs_resp_handle[index] = 0;
-        subs_stream_id[index] = 0;
-        subs_recv_handle[index] = 0;
-    } else {
-        GGL_LOGD("Releasing subscription state failed; already released.");
+static uint32_t hash_buffer(GglBuffer buf) {
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < buf.len; i++) {
+        hash ^= buf.data[i];
+        hash *= 16777619U;
     }
+    return hash;
 }
 
-static GglError subs_set_recv_handle(
-    size_t index, uint32_t resp_handle, uint32_t recv_handle
+/// Write the key identifying a subscription into key, returning whether it
+/// fits.
+static bool subscription_key(
+    GglBuffer interface, GglBuffer method, GglMap params, GglBuffer *key
 ) {
-    assert(resp_handle != 0);
-    assert(recv_handle != 0);
+    size_t prefix_len = interface.len + 1 + method.len + 1;
+    if (prefix_len > key->len) {
+        return false;
+    }
+    memcpy(key->data, interface.data, interface.len);
+    key->data[interface.len] = '\0';
+    memcpy(&key->data[interface.len + 1], method.data, method.len);
+    key->data[prefix_len - 1] = '\0';
+
+    GglBuffer params_buf = ggl_buffer_substr(*key, prefix_len, SIZE_MAX);
+    if (ggl_json_encode(GGL_OBJ_MAP(params), &params_buf) != GGL_ERR_OK) {
+        return false;
+    }
+    key->len = prefix_len + params_buf.len;
+    return true;
+}
 
-    GGL_MTX_SCOPE_GUARD(&subs_state_mtx);
+static Upstream *find_upstream(GglBuffer key, uint32_t key_hash) {
+    for (size_t i = 0; i < GGL_IPC_MAX_UPSTREAMS; i++) {
+        Upstream *upstream = &upstreams[i];
+        if ((upstream->recv_handle != 0) && upstream->shared
+            && (upstream->key_hash == key_hash)
+            && ggl_buffer_eq(
+                (GglBuffer) { .data = upstream->key, .len = upstream->key_len },
+                key
+            )) {
+            return upstream;
+        }
+    }
+    return NULL;
+}
 
-    if (subs_resp_handle[index] == resp_handle) {
-        subs_recv_handle[index] = recv_handle;
+static GglError add_downstream(
+    uint32_t resp_handle,
+    int32_t stream_id,
+    Upstream *upstream,
+    GglIpcSubscribeCallback on_response
+) {
+    for (uint16_t i = 0; i < GGL_IPC_MAX_SUBSCRIPTIONS; i++) {
+        if (downstreams[i].resp_handle != 0) {
+            continue;
+        }
+
+        uint16_t *conn = conn_list(resp_handle);
+        GGL_MTX_SCOPE_GUARD(&upstream->mtx);
+
+        downstreams[i] = (Downstream) {
+            .resp_handle = resp_handle,
+            .stream_id = stream_id,
+            .on_response = on_response,
+            .upstream = (uint16_t) (upstream - upstreams),
+            .upstream_next = upstream->first,
+            .conn_next = *conn,
+        };
+        upstream->first = i + 1;
+        upstream->refs += 1;
+        *conn = i + 1;
         return GGL_ERR_OK;
     }
 
-    GGL_LOGD("Setting subscription recv handle failed; state already released."
-    );
-    return GGL_ERR_FAILURE;
+    GGL_LOGE("Exceeded maximum tracked subscriptions.");
+    return GGL_ERR_NOMEM;
+}
+
+/// Remove the stream linked from *conn_link, returning the recv handle of its
+/// upstream if that has no streams left and must be closed, else 0.
+static uint32_t remove_downstream(uint16_t *conn_link) {
+    uint16_t link = *conn_link;
+    Downstream *downstream = &downstreams[link - 1];
+    Upstream *upstream = &upstreams[downstream->upstream];
+    *conn_link = downstream->conn_next;
+
+    GGL_MTX_SCOPE_GUARD(&upstream->mtx);
+
+    uint16_t *upstream_link = &upstream->first;
+    while (*upstream_link != link) {
+        upstream_link = &downstreams[*upstream_link - 1].upstream_next;
+    }
+    *upstream_link = downstream->upstream_next;
+    *downstream = (Downstream) { 0 };
+
+    upstream->refs -= 1;
+    if (upstream->refs > 0) {
+        return 0;
+    }
+    uint32_t recv_handle = upstream->recv_handle;
+    upstream->recv_handle = 0;
+    upstream->first = 0;
+    return recv_handle;
 }
 
 static GglError subscription_on_response(
     void *ctx, uint32_t recv_handle, GglObject data
 ) {
-    GglIpcSubscribeCallback on_response = ctx;
+    (void) ctx;
+
+    Upstream *upstream = upstream_slot(recv_handle);
+    if (upstream == NULL) {
+        return GGL_ERR_FAILURE;
+    }
 
-    uint32_t resp_handle = 0;
-    int32_t stream_id = -1;
-    bool found = false;
+    Downstream targets[GGL_IPC_MAX_SUBSCRIPTIONS];
+    size_t target_count = 0;
 
     {
-        GGL_MTX_SCOPE_GUARD(&subs_state_mtx);
-        for (size_t i = 0; i < GGL_IPC_MAX_SUBSCRIPTIONS; i++) {
-            if (recv_handle == subs_recv_handle[i]) {
-                found = true;
-                resp_handle = subs_resp_handle[i];
-                stream_id = subs_stream_id[i];
-                break;
-            }
-        }
-    }
+        GGL_MTX_SCOPE_GUARD(&upstream->mtx);
 
-    if (!found) {
-        GGL_LOGD("Received response on released subscription.");
-        return GGL_ERR_FAILURE;
+        // Released upstreams are closed by the releaser; a mismatch here is a
+        // response racing the subscription's registration.
+        if (upstream->recv_handle != recv_handle) {
+            GGL_LOGD("Received response on unregistered subscription.");
+            return GGL_ERR_OK;
+        }
+        for (uint16_t link = upstream->first; link != 0;
+             link = downstreams[link - 1].upstream_next) {
+            targets[target_count++] = downstreams[link - 1];
+        }
     }
 
+    // The response is decoded once and sent to each stream from that.
     static uint8_t resp_mem
         [(GGL_IPC_PAYLOAD_MAX_SUBOBJECTS * sizeof(GglObject))
          + GGL_IPC_MAX_MSG_LEN];
-    GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(resp_mem));
 
-    return on_response(data, resp_handle, stream_id, &balloc.alloc);
+    for (size_t i = 0; i < target_count; i++) {
+        GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(resp_mem));
+        GglError ret = targets[i].on_response(
+            data, targets[i].resp_handle, targets[i].stream_id, &balloc.alloc
+        );
+        if (ret != GGL_ERR_OK) {
+            // Only the failing stream stops receiving responses
+            ggl_ipc_release_subscription(
+                targets[i].resp_handle, targets[i].stream_id
+            );
+        }
+    }
+
+    return GGL_ERR_OK;
 }
 
 static void subscription_on_close(void *ctx, uint32_t recv_handle) {
     (void) ctx;
-    GGL_MTX_SCOPE_GUARD(&subs_state_mtx);
-
-    for (size_t i = 0; i < GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS; i++) {
-        if (recv_handle == subs_recv_handle[i]) {
-            subs_resp_handle[i] = 0;
-            subs_stream_id[i] = 0;
-            subs_recv_handle[i] = 0;
-            return;
+
+    Upstream *upstream = upstream_slot(recv_handle);
+    if (upstream == NULL) {
+        return;
+    }
+
+    Downstream closed[GGL_IPC_MAX_SUBSCRIPTIONS];
+    size_t closed_count = 0;
+
+    {
+        GGL_MTX_SCOPE_GUARD(&subs_state_mtx);
+
+        uint16_t link;
+        {
+            GGL_MTX_SCOPE_GUARD(&upstream->mtx);
+            if (upstream->recv_handle != recv_handle) {
+                GGL_LOGD("Already released subscription closed.");
+                return;
+            }
+            link = upstream->first;
+        }
+
+        // Removing the last stream frees the upstream
+        while (link != 0) {
+            uint16_t next = downstreams[link - 1].upstream_next;
+            closed[closed_count++] = downstreams[link - 1];
+            uint16_t *conn_link = conn_list(downstreams[link - 1].resp_handle);
+            while (*conn_link != link) {
+                conn_link = &downstreams[*conn_link - 1].conn_next;
+            }
+            (void) remove_downstream(conn_link);
+            link = next;
         }
     }
 
-    GGL_LOGD("Already released subscription closed.");
+    // Streams of a subscription closed by its server are ended with an error,
+    // so clients do not wait on them
+    for (size_t i = 0; i < closed_count; i++) {
+        (void) ggl_ipc_stream_error_send(
+            closed[i].resp_handle, closed[i].stream_id
+        );
+    }
 }
 
 GglError ggl_ipc_bind_subscription(
@@ -138,49 +315,120 @@ GglError ggl_ipc_bind_subscription(
     GglIpcSubscribeCallback on_response,
     GglError *error
 ) {
-    size_t subs_index = 0;
-    GglError ret = init_subs_index(resp_handle, stream_id, &subs_index);
-    if (ret != GGL_ERR_OK) {
-        return ret;
+    assert(resp_handle != 0);
+
+    GGL_MTX_SCOPE_GUARD(&bind_mtx);
+
+    static uint8_t key_mem[GGL_IPC_SUBSCRIPTION_KEY_MAX];
+    GglBuffer key = GGL_BUF(key_mem);
+    bool shared = subscription_key(interface, method, params, &key);
+    uint32_t key_hash = shared ? hash_buffer(key) : 0;
+
+    {
+        GGL_MTX_SCOPE_GUARD(&subs_state_mtx);
+
+        Upstream *upstream = shared ? find_upstream(key, key_hash) : NULL;
+        if (upstream != NULL) {
+            GGL_LOGD("Sharing existing core bus subscription.");
+            return add_downstream(
+                resp_handle, stream_id, upstream, on_response
+            );
+        }
     }
 
     uint32_t recv_handle = 0;
-    ret = ggl_subscribe(
+    GglError ret = ggl_subscribe(
         interface,
         method,
         params,
         subscription_on_response,
         subscription_on_close,
-        on_response,
+        NULL,
         error,
         &recv_handle
     );
     if (ret != GGL_ERR_OK) {
-        release_subs_index(subs_index, resp_handle);
         return ret;
     }
 
-    (void) subs_set_recv_handle(subs_index, resp_handle, recv_handle);
+    {
+        GGL_MTX_SCOPE_GUARD(&subs_state_mtx);
 
-    return GGL_ERR_OK;
+        Upstream *upstream = upstream_slot(recv_handle);
+        if (upstream == NULL) {
+            GGL_LOGE("Core bus subscription handle out of range.");
+            ret = GGL_ERR_FAILURE;
+        } else {
+            {
+                GGL_MTX_SCOPE_GUARD(&upstream->mtx);
+                upstream->recv_handle = recv_handle;
+                upstream->first = 0;
+                upstream->refs = 0;
+                upstream->shared = shared;
+                upstream->key_hash = key_hash;
+                upstream->key_len = shared ? key.len : 0;
+                if (shared) {
+                    memcpy(upstream->key, key.data, key.len);
+                }
+            }
+            ret = add_downstream(resp_handle, stream_id, upstream, on_response);
+            if (ret != GGL_ERR_OK) {
+                GGL_MTX_SCOPE_GUARD(&upstream->mtx);
+                upstream->recv_handle = 0;
+            }
+        }
+    }
+
+    if (ret != GGL_ERR_OK) {
+        ggl_client_sub_close(recv_handle);
+    }
+    return ret;
 }
 
-GglError ggl_ipc_release_subscriptions_for_conn(uint32_t resp_handle) {
-    for (size_t i = 0; i < GGL_COREBUS_CLIENT_MAX_SUBSCRIPTIONS; i++) {
-        uint32_t recv_handle = 0;
+void ggl_ipc_release_subscription(uint32_t resp_handle, int32_t stream_id) {
+    uint32_t close_handle = 0;
 
-        {
-            GGL_MTX_SCOPE_GUARD(&subs_state_mtx);
+    {
+        GGL_MTX_SCOPE_GUARD(&subs_state_mtx);
 
-            if (subs_resp_handle[i] == resp_handle) {
-                recv_handle = subs_recv_handle[i];
+        for (uint16_t *link = conn_list(resp_handle); *link != 0;
+             link = &downstreams[*link - 1].conn_next) {
+            if ((downstreams[*link - 1].resp_handle == resp_handle)
+                && (downstreams[*link - 1].stream_id == stream_id)) {
+                close_handle = remove_downstream(link);
+                break;
             }
         }
+    }
 
-        if (recv_handle != 0) {
-            ggl_client_sub_close(recv_handle);
+    if (close_handle != 0) {
+        ggl_client_sub_close(close_handle);
+    }
+}
+
+GglError ggl_ipc_release_subscriptions_for_conn(uint32_t resp_handle) {
+    uint32_t close_handles[GGL_IPC_MAX_UPSTREAMS];
+    size_t close_count = 0;
+
+    {
+        GGL_MTX_SCOPE_GUARD(&subs_state_mtx);
+
+        uint16_t *link = conn_list(resp_handle);
+        while (*link != 0) {
+            if (downstreams[*link - 1].resp_handle != resp_handle) {
+                link = &downstreams[*link - 1].conn_next;
+                continue;
+            }
+            uint32_t close_handle = remove_downstream(link);
+            if (close_handle != 0) {
+                close_handles[close_count++] = close_handle;
+            }
         }
     }
 
+    for (size_t i = 0; i < close_count; i++) {
+        ggl_client_sub_close(close_handles[i]);
+    }
+
     return GGL_ERR_OK;
 }
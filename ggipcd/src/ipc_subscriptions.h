@@ -17,6 +17,8 @@ typedef GglError (*GglIpcSubscribeCallback)(
 );
 
 /// Wrapper around ggl_subscribe for IPC handlers.
+/// IPC subscriptions with the same interface, method, and params share one
+/// core bus subscription, and each response is decoded once for all of them.
 GglError ggl_ipc_bind_subscription(
     uint32_t resp_handle,
     int32_t stream_id,
@@ -27,6 +29,9 @@ GglError ggl_ipc_bind_subscription(
     GglError *error
 ) __attribute__((warn_unused_result));
 
+/// Clean up an IPC client's subscription on a stream
+void ggl_ipc_release_subscription(uint32_t resp_handle, int32_t stream_id);
+
 /// Clean up subscriptions for an IPC client
 GglError ggl_ipc_release_subscriptions_for_conn(uint32_t resp_handle);
 
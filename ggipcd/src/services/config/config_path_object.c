@@ -17,7 +17,7 @@
 GglError ggl_make_config_path_object(
     GglBuffer component_name, GglList key_path, GglBufList *result
 ) {
-    static GglBuffer full_key_path_mem[GGL_MAX_OBJECT_DEPTH];
+    static _Thread_local GglBuffer full_key_path_mem[GGL_MAX_OBJECT_DEPTH];
     GglBufVec full_key_path = GGL_BUF_VEC(full_key_path_mem);
 
     GglError ret = ggl_buf_vec_push(&full_key_path, GGL_STR("services"));
@@ -36,21 +36,21 @@ GglError ggl_make_config_path_object(
 GglError ggl_parse_config_path(
     GglList config_path, GglBuffer *component_name, GglList *key_path
 ) {
-    if (config_path.len < 4) {
+    // `services.myComponent.configuration` alone is the configuration root,
+    // which has an empty key path
+    if (config_path.len < 3) {
         GGL_LOGE("Config path is not in the expected format");
         return GGL_ERR_INVALID;
     }
 
     *component_name = config_path.items[1].buf;
 
-    static GglObject component_key_path_mem[GGL_MAX_COMPONENT_CONFIG_DEPTH];
-    static GglObjVec component_key_path = GGL_OBJ_VEC(component_key_path_mem);
-    component_key_path.list.len = 0;
+    static _Thread_local GglObject
+        component_key_path_mem[GGL_MAX_COMPONENT_CONFIG_DEPTH];
+    GglObjVec component_key_path = GGL_OBJ_VEC(component_key_path_mem);
 
-    GglError ret = ggl_obj_vec_push(
-        &component_key_path, GGL_OBJ_BUF(config_path.items[3].buf)
-    );
-    for (size_t i = 4; i < config_path.len; i++) {
+    GglError ret = GGL_ERR_OK;
+    for (size_t i = 3; i < config_path.len; i++) {
         ggl_obj_vec_chain_push(
             &ret, &component_key_path, GGL_OBJ_BUF(config_path.items[i].buf)
         );
@@ -10,8 +10,8 @@
 #include <ggl/object.h>
 
 /// Combine the component name and key path and returns a new configuration path
-/// result uses static memory owned by this function which is valid until the
-/// next call. Not re-entrant.
+/// result uses thread-local memory owned by this function which is valid until
+/// the next call on the same thread. Not re-entrant.
 GglError ggl_make_config_path_object(
     GglBuffer component_name, GglList key_path, GglBufList *result
 );
@@ -19,8 +19,8 @@ GglError ggl_make_config_path_object(
 /// Parse the component name and key path from a configuration path
 /// component_name will point to the data in config_path which contains
 /// the component name.
-/// key_path uses static memory owned by this function which is valid until the
-/// next call. Not re-entrant.
+/// key_path uses thread-local memory owned by this function which is valid
+/// until the next call on the same thread. Not re-entrant.
 GglError ggl_parse_config_path(
     GglList config_path, GglBuffer *component_name, GglList *key_path
 );
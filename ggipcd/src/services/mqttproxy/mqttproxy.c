@@ -57,8 +57,8 @@ static bool match_topic_filter(GglBuffer resource, GglBuffer filter) {
 }
 
 bool ggl_ipc_mqtt_policy_matcher(
-    GglBuffer request_resource, GglBuffer policy_resource
+    GglBuffer request_resource, const GglIpcPolicyResource *policy_resource
 ) {
     return ggl_ipc_default_policy_matcher(request_resource, policy_resource)
-        || match_topic_filter(request_resource, policy_resource);
+        || match_topic_filter(request_resource, policy_resource->raw);
 }
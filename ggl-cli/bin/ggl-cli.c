@@ -5,10 +5,14 @@
 #include <argp.h>
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <ggl/buffer.h>
 #include <ggl/bump_alloc.h>
+#include <ggl/cleanup.h>
 #include <ggl/core_bus/client.h>
+#include <ggl/core_bus/gg_config.h>
 #include <ggl/error.h>
+#include <ggl/file.h>
 #include <ggl/log.h>
 #include <ggl/object.h>
 #include <ggl/vector.h>
@@ -28,6 +32,7 @@ char *recipe_dir = NULL;
 char *artifacts_dir = NULL;
 char *component_name = NULL;
 char *component_version = NULL;
+char *config_path = NULL;
 
 static char doc[] = "ggl-cli -- Greengrass CLI for Nucleus Lite";
 
@@ -60,12 +65,15 @@ static error_t arg_parser(int key, char *arg, struct argp_state *state) {
         break;
     }
     case ARGP_KEY_ARG:
-        if (command != NULL) {
-            // NOLINTNEXTLINE(concurrency-mt-unsafe)
-            argp_usage(state);
-        }
-        if (strcmp(arg, "deploy") == 0) {
-            command = arg;
+        if (command == NULL) {
+            if ((strcmp(arg, "deploy") == 0)
+                || (strcmp(arg, "config-export") == 0)
+                || (strcmp(arg, "config-import") == 0)) {
+                command = arg;
+                break;
+            }
+        } else if ((strcmp(command, "deploy") != 0) && (config_path == NULL)) {
+            config_path = arg;
             break;
         }
         // NOLINTNEXTLINE(concurrency-mt-unsafe)
@@ -75,18 +83,57 @@ static error_t arg_parser(int key, char *arg, struct argp_state *state) {
         // NOLINTNEXTLINE(concurrency-mt-unsafe)
         argp_usage(state);
         break;
+    case ARGP_KEY_END:
+        if ((command == NULL)
+            || ((strcmp(command, "deploy") != 0) && (config_path == NULL))) {
+            // NOLINTNEXTLINE(concurrency-mt-unsafe)
+            argp_usage(state);
+        }
+        break;
     default:
         break;
     }
     return 0;
 }
 
-static struct argp argp = { opts, arg_parser, "deploy", doc, 0, 0, 0 };
+static struct argp argp = { opts,
+                            arg_parser,
+                            "deploy\nconfig-export PATH\nconfig-import PATH",
+                            doc,
+                            0,
+                            0,
+                            0 };
+
+static int config_snapshot(void) {
+    // The file is opened here and passed to ggconfigd, so it is accessed with
+    // the permissions of the user running the CLI.
+    bool export = strcmp(command, "config-export") == 0;
+    int fd = -1;
+    GglError ret = ggl_file_open(
+        ggl_buffer_from_null_term(config_path),
+        export ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY,
+        0600,
+        &fd
+    );
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGE("Failed to open %s.", config_path);
+        return 1;
+    }
+    GGL_CLEANUP(cleanup_close, fd);
 
-int main(int argc, char **argv) {
-    // NOLINTNEXTLINE(concurrency-mt-unsafe)
-    argp_parse(&argp, argc, argv, 0, 0, NULL);
+    if (export) {
+        ret = ggl_gg_config_export(fd);
+    } else {
+        ret = ggl_gg_config_import(fd);
+    }
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGE("Failed to run %s: %d.", command, ret);
+        return 1;
+    }
+    return 0;
+}
 
+static int deploy(void) {
     GglKVVec args = GGL_KV_VEC((GglKV[3]) { 0 });
 
     if (recipe_dir != NULL) {
@@ -175,4 +222,15 @@ int main(int argc, char **argv) {
     }
 
     printf("Deployment id: %.*s.", (int) result.buf.len, result.buf.data);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // NOLINTNEXTLINE(concurrency-mt-unsafe)
+    argp_parse(&argp, argc, argv, 0, 0, NULL);
+
+    if (strcmp(command, "deploy") == 0) {
+        return deploy();
+    }
+    return config_snapshot();
 }
@@ -10,6 +10,7 @@
 #include <ggl/buffer.h>
 #include <ggl/error.h>
 #include <ggl/io.h>
+#include <stdbool.h>
 
 /// Wrapper for reading full buffer from socket.
 GglError ggl_socket_read(int fd, GglBuffer buf);
@@ -17,6 +18,36 @@ GglError ggl_socket_read(int fd, GglBuffer buf);
 /// Wrapper for writing full buffer to socket.
 GglError ggl_socket_write(int fd, GglBuffer buf);
 
+/// Read into a buffer with a single recvmsg call, accepting a passed fd.
+/// `buf` is advanced past the read data. If a file descriptor is received and
+/// `*recv_fd` is negative, it is stored there and must be closed by the
+/// caller; other received descriptors are closed.
+/// Returns GGL_ERR_RETRY if interrupted and GGL_ERR_NODATA on end of stream.
+GglError ggl_socket_read_partial_with_fd(int fd, GglBuffer *buf, int *recv_fd);
+
+/// Wrapper for reading full buffer from socket, accepting a passed fd.
+/// `*recv_fd` should be initialized to -1; see
+/// `ggl_socket_read_partial_with_fd`.
+GglError ggl_socket_read_with_fd(int fd, GglBuffer buf, int *recv_fd);
+
+/// Write as much of a list of buffers as a single sendmsg call accepts.
+/// `bufs` is advanced past the written data, and its first remaining buffer is
+/// shortened in place. If `send_fd` is not negative, it is passed to the peer
+/// along with the written data. If `nonblocking`, returns GGL_ERR_OK having
+/// written nothing when the socket is full. Returns GGL_ERR_RETRY if
+/// interrupted.
+GglError ggl_socket_writev_partial(
+    int fd, GglBufList *bufs, int send_fd, bool nonblocking
+);
+
+/// Wrapper for writing a list of buffers in order to socket.
+/// The entries of `bufs` are used as scratch space.
+GglError ggl_socket_writev(int fd, GglBufList bufs);
+
+/// Wrapper for writing a list of buffers in order to socket, passing a fd to
+/// the peer with the data. The entries of `bufs` are used as scratch space.
+GglError ggl_socket_writev_with_fd(int fd, GglBufList bufs, int send_fd);
+
 /// Connect to a socket and return the fd
 GglError ggl_connect(GglBuffer path, int *fd);
 
@@ -17,10 +17,34 @@ GglError ggl_socket_epoll_create(int *epoll_fd);
 /// Add an epoll watch.
 GglError ggl_socket_epoll_add(int epoll_fd, int target_fd, uint64_t data);
 
+/// Add an epoll watch that is disabled after each event until rearmed.
+GglError ggl_socket_epoll_add_oneshot(
+    int epoll_fd, int target_fd, uint64_t data
+);
+
+/// Re-enable a oneshot epoll watch after handling its event.
+GglError ggl_socket_epoll_rearm(int epoll_fd, int target_fd, uint64_t data);
+
+/// Add a oneshot epoll watch for the target becoming writable.
+GglError ggl_socket_epoll_add_writable(
+    int epoll_fd, int target_fd, uint64_t data
+);
+
+/// Re-enable a oneshot writable epoll watch.
+GglError ggl_socket_epoll_rearm_writable(
+    int epoll_fd, int target_fd, uint64_t data
+);
+
 /// Continuously wait on epoll, calling callback when data is ready.
 /// Exits only on error waiting or error from callback.
 GglError ggl_socket_epoll_run(
     int epoll_fd, GglError (*fd_ready)(void *ctx, uint64_t data), void *ctx
 );
 
+/// Like `ggl_socket_epoll_run`, but takes a single event per wait.
+/// Used when multiple threads wait on the same epoll fd with oneshot watches.
+GglError ggl_socket_epoll_run_single(
+    int epoll_fd, GglError (*fd_ready)(void *ctx, uint64_t data), void *ctx
+);
+
 #endif
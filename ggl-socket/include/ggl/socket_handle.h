@@ -19,13 +19,20 @@
 
 /// Pool of memory for client/server sockets.
 /// Can be shared between multiple server/client instances.
-/// `fds` and `generations` should be set to arrays of length `max_fds`.
+/// `fds`, `generations`, and `in_use` should be set to arrays of length
+/// `max_fds`. `in_use` counts the reads and writes in progress on each fd,
+/// which are made without the pool lock held.
+/// `on_register` and `on_release` are called with the pool lock held.
+/// `on_close` is called after a handle is closed, without the pool lock, so it
+/// may take locks that are held while using the pool.
 typedef struct {
     uint16_t max_fds;
     int *fds;
     uint16_t *generations;
+    uint16_t *in_use;
     GglError (*on_register)(uint32_t handle, size_t index);
     GglError (*on_release)(uint32_t handle, size_t index);
+    void (*on_close)(uint32_t handle);
     pthread_mutex_t mtx;
 } GglSocketPool;
 
@@ -43,6 +50,8 @@ GglError ggl_socket_pool_register(
 
 /// Take a fd from a socket pool.
 /// If successful, the fd was removed and is now owned by the caller.
+/// If the fd is being read or written by another thread, it is instead shut
+/// down, closed once those finish, and `*fd` is set to -1.
 GglError ggl_socket_pool_release(GglSocketPool *pool, uint32_t handle, int *fd);
 
 /// Read exact amount of data from a socket.
@@ -55,6 +64,25 @@ GglError ggl_socket_handle_write(
     GglSocketPool *pool, uint32_t handle, GglBuffer buf
 );
 
+/// Read exact amount of data from a socket, accepting a passed fd.
+/// `*recv_fd` should be initialized to -1; if a file descriptor is received,
+/// it is stored there and must be closed by the caller.
+GglError ggl_socket_handle_read_with_fd(
+    GglSocketPool *pool, uint32_t handle, GglBuffer buf, int *recv_fd
+);
+
+/// Write a list of buffers in order to a socket.
+/// The entries of `bufs` are used as scratch space.
+GglError ggl_socket_handle_writev(
+    GglSocketPool *pool, uint32_t handle, GglBufList bufs
+);
+
+/// Write a list of buffers in order to a socket, passing a fd to the peer
+/// with the data. The entries of `bufs` are used as scratch space.
+GglError ggl_socket_handle_writev_with_fd(
+    GglSocketPool *pool, uint32_t handle, GglBufList bufs, int send_fd
+);
+
 /// Close a socket.
 GglError ggl_socket_handle_close(GglSocketPool *pool, uint32_t handle);
 
@@ -11,6 +11,7 @@
 #include <sys/types.h>
 #include <ggl/buffer.h>
 #include <ggl/error.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /// Run a server listening on `path`.
@@ -27,6 +28,21 @@ GglError ggl_socket_server_listen(
     void *ctx
 );
 
+/// Run a server listening on `path`, handling clients with `worker_count`
+/// threads (including the calling thread).
+/// `client_ready` may be called concurrently for different handles, but is not
+/// called again for a handle until the previous call for it returns, so data
+/// from each client is handled in order.
+GglError ggl_socket_server_listen_threaded(
+    const GglBuffer *socket_name,
+    GglBuffer path,
+    mode_t mode,
+    GglSocketPool *pool,
+    GglError (*client_ready)(void *ctx, uint32_t handle),
+    void *ctx,
+    size_t worker_count
+);
+
 extern void (*ggl_socket_server_ext_handler)(void);
 extern int ggl_socket_server_ext_fd;
 
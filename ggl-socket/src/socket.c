@@ -10,9 +10,15 @@
 #include <ggl/file.h>
 #include <ggl/io.h>
 #include <ggl/log.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
 GglError ggl_socket_read(int fd, GglBuffer buf) {
@@ -27,6 +33,167 @@ GglError ggl_socket_write(int fd, GglBuffer buf) {
     return ggl_file_write(fd, buf);
 }
 
+/// Max buffers passed to one sendmsg call.
+#define SOCKET_IOV_MAX 16
+
+/// Max descriptors accepted in one recvmsg call; extras are closed.
+#define SOCKET_RECV_FDS_MAX 4
+
+GglError ggl_socket_read_partial_with_fd(int fd, GglBuffer *buf, int *recv_fd) {
+    struct iovec iov = { .iov_base = buf->data, .iov_len = buf->len };
+    alignas(struct cmsghdr
+    ) uint8_t control[CMSG_SPACE(sizeof(int) * SOCKET_RECV_FDS_MAX)];
+    struct msghdr msg = { .msg_iov = &iov,
+                          .msg_iovlen = 1,
+                          .msg_control = control,
+                          .msg_controllen = sizeof(control) };
+
+    ssize_t ret = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return GGL_ERR_RETRY;
+        }
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            GGL_LOGE("Read timed out on fd %d.", fd);
+            return GGL_ERR_FAILURE;
+        }
+        GGL_LOGE("Failed to read fd %d: %d.", fd, errno);
+        return GGL_ERR_FAILURE;
+    }
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if ((cmsg->cmsg_level != SOL_SOCKET)
+            || (cmsg->cmsg_type != SCM_RIGHTS)) {
+            continue;
+        }
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; i++) {
+            int received;
+            memcpy(
+                &received, &CMSG_DATA(cmsg)[i * sizeof(int)], sizeof(int)
+            );
+            if ((recv_fd != NULL) && (*recv_fd < 0)) {
+                *recv_fd = received;
+            } else {
+                GGL_LOGW("Closing unexpected fd received on fd %d.", fd);
+                ggl_close(received);
+            }
+        }
+    }
+
+    if (ret == 0) {
+        return GGL_ERR_NODATA;
+    }
+
+    *buf = ggl_buffer_substr(*buf, (size_t) ret, SIZE_MAX);
+    return GGL_ERR_OK;
+}
+
+GglError ggl_socket_read_with_fd(int fd, GglBuffer buf, int *recv_fd) {
+    GglBuffer rest = buf;
+
+    while (rest.len > 0) {
+        GglError ret = ggl_socket_read_partial_with_fd(fd, &rest, recv_fd);
+        if (ret == GGL_ERR_RETRY) {
+            continue;
+        }
+        if (ret == GGL_ERR_NODATA) {
+            GGL_LOGD("Socket %d closed by peer.", fd);
+        }
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+
+    return GGL_ERR_OK;
+}
+
+GglError ggl_socket_writev_partial(
+    int fd, GglBufList *bufs, int send_fd, bool nonblocking
+) {
+    struct iovec iov[SOCKET_IOV_MAX];
+    size_t iov_len = 0;
+    for (size_t i = 0; (i < bufs->len) && (iov_len < SOCKET_IOV_MAX); i++) {
+        if (bufs->bufs[i].len > 0) {
+            iov[iov_len] = (struct iovec) { .iov_base = bufs->bufs[i].data,
+                                            .iov_len = bufs->bufs[i].len };
+            iov_len += 1;
+        }
+    }
+
+    alignas(struct cmsghdr) uint8_t control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = iov_len };
+    if (send_fd >= 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &send_fd, sizeof(int));
+    }
+
+    ssize_t ret = 0;
+    if (iov_len > 0) {
+        ret = sendmsg(
+            fd, &msg, MSG_NOSIGNAL | (nonblocking ? MSG_DONTWAIT : 0)
+        );
+    }
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return GGL_ERR_RETRY;
+        }
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            if (nonblocking) {
+                return GGL_ERR_OK;
+            }
+            GGL_LOGE("Write timed out on fd %d.", fd);
+            return GGL_ERR_FAILURE;
+        }
+        if (errno == EPIPE) {
+            GGL_LOGE("Write failed to %d; peer closed socket.", fd);
+            return GGL_ERR_NOCONN;
+        }
+        GGL_LOGE("Failed to write to fd %d: %d.", fd, errno);
+        return GGL_ERR_FAILURE;
+    }
+
+    size_t written = (size_t) ret;
+    while ((bufs->len > 0) && (written >= bufs->bufs[0].len)) {
+        written -= bufs->bufs[0].len;
+        bufs->bufs = &bufs->bufs[1];
+        bufs->len -= 1;
+    }
+    if (bufs->len > 0) {
+        bufs->bufs[0] = ggl_buffer_substr(bufs->bufs[0], written, SIZE_MAX);
+    }
+    return GGL_ERR_OK;
+}
+
+GglError ggl_socket_writev(int fd, GglBufList bufs) {
+    return ggl_socket_writev_with_fd(fd, bufs, -1);
+}
+
+GglError ggl_socket_writev_with_fd(int fd, GglBufList bufs, int send_fd) {
+    GglBufList rest = bufs;
+    int pending_fd = send_fd;
+
+    while (rest.len > 0) {
+        GglError ret = ggl_socket_writev_partial(fd, &rest, pending_fd, false);
+        if (ret == GGL_ERR_RETRY) {
+            continue;
+        }
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        // Descriptor is sent with the first written bytes
+        pending_fd = -1;
+    }
+
+    return GGL_ERR_OK;
+}
+
 GglError ggl_connect(GglBuffer path, int *fd) {
     struct sockaddr_un addr = { .sun_family = AF_UNIX, .sun_path = { 0 } };
 
@@ -23,33 +23,69 @@ GglError ggl_socket_epoll_create(int *epoll_fd) {
     return GGL_ERR_OK;
 }
 
-GglError ggl_socket_epoll_add(int epoll_fd, int target_fd, uint64_t data) {
+static GglError epoll_ctl_watch(
+    int epoll_fd, int op, int target_fd, uint32_t events, uint64_t data
+) {
     assert(epoll_fd >= 0);
     assert(target_fd >= 0);
 
-    struct epoll_event event = { .events = EPOLLIN, .data = { .u64 = data } };
+    struct epoll_event event = { .events = events, .data = { .u64 = data } };
 
-    int err = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, target_fd, &event);
+    int err = epoll_ctl(epoll_fd, op, target_fd, &event);
     if (err == -1) {
         err = errno;
-        GGL_LOGE("Failed to add watch for %d: %d.", target_fd, err);
+        GGL_LOGE("Failed to update watch for %d: %d.", target_fd, err);
         return GGL_ERR_FAILURE;
     }
     return GGL_ERR_OK;
 }
 
-GglError ggl_socket_epoll_run(
-    int epoll_fd, GglError (*fd_ready)(void *ctx, uint64_t data), void *ctx
+GglError ggl_socket_epoll_add(int epoll_fd, int target_fd, uint64_t data) {
+    return epoll_ctl_watch(epoll_fd, EPOLL_CTL_ADD, target_fd, EPOLLIN, data);
+}
+
+GglError ggl_socket_epoll_add_oneshot(
+    int epoll_fd, int target_fd, uint64_t data
+) {
+    return epoll_ctl_watch(
+        epoll_fd, EPOLL_CTL_ADD, target_fd, EPOLLIN | EPOLLONESHOT, data
+    );
+}
+
+GglError ggl_socket_epoll_rearm(int epoll_fd, int target_fd, uint64_t data) {
+    return epoll_ctl_watch(
+        epoll_fd, EPOLL_CTL_MOD, target_fd, EPOLLIN | EPOLLONESHOT, data
+    );
+}
+
+GglError ggl_socket_epoll_add_writable(
+    int epoll_fd, int target_fd, uint64_t data
+) {
+    return epoll_ctl_watch(
+        epoll_fd, EPOLL_CTL_ADD, target_fd, EPOLLOUT | EPOLLONESHOT, data
+    );
+}
+
+GglError ggl_socket_epoll_rearm_writable(
+    int epoll_fd, int target_fd, uint64_t data
+) {
+    return epoll_ctl_watch(
+        epoll_fd, EPOLL_CTL_MOD, target_fd, EPOLLOUT | EPOLLONESHOT, data
+    );
+}
+
+static GglError epoll_run_batch(
+    int epoll_fd,
+    GglError (*fd_ready)(void *ctx, uint64_t data),
+    void *ctx,
+    struct epoll_event *events,
+    int max_events
 ) {
     assert(epoll_fd >= 0);
     assert(fd_ready != NULL);
 
-    struct epoll_event events[10];
-
     while (true) {
-        int ready = epoll_wait(
-            epoll_fd, events, sizeof(events) / sizeof(*events), -1
-        );
+        int ready = epoll_wait(epoll_fd, events, max_events, -1);
 
         if (ready == -1) {
             if (errno == EINTR) {
@@ -71,3 +107,19 @@ GglError ggl_socket_epoll_run(
 
     return GGL_ERR_FAILURE;
 }
+
+GglError ggl_socket_epoll_run(
+    int epoll_fd, GglError (*fd_ready)(void *ctx, uint64_t data), void *ctx
+) {
+    struct epoll_event events[10];
+    return epoll_run_batch(
+        epoll_fd, fd_ready, ctx, events, sizeof(events) / sizeof(*events)
+    );
+}
+
+GglError ggl_socket_epoll_run_single(
+    int epoll_fd, GglError (*fd_ready)(void *ctx, uint64_t data), void *ctx
+) {
+    struct epoll_event event;
+    return epoll_run_batch(epoll_fd, fd_ready, ctx, &event, 1);
+}
@@ -8,6 +8,7 @@
 #include <ggl/error.h>
 #include <ggl/file.h>
 #include <ggl/log.h>
+#include <ggl/socket.h>
 #include <pthread.h>
 #include <sys/socket.h>
 #include <stddef.h>
@@ -25,6 +26,13 @@
 // array length (pool->max_fds) is in the range [0, UINT16_MAX], valid indices
 // are in the range [0, UINT16_MAX - 1]. Thus incrementing the index will not
 // overflow a uint16_t.
+//
+// Reads and writes are made without the mutex held, so that a client that is
+// slow to send or receive does not hold up use of the rest of the pool. While
+// they are in progress, the slot's in-use count is raised; closing the handle
+// then shuts the socket down to end them, and the last of them closes the fd.
+// The slot is not reused until then, so the fd number can't be reused under
+// them.
 
 static const int32_t FD_FREE = -0x55555556; // Alternating bits for debugging
 
@@ -49,15 +57,54 @@ static GglError validate_handle(
     return GGL_ERR_OK;
 }
 
+/// Get a handle's fd for use without the pool lock held.
+/// `release_fd` must be called once done with it.
+static GglError acquire_fd(
+    GglSocketPool *pool,
+    uint32_t handle,
+    uint16_t *index,
+    int *fd,
+    const char *location
+) {
+    GGL_MTX_SCOPE_GUARD(&pool->mtx);
+
+    GglError ret = validate_handle(pool, handle, index, location);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    pool->in_use[*index] += 1;
+    *fd = pool->fds[*index];
+    return GGL_ERR_OK;
+}
+
+static void release_fd(GglSocketPool *pool, uint32_t handle, uint16_t index) {
+    GGL_MTX_SCOPE_GUARD(&pool->mtx);
+
+    pool->in_use[index] -= 1;
+
+    // If the handle was closed while in use, its fd was left for us to close
+    if ((pool->in_use[index] == 0)
+        && ((uint16_t) (handle >> 16) != pool->generations[index])) {
+        GGL_LOGD(
+            "Closing fd %d at index %u after last use.", pool->fds[index], index
+        );
+        ggl_close(pool->fds[index]);
+        pool->fds[index] = FD_FREE;
+    }
+}
+
 void ggl_socket_pool_init(GglSocketPool *pool) {
     assert(pool != NULL);
     assert(pool->fds != NULL);
     assert(pool->generations != NULL);
+    assert(pool->in_use != NULL);
 
     GGL_LOGT("Initializing socket pool %p.", pool);
 
     for (size_t i = 0; i < pool->max_fds; i++) {
         pool->fds[i] = FD_FREE;
+        pool->in_use[i] = 0;
     }
 
     // TODO: handle mutex init failure?
@@ -141,10 +188,6 @@ GglError ggl_socket_pool_release(
         }
     }
 
-    if (fd != NULL) {
-        *fd = pool->fds[index];
-    }
-
     GGL_LOGD(
         "Releasing fd %d at index %u, generation %u.",
         pool->fds[index],
@@ -153,6 +196,19 @@ GglError ggl_socket_pool_release(
     );
 
     pool->generations[index] += 1;
+
+    if (pool->in_use[index] > 0) {
+        // End the reads/writes in progress; the last of them closes the fd
+        shutdown(pool->fds[index], SHUT_RDWR);
+        if (fd != NULL) {
+            *fd = -1;
+        }
+        return GGL_ERR_OK;
+    }
+
+    if (fd != NULL) {
+        *fd = pool->fds[index];
+    }
     pool->fds[index] = FD_FREE;
 
     return GGL_ERR_OK;
@@ -165,26 +221,30 @@ GglError ggl_socket_handle_read(
         "Reading %zu bytes from handle %u in pool %p.", buf.len, handle, pool
     );
 
+    uint16_t index = 0;
+    int fd = -1;
+    GglError ret = acquire_fd(pool, handle, &index, &fd, __func__);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
     GglBuffer rest = buf;
 
     while (rest.len > 0) {
-        GGL_MTX_SCOPE_GUARD(&pool->mtx);
-
-        uint16_t index = 0;
-        GglError ret = validate_handle(pool, handle, &index, __func__);
-        if (ret != GGL_ERR_OK) {
-            return ret;
-        }
-
-        ret = ggl_file_read_partial(pool->fds[index], &rest);
+        ret = ggl_file_read_partial(fd, &rest);
         if (ret == GGL_ERR_RETRY) {
             continue;
         }
         if (ret != GGL_ERR_OK) {
-            return ret;
+            break;
         }
     }
 
+    release_fd(pool, handle, index);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
     GGL_LOGT("Read from %u successful.", handle);
     return GGL_ERR_OK;
 }
@@ -196,24 +256,107 @@ GglError ggl_socket_handle_write(
         "Writing %zu bytes to handle %u in pool %p.", buf.len, handle, pool
     );
 
+    uint16_t index = 0;
+    int fd = -1;
+    GglError ret = acquire_fd(pool, handle, &index, &fd, __func__);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
     GglBuffer rest = buf;
 
     while (rest.len > 0) {
-        GGL_MTX_SCOPE_GUARD(&pool->mtx);
+        ret = ggl_file_write_partial(fd, &rest);
+        if (ret == GGL_ERR_RETRY) {
+            continue;
+        }
+        if (ret != GGL_ERR_OK) {
+            break;
+        }
+    }
 
-        uint16_t index = 0;
-        GglError ret = validate_handle(pool, handle, &index, __func__);
+    release_fd(pool, handle, index);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    GGL_LOGT("Write to %u successful.", handle);
+    return GGL_ERR_OK;
+}
+
+GglError ggl_socket_handle_read_with_fd(
+    GglSocketPool *pool, uint32_t handle, GglBuffer buf, int *recv_fd
+) {
+    GGL_LOGT(
+        "Reading %zu bytes from handle %u in pool %p.", buf.len, handle, pool
+    );
+
+    uint16_t index = 0;
+    int fd = -1;
+    GglError ret = acquire_fd(pool, handle, &index, &fd, __func__);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    GglBuffer rest = buf;
+
+    while (rest.len > 0) {
+        ret = ggl_socket_read_partial_with_fd(fd, &rest, recv_fd);
+        if (ret == GGL_ERR_RETRY) {
+            continue;
+        }
         if (ret != GGL_ERR_OK) {
-            return ret;
+            break;
         }
+    }
 
-        ret = ggl_file_write_partial(pool->fds[index], &rest);
+    release_fd(pool, handle, index);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    GGL_LOGT("Read from %u successful.", handle);
+    return GGL_ERR_OK;
+}
+
+GglError ggl_socket_handle_writev(
+    GglSocketPool *pool, uint32_t handle, GglBufList bufs
+) {
+    return ggl_socket_handle_writev_with_fd(pool, handle, bufs, -1);
+}
+
+GglError ggl_socket_handle_writev_with_fd(
+    GglSocketPool *pool, uint32_t handle, GglBufList bufs, int send_fd
+) {
+    GGL_LOGT(
+        "Writing %zu buffers to handle %u in pool %p.", bufs.len, handle, pool
+    );
+
+    uint16_t index = 0;
+    int fd = -1;
+    GglError ret = acquire_fd(pool, handle, &index, &fd, __func__);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    GglBufList rest = bufs;
+    int pending_fd = send_fd;
+
+    while (rest.len > 0) {
+        ret = ggl_socket_writev_partial(fd, &rest, pending_fd, false);
         if (ret == GGL_ERR_RETRY) {
             continue;
         }
         if (ret != GGL_ERR_OK) {
-            return ret;
+            break;
         }
+        // Descriptor is sent with the first written bytes
+        pending_fd = -1;
+    }
+
+    release_fd(pool, handle, index);
+    if (ret != GGL_ERR_OK) {
+        return ret;
     }
 
     GGL_LOGT("Write to %u successful.", handle);
@@ -227,7 +370,12 @@ GglError ggl_socket_handle_close(GglSocketPool *pool, uint32_t handle) {
 
     GglError ret = ggl_socket_pool_release(pool, handle, &fd);
     if (ret == GGL_ERR_OK) {
-        ggl_close(fd);
+        if (fd >= 0) {
+            ggl_close(fd);
+        }
+        if (pool->on_close != NULL) {
+            pool->on_close(handle);
+        }
     }
 
     GGL_LOGT("Close of %u successful.", handle);
@@ -14,6 +14,7 @@
 #include <ggl/file.h>
 #include <ggl/log.h>
 #include <limits.h>
+#include <pthread.h>
 #include <string.h>
 #include <sys/resource.h>
 #include <sys/socket.h>
@@ -22,6 +23,7 @@
 #include <sys/un.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -29,7 +31,7 @@ void (*ggl_socket_server_ext_handler)(void) = NULL;
 int ggl_socket_server_ext_fd;
 
 static void new_client_available(
-    GglSocketPool *pool, int epoll_fd, int socket_fd
+    GglSocketPool *pool, int epoll_fd, int socket_fd, bool oneshot
 ) {
     assert(epoll_fd >= 0);
     assert(socket_fd >= 0);
@@ -72,7 +74,8 @@ static void new_client_available(
     // NOLINTNEXTLINE(clang-analyzer-deadcode.DeadStores) false positive
     client_fd_cleanup = -1;
 
-    ret = ggl_socket_epoll_add(epoll_fd, client_fd, handle);
+    ret = oneshot ? ggl_socket_epoll_add_oneshot(epoll_fd, client_fd, handle)
+                  : ggl_socket_epoll_add(epoll_fd, client_fd, handle);
     if (ret != GGL_ERR_OK) {
         ggl_socket_handle_close(pool, handle);
         GGL_LOGE("Failed to register client %d with epoll.", client_fd);
@@ -80,8 +83,24 @@ static void new_client_available(
     }
 }
 
+typedef struct {
+    GglSocketPool *pool;
+    int epoll_fd;
+    uint32_t handle;
+    GglError ret;
+} RearmArgs;
+
+static void rearm_client(void *ctx, size_t index) {
+    RearmArgs *args = ctx;
+    args->ret = ggl_socket_epoll_rearm(
+        args->epoll_fd, args->pool->fds[index], args->handle
+    );
+}
+
 static void client_data_ready(
     GglSocketPool *pool,
+    int epoll_fd,
+    bool oneshot,
     uint32_t handle,
     GglError (*client_ready)(void *ctx, uint32_t handle),
     void *ctx
@@ -91,6 +110,17 @@ static void client_data_ready(
     GglError ret = client_ready(ctx, handle);
     if (ret != GGL_ERR_OK) {
         ggl_socket_handle_close(pool, handle);
+        return;
+    }
+
+    if (oneshot) {
+        RearmArgs args
+            = { .pool = pool, .epoll_fd = epoll_fd, .handle = handle };
+        // If the handle was closed while handling, there is nothing to rearm
+        ret = ggl_socket_handle_protected(rearm_client, &args, pool, handle);
+        if ((ret == GGL_ERR_OK) && (args.ret != GGL_ERR_OK)) {
+            ggl_socket_handle_close(pool, handle);
+        }
     }
 }
 
@@ -173,6 +203,8 @@ typedef struct {
     GglSocketPool *pool;
     int epoll_fd;
     int server_fd;
+    /// Watches are oneshot and rearmed after handling (worker mode).
+    bool oneshot;
     GglError (*client_ready)(void *ctx, uint32_t handle);
     void *ctx;
 } SocketServerCtx;
@@ -187,14 +219,29 @@ static GglError epoll_fd_ready(void *epoll_ctx, uint64_t data) {
 
     if (data == SERVER_FD_DATA) {
         new_client_available(
-            server_ctx->pool, server_ctx->epoll_fd, server_ctx->server_fd
+            server_ctx->pool,
+            server_ctx->epoll_fd,
+            server_ctx->server_fd,
+            server_ctx->oneshot
         );
+        if (server_ctx->oneshot) {
+            return ggl_socket_epoll_rearm(
+                server_ctx->epoll_fd, server_ctx->server_fd, SERVER_FD_DATA
+            );
+        }
     } else if ((ggl_socket_server_ext_handler != NULL)
                && (data == EXT_FD_DATA)) {
         ggl_socket_server_ext_handler();
+        if (server_ctx->oneshot) {
+            return ggl_socket_epoll_rearm(
+                server_ctx->epoll_fd, ggl_socket_server_ext_fd, EXT_FD_DATA
+            );
+        }
     } else if (data <= UINT32_MAX) {
         client_data_ready(
             server_ctx->pool,
+            server_ctx->epoll_fd,
+            server_ctx->oneshot,
             (uint32_t) data,
             server_ctx->client_ready,
             server_ctx->ctx
@@ -306,13 +353,25 @@ static int inherit_socket_from_env(GglBuffer socket_name) {
     return -1;
 }
 
-GglError ggl_socket_server_listen(
+static void *server_worker_thread(void *ctx) {
+    SocketServerCtx *server_ctx = ctx;
+
+    GGL_LOGD("Started socket server worker thread.");
+    ggl_socket_epoll_run_single(server_ctx->epoll_fd, epoll_fd_ready, ctx);
+
+    // Server ctx is owned by the listening thread; can't continue safely
+    GGL_LOGE("Socket server worker thread exited.");
+    _Exit(1);
+}
+
+static GglError server_listen(
     const GglBuffer *socket_name,
     GglBuffer path,
     mode_t mode,
     GglSocketPool *pool,
     GglError (*client_ready)(void *ctx, uint32_t handle),
-    void *ctx
+    void *ctx,
+    size_t worker_count
 ) {
     assert(pool != NULL);
     assert(pool->fds != NULL);
@@ -359,15 +418,22 @@ GglError ggl_socket_server_listen(
     }
     GGL_CLEANUP(cleanup_close, server_fd);
 
-    ret = ggl_socket_epoll_add(epoll_fd, server_fd, SERVER_FD_DATA);
+    bool oneshot = worker_count > 1;
+
+    ret = oneshot
+        ? ggl_socket_epoll_add_oneshot(epoll_fd, server_fd, SERVER_FD_DATA)
+        : ggl_socket_epoll_add(epoll_fd, server_fd, SERVER_FD_DATA);
     if (ret != GGL_ERR_OK) {
         return ret;
     }
 
     if (ggl_socket_server_ext_handler != NULL) {
-        ret = ggl_socket_epoll_add(
-            epoll_fd, ggl_socket_server_ext_fd, EXT_FD_DATA
-        );
+        ret = oneshot ? ggl_socket_epoll_add_oneshot(
+                            epoll_fd, ggl_socket_server_ext_fd, EXT_FD_DATA
+                        )
+                      : ggl_socket_epoll_add(
+                            epoll_fd, ggl_socket_server_ext_fd, EXT_FD_DATA
+                        );
         if (ret != GGL_ERR_OK) {
             return ret;
         }
@@ -377,9 +443,53 @@ GglError ggl_socket_server_listen(
         .pool = pool,
         .epoll_fd = epoll_fd,
         .server_fd = server_fd,
+        .oneshot = oneshot,
         .client_ready = client_ready,
         .ctx = ctx,
     };
 
-    return ggl_socket_epoll_run(epoll_fd, epoll_fd_ready, &server_ctx);
+    if (!oneshot) {
+        return ggl_socket_epoll_run(epoll_fd, epoll_fd_ready, &server_ctx);
+    }
+
+    // Calling thread is one of the workers
+    for (size_t i = 1; i < worker_count; i++) {
+        pthread_t worker = { 0 };
+        int sys_ret = pthread_create(
+            &worker, NULL, server_worker_thread, &server_ctx
+        );
+        if (sys_ret != 0) {
+            GGL_LOGE("Failed to create socket server worker thread.");
+            return GGL_ERR_FATAL;
+        }
+        pthread_detach(worker);
+    }
+
+    GGL_LOGD("Socket server running with %zu workers.", worker_count);
+    return ggl_socket_epoll_run_single(epoll_fd, epoll_fd_ready, &server_ctx);
+}
+
+GglError ggl_socket_server_listen(
+    const GglBuffer *socket_name,
+    GglBuffer path,
+    mode_t mode,
+    GglSocketPool *pool,
+    GglError (*client_ready)(void *ctx, uint32_t handle),
+    void *ctx
+) {
+    return server_listen(socket_name, path, mode, pool, client_ready, ctx, 1);
+}
+
+GglError ggl_socket_server_listen_threaded(
+    const GglBuffer *socket_name,
+    GglBuffer path,
+    mode_t mode,
+    GglSocketPool *pool,
+    GglError (*client_ready)(void *ctx, uint32_t handle),
+    void *ctx,
+    size_t worker_count
+) {
+    return server_listen(
+        socket_name, path, mode, pool, client_ready, ctx, worker_count
+    );
 }
@@ -0,0 +1,149 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef GGL_TOPIC_INDEX_H
+#define GGL_TOPIC_INDEX_H
+
+//! Index of MQTT-style topic filter subscriptions
+
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Filters without wildcards are kept in a hash table keyed by the full filter,
+// so publishes to them are found with a single lookup. Filters with wildcards
+// are kept in a trie with one node per topic level, so matching cost depends
+// on topic depth and matching filters rather than total subscriptions.
+// Subscriptions to the same filter share one filter entry, which keeps a count
+// of its subscriptions.
+
+/// Maximum length of a topic filter.
+/// Can be configured with `-DGGL_TOPIC_FILTER_MAX_LEN=<N>`.
+#ifndef GGL_TOPIC_FILTER_MAX_LEN
+#define GGL_TOPIC_FILTER_MAX_LEN 256
+#endif
+
+/// A distinct topic filter and its subscriptions.
+/// Links are array index + 1, with 0 for none.
+typedef struct {
+    uint8_t text[GGL_TOPIC_FILTER_MAX_LEN];
+    uint16_t len;
+    /// Number of subscriptions using this filter; 0 if free.
+    uint16_t refs;
+    uint32_t hash;
+    /// First subscription with this filter.
+    uint16_t subs;
+    /// Trie node this filter ends at; 0 if it has no wildcards.
+    uint16_t node;
+    /// Next filter in hash bucket, or in free list.
+    uint16_t bucket_next;
+    /// Next filter ending at the same trie node.
+    uint16_t node_next;
+} GglTopicFilter;
+
+/// Trie node for one level of wildcard filters.
+/// Nodes are found by hashing the parent node and the level, and are
+/// identified by hash and length of the level; matches are confirmed against
+/// the full filter.
+typedef struct {
+    uint32_t hash;
+    uint16_t len;
+    uint16_t parent;
+    /// Next node in hash bucket, or in free list.
+    uint16_t bucket_next;
+    /// First filter ending at this node.
+    uint16_t filters;
+    /// Number of filters through or ending at this node.
+    uint16_t refs;
+} GglTopicNode;
+
+/// A subscription to a filter.
+typedef struct {
+    /// Caller data, such as a core bus handle.
+    uint32_t value;
+    /// Filter used by this subscription; 0 if free.
+    uint16_t filter;
+    /// Next subscription with the same filter, or in free list.
+    uint16_t next;
+} GglTopicSub;
+
+/// Topic filter subscription index.
+/// Array pointers and lengths should be set before calling
+/// `ggl_topic_index_init`. `nodes` needs one entry more than the number of
+/// trie nodes, which is at most the total levels of all wildcard filters.
+/// `buckets` and `node_buckets` are hash tables for filters and nodes.
+/// Not thread safe.
+typedef struct {
+    GglTopicFilter *filters;
+    uint16_t max_filters;
+    GglTopicNode *nodes;
+    uint16_t max_nodes;
+    GglTopicSub *subs;
+    uint16_t max_subs;
+    uint16_t *buckets;
+    uint16_t bucket_count;
+    uint16_t *node_buckets;
+    uint16_t node_bucket_count;
+    uint16_t free_filters;
+    uint16_t free_nodes;
+    uint16_t free_node_count;
+    uint16_t free_subs;
+} GglTopicIndex;
+
+/// Initialize an index, removing any subscriptions.
+void ggl_topic_index_init(GglTopicIndex *index);
+
+/// Copy the contents of `src` into `dst`.
+/// Both indexes must have the same array sizes.
+void ggl_topic_index_copy(GglTopicIndex *dst, const GglTopicIndex *src);
+
+/// Add a subscription to `filter`, identified by the returned `sub_id`.
+/// `new_filter` is set if no other subscription uses the same filter.
+GglError ggl_topic_index_add(
+    GglTopicIndex *index,
+    GglBuffer filter,
+    uint32_t value,
+    uint16_t *sub_id,
+    bool *new_filter
+);
+
+/// Remove a subscription.
+/// `last` is set if it was the last subscription to its filter.
+void ggl_topic_index_remove(GglTopicIndex *index, uint16_t sub_id, bool *last);
+
+/// Get the filter of a subscription.
+GglBuffer ggl_topic_index_filter(const GglTopicIndex *index, uint16_t sub_id);
+
+/// Get the caller data of a subscription.
+uint32_t ggl_topic_index_value(const GglTopicIndex *index, uint16_t sub_id);
+
+/// Get the next subscription to the same filter as `sub_id`, or 0 if none.
+uint16_t ggl_topic_index_next_sub(const GglTopicIndex *index, uint16_t sub_id);
+
+/// Call `on_filter` once for each distinct filter, with its first subscription.
+/// The index must not be modified from `on_filter`.
+void ggl_topic_index_for_each_filter(
+    const GglTopicIndex *index,
+    void (*on_filter)(void *ctx, GglBuffer filter, uint16_t first_sub),
+    void *ctx
+);
+
+/// Call `on_match` for each subscription with a filter matching `topic`.
+/// The index must not be modified from `on_match`.
+void ggl_topic_index_match(
+    const GglTopicIndex *index,
+    GglBuffer topic,
+    void (*on_match)(void *ctx, uint16_t sub_id, uint32_t value),
+    void *ctx
+);
+
+/// Check if a topic filter is valid.
+/// Wildcards must make up a whole level, and `#` must be the last level.
+bool ggl_topic_filter_valid(GglBuffer filter);
+
+/// Check if a topic matches a topic filter.
+bool ggl_topic_filter_match(GglBuffer filter, GglBuffer topic);
+
+#endif
@@ -0,0 +1,556 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ggl/topic_index.h"
+#include <assert.h>
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <ggl/log.h>
+#include <ggl/object.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Links in the index are array index + 1, with 0 for none.
+// Node 1 (index 0) is the trie root.
+
+#define ROOT_NODE 1
+
+static uint32_t hash_buffer(GglBuffer buf) {
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < buf.len; i++) {
+        hash ^= buf.data[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/// Get the topic level starting at `pos` and advance `pos` past it.
+/// `pos` is past the end once the last level is returned.
+static GglBuffer next_level(GglBuffer topic, size_t *pos) {
+    size_t start = *pos;
+    size_t end = start;
+    while ((end < topic.len) && (topic.data[end] != '/')) {
+        end += 1;
+    }
+    *pos = end + 1;
+    return ggl_buffer_substr(topic, start, end);
+}
+
+static bool levels_remain(GglBuffer topic, size_t pos) {
+    return pos <= topic.len;
+}
+
+static bool is_level(GglBuffer level, char wildcard) {
+    return (level.len == 1) && (level.data[0] == (uint8_t) wildcard);
+}
+
+static GglTopicFilter *get_filter(const GglTopicIndex *index, uint16_t id) {
+    assert((id > 0) && (id <= index->max_filters));
+    return &index->filters[id - 1];
+}
+
+static GglTopicNode *get_node(const GglTopicIndex *index, uint16_t id) {
+    assert((id > 0) && (id <= index->max_nodes));
+    return &index->nodes[id - 1];
+}
+
+static GglTopicSub *get_sub(const GglTopicIndex *index, uint16_t id) {
+    assert((id > 0) && (id <= index->max_subs));
+    return &index->subs[id - 1];
+}
+
+void ggl_topic_index_init(GglTopicIndex *index) {
+    assert(index->filters != NULL);
+    assert(index->nodes != NULL);
+    assert(index->subs != NULL);
+    assert(index->buckets != NULL);
+    assert(index->node_buckets != NULL);
+    assert(index->max_nodes > 0);
+    assert(index->bucket_count > 0);
+    assert(index->node_bucket_count > 0);
+
+    for (uint16_t i = 0; i < index->max_filters; i++) {
+        index->filters[i] = (GglTopicFilter) {
+            .bucket_next = (i + 1U < index->max_filters) ? i + 2U : 0,
+        };
+    }
+    index->free_filters = (index->max_filters > 0) ? 1 : 0;
+
+    index->nodes[0] = (GglTopicNode) { 0 };
+    for (uint16_t i = 1; i < index->max_nodes; i++) {
+        index->nodes[i] = (GglTopicNode) {
+            .bucket_next = (i + 1U < index->max_nodes) ? i + 2U : 0,
+        };
+    }
+    index->free_nodes = (index->max_nodes > 1) ? 2 : 0;
+    index->free_node_count = (uint16_t) (index->max_nodes - 1U);
+
+    for (uint16_t i = 0; i < index->max_subs; i++) {
+        index->subs[i] = (GglTopicSub) {
+            .next = (i + 1U < index->max_subs) ? i + 2U : 0,
+        };
+    }
+    index->free_subs = (index->max_subs > 0) ? 1 : 0;
+
+    memset(index->buckets, 0, index->bucket_count * sizeof(uint16_t));
+    memset(
+        index->node_buckets, 0, index->node_bucket_count * sizeof(uint16_t)
+    );
+}
+
+void ggl_topic_index_copy(GglTopicIndex *dst, const GglTopicIndex *src) {
+    assert(dst->max_filters == src->max_filters);
+    assert(dst->max_nodes == src->max_nodes);
+    assert(dst->max_subs == src->max_subs);
+    assert(dst->bucket_count == src->bucket_count);
+    assert(dst->node_bucket_count == src->node_bucket_count);
+
+    memcpy(
+        dst->filters, src->filters, src->max_filters * sizeof(GglTopicFilter)
+    );
+    memcpy(dst->nodes, src->nodes, src->max_nodes * sizeof(GglTopicNode));
+    memcpy(dst->subs, src->subs, src->max_subs * sizeof(GglTopicSub));
+    memcpy(dst->buckets, src->buckets, src->bucket_count * sizeof(uint16_t));
+    memcpy(
+        dst->node_buckets,
+        src->node_buckets,
+        src->node_bucket_count * sizeof(uint16_t)
+    );
+
+    dst->free_filters = src->free_filters;
+    dst->free_nodes = src->free_nodes;
+    dst->free_node_count = src->free_node_count;
+    dst->free_subs = src->free_subs;
+}
+
+static bool filter_has_wildcard(GglBuffer filter) {
+    size_t pos = 0;
+    while (levels_remain(filter, pos)) {
+        GglBuffer level = next_level(filter, &pos);
+        if (is_level(level, '+') || is_level(level, '#')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint16_t *node_bucket_for(
+    const GglTopicIndex *index, uint16_t parent, uint32_t hash
+) {
+    uint32_t key = hash ^ (parent * 2654435761U);
+    return &index->node_buckets[key % index->node_bucket_count];
+}
+
+static uint16_t find_child(
+    const GglTopicIndex *index, uint16_t parent, uint32_t hash, size_t len
+) {
+    for (uint16_t id = *node_bucket_for(index, parent, hash); id != 0;
+         id = get_node(index, id)->bucket_next) {
+        GglTopicNode *node = get_node(index, id);
+        if ((node->parent == parent) && (node->hash == hash)
+            && (node->len == len)) {
+            return id;
+        }
+    }
+    return 0;
+}
+
+/// Count nodes needed to add a wildcard filter to the trie.
+static size_t new_nodes_needed(const GglTopicIndex *index, GglBuffer filter) {
+    uint16_t node = ROOT_NODE;
+    size_t pos = 0;
+    while (levels_remain(filter, pos)) {
+        GglBuffer level = next_level(filter, &pos);
+        node = find_child(index, node, hash_buffer(level), level.len);
+        if (node == 0) {
+            size_t needed = 1;
+            while (levels_remain(filter, pos)) {
+                (void) next_level(filter, &pos);
+                needed += 1;
+            }
+            return needed;
+        }
+    }
+    return 0;
+}
+
+static uint16_t trie_insert(GglTopicIndex *index, GglBuffer filter) {
+    uint16_t node = ROOT_NODE;
+    size_t pos = 0;
+    while (levels_remain(filter, pos)) {
+        GglBuffer level = next_level(filter, &pos);
+        uint32_t hash = hash_buffer(level);
+        uint16_t child = find_child(index, node, hash, level.len);
+        if (child == 0) {
+            child = index->free_nodes;
+            assert(child != 0);
+            GglTopicNode *new_node = get_node(index, child);
+            index->free_nodes = new_node->bucket_next;
+            index->free_node_count -= 1;
+
+            uint16_t *bucket = node_bucket_for(index, node, hash);
+            *new_node = (GglTopicNode) { .hash = hash,
+                                         .len = (uint16_t) level.len,
+                                         .parent = node,
+                                         .bucket_next = *bucket };
+            *bucket = child;
+        }
+        get_node(index, child)->refs += 1;
+        node = child;
+    }
+    return node;
+}
+
+static void trie_remove(GglTopicIndex *index, uint16_t node) {
+    while (node != ROOT_NODE) {
+        GglTopicNode *entry = get_node(index, node);
+        uint16_t parent = entry->parent;
+        entry->refs -= 1;
+
+        if (entry->refs == 0) {
+            assert(entry->filters == 0);
+
+            uint16_t *link = node_bucket_for(index, parent, entry->hash);
+            while (*link != node) {
+                link = &get_node(index, *link)->bucket_next;
+            }
+            *link = entry->bucket_next;
+
+            *entry = (GglTopicNode) { .bucket_next = index->free_nodes };
+            index->free_nodes = node;
+            index->free_node_count += 1;
+        }
+
+        node = parent;
+    }
+}
+
+static uint16_t *bucket_for(const GglTopicIndex *index, uint32_t hash) {
+    return &index->buckets[hash % index->bucket_count];
+}
+
+static uint16_t find_filter(
+    const GglTopicIndex *index, GglBuffer filter, uint32_t hash
+) {
+    for (uint16_t id = *bucket_for(index, hash); id != 0;
+         id = get_filter(index, id)->bucket_next) {
+        GglTopicFilter *entry = get_filter(index, id);
+        if ((entry->hash == hash) && (entry->len == filter.len)
+            && (memcmp(entry->text, filter.data, filter.len) == 0)) {
+            return id;
+        }
+    }
+    return 0;
+}
+
+static GglError add_filter(
+    GglTopicIndex *index, GglBuffer filter, uint32_t hash, uint16_t *filter_id
+) {
+    uint16_t id = index->free_filters;
+    if (id == 0) {
+        GGL_LOGE("Maximum topic filters exceeded.");
+        return GGL_ERR_NOMEM;
+    }
+
+    uint16_t node = 0;
+    if (filter_has_wildcard(filter)) {
+        if (new_nodes_needed(index, filter) > index->free_node_count) {
+            GGL_LOGE("Maximum topic filter levels exceeded.");
+            return GGL_ERR_NOMEM;
+        }
+        node = trie_insert(index, filter);
+    }
+
+    GglTopicFilter *entry = get_filter(index, id);
+    index->free_filters = entry->bucket_next;
+
+    uint16_t *bucket = bucket_for(index, hash);
+    *entry = (GglTopicFilter) { .len = (uint16_t) filter.len,
+                                .hash = hash,
+                                .node = node,
+                                .bucket_next = *bucket };
+    memcpy(entry->text, filter.data, filter.len);
+    *bucket = id;
+
+    if (node != 0) {
+        GglTopicNode *node_entry = get_node(index, node);
+        entry->node_next = node_entry->filters;
+        node_entry->filters = id;
+    }
+
+    *filter_id = id;
+    return GGL_ERR_OK;
+}
+
+static void remove_filter(GglTopicIndex *index, uint16_t id) {
+    GglTopicFilter *entry = get_filter(index, id);
+
+    uint16_t *link = bucket_for(index, entry->hash);
+    while (*link != id) {
+        link = &get_filter(index, *link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+
+    if (entry->node != 0) {
+        link = &get_node(index, entry->node)->filters;
+        while (*link != id) {
+            link = &get_filter(index, *link)->node_next;
+        }
+        *link = entry->node_next;
+        trie_remove(index, entry->node);
+    }
+
+    entry->len = 0;
+    entry->node = 0;
+    entry->node_next = 0;
+    entry->bucket_next = index->free_filters;
+    index->free_filters = id;
+}
+
+GglError ggl_topic_index_add(
+    GglTopicIndex *index,
+    GglBuffer filter,
+    uint32_t value,
+    uint16_t *sub_id,
+    bool *new_filter
+) {
+    if (filter.len > GGL_TOPIC_FILTER_MAX_LEN) {
+        GGL_LOGE("Topic filter exceeds max length.");
+        return GGL_ERR_RANGE;
+    }
+    if (!ggl_topic_filter_valid(filter)) {
+        GGL_LOGE("Invalid topic filter: %.*s.", (int) filter.len, filter.data);
+        return GGL_ERR_INVALID;
+    }
+
+    uint16_t id = index->free_subs;
+    if (id == 0) {
+        GGL_LOGE("Maximum topic subscriptions exceeded.");
+        return GGL_ERR_NOMEM;
+    }
+
+    uint32_t hash = hash_buffer(filter);
+    uint16_t filter_id = find_filter(index, filter, hash);
+    bool created = false;
+
+    if (filter_id == 0) {
+        GglError ret = add_filter(index, filter, hash, &filter_id);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+        created = true;
+    }
+
+    GglTopicSub *sub = get_sub(index, id);
+    index->free_subs = sub->next;
+
+    GglTopicFilter *filter_entry = get_filter(index, filter_id);
+    *sub = (GglTopicSub) { .value = value,
+                           .filter = filter_id,
+                           .next = filter_entry->subs };
+    filter_entry->subs = id;
+    filter_entry->refs += 1;
+
+    *sub_id = id;
+    if (new_filter != NULL) {
+        *new_filter = created;
+    }
+    return GGL_ERR_OK;
+}
+
+void ggl_topic_index_remove(GglTopicIndex *index, uint16_t sub_id, bool *last) {
+    GglTopicSub *sub = get_sub(index, sub_id);
+    assert(sub->filter != 0);
+    GglTopicFilter *filter = get_filter(index, sub->filter);
+
+    uint16_t *link = &filter->subs;
+    while (*link != sub_id) {
+        link = &get_sub(index, *link)->next;
+    }
+    *link = sub->next;
+
+    filter->refs -= 1;
+    bool removed = filter->refs == 0;
+    if (removed) {
+        remove_filter(index, sub->filter);
+    }
+
+    *sub = (GglTopicSub) { .next = index->free_subs };
+    index->free_subs = sub_id;
+
+    if (last != NULL) {
+        *last = removed;
+    }
+}
+
+GglBuffer ggl_topic_index_filter(const GglTopicIndex *index, uint16_t sub_id) {
+    GglTopicFilter *filter = get_filter(index, get_sub(index, sub_id)->filter);
+    return (GglBuffer) { .data = filter->text, .len = filter->len };
+}
+
+uint32_t ggl_topic_index_value(const GglTopicIndex *index, uint16_t sub_id) {
+    return get_sub(index, sub_id)->value;
+}
+
+uint16_t ggl_topic_index_next_sub(const GglTopicIndex *index, uint16_t sub_id) {
+    return get_sub(index, sub_id)->next;
+}
+
+void ggl_topic_index_for_each_filter(
+    const GglTopicIndex *index,
+    void (*on_filter)(void *ctx, GglBuffer filter, uint16_t first_sub),
+    void *ctx
+) {
+    for (size_t i = 0; i < index->max_filters; i++) {
+        GglTopicFilter *filter = get_filter(index, (uint16_t) (i + 1U));
+        if (filter->refs != 0) {
+            on_filter(
+                ctx,
+                (GglBuffer) { .data = filter->text, .len = filter->len },
+                filter->subs
+            );
+        }
+    }
+}
+
+typedef struct {
+    const GglTopicIndex *index;
+    GglBuffer topic;
+    void (*on_match)(void *ctx, uint16_t sub_id, uint32_t value);
+    void *ctx;
+    uint32_t hash_single;
+    uint32_t hash_multi;
+} MatchCtx;
+
+static void emit_filter_subs(const MatchCtx *match, uint16_t filter_id) {
+    for (uint16_t sub = get_filter(match->index, filter_id)->subs; sub != 0;
+         sub = get_sub(match->index, sub)->next) {
+        match->on_match(match->ctx, sub, get_sub(match->index, sub)->value);
+    }
+}
+
+static void emit_node_filters(const MatchCtx *match, uint16_t node) {
+    for (uint16_t id = get_node(match->index, node)->filters; id != 0;
+         id = get_filter(match->index, id)->node_next) {
+        GglTopicFilter *filter = get_filter(match->index, id);
+        // Trie nodes only compare level hashes, so confirm the match
+        if (ggl_topic_filter_match(
+                (GglBuffer) { .data = filter->text, .len = filter->len },
+                match->topic
+            )) {
+            emit_filter_subs(match, id);
+        }
+    }
+}
+
+static void match_node(const MatchCtx *match, uint16_t node, size_t pos) {
+    const GglTopicIndex *index = match->index;
+
+    // Matches the remaining levels, or none (parent level)
+    uint16_t multi_level = find_child(index, node, match->hash_multi, 1);
+    if (multi_level != 0) {
+        emit_node_filters(match, multi_level);
+    }
+
+    if (!levels_remain(match->topic, pos)) {
+        emit_node_filters(match, node);
+        return;
+    }
+
+    GglBuffer level = next_level(match->topic, &pos);
+
+    uint16_t single_level = find_child(index, node, match->hash_single, 1);
+    if (single_level != 0) {
+        match_node(match, single_level, pos);
+    }
+
+    uint16_t exact = find_child(index, node, hash_buffer(level), level.len);
+    if ((exact != 0) && (exact != single_level)) {
+        match_node(match, exact, pos);
+    }
+}
+
+void ggl_topic_index_match(
+    const GglTopicIndex *index,
+    GglBuffer topic,
+    void (*on_match)(void *ctx, uint16_t sub_id, uint32_t value),
+    void *ctx
+) {
+    assert(on_match != NULL);
+
+    MatchCtx match = {
+        .index = index,
+        .topic = topic,
+        .on_match = on_match,
+        .ctx = ctx,
+        .hash_single = hash_buffer(GGL_STR("+")),
+        .hash_multi = hash_buffer(GGL_STR("#")),
+    };
+
+    // Filters without wildcards only match identical topics
+    uint32_t hash = hash_buffer(topic);
+    for (uint16_t id = *bucket_for(index, hash); id != 0;
+         id = get_filter(index, id)->bucket_next) {
+        GglTopicFilter *filter = get_filter(index, id);
+        if ((filter->node == 0) && (filter->hash == hash)
+            && (filter->len == topic.len)
+            && (memcmp(filter->text, topic.data, topic.len) == 0)) {
+            emit_filter_subs(&match, id);
+        }
+    }
+
+    if (index->free_node_count + 1U < index->max_nodes) {
+        match_node(&match, ROOT_NODE, 0);
+    }
+}
+
+bool ggl_topic_filter_valid(GglBuffer filter) {
+    if (filter.len == 0) {
+        return false;
+    }
+    size_t pos = 0;
+    while (levels_remain(filter, pos)) {
+        GglBuffer level = next_level(filter, &pos);
+        for (size_t i = 0; i < level.len; i++) {
+            if ((level.data[i] == '+') || (level.data[i] == '#')) {
+                if (level.len != 1) {
+                    return false;
+                }
+                if ((level.data[i] == '#') && levels_remain(filter, pos)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool ggl_topic_filter_match(GglBuffer filter, GglBuffer topic) {
+    // Wildcards in the first level do not match topics starting with `$`
+    if ((topic.len > 0) && (topic.data[0] == '$') && (filter.len > 0)
+        && ((filter.data[0] == '+') || (filter.data[0] == '#'))) {
+        return false;
+    }
+
+    size_t filter_pos = 0;
+    size_t topic_pos = 0;
+    while (levels_remain(filter, filter_pos)) {
+        GglBuffer filter_level = next_level(filter, &filter_pos);
+        if (is_level(filter_level, '#')) {
+            return true;
+        }
+        if (!levels_remain(topic, topic_pos)) {
+            return false;
+        }
+        GglBuffer topic_level = next_level(topic, &topic_pos);
+        if (!is_level(filter_level, '+')
+            && !ggl_buffer_eq(filter_level, topic_level)) {
+            return false;
+        }
+    }
+    return !levels_remain(topic, topic_pos);
+}
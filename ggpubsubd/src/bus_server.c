@@ -3,23 +3,28 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "ggpubsubd.h"
-#include <sys/types.h>
 #include <assert.h>
-#include <core_mqtt.h>
-#include <core_mqtt_config.h>
 #include <ggl/buffer.h>
+#include <ggl/cleanup.h>
 #include <ggl/core_bus/server.h>
 #include <ggl/error.h>
 #include <ggl/log.h>
 #include <ggl/map.h>
 #include <ggl/object.h>
-#include <string.h>
+#include <ggl/topic_index.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // Matches AWS IoT topic length
 #define GGL_PUBSUB_MAX_TOPIC_LENGTH 256
 
+static_assert(
+    GGL_PUBSUB_MAX_TOPIC_LENGTH <= GGL_TOPIC_FILTER_MAX_LEN,
+    "GGL_PUBSUB_MAX_TOPIC_LENGTH does not fit in topic index."
+);
+
 /// Maximum number of local subscriptions.
 /// Can be configured with `-DGGL_PUBSUB_MAX_SUBSCRIPTIONS=<N>`.
 #ifndef GGL_PUBSUB_MAX_SUBSCRIPTIONS
@@ -32,39 +37,43 @@ static_assert(
     "maximum, then subscriptions can block publishes from being handled."
 );
 
-static uint32_t sub_handle[GGL_PUBSUB_MAX_SUBSCRIPTIONS];
-static uint32_t sub_topic_filter[GGL_PUBSUB_MAX_SUBSCRIPTIONS]
-                                [GGL_PUBSUB_MAX_TOPIC_LENGTH];
-// Stores length -1 so fits in uint8_t
-static uint8_t sub_topic_length[GGL_PUBSUB_MAX_SUBSCRIPTIONS];
+/// Maximum total levels across distinct wildcard topic filters.
+/// Can be configured with `-DGGL_PUBSUB_MAX_TOPIC_LEVELS=<N>`.
+#ifndef GGL_PUBSUB_MAX_TOPIC_LEVELS
+#define GGL_PUBSUB_MAX_TOPIC_LEVELS (8 * GGL_PUBSUB_MAX_SUBSCRIPTIONS)
+#endif
 
-static_assert(
-    GGL_PUBSUB_MAX_TOPIC_LENGTH - 1 <= UINT8_MAX,
-    "GGL_PUBSUB_MAX_TOPIC_LENGTH does not fit in an uint8_t."
-);
+static GglTopicFilter sub_filters[GGL_PUBSUB_MAX_SUBSCRIPTIONS];
+static GglTopicNode sub_filter_nodes[GGL_PUBSUB_MAX_TOPIC_LEVELS + 1];
+static GglTopicSub subs[GGL_PUBSUB_MAX_SUBSCRIPTIONS];
+static uint16_t sub_filter_buckets[GGL_PUBSUB_MAX_SUBSCRIPTIONS];
+static uint16_t sub_filter_node_buckets[GGL_PUBSUB_MAX_SUBSCRIPTIONS];
+
+static GglTopicIndex sub_index = {
+    .filters = sub_filters,
+    .max_filters = GGL_PUBSUB_MAX_SUBSCRIPTIONS,
+    .nodes = sub_filter_nodes,
+    .max_nodes = GGL_PUBSUB_MAX_TOPIC_LEVELS + 1,
+    .subs = subs,
+    .max_subs = GGL_PUBSUB_MAX_SUBSCRIPTIONS,
+    .buckets = sub_filter_buckets,
+    .bucket_count = GGL_PUBSUB_MAX_SUBSCRIPTIONS,
+    .node_buckets = sub_filter_node_buckets,
+    .node_bucket_count = GGL_PUBSUB_MAX_SUBSCRIPTIONS,
+};
+
+// Subscriptions may be closed from other core bus threads
+static pthread_mutex_t sub_index_mtx = PTHREAD_MUTEX_INITIALIZER;
 
 static GglError rpc_publish(void *ctx, GglMap params, uint32_t handle);
 static GglError rpc_subscribe(void *ctx, GglMap params, uint32_t handle);
 
-// coreMQTT mtx APIs need defining since we link to it, but we only use topic
-// matching so they should never be called.
-
-pthread_mutex_t *coremqtt_get_send_mtx(const MQTTContext_t *ctx) {
-    (void) ctx;
-    assert(false);
-    return NULL;
-}
-
-pthread_mutex_t *coremqtt_get_state_mtx(const MQTTContext_t *ctx) {
-    (void) ctx;
-    assert(false);
-    return NULL;
-}
-
 GglError run_ggpubsubd(void) {
+    ggl_topic_index_init(&sub_index);
+
     GglRpcMethodDesc handlers[] = {
-        { GGL_STR("publish"), false, rpc_publish, NULL },
-        { GGL_STR("subscribe"), true, rpc_subscribe, NULL },
+        { GGL_STR("publish"), false, rpc_publish, NULL, false },
+        { GGL_STR("subscribe"), true, rpc_subscribe, NULL, false },
     };
     size_t handlers_len = sizeof(handlers) / sizeof(handlers[0]);
 
@@ -74,6 +83,19 @@ GglError run_ggpubsubd(void) {
     return ret;
 }
 
+typedef struct {
+    uint32_t handles[GGL_PUBSUB_MAX_SUBSCRIPTIONS];
+    size_t len;
+} MatchedHandles;
+
+static void add_matched_handle(void *ctx, uint16_t sub_id, uint32_t value) {
+    (void) sub_id;
+    MatchedHandles *matched = ctx;
+    assert(matched->len < GGL_PUBSUB_MAX_SUBSCRIPTIONS);
+    matched->handles[matched->len] = value;
+    matched->len += 1;
+}
+
 static GglError rpc_publish(void *ctx, GglMap params, uint32_t handle) {
     (void) ctx;
     GGL_LOGD("Handling request from %u.", handle);
@@ -97,48 +119,27 @@ static GglError rpc_publish(void *ctx, GglMap params, uint32_t handle) {
         return GGL_ERR_RANGE;
     }
 
-    for (size_t i = 0; i < GGL_PUBSUB_MAX_SUBSCRIPTIONS; i++) {
-        if (sub_handle[i] != 0) {
-            bool matches = false;
-            MQTT_MatchTopic(
-                (char *) topic.data,
-                (uint16_t) topic.len,
-                (char *) sub_topic_filter[i],
-                (uint16_t) sub_topic_length[i] + 1,
-                &matches
-            );
-            if (matches) {
-                ggl_sub_respond(sub_handle[i], GGL_OBJ_MAP(params));
-            }
-        }
+    MatchedHandles matched = { .len = 0 };
+
+    {
+        GGL_MTX_SCOPE_GUARD(&sub_index_mtx);
+        ggl_topic_index_match(&sub_index, topic, add_matched_handle, &matched);
+    }
+
+    // Responding may close subscriptions, so index lock must not be held
+    for (size_t i = 0; i < matched.len; i++) {
+        ggl_sub_respond(matched.handles[i], GGL_OBJ_MAP(params));
     }
 
     ggl_respond(handle, GGL_OBJ_NULL());
     return GGL_ERR_OK;
 }
 
-static GglError register_subscription(
-    GglBuffer topic_filter, uint32_t handle, uint32_t **handle_ptr
-) {
-    for (size_t i = 0; i < GGL_PUBSUB_MAX_SUBSCRIPTIONS; i++) {
-        if (sub_handle[i] == 0) {
-            sub_handle[i] = handle;
-            memcpy(sub_topic_filter[i], topic_filter.data, topic_filter.len);
-            sub_topic_length[i] = (uint8_t) (topic_filter.len - 1);
-            *handle_ptr = &sub_handle[i];
-            return GGL_ERR_OK;
-        }
-    }
-    GGL_LOGE("Configured maximum subscriptions exceeded.");
-    return GGL_ERR_NOMEM;
-}
-
 static void release_subscription(void *ctx, uint32_t handle) {
-    (void) handle;
-    uint32_t *handle_ptr = ctx;
-    size_t index = (size_t) (handle_ptr - sub_handle);
-    assert(sub_handle[index] == handle);
-    sub_handle[index] = 0;
+    uint16_t sub_id = (uint16_t) (uintptr_t) ctx;
+    GGL_MTX_SCOPE_GUARD(&sub_index_mtx);
+    assert(ggl_topic_index_value(&sub_index, sub_id) == handle);
+    ggl_topic_index_remove(&sub_index, sub_id, NULL);
 }
 
 static GglError rpc_subscribe(void *ctx, GglMap params, uint32_t handle) {
@@ -164,12 +165,20 @@ static GglError rpc_subscribe(void *ctx, GglMap params, uint32_t handle) {
         return GGL_ERR_INVALID;
     }
 
-    uint32_t *handle_ptr;
-    GglError ret = register_subscription(topic_filter, handle, &handle_ptr);
+    uint16_t sub_id = 0;
+    GglError ret;
+    {
+        GGL_MTX_SCOPE_GUARD(&sub_index_mtx);
+        ret = ggl_topic_index_add(
+            &sub_index, topic_filter, handle, &sub_id, NULL
+        );
+    }
     if (ret != GGL_ERR_OK) {
         return ret;
     }
 
-    ggl_sub_accept(handle, release_subscription, handle_ptr);
+    ggl_sub_accept(handle, release_subscription, (void *) (uintptr_t) sub_id);
+    // A slow subscriber misses old messages rather than being disconnected
+    ggl_sub_set_queue_policy(handle, GGL_SUB_QUEUE_DROP_OLDEST);
     return GGL_ERR_OK;
 }
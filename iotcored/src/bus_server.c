@@ -22,9 +22,9 @@ static GglError rpc_get_status(void *ctx, GglMap params, uint32_t handle);
 
 void iotcored_start_server(IotcoredArgs *args) {
     GglRpcMethodDesc handlers[] = {
-        { GGL_STR("publish"), false, rpc_publish, NULL },
-        { GGL_STR("subscribe"), true, rpc_subscribe, NULL },
-        { GGL_STR("connection_status"), true, rpc_get_status, NULL },
+        { GGL_STR("publish"), false, rpc_publish, NULL, false },
+        { GGL_STR("subscribe"), true, rpc_subscribe, NULL, false },
+        { GGL_STR("connection_status"), true, rpc_get_status, NULL, false },
     };
     size_t handlers_len = sizeof(handlers) / sizeof(handlers[0]);
 
@@ -167,6 +167,8 @@ static GglError rpc_subscribe(void *ctx, GglMap params, uint32_t handle) {
     }
 
     ggl_sub_accept(handle, sub_close_callback, NULL);
+    // A slow subscriber misses old messages rather than being disconnected
+    ggl_sub_set_queue_policy(handle, GGL_SUB_QUEUE_DROP_OLDEST);
     return GGL_ERR_OK;
 }
 
@@ -185,6 +187,8 @@ static GglError rpc_get_status(void *ctx, GglMap params, uint32_t handle) {
     }
 
     ggl_sub_accept(handle, mqtt_status_sub_close_callback, NULL);
+    // Only the latest status matters to a slow subscriber
+    ggl_sub_set_queue_policy(handle, GGL_SUB_QUEUE_DROP_OLDEST);
 
     // Send a status update as soon as a subscription is accepted.
     iotcored_mqtt_status_update_send(
@@ -598,18 +598,6 @@ GglError iotcored_mqtt_unsubscribe(GglBuffer *topic_filters, size_t count) {
     return 0;
 }
 
-bool iotcored_mqtt_topic_filter_match(GglBuffer topic_filter, GglBuffer topic) {
-    bool matches = false;
-    MQTTStatus_t result = MQTT_MatchTopic(
-        (char *) topic.data,
-        (uint16_t) topic.len,
-        (char *) topic_filter.data,
-        (uint16_t) topic_filter.len,
-        &matches
-    );
-    return (result == MQTTSuccess) && matches;
-}
-
 static void event_callback(
     MQTTContext_t *ctx,
     MQTTPacketInfo_t *packet_info,
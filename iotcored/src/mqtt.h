@@ -30,8 +30,6 @@ GglError iotcored_mqtt_subscribe(
 );
 GglError iotcored_mqtt_unsubscribe(GglBuffer *topic_filters, size_t count);
 
-bool iotcored_mqtt_topic_filter_match(GglBuffer topic_filter, GglBuffer topic);
-
 void iotcored_mqtt_receive(const IotcoredMsg *msg);
 
 #endif
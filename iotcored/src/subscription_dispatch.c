@@ -1,17 +1,17 @@
-// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
-// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
-// SPDX-License-Identifier: Apache-2.0
-
 #include "subscription_dispatch.h"
 #include "mqtt.h"
 #include <sys/types.h>
+#include <assert.h>
 #include <ggl/buffer.h>
 #include <ggl/cleanup.h>
 #include <ggl/core_bus/server.h>
 #include <ggl/error.h>
 #include <ggl/log.h>
 #include <ggl/object.h>
+#include <ggl/topic_index.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -22,26 +22,111 @@
 /// https://docs.aws.amazon.com/general/latest/gr/iot-core.html#limits_iot
 #define AWS_IOT_MAX_TOPIC_SIZE 256
 
+static_assert(
+    AWS_IOT_MAX_TOPIC_SIZE <= GGL_TOPIC_FILTER_MAX_LEN,
+    "AWS_IOT_MAX_TOPIC_SIZE does not fit in topic index."
+);
+
 /// Maximum number of MQTT subscriptions supported.
 /// Can be configured with `-DIOTCORED_MAX_SUBSCRIPTIONS=<N>`.
 #ifndef IOTCORED_MAX_SUBSCRIPTIONS
 #define IOTCORED_MAX_SUBSCRIPTIONS 128
 #endif
 
-static size_t topic_filter_len[IOTCORED_MAX_SUBSCRIPTIONS] = { 0 };
-static uint8_t sub_topic_filters[IOTCORED_MAX_SUBSCRIPTIONS]
-                                [AWS_IOT_MAX_TOPIC_SIZE];
-static uint32_t handles[IOTCORED_MAX_SUBSCRIPTIONS];
-static uint8_t topic_qos[IOTCORED_MAX_SUBSCRIPTIONS];
+/// Maximum total levels across distinct wildcard topic filters.
+/// Can be configured with `-DIOTCORED_MAX_TOPIC_LEVELS=<N>`.
+#ifndef IOTCORED_MAX_TOPIC_LEVELS
+#define IOTCORED_MAX_TOPIC_LEVELS (8 * IOTCORED_MAX_SUBSCRIPTIONS)
+#endif
+
+/// A version of the subscription table.
+/// Subscription values are core bus handles.
+typedef struct {
+    GglTopicFilter filters[IOTCORED_MAX_SUBSCRIPTIONS];
+    GglTopicNode nodes[IOTCORED_MAX_TOPIC_LEVELS + 1];
+    GglTopicSub subs[IOTCORED_MAX_SUBSCRIPTIONS];
+    uint16_t buckets[IOTCORED_MAX_SUBSCRIPTIONS];
+    uint16_t node_buckets[IOTCORED_MAX_SUBSCRIPTIONS];
+    /// QoS of each subscription, indexed by sub id - 1.
+    uint8_t qos[IOTCORED_MAX_SUBSCRIPTIONS];
+    GglTopicIndex index;
+    /// Number of receive path readers using this version.
+    atomic_size_t readers;
+} SubTable;
+
+// The receive path reads the active table without locking. Writers update the
+// inactive table and then swap it in, so readers never wait on subscription
+// changes (which may include network I/O).
+static SubTable sub_tables[2];
+static _Atomic(SubTable *) active_table = &sub_tables[0];
+/// Serializes subscription table updates and the resulting MQTT subscribe
+/// and unsubscribe requests.
 static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
 
 static uint32_t mqtt_status_handles[IOTCORED_MAX_SUBSCRIPTIONS];
 static pthread_mutex_t mqtt_status_mtx = PTHREAD_MUTEX_INITIALIZER;
 
-static GglBuffer topic_filter_buf(size_t index) {
-    return ggl_buffer_substr(
-        GGL_BUF(sub_topic_filters[index]), 0, topic_filter_len[index]
-    );
+__attribute__((constructor)) static void init_sub_tables(void) {
+    for (size_t i = 0; i < 2; i++) {
+        SubTable *table = &sub_tables[i];
+        table->index = (GglTopicIndex) {
+            .filters = table->filters,
+            .max_filters = IOTCORED_MAX_SUBSCRIPTIONS,
+            .nodes = table->nodes,
+            .max_nodes = IOTCORED_MAX_TOPIC_LEVELS + 1,
+            .subs = table->subs,
+            .max_subs = IOTCORED_MAX_SUBSCRIPTIONS,
+            .buckets = table->buckets,
+            .bucket_count = IOTCORED_MAX_SUBSCRIPTIONS,
+            .node_buckets = table->node_buckets,
+            .node_bucket_count = IOTCORED_MAX_SUBSCRIPTIONS,
+        };
+        ggl_topic_index_init(&table->index);
+    }
+}
+
+static SubTable *acquire_active_table(void) {
+    while (true) {
+        SubTable *table = atomic_load(&active_table);
+        atomic_fetch_add(&table->readers, 1);
+        // If swapped out before we registered as a reader, a writer may be
+        // modifying it
+        if (atomic_load(&active_table) == table) {
+            return table;
+        }
+        atomic_fetch_sub(&table->readers, 1);
+    }
+}
+
+static void release_table(SubTable *table) {
+    atomic_fetch_sub(&table->readers, 1);
+}
+
+/// Get a copy of the active table for modifying.
+/// Must hold mtx.
+static SubTable *begin_table_update(void) {
+    SubTable *current = atomic_load(&active_table);
+    SubTable *next
+        = (current == &sub_tables[0]) ? &sub_tables[1] : &sub_tables[0];
+
+    // Readers that acquired this table before the last swap finish quickly
+    while (atomic_load(&next->readers) != 0) {
+        sched_yield();
+    }
+
+    ggl_topic_index_copy(&next->index, &current->index);
+    memcpy(next->qos, current->qos, sizeof(next->qos));
+    return next;
+}
+
+/// Make an updated table visible to readers.
+/// Must hold mtx.
+static void commit_table_update(SubTable *table) {
+    atomic_store(&active_table, table);
+}
+
+static bool sub_in_use(const SubTable *table, uint16_t sub_id) {
+    return table->subs[sub_id - 1].filter != 0;
 }
 
 GglError iotcored_register_subscriptions(
@@ -64,89 +149,97 @@ GglError iotcored_register_subscriptions(
 
     GGL_MTX_SCOPE_GUARD(&mtx);
 
-    size_t filter_index = 0;
-    for (size_t i = 0; i < IOTCORED_MAX_SUBSCRIPTIONS; i++) {
-        if (topic_filter_len[i] == 0) {
-            topic_filter_len[i] = topic_filters[filter_index].len;
-            memcpy(
-                sub_topic_filters[i],
-                topic_filters[filter_index].data,
-                topic_filters[filter_index].len
-            );
-            handles[i] = handle;
-            topic_qos[i] = qos;
-            filter_index += 1;
-            if (filter_index == count) {
-                return GGL_ERR_OK;
-            }
-        }
-    }
-    GGL_LOGE("Configured maximum subscriptions exceeded.");
+    SubTable *table = begin_table_update();
 
-    for (size_t i = 0; i < IOTCORED_MAX_SUBSCRIPTIONS; i++) {
-        if (handles[i] == handle) {
-            topic_filter_len[i] = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint16_t sub_id = 0;
+        // On failure, the partially updated table is discarded
+        GglError ret = ggl_topic_index_add(
+            &table->index, topic_filters[i], handle, &sub_id, NULL
+        );
+        if (ret != GGL_ERR_OK) {
+            return ret;
         }
+        table->qos[sub_id - 1] = qos;
     }
 
-    return GGL_ERR_NOMEM;
+    commit_table_update(table);
+    return GGL_ERR_OK;
 }
 
-// NOLINTNEXTLINE(readability-function-cognitive-complexity)
 void iotcored_unregister_subscriptions(uint32_t handle, bool unsubscribe) {
     GGL_MTX_SCOPE_GUARD(&mtx);
 
-    for (size_t i = 0; i < IOTCORED_MAX_SUBSCRIPTIONS; i++) {
-        if (handles[i] == handle) {
-            if (unsubscribe) {
-                size_t j;
-                for (j = 0; j < IOTCORED_MAX_SUBSCRIPTIONS; j++) {
-                    if (i == j) {
-                        continue;
-                    }
-                    if ((topic_filter_len[j] != 0)
-                        && (topic_filter_len[i] == topic_filter_len[j])
-                        && (memcmp(
-                                sub_topic_filters[i],
-                                sub_topic_filters[j],
-                                topic_filter_len[i]
-                            )
-                            == 0)) {
-                        // Found a matching topic filter. No need to check
-                        // further.
-                        break;
-                    }
-                }
-
-                // This is the only subscription to this topic. Send an
-                // unsubscribe.
-                if (j == IOTCORED_MAX_SUBSCRIPTIONS) {
-                    GglBuffer buf[] = { topic_filter_buf(i) };
-                    iotcored_mqtt_unsubscribe(buf, 1U);
-                }
-            }
+    SubTable *table = begin_table_update();
 
-            topic_filter_len[i] = 0;
+    // Filters with no remaining subscriptions
+    static uint8_t unused_filter_mem[IOTCORED_MAX_SUBSCRIPTIONS]
+                                    [AWS_IOT_MAX_TOPIC_SIZE];
+    static GglBuffer unused_filters[IOTCORED_MAX_SUBSCRIPTIONS];
+    size_t unused_count = 0;
+
+    for (uint16_t sub_id = 1; sub_id <= IOTCORED_MAX_SUBSCRIPTIONS; sub_id++) {
+        if (!sub_in_use(table, sub_id)
+            || (ggl_topic_index_value(&table->index, sub_id) != handle)) {
+            continue;
+        }
+
+        GglBuffer filter = ggl_topic_index_filter(&table->index, sub_id);
+        memcpy(unused_filter_mem[unused_count], filter.data, filter.len);
+
+        bool last = false;
+        ggl_topic_index_remove(&table->index, sub_id, &last);
+
+        if (last) {
+            unused_filters[unused_count] = (GglBuffer) {
+                .data = unused_filter_mem[unused_count], .len = filter.len
+            };
+            unused_count += 1;
         }
     }
+
+    commit_table_update(table);
+
+    // Still holding mtx so a new subscription to the same filter is not sent
+    // before this unsubscribe.
+    if (unsubscribe) {
+        for (size_t i = 0; i < unused_count; i++) {
+            iotcored_mqtt_unsubscribe(&unused_filters[i], 1U);
+        }
+    }
+}
+
+typedef struct {
+    uint32_t handles[IOTCORED_MAX_SUBSCRIPTIONS];
+    size_t len;
+} MatchedHandles;
+
+static void add_matched_handle(void *ctx, uint16_t sub_id, uint32_t value) {
+    (void) sub_id;
+    MatchedHandles *matched = ctx;
+    assert(matched->len < IOTCORED_MAX_SUBSCRIPTIONS);
+    matched->handles[matched->len] = value;
+    matched->len += 1;
 }
 
 void iotcored_mqtt_receive(const IotcoredMsg *msg) {
-    GGL_MTX_SCOPE_GUARD(&mtx);
+    MatchedHandles matched = { .len = 0 };
 
-    for (size_t i = 0; i < IOTCORED_MAX_SUBSCRIPTIONS; i++) {
-        if ((topic_filter_len[i] != 0)
-            && iotcored_mqtt_topic_filter_match(
-                topic_filter_buf(i), msg->topic
-            )) {
-            ggl_sub_respond(
-                handles[i],
-                GGL_OBJ_MAP(GGL_MAP(
-                    { GGL_STR("topic"), GGL_OBJ_BUF(msg->topic) },
-                    { GGL_STR("payload"), GGL_OBJ_BUF(msg->payload) }
-                ))
-            );
-        }
+    SubTable *table = acquire_active_table();
+    ggl_topic_index_match(
+        &table->index, msg->topic, add_matched_handle, &matched
+    );
+    release_table(table);
+
+    // Table is released first so it can be updated if a response fails
+    for (size_t i = 0; i < matched.len; i++) {
+        ggl_sub_respond(
+            matched.handles[i],
+            GGL_OBJ_MAP(GGL_MAP(
+                { GGL_STR("topic"), GGL_OBJ_BUF(msg->topic) },
+                { GGL_STR("payload"), GGL_OBJ_BUF(msg->payload) }
+            ))
+        );
     }
 }
 
@@ -181,23 +274,56 @@ void iotcored_mqtt_status_update_send(GglObject status) {
     }
 }
 
+typedef struct {
+    GglBuffer filters[IOTCORED_MAX_SUBSCRIPTIONS];
+    uint16_t first_subs[IOTCORED_MAX_SUBSCRIPTIONS];
+    size_t len;
+} DistinctFilters;
+
+static void add_distinct_filter(
+    void *ctx, GglBuffer filter, uint16_t first_sub
+) {
+    DistinctFilters *distinct = ctx;
+    assert(distinct->len < IOTCORED_MAX_SUBSCRIPTIONS);
+    distinct->filters[distinct->len] = filter;
+    distinct->first_subs[distinct->len] = first_sub;
+    distinct->len += 1;
+}
+
 void iotcored_re_register_all_subs(void) {
     GGL_MTX_SCOPE_GUARD(&mtx);
 
-    for (size_t i = 0; i < IOTCORED_MAX_SUBSCRIPTIONS; i++) {
-        if (topic_filter_len[i] != 0) {
-            GglBuffer buffer
-                = { .data = sub_topic_filters[i], .len = topic_filter_len[i] };
-            GGL_LOGD(
-                "Subscribing again to:  %.*s",
-                (int) topic_filter_len[i],
-                sub_topic_filters[i]
-            );
-            if (iotcored_mqtt_subscribe(&buffer, 1, topic_qos[i])
-                != GGL_ERR_OK) {
-                topic_filter_len[i] = 0;
-                GGL_LOGE("Failed to subscribe to topic filter.");
+    SubTable *table = begin_table_update();
+
+    // Subscriptions sharing a filter share one MQTT subscription
+    static DistinctFilters distinct;
+    distinct.len = 0;
+    ggl_topic_index_for_each_filter(
+        &table->index, add_distinct_filter, &distinct
+    );
+
+    for (size_t i = 0; i < distinct.len; i++) {
+        GglBuffer filter = distinct.filters[i];
+
+        uint8_t qos = 0;
+        for (uint16_t sub_id = distinct.first_subs[i]; sub_id != 0;
+             sub_id = ggl_topic_index_next_sub(&table->index, sub_id)) {
+            if (table->qos[sub_id - 1] > qos) {
+                qos = table->qos[sub_id - 1];
+            }
+        }
+
+        GGL_LOGD("Subscribing again to:  %.*s", (int) filter.len, filter.data);
+        if (iotcored_mqtt_subscribe(&filter, 1, qos) != GGL_ERR_OK) {
+            GGL_LOGE("Failed to subscribe to topic filter.");
+            uint16_t sub_id = distinct.first_subs[i];
+            while (sub_id != 0) {
+                uint16_t next = ggl_topic_index_next_sub(&table->index, sub_id);
+                ggl_topic_index_remove(&table->index, sub_id, NULL);
+                sub_id = next;
             }
         }
     }
+
+    commit_table_update(table);
 }
@@ -0,0 +1,14 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef IPC_AUTHZ_TEST_H
+#define IPC_AUTHZ_TEST_H
+
+#include <ggl/error.h>
+
+/// Compare ggipcd's cached accessControl checks with checking policies as
+/// read from configuration. Requires ggconfigd to be running.
+GglError run_ipc_authz_test(void);
+
+#endif
@@ -0,0 +1,405 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ipc-authz-test.h"
+#include "ipc_authz.h"
+#include "ipc_service.h"
+#include <ggl/buffer.h>
+#include <ggl/bump_alloc.h>
+#include <ggl/core_bus/gg_config.h>
+#include <ggl/error.h>
+#include <ggl/list.h>
+#include <ggl/log.h>
+#include <ggl/map.h>
+#include <ggl/object.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// More resources than fit in a policy cache entry
+#define LARGE_POLICY_RESOURCES (GGL_IPC_POLICY_MAX_RESOURCES + 8)
+
+#define PUBLISH "aws.greengrass#PublishToTopic"
+#define SUBSCRIBE "aws.greengrass#SubscribeToTopic"
+
+static const GglBuffer SERVICE = GGL_STR("aws.greengrass.ipc.pubsub");
+
+// Reference matcher, resolving wildcards and escapes on each check
+static bool reference_matcher(
+    GglBuffer request_resource, GglBuffer policy_resource
+) {
+    static uint8_t pattern_mem[GGL_IPC_POLICY_MAX_BYTES];
+    if (policy_resource.len > sizeof(pattern_mem)) {
+        return false;
+    }
+    GglBuffer pattern = { .data = pattern_mem, .len = 0 };
+
+    bool in_escape = false;
+    for (size_t i = 0; i < policy_resource.len; i++) {
+        uint8_t c = policy_resource.data[i];
+        if (in_escape) {
+            if (c == (uint8_t) '}') {
+                in_escape = false;
+                continue;
+            }
+        } else {
+            if (c == (uint8_t) '*') {
+                pattern.data[pattern.len] = (uint8_t) '\0';
+                pattern.len += 1;
+                continue;
+            }
+            if ((c == (uint8_t) '$') && (i < policy_resource.len - 1)
+                && (policy_resource.data[i + 1] == (uint8_t) '{')) {
+                in_escape = true;
+                i += 1;
+                continue;
+            }
+        }
+
+        pattern.data[pattern.len] = c;
+        pattern.len += 1;
+    }
+
+    GglBuffer remaining = request_resource;
+    size_t start = 0;
+    for (size_t i = 0; i < pattern.len; i++) {
+        if (pattern.data[i] == (uint8_t) '\0') {
+            GglBuffer segment = ggl_buffer_substr(pattern, start, i);
+            bool match;
+            size_t match_start = 0;
+            if (start == 0) {
+                match = ggl_buffer_has_prefix(remaining, segment);
+            } else {
+                match = ggl_buffer_contains(remaining, segment, &match_start);
+            }
+            if (!match) {
+                return false;
+            }
+            remaining = ggl_buffer_substr(
+                remaining, match_start + segment.len, SIZE_MAX
+            );
+            start = i + 1;
+        }
+    }
+
+    if (start == 0) {
+        return ggl_buffer_eq(remaining, pattern);
+    }
+    GglBuffer segment = ggl_buffer_substr(pattern, start, SIZE_MAX);
+    return ggl_buffer_has_suffix(remaining, segment);
+}
+
+static GglError reference_policy_match(
+    GglMap policy, GglBuffer operation, GglBuffer resource
+) {
+    GglObject *operations_obj;
+    GglObject *resources_obj;
+    GglError ret = ggl_map_validate(
+        policy,
+        GGL_MAP_SCHEMA(
+            { GGL_STR("operations"), true, GGL_TYPE_LIST, &operations_obj },
+            { GGL_STR("resources"), true, GGL_TYPE_LIST, &resources_obj },
+        )
+    );
+    if ((ret != GGL_ERR_OK)
+        || (ggl_list_type_check(operations_obj->list, GGL_TYPE_BUF)
+            != GGL_ERR_OK)
+        || (ggl_list_type_check(resources_obj->list, GGL_TYPE_BUF)
+            != GGL_ERR_OK)) {
+        return GGL_ERR_CONFIG;
+    }
+
+    GGL_LIST_FOREACH(policy_operation, operations_obj->list) {
+        if (ggl_buffer_eq(operation, policy_operation->buf)) {
+            GGL_LIST_FOREACH(policy_resource, resources_obj->list) {
+                if (ggl_buffer_eq(GGL_STR("*"), policy_resource->buf)
+                    || reference_matcher(resource, policy_resource->buf)) {
+                    return GGL_ERR_OK;
+                }
+            }
+            return GGL_ERR_FAILURE;
+        }
+    }
+
+    return GGL_ERR_NOENTRY;
+}
+
+// Reference check, reading and walking the policies on each request
+static GglError reference_auth(
+    const GglIpcOperationInfo *info, GglBuffer resource
+) {
+    static uint8_t policy_mem[4096];
+    GglBumpAlloc balloc = ggl_bump_alloc_init(GGL_BUF(policy_mem));
+
+    GglObject policies;
+    GglError ret = ggl_gg_config_read(
+        GGL_BUF_LIST(
+            GGL_STR("services"),
+            info->component,
+            GGL_STR("configuration"),
+            GGL_STR("accessControl"),
+            info->service
+        ),
+        &balloc.alloc,
+        &policies
+    );
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+    if (policies.type != GGL_TYPE_MAP) {
+        return GGL_ERR_CONFIG;
+    }
+
+    GGL_MAP_FOREACH(policy_kv, policies.map) {
+        if (policy_kv->val.type != GGL_TYPE_MAP) {
+            return GGL_ERR_CONFIG;
+        }
+        ret = reference_policy_match(
+            policy_kv->val.map, info->operation, resource
+        );
+        if (ret == GGL_ERR_OK) {
+            return GGL_ERR_OK;
+        }
+    }
+
+    return GGL_ERR_NOENTRY;
+}
+
+static GglError write_policies(GglBuffer component, GglObject policies) {
+    GglError ret = ggl_gg_config_write(
+        GGL_BUF_LIST(
+            GGL_STR("services"),
+            component,
+            GGL_STR("configuration"),
+            GGL_STR("accessControl"),
+            SERVICE
+        ),
+        policies,
+        NULL
+    );
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGE(
+            "Failed to write policies for %.*s.",
+            (int) component.len,
+            component.data
+        );
+    }
+    return ret;
+}
+
+static GglError write_test_policies(void) {
+    GglError ret = write_policies(
+        GGL_STR("ipc-authz-test-a"),
+        GGL_OBJ_MAP(GGL_MAP(
+            { GGL_STR("p1"),
+              GGL_OBJ_MAP(GGL_MAP(
+                  { GGL_STR("operations"),
+                    GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(GGL_STR(PUBLISH)))) },
+                  { GGL_STR("resources"),
+                    GGL_OBJ_LIST(GGL_LIST(
+                        GGL_OBJ_BUF(GGL_STR("a/*/c")),
+                        GGL_OBJ_BUF(GGL_STR("lit${*}x")),
+                        GGL_OBJ_BUF(GGL_STR("*suffix")),
+                        GGL_OBJ_BUF(GGL_STR("pre*")),
+                        GGL_OBJ_BUF(GGL_STR("x*y*z"))
+                    )) }
+              )) },
+            { GGL_STR("p2"),
+              GGL_OBJ_MAP(GGL_MAP(
+                  { GGL_STR("operations"),
+                    GGL_OBJ_LIST(GGL_LIST(
+                        GGL_OBJ_BUF(GGL_STR(SUBSCRIBE)),
+                        GGL_OBJ_BUF(GGL_STR(PUBLISH))
+                    )) },
+                  { GGL_STR("resources"),
+                    GGL_OBJ_LIST(GGL_LIST(
+                        GGL_OBJ_BUF(GGL_STR("exact")),
+                        GGL_OBJ_BUF(GGL_STR("${$}{"))
+                    )) }
+              )) },
+            { GGL_STR("bad"),
+              GGL_OBJ_MAP(GGL_MAP(
+                  { GGL_STR("operations"), GGL_OBJ_BUF(GGL_STR("notalist")) },
+                  { GGL_STR("resources"),
+                    GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(GGL_STR("*")))) }
+              )) },
+            { GGL_STR("p3"),
+              GGL_OBJ_MAP(GGL_MAP(
+                  { GGL_STR("operations"),
+                    GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(GGL_STR(SUBSCRIBE)))) },
+                  { GGL_STR("resources"),
+                    GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(GGL_STR("*")))) }
+              )) }
+        ))
+    );
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    // Policies after one that is not a map are not used
+    ret = write_policies(
+        GGL_STR("ipc-authz-test-b"),
+        GGL_OBJ_MAP(GGL_MAP(
+            { GGL_STR("p1"),
+              GGL_OBJ_MAP(GGL_MAP(
+                  { GGL_STR("operations"),
+                    GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(GGL_STR(PUBLISH)))) },
+                  { GGL_STR("resources"),
+                    GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(GGL_STR("b/#")))) }
+              )) },
+            { GGL_STR("notmap"), GGL_OBJ_I64(5) },
+            { GGL_STR("p2"),
+              GGL_OBJ_MAP(GGL_MAP(
+                  { GGL_STR("operations"),
+                    GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(GGL_STR(PUBLISH)))) },
+                  { GGL_STR("resources"),
+                    GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(GGL_STR("later")))) }
+              )) }
+        ))
+    );
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    // Component with configuration but no accessControl
+    ret = ggl_gg_config_write(
+        GGL_BUF_LIST(
+            GGL_STR("services"),
+            GGL_STR("ipc-authz-test-c"),
+            GGL_STR("configuration"),
+            GGL_STR("other")
+        ),
+        GGL_OBJ_I64(1),
+        NULL
+    );
+    if (ret != GGL_ERR_OK) {
+        GGL_LOGE("Failed to write configuration for ipc-authz-test-c.");
+        return ret;
+    }
+
+    // Policies too large to cache
+    static char large_mem[LARGE_POLICY_RESOURCES][16];
+    static GglObject large_resources[LARGE_POLICY_RESOURCES];
+    for (size_t i = 0; i < LARGE_POLICY_RESOURCES; i++) {
+        int len = snprintf(large_mem[i], sizeof(large_mem[i]), "big/%zu", i);
+        large_resources[i] = GGL_OBJ_BUF((GglBuffer) {
+            .data = (uint8_t *) large_mem[i], .len = (size_t) len });
+    }
+    large_resources[LARGE_POLICY_RESOURCES - 1]
+        = GGL_OBJ_BUF(GGL_STR("tail*"));
+    return write_policies(
+        GGL_STR("ipc-authz-test-e"),
+        GGL_OBJ_MAP(GGL_MAP(
+            { GGL_STR("p1"),
+              GGL_OBJ_MAP(GGL_MAP(
+                  { GGL_STR("operations"),
+                    GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(GGL_STR(PUBLISH)))) },
+                  { GGL_STR("resources"),
+                    GGL_OBJ_LIST((GglList) {
+                        .items = large_resources,
+                        .len = LARGE_POLICY_RESOURCES }) }
+              )) },
+            { GGL_STR("p2"),
+              GGL_OBJ_MAP(GGL_MAP(
+                  { GGL_STR("operations"),
+                    GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(GGL_STR(SUBSCRIBE)))) },
+                  { GGL_STR("resources"),
+                    GGL_OBJ_LIST(GGL_LIST(GGL_OBJ_BUF(GGL_STR("big/*")))) }
+              )) }
+        ))
+    );
+}
+
+GglError run_ipc_authz_test(void) {
+    GglError ret = write_test_policies();
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    // ipc-authz-test-d has no configuration
+    GglBuffer components[] = {
+        GGL_STR("ipc-authz-test-a"),
+        GGL_STR("ipc-authz-test-b"),
+        GGL_STR("ipc-authz-test-c"),
+        GGL_STR("ipc-authz-test-d"),
+        GGL_STR("ipc-authz-test-e"),
+    };
+    GglBuffer operations[] = {
+        GGL_STR(PUBLISH),
+        GGL_STR(SUBSCRIBE),
+        GGL_STR("aws.greengrass#Other"),
+    };
+    GglBuffer resources[] = {
+        GGL_STR("a/b/c"),
+        GGL_STR("a//c"),
+        GGL_STR("a/b/cd"),
+        GGL_STR("lit*x"),
+        GGL_STR("litx"),
+        GGL_STR("lit${*}x"),
+        GGL_STR("foosuffix"),
+        GGL_STR("suffix"),
+        GGL_STR("prefix"),
+        GGL_STR("pre"),
+        GGL_STR("xyz"),
+        GGL_STR("x1y2z"),
+        GGL_STR("xzy"),
+        GGL_STR("exact"),
+        GGL_STR("exac"),
+        GGL_STR("${{"),
+        GGL_STR("${"),
+        GGL_STR("anything"),
+        GGL_STR(""),
+        GGL_STR("b/#"),
+        GGL_STR("b/c"),
+        GGL_STR("later"),
+        GGL_STR("big/0"),
+        GGL_STR("big/38"),
+        GGL_STR("tail/x"),
+    };
+
+    size_t checked = 0;
+    size_t mismatches = 0;
+    // First pass compiles policies, second uses the cache
+    for (size_t pass = 0; pass < 2; pass++) {
+        for (size_t c = 0; c < sizeof(components) / sizeof(components[0]);
+             c++) {
+            for (size_t o = 0; o < sizeof(operations) / sizeof(operations[0]);
+                 o++) {
+                GglIpcOperationInfo info = { .component = components[c],
+                                             .service = SERVICE,
+                                             .operation = operations[o] };
+                for (size_t r = 0; r < sizeof(resources) / sizeof(resources[0]);
+                     r++) {
+                    GglError result = ggl_ipc_auth(
+                        &info, resources[r], ggl_ipc_default_policy_matcher
+                    );
+                    GglError expected = reference_auth(&info, resources[r]);
+                    checked += 1;
+                    if (result != expected) {
+                        mismatches += 1;
+                        GGL_LOGE(
+                            "%.*s %.*s on \"%.*s\": got %u, expected %u.",
+                            (int) components[c].len,
+                            components[c].data,
+                            (int) operations[o].len,
+                            operations[o].data,
+                            (int) resources[r].len,
+                            resources[r].data,
+                            (unsigned) result,
+                            (unsigned) expected
+                        );
+                    }
+                }
+            }
+        }
+    }
+
+    GGL_LOGI("Checked %zu requests, %zu mismatched.", checked, mismatches);
+    if (mismatches > 0) {
+        return GGL_ERR_FAILURE;
+    }
+    return GGL_ERR_OK;
+}
@@ -17,7 +17,7 @@ static GglError handle_echo(void *ctx, GglMap params, uint32_t handle) {
 
 int main(void) {
     GglRpcMethodDesc handlers[] = {
-        { GGL_STR("echo"), false, handle_echo, NULL },
+        { GGL_STR("echo"), false, handle_echo, NULL, false },
     };
     size_t handlers_len = sizeof(handlers) / sizeof(handlers[0]);
 
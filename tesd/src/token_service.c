@@ -168,11 +168,16 @@ static GglError rpc_request_formatted_creds(
 static void start_tes_core_bus_server(void) {
     // Server handler
     GglRpcMethodDesc handlers[] = {
-        { GGL_STR("request_credentials"), false, rpc_request_creds, NULL },
+        { GGL_STR("request_credentials"),
+          false,
+          rpc_request_creds,
+          NULL,
+          false },
         { GGL_STR("request_credentials_formatted"),
           false,
           rpc_request_formatted_creds,
-          NULL },
+          NULL,
+          false },
     };
     size_t handlers_len = sizeof(handlers) / sizeof(handlers[0]);
 
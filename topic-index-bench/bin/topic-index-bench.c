@@ -0,0 +1,13 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "topic-index-bench.h"
+#include <ggl/error.h>
+
+int main(void) {
+    GglError ret = run_topic_index_bench();
+    if (ret != GGL_ERR_OK) {
+        return 1;
+    }
+}
@@ -0,0 +1,12 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef TOPIC_INDEX_BENCH_H
+#define TOPIC_INDEX_BENCH_H
+
+#include <ggl/error.h>
+
+GglError run_topic_index_bench(void);
+
+#endif
@@ -0,0 +1,155 @@
+// aws-greengrass-lite - AWS IoT Greengrass runtime for constrained devices
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "topic-index-bench.h"
+#include <ggl/buffer.h>
+#include <ggl/error.h>
+#include <ggl/log.h>
+#include <ggl/topic_index.h>
+#include <stdio.h>
+#include <time.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Compares publish matching using the topic index against checking every
+// subscription's filter, at several subscription counts.
+
+#define BENCH_MAX_SUBS 10000
+
+/// Every nth subscription uses a wildcard filter.
+#define WILDCARD_INTERVAL 10
+
+/// Filter checks done per run of the linear scan, to bound its run time.
+#define LINEAR_SCAN_CHECKS 20000000
+
+static GglTopicFilter filters[BENCH_MAX_SUBS];
+static GglTopicNode nodes[(4 * BENCH_MAX_SUBS) + 1];
+static GglTopicSub subs[BENCH_MAX_SUBS];
+static uint16_t buckets[BENCH_MAX_SUBS];
+static uint16_t node_buckets[BENCH_MAX_SUBS];
+static uint16_t sub_ids[BENCH_MAX_SUBS];
+
+static GglTopicIndex bench_index = {
+    .filters = filters,
+    .max_filters = BENCH_MAX_SUBS,
+    .nodes = nodes,
+    .max_nodes = (4 * BENCH_MAX_SUBS) + 1,
+    .subs = subs,
+    .max_subs = BENCH_MAX_SUBS,
+    .buckets = buckets,
+    .node_buckets = node_buckets,
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000U) + (uint64_t) ts.tv_nsec;
+}
+
+static uint32_t next_rand(uint32_t *state) {
+    *state = (*state * 1103515245U) + 12345U;
+    return *state >> 8;
+}
+
+static GglBuffer device_topic(uint8_t *mem, size_t mem_len, uint32_t device) {
+    int len = snprintf((char *) mem, mem_len, "devices/%u/telemetry", device);
+    return (GglBuffer) { .data = mem, .len = (size_t) len };
+}
+
+static void count_match(void *ctx, uint16_t sub_id, uint32_t value) {
+    (void) sub_id;
+    (void) value;
+    size_t *count = ctx;
+    *count += 1;
+}
+
+static GglError populate(uint16_t sub_count) {
+    bench_index.bucket_count = sub_count;
+    bench_index.node_bucket_count = sub_count;
+    ggl_topic_index_init(&bench_index);
+
+    for (uint16_t i = 0; i < sub_count; i++) {
+        uint8_t mem[64];
+        int len = (i % WILDCARD_INTERVAL == 0)
+            ? snprintf((char *) mem, sizeof(mem), "devices/%u/+", i)
+            : snprintf((char *) mem, sizeof(mem), "devices/%u/telemetry", i);
+        GglBuffer filter = { .data = mem, .len = (size_t) len };
+
+        GglError ret
+            = ggl_topic_index_add(&bench_index, filter, i, &sub_ids[i], NULL);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+    return GGL_ERR_OK;
+}
+
+static GglError bench(uint16_t sub_count) {
+    GglError ret = populate(sub_count);
+    if (ret != GGL_ERR_OK) {
+        return ret;
+    }
+
+    size_t publishes = LINEAR_SCAN_CHECKS / sub_count;
+    uint8_t mem[64];
+
+    uint32_t rand_state = 1;
+    size_t index_matches = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < publishes; i++) {
+        GglBuffer topic = device_topic(
+            mem, sizeof(mem), next_rand(&rand_state) % sub_count
+        );
+        ggl_topic_index_match(&bench_index, topic, count_match, &index_matches);
+    }
+    uint64_t index_ns = now_ns() - start;
+
+    rand_state = 1;
+    size_t linear_matches = 0;
+    start = now_ns();
+    for (size_t i = 0; i < publishes; i++) {
+        GglBuffer topic = device_topic(
+            mem, sizeof(mem), next_rand(&rand_state) % sub_count
+        );
+        for (uint16_t j = 0; j < sub_count; j++) {
+            if (ggl_topic_filter_match(
+                    ggl_topic_index_filter(&bench_index, sub_ids[j]), topic
+                )) {
+                linear_matches += 1;
+            }
+        }
+    }
+    uint64_t linear_ns = now_ns() - start;
+
+    if (index_matches != linear_matches) {
+        GGL_LOGE(
+            "Match count mismatch: index %zu, linear %zu.",
+            index_matches,
+            linear_matches
+        );
+        return GGL_ERR_FAILURE;
+    }
+
+    GGL_LOGI(
+        "%5u subscriptions: index %7.1f ns/publish, linear scan %9.1f "
+        "ns/publish (%zu publishes).",
+        sub_count,
+        (double) index_ns / (double) publishes,
+        (double) linear_ns / (double) publishes,
+        publishes
+    );
+    return GGL_ERR_OK;
+}
+
+GglError run_topic_index_bench(void) {
+    static const uint16_t SUB_COUNTS[] = { 10, 100, BENCH_MAX_SUBS };
+
+    for (size_t i = 0; i < sizeof(SUB_COUNTS) / sizeof(SUB_COUNTS[0]); i++) {
+        GglError ret = bench(SUB_COUNTS[i]);
+        if (ret != GGL_ERR_OK) {
+            return ret;
+        }
+    }
+    return GGL_ERR_OK;
+}